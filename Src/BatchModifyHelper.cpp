@@ -0,0 +1,253 @@
+﻿#include "BatchModifyHelper.hpp"
+#include "UndoScope.hpp"
+#include "Perf.hpp"
+#include "BrowserRepl.hpp"
+#include "JobManager.hpp"
+#include "MeshIntersectionHelper.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace BatchModifyHelper {
+
+static inline void Log (const GS::UniString& s)
+{
+    if (BrowserRepl::HasInstance())
+        BrowserRepl::GetInstance().LogToBrowser(s);
+}
+
+// Элементов, читаемых за один шаг задачи (Submit)
+static constexpr UIndex FetchSlice = 512;
+
+static inline double SecondsSince (const std::chrono::steady_clock::time_point& t0)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// ---------------- Параллельный расчёт ----------------
+static void ComputeParallel (std::vector<Item>& items, const ComputeFn& compute)
+{
+    const size_t n = items.size();
+    const size_t hw = std::max<size_t>(1, (size_t)std::thread::hardware_concurrency());
+    const size_t nThreads = std::min(hw, (n + 255) / 256); // мелкие пакеты — в одном потоке
+
+    Perf::Sink* sink = Perf::SinkScope::Current();
+    auto worker = [&](std::atomic<size_t>& next) {
+        Perf::SinkScope perf(sink);
+        const size_t chunk = 64;
+        for (size_t beg = next.fetch_add(chunk); beg < n; beg = next.fetch_add(chunk)) {
+            const size_t end = std::min(n, beg + chunk);
+            for (size_t i = beg; i < end; ++i) items[i].changed = compute(items[i]);
+        }
+    };
+
+    std::atomic<size_t> next(0);
+    if (nThreads <= 1) { worker(next); return; }
+
+    std::vector<std::thread> pool;
+    pool.reserve(nThreads);
+    for (size_t t = 0; t < nThreads; ++t) pool.emplace_back(worker, std::ref(next));
+    for (std::thread& th : pool) th.join();
+}
+
+// ---------------- Фазы пакета ----------------
+static void FetchRange (const GS::Array<API_Guid>& guids, UIndex from, UIndex to,
+                        const StoryLevels& stories, const FetchFn& fetch, std::vector<Item>& items, Stats& st)
+{
+    for (UIndex i = from; i < to; ++i) {
+        items.emplace_back();
+        Item& it = items.back();
+        it.elem.header.guid = guids[i];
+        if (Perf::ElementGet(&it.elem) != NoError) { items.pop_back(); ++st.failed; continue; }
+        it.floorZ = stories.Get(it.elem.header.floorInd);
+        if (fetch != nullptr && !fetch(it)) { items.pop_back(); ++st.failed; }
+    }
+}
+
+// группировка по типу: порядок записи — по индексам, сами элементы не двигаем
+static std::vector<UInt32> TypeOrder (const std::vector<Item>& items)
+{
+    std::vector<UInt32> order(items.size());
+    for (UInt32 i = 0; i < (UInt32)order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](UInt32 a, UInt32 b) {
+        return items[a].elem.header.type.typeID < items[b].elem.header.type.typeID;
+    });
+    return order;
+}
+
+static GSErrCode Commit (const char* undoName, std::vector<Item>& items, const std::vector<UInt32>& order,
+                         const MemoMaskFn& memoMask, Stats& st)
+{
+    return UndoScope::Call(undoName, [&]() -> GSErrCode {
+        API_Element mask;
+        for (UInt32 idx : order) {
+            Item& it = items[idx];
+            if (!it.changed) continue;
+            if (it.mask.Overflowed()) {
+                // часть полей не попала бы в маску — запись была бы неполной
+                Log(GS::UniString::Printf("[Batch] %s: field mask overflow, element skipped", undoName));
+                ++st.failed;
+                continue;
+            }
+            it.mask.Expand(mask);
+
+            const UInt64 mm = (memoMask != nullptr) ? memoMask(it.elem.header.type.typeID) : 0;
+            API_ElementMemo memo = {};
+            const bool hasMemo = (mm != 0) && (Perf::ElementGetMemo(it.elem.header.guid, &memo, mm) == NoError);
+
+            const GSErrCode chg = Perf::ElementChange(&it.elem, &mask, hasMemo ? &memo : nullptr, hasMemo ? mm : 0, true);
+            if (hasMemo) ACAPI_DisposeElemMemoHdls(&memo);
+
+            if (chg == NoError) ++st.changed;
+            else                ++st.failed;
+        }
+        return NoError;
+    });
+}
+
+static void LogStats (const char* tag, const Stats& st)
+{
+    Perf::AddTime(Perf::Timer::Fetch, st.fetchSec * 1000.0);
+    Perf::AddTime(Perf::Timer::Compute, st.computeSec * 1000.0);
+    Perf::AddTime(Perf::Timer::Commit, st.commitSec * 1000.0);
+
+    const double total = st.fetchSec + st.computeSec + st.commitSec;
+    Log(GS::UniString::Printf("%s changed=%u of %u, failed=%u | fetch %.3fs, compute %.3fs, commit %.3fs (%.0f el/s)",
+        tag, (unsigned)st.changed, (unsigned)st.requested, (unsigned)st.failed,
+        st.fetchSec, st.computeSec, st.commitSec, total > 1e-9 ? st.changed / total : 0.0));
+}
+
+// ---------------- Пакет ----------------
+bool Run (const char* undoName, const char* tag,
+          const GS::Array<API_Guid>& guids,
+          const ComputeFn& compute,
+          Stats* outStats,
+          const MemoMaskFn& memoMask,
+          const FetchFn& fetch)
+{
+    Stats st;
+    st.requested = (UInt32)guids.GetSize();
+    if (guids.IsEmpty() || compute == nullptr) {
+        if (outStats) *outStats = st;
+        return false;
+    }
+
+    // 1) чтение
+    auto t0 = std::chrono::steady_clock::now();
+    const StoryLevels stories;
+    std::vector<Item> items;
+    items.reserve(guids.GetSize());
+    FetchRange(guids, 0, guids.GetSize(), stories, fetch, items, st);
+    st.fetched = (UInt32)items.size();
+    const std::vector<UInt32> order = TypeOrder(items);
+    st.fetchSec = SecondsSince(t0);
+
+    // 2) расчёт
+    t0 = std::chrono::steady_clock::now();
+    ComputeParallel(items, compute);
+    for (const Item& it : items) if (it.changed) ++st.computed;
+    st.computeSec = SecondsSince(t0);
+
+    if (st.computed == 0) {
+        Log(GS::UniString::Printf("%s nothing to change (selected=%u)", tag, (unsigned)st.requested));
+        if (outStats) *outStats = st;
+        return false;
+    }
+
+    // 3) запись
+    t0 = std::chrono::steady_clock::now();
+    const GSErrCode err = Commit(undoName, items, order, memoMask, st);
+    st.commitSec = SecondsSince(t0);
+
+    LogStats(tag, st);
+    if (outStats) *outStats = st;
+    return err == NoError && st.changed > 0;
+}
+
+// ---------------- Пакет задачей ----------------
+UInt32 Submit (const char* undoName, const char* tag,
+               const GS::Array<API_Guid>& guids,
+               const ComputeFn& compute,
+               const MemoMaskFn& memoMask,
+               const FetchFn& fetch)
+{
+    if (guids.IsEmpty() || compute == nullptr) return 0;
+
+    // Состояние живёт в замыкании шага; элементы читаются порциями, чтобы idle не подвисал
+    struct State {
+        enum Phase { Fetch, Compute, Commit } phase = Fetch;
+        std::string              undoName, tag;
+        GS::Array<API_Guid>      guids;
+        ComputeFn                compute;
+        MemoMaskFn               memoMask;
+        FetchFn                  fetch;
+        std::unique_ptr<StoryLevels> stories;
+        std::vector<Item>        items;
+        std::vector<UInt32>      order;
+        UIndex                   next = 0;
+        Stats                    st;
+    };
+    auto state = std::make_shared<State>();
+    state->undoName = undoName;
+    state->tag = tag;
+    state->guids = guids;
+    state->compute = compute;
+    state->memoMask = memoMask;
+    state->fetch = fetch;
+    state->st.requested = (UInt32)guids.GetSize();
+
+    return JobManager::Submit(GS::UniString(undoName), [state](JobManager::Context& ctx) -> JobManager::Step {
+        State& s = *state;
+        const UIndex n = s.guids.GetSize();
+
+        switch (s.phase) {
+        case State::Fetch: {
+            const auto t0 = std::chrono::steady_clock::now();
+            if (s.stories == nullptr) { s.stories.reset(new StoryLevels()); s.items.reserve(n); }
+            const UIndex to = std::min<UIndex>(n, s.next + FetchSlice);
+            FetchRange(s.guids, s.next, to, *s.stories, s.fetch, s.items, s.st);
+            s.next = to;
+            s.st.fetchSec += SecondsSince(t0);
+            ctx.Report((UInt32)s.next, (UInt32)n, "fetch");
+            if (s.next < n) return JobManager::Step::Continue;
+
+            s.st.fetched = (UInt32)s.items.size();
+            s.order = TypeOrder(s.items);
+            s.phase = State::Compute;
+            ctx.Report(0, s.st.fetched, "compute");
+            ctx.RunAsync([state]() {
+                const auto c0 = std::chrono::steady_clock::now();
+                ComputeParallel(state->items, state->compute);
+                state->st.computeSec = SecondsSince(c0);
+            });
+            return JobManager::Step::Continue;
+        }
+        case State::Compute:
+            for (const Item& it : s.items) if (it.changed) ++s.st.computed;
+            if (s.st.computed == 0) {
+                Log(GS::UniString::Printf("%s nothing to change (selected=%u)", s.tag.c_str(), (unsigned)s.st.requested));
+                return JobManager::Step::Failed;
+            }
+            s.phase = State::Commit;
+            ctx.Report(0, s.st.computed, "commit");
+            return JobManager::Step::Continue;
+
+        case State::Commit: {
+            const auto t0 = std::chrono::steady_clock::now();
+            const GSErrCode err = Commit(s.undoName.c_str(), s.items, s.order, s.memoMask, s.st);
+            s.st.commitSec = SecondsSince(t0);
+            ctx.Report(s.st.changed, s.st.computed, "commit");
+            LogStats(s.tag.c_str(), s.st);
+            return (err == NoError && s.st.changed > 0) ? JobManager::Step::Done : JobManager::Step::Failed;
+        }
+        }
+        return JobManager::Step::Failed;
+    });
+}
+
+} // namespace BatchModifyHelper
@@ -0,0 +1,101 @@
+﻿#ifndef BATCHMODIFYHELPER_HPP
+#define BATCHMODIFYHELPER_HPP
+
+#include "APIEnvir.h"
+#include "ACAPinc.h"
+#include "GSRoot.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+// ============================================================================
+// BatchModifyHelper — пакетное изменение элементов
+//   1) чтение (главный поток): Element_Get + уровень этажа, группировка по типу
+//   2) расчёт (параллельно): только арифметика над копиями, без ACAPI и логов
+//   3) запись (главный поток): Element_Change по порядку в одной команде Undo
+// ============================================================================
+namespace BatchModifyHelper {
+
+    // Маска изменённых полей: до 8 байтовых диапазонов API_Element вместо второго API_Element
+    // на каждый элемент пакета. Полная маска собирается только на время Element_Change.
+    // Лишние диапазоны не теряются молча: элемент с переполненной маской не записывается.
+    class FieldMask {
+    public:
+        void Set (size_t offset, size_t size)
+        {
+            DBASSERT(m_count < MaxRanges);
+            if (m_count < MaxRanges) { m_off[m_count] = (UInt16)offset; m_len[m_count] = (UInt16)size; ++m_count; }
+            else m_overflow = true;
+        }
+        bool IsEmpty () const { return m_count == 0; }
+        bool Overflowed () const { return m_overflow; }
+
+        void Expand (API_Element& mask) const
+        {
+            ACAPI_ELEMENT_MASK_CLEAR(mask);
+            for (UInt32 i = 0; i < m_count; ++i)
+                std::memset(reinterpret_cast<char*>(&mask) + m_off[i], 0xFF, m_len[i]);
+        }
+
+    private:
+        static constexpr UInt32 MaxRanges = 8;
+        UInt16 m_off[MaxRanges] = {};
+        UInt16 m_len[MaxRanges] = {};
+        UInt32 m_count = 0;
+        bool   m_overflow = false;
+    };
+
+    struct Item {
+        API_Element elem = {};       // прочитанный элемент; ComputeFn правит его на месте
+        FieldMask   mask;
+        double      floorZ = 0.0;    // абсолютная отметка этажа элемента
+        bool        changed = false; // выставляется движком по результату ComputeFn
+        std::vector<API_Coord> footprint; // основание в плане (заполняет FetchFn, если нужен)
+    };
+
+    // Расчёт новых значений; вызывается из рабочих потоков. Возвращает true, если элемент надо записать
+    // (поля и mask заполнены). Внутри нельзя вызывать ACAPI и Log.
+    using ComputeFn = std::function<bool (Item& item)>;
+
+    // Какие части memo нужны для Change данного типа (0 — memo не нужен)
+    using MemoMaskFn = std::function<UInt64 (API_ElemTypeID typeID)>;
+
+    // Дочитать данные элемента при чтении (главный поток, ACAPI можно). false — элемент пропустить
+    using FetchFn = std::function<bool (Item& item)>;
+
+    struct Stats {
+        UInt32 requested = 0;
+        UInt32 fetched = 0;
+        UInt32 computed = 0;
+        UInt32 changed = 0;
+        UInt32 failed = 0;
+        double fetchSec = 0.0;
+        double computeSec = 0.0;
+        double commitSec = 0.0;
+    };
+
+    // Прогнать пакет; undoName — имя команды Undo, tag — префикс лога ("[Rotate]" и т.п.)
+    bool Run (const char* undoName, const char* tag,
+              const GS::Array<API_Guid>& guids,
+              const ComputeFn& compute,
+              Stats* outStats = nullptr,
+              const MemoMaskFn& memoMask = nullptr,
+              const FetchFn& fetch = nullptr);
+
+    // То же задачей JobManager: чтение порциями в idle, расчёт в рабочем потоке, запись одной командой Undo.
+    // compute, memoMask и fetch копируются и должны владеть своими данными. Возвращает ID задачи (0 — нечего делать)
+    UInt32 Submit (const char* undoName, const char* tag,
+                   const GS::Array<API_Guid>& guids,
+                   const ComputeFn& compute,
+                   const MemoMaskFn& memoMask = nullptr,
+                   const FetchFn& fetch = nullptr);
+
+}
+
+// Аналог ACAPI_ELEMENT_MASK_SET для FieldMask
+#define BATCH_MASK_SET(fieldMask, type, field) \
+    (fieldMask).Set(offsetof(type, field), sizeof(((type*)nullptr)->field))
+
+#endif // BATCHMODIFYHELPER_HPP
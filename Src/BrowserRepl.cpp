@@ -5,46 +5,68 @@
 
 #include "BrowserRepl.hpp"
 #include "SelectionHelper.hpp"
-#include "RotateHelper.hpp"
-#include "LandscapeHelper.hpp"
-#include "GroundHelper.hpp"
-#include "BuildHelper.hpp"
 #include "GDLHelper.hpp"
-#include "MarkupHelper.hpp"
-#include "RoadHelper.hpp"
 #include "HelpPalette.hpp"
 #include "LayerHelper.hpp"
-#include "ColumnOrientHelper.hpp"
+#include "JobManager.hpp"
+#include "CommandProtocol.hpp"
+#include "ReplEngine.hpp"
 
 
 
 #include <cmath>
 #include <cstdio>
 #include <cstring>
+#include <string>
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <vector>
 
 // --------------------- Palette GUID / Instance ---------------------
 static const GS::Guid paletteGuid("{11bd981d-f772-4a57-8709-42e18733a0cc}");
 GS::Ref<BrowserRepl> BrowserRepl::instance;
 
 // --------------------- Helpers (resource, js parsing, logging) ---------------------
-static GS::UniString LoadHtmlFromResource()
+// Страница палитры (DATA 100) и модули вкладок (DATA 101+, Module_*.html) декодируются
+// один раз и живут до выгрузки дополнения; модуль вкладки, которую не открывали, не читается.
+// Неудачная загрузка в кэш не попадает — повторный LoadModule попробует снова.
+static const GS::UniString& LoadHtmlFromResource(short resId = 100)
 {
-	GS::UniString resourceData;
-	GSHandle data = RSLoadResource('DATA', ACAPI_GetOwnResModule(), 100);
+	static std::map<short, GS::UniString> cache;
+	static const GS::UniString empty;
+	const auto it = cache.find(resId);
+	if (it != cache.end())
+		return it->second;
+
+	GSHandle data = RSLoadResource('DATA', ACAPI_GetOwnResModule(), resId);
 	if (data != nullptr) {
 		const GSSize handleSize = BMhGetSize(data);
+		GS::UniString& resourceData = cache[resId];
 		resourceData.Append(*data, handleSize);
 		BMhKill(&data);
 		if (BrowserRepl::HasInstance())
-			BrowserRepl::GetInstance().LogToBrowser(GS::UniString::Printf("[UI] HTML resource loaded, size=%u bytes", (unsigned)handleSize));
-		ACAPI_WriteReport("[BrowserRepl] HTML resource loaded, size=%u bytes", false, (unsigned)handleSize);
-	}
-	else {
-		if (BrowserRepl::HasInstance())
-			BrowserRepl::GetInstance().LogToBrowser("[UI] ERROR: HTML resource not found (DATA 100)");
-		ACAPI_WriteReport("[BrowserRepl] ERROR: HTML resource not found (DATA 100)", false);
+			BrowserRepl::GetInstance().LogToBrowser(GS::UniString::Printf("[UI] HTML resource %d loaded, size=%u bytes", (int)resId, (unsigned)handleSize));
+		ACAPI_WriteReport("[BrowserRepl] HTML resource %d loaded, size=%u bytes", false, (int)resId, (unsigned)handleSize);
+		return resourceData;
 	}
-	return resourceData;
+
+	if (BrowserRepl::HasInstance())
+		BrowserRepl::GetInstance().LogToBrowser(GS::UniString::Printf("[UI] ERROR: HTML resource not found (DATA %d)", (int)resId));
+	ACAPI_WriteReport("[BrowserRepl] ERROR: HTML resource not found (DATA %d)", false, (int)resId);
+	return empty;
+}
+
+// Модули вкладок: имя из TAB_MODULES страницы → ресурс DATA
+static short HtmlModuleResId(const GS::UniString& name)
+{
+	static const struct { const char* name; short resId; } kModules[] = {
+		{ "orient", 101 }, { "ground", 102 }, { "markup", 103 }, { "shell", 104 },
+		{ "id",     105 }, { "layers", 106 }, { "repl",   107 }, { "perf",  108 },
+	};
+	for (const auto& m : kModules)
+		if (name == GS::UniString(m.name)) return m.resId;
+	return 0;
 }
 
 // --- Extract double from JS::Base (supports 123 / "123.4" / "123,4") ---
@@ -79,7 +101,6 @@ static double GetDoubleFromJs(GS::Ref<JS::Base> p, double def = 0.0)
 	return def;
 }
 
-
 static GS::UniString GetStringFromJavaScriptVariable(GS::Ref<JS::Base> jsVariable)
 {
 	GS::Ref<JS::Value> jsValue = GS::DynamicCast<JS::Value>(jsVariable);
@@ -115,12 +136,77 @@ static GS::Ref<JS::Base> ConvertToJavaScriptVariable(const GS::Array<Type>& cppA
 	return newArray;
 }
 
-// Буфер последнего ΔZ (м) — используется, если ApplyZDelta вызвали без аргумента
-static double g_lastZDeltaMeters = 0.0;
+// Значение JS-аргумента как JSON: число, bool, строка; строка с JSON-объектом — готовые args
+static JsonLite::Value JsValueToJson(GS::Ref<JS::Base> param)
+{
+	GS::Ref<JS::Value> v = GS::DynamicCast<JS::Value>(param);
+	if (v == nullptr) return JsonLite::Value();
+	switch (v->GetType()) {
+	case JS::Value::DOUBLE:  return JsonLite::Value::Number(v->GetDouble());
+	case JS::Value::INTEGER: return JsonLite::Value::Number((double)v->GetInteger());
+	case JS::Value::BOOL:    return JsonLite::Value::Bool(v->GetBool());
+	case JS::Value::STRING: {
+		const std::string text = CommandProtocol::ToUtf8(v->GetString());
+		JsonLite::Value obj;
+		std::string err;
+		if (!text.empty() && text[0] == '{' && JsonLite::Parse(text, obj, err) && obj.IsObject()) return obj;
+		return JsonLite::Value::String(text);
+	}
+	default: return JsonLite::Value();
+	}
+}
+
+// Старый вызов ACAPI.Имя(аргумент) → команда CommandProtocol: объект — это args целиком,
+// одиночное значение — первый аргумент по схеме команды. Возвращает признак успеха
+static bool RunLegacyCommand(const char* name, GS::Ref<JS::Base> param)
+{
+	const CommandProtocol::Command* cmd = CommandProtocol::Find(name);
+	if (cmd == nullptr) return false;
+
+	const JsonLite::Value v = JsValueToJson(param);
+	JsonLite::Value args = JsonLite::Value::Object();
+	if (v.IsObject())                            args = v;
+	else if (!v.IsNull() && !cmd->params.empty()) args.Set(cmd->params[0].name, v);
+
+	JsonLite::Value call = JsonLite::Value::Object();
+	call.Set("cmd", JsonLite::Value::String(name));
+	call.Set("args", args);
+	const JsonLite::Value res = CommandProtocol::RunOne(call);
+	const JsonLite::Value* ok = res.Find("ok");
+	return ok != nullptr && ok->AsBool();
+}
+
+// Запуск долгой команды задачей JobManager: JSON {"cmd":..,"args":{..}}, задачу ставит обработчик
+// команды с "async":true. Возвращает ID задачи (0 — не запущена)
+static UInt32 SubmitJobCommand(const GS::UniString& spec)
+{
+	JsonLite::Value call;
+	std::string err;
+	if (!JsonLite::Parse(CommandProtocol::ToUtf8(spec), call, err) || !call.IsObject()) {
+		if (BrowserRepl::HasInstance())
+			BrowserRepl::GetInstance().LogToBrowser("[Job] bad spec: " + spec);
+		return 0;
+	}
+	const JsonLite::Value* args = call.Find("args");
+	JsonLite::Value a = (args != nullptr && args->IsObject()) ? *args : JsonLite::Value::Object();
+	a.Set("async", JsonLite::Value::Bool(true));
+	call.Set("args", a);
+
+	const JsonLite::Value res = CommandProtocol::RunOne(call);
+	const JsonLite::Value* value = res.Find("value");
+	const JsonLite::Value* jobId = (value != nullptr) ? value->Find("jobId") : nullptr;
+	return (jobId != nullptr && jobId->IsNumber()) ? (UInt32)jobId->AsNumber() : 0;
+}
 
 // --------------------- Project event handler ---------------------
 static GSErrCode __ACENV_CALL NotificationHandler(API_NotifyEventID notifID, Int32 /*param*/)
 {
+	// другой проект / принятые изменения Teamwork — имена слоёв могли поменяться
+	if (notifID != APINotify_Quit) {
+		SelectionHelper::InvalidateCaches();
+		LayerHelper::InvalidateCache();
+	}
+
 	if (notifID == APINotify_Quit) {
 		ACAPI_WriteReport("[BrowserRepl] APINotify_Quit to DestroyInstance", false);
 		BrowserRepl::DestroyInstance();
@@ -134,13 +220,18 @@ BrowserRepl::BrowserRepl() :
 	browser(GetReference(), BrowserId)
 {
 	ACAPI_WriteReport("[BrowserRepl] ctor", false);
-	ACAPI_ProjectOperation_CatchProjectEvent(APINotify_Quit, NotificationHandler);
+	ACAPI_ProjectOperation_CatchProjectEvent(APINotify_Quit | APINotify_New | APINotify_NewAndReset |
+		APINotify_Open | APINotify_Close | APINotify_ReceiveChanges, NotificationHandler);
 
 	// Подпишемся на изменение выделения (чтобы UI таблица актуализировалась)
 	const GSErr selErr = ACAPI_Notification_CatchSelectionChange(SelectionChangeHandler);
 	ACAPI_WriteReport("[BrowserRepl] CatchSelectionChange then err=%d", false, (int)selErr);
 
+	mainThreadId = std::this_thread::get_id();
+	lastLogFlush = std::chrono::steady_clock::now();
+
 	Attach(*this);
+	EnableIdleEvent();
 	BeginEventProcessing();
 	InitBrowserControl();
 }
@@ -148,6 +239,7 @@ BrowserRepl::BrowserRepl() :
 BrowserRepl::~BrowserRepl()
 {
 	ACAPI_WriteReport("[BrowserRepl] dtor", false);
+	JobManager::Shutdown();
 	EndEventProcessing();
 }
 
@@ -192,7 +284,8 @@ void BrowserRepl::InitBrowserControl()
 	LogToBrowser("[C++] BrowserRepl initialized");
 }
 
-void BrowserRepl::LogToBrowser(const GS::UniString& msg)
+// Экранирование строки для JS-литерала в двойных кавычках
+static GS::UniString EscapeForJs(const GS::UniString& msg)
 {
 	// UniString → UTF-8
 	std::string utf8(msg.ToCStr(CC_UTF8));
@@ -203,8 +296,92 @@ void BrowserRepl::LogToBrowser(const GS::UniString& msg)
 	jsSafe.ReplaceAll("\"", "\\\"");
 	jsSafe.ReplaceAll("\r", "");
 	jsSafe.ReplaceAll("\n", "\\n");
+	return jsSafe;
+}
+
+void BrowserRepl::LogToBrowser(const GS::UniString& msg)
+{
+	bool flushNow = false;
+	{
+		std::lock_guard<std::mutex> lock(logMutex);
+		if (logRing.size() != LogCapacity) logRing.resize(LogCapacity);
+		if (logCount == LogCapacity) {
+			// переполнение: затираем самое старое
+			logHead = (logHead + 1) % LogCapacity;
+			--logCount;
+			++logDropped;
+			++logDroppedTotal;
+		}
+		logRing[(logHead + logCount) % LogCapacity] = msg;
+		++logCount;
+
+		// из главного потока сбрасываем не чаще раза в LogFlushIntervalMs — долгие операции
+		// всё равно показывают прогресс, но без JS-вызова на каждую строку
+		if (std::this_thread::get_id() == mainThreadId) {
+			const auto now = std::chrono::steady_clock::now();
+			flushNow = (now - lastLogFlush) >= std::chrono::milliseconds(LogFlushIntervalMs);
+		}
+	}
+	if (flushNow) FlushLog();
+}
+
+void BrowserRepl::FlushLog()
+{
+	if (std::this_thread::get_id() != mainThreadId) return;
+
+	for (;;) {
+		GS::UniString js;
+		UInt32 dropped = 0;
+		UInt64 droppedTotal = 0;
+		size_t taken = 0;
+		{
+			std::lock_guard<std::mutex> lock(logMutex);
+			lastLogFlush = std::chrono::steady_clock::now();
+			if (logCount == 0 && logDropped == 0) return;
+
+			js = "AddLogBatch([";
+			taken = std::min(logCount, LogMaxBatch);
+			for (size_t i = 0; i < taken; ++i) {
+				GS::UniString& slot = logRing[(logHead + i) % LogCapacity];
+				if (i > 0) js += ",";
+				js += "\"" + EscapeForJs(slot) + "\"";
+				slot.Clear();
+			}
+			logHead = (logHead + taken) % LogCapacity;
+			logCount -= taken;
+			dropped = logDropped;
+			logDropped = 0;
+			droppedTotal = logDroppedTotal;
+			js += GS::UniString::Printf("],%u,%llu);", (unsigned)dropped, (unsigned long long)droppedTotal);
+		}
+		browser.ExecuteJS(js);
+		if (taken < LogMaxBatch) return;
+	}
+}
+
+void BrowserRepl::PanelIdle(const DG::PanelIdleEvent&)
+{
+	JobManager::Pump();
+	FlushLog();
+
+	// выделение синхронизируем, когда пользователь перестал его менять
+	if (selSyncPending &&
+		std::chrono::steady_clock::now() - selSyncRequestedAt >= std::chrono::milliseconds(SelectionDebounceMs))
+	{
+		SyncSelectionToHTML(false);
+	}
+}
+
+void BrowserRepl::PostJobEvent(UInt32 jobId, const GS::UniString& name, const char* state,
+	UInt32 done, UInt32 total, const GS::UniString& stage, double seconds)
+{
+	if (std::this_thread::get_id() != mainThreadId) return;
+	FlushLog(); // лог задачи должен прийти раньше её события
 
-	browser.ExecuteJS("AddLog(\"" + jsSafe + "\");");
+	GS::UniString js = GS::UniString::Printf("JobEvent({id:%u,state:\"%s\",done:%u,total:%u,sec:%.3f,name:\"",
+		(unsigned)jobId, state, (unsigned)done, (unsigned)total, seconds);
+	js += EscapeForJs(name) + "\",stage:\"" + EscapeForJs(stage) + "\"});";
+	browser.ExecuteJS(js);
 }
 
 // ------------------ JS API registration ---------------------
@@ -229,137 +406,41 @@ void BrowserRepl::RegisterACAPIJavaScriptObject()
 		return ConvertToJavaScriptVariable(elements);
 		}));
 
-	jsACAPI->AddItem(new JS::Function("AddElementToSelection", [](GS::Ref<JS::Base> param) {
-		const GS::UniString id = GetStringFromJavaScriptVariable(param);
-		// if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser("[JS] AddElementToSelection " + id);
-		SelectionHelper::ModifySelection(id, SelectionHelper::AddToSelection);
-		return ConvertToJavaScriptVariable(true);
-		}));
-
-	jsACAPI->AddItem(new JS::Function("RemoveElementFromSelection", [](GS::Ref<JS::Base> param) {
-		const GS::UniString id = GetStringFromJavaScriptVariable(param);
-		// if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser("[JS] RemoveElementFromSelection " + id);
-		SelectionHelper::ModifySelection(id, SelectionHelper::RemoveFromSelection);
-		return ConvertToJavaScriptVariable(true);
-		}));
-
-	jsACAPI->AddItem(new JS::Function("ChangeSelectedElementsID", [](GS::Ref<JS::Base> param) {
-		const GS::UniString baseID = GetStringFromJavaScriptVariable(param);
-		if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser("[JS] ChangeSelectedElementsID " + baseID);
-		const bool success = SelectionHelper::ChangeSelectedElementsID(baseID);
-		return ConvertToJavaScriptVariable(success);
-		}));
-
-	jsACAPI->AddItem(new JS::Function("CreateLayerAndMoveElements", [](GS::Ref<JS::Base> param) {
-		if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser("[JS] CreateLayerAndMoveElements");
-		
-		// Парсим параметры из JavaScript строки (передаем как JSON строку)
-		LayerHelper::LayerCreationParams params;
-		
-		GS::UniString jsonStr = GetStringFromJavaScriptVariable(param);
-		if (BrowserRepl::HasInstance()) {
-			BrowserRepl::GetInstance().LogToBrowser("[C++] JSON строка: " + jsonStr);
-		}
-		
-		// Простой парсинг JSON (папка|слой)
-		GS::Array<GS::UniString> parts;
-		jsonStr.Split(GS::UniString("|"), [&parts](const GS::UniString& part) {
-			parts.Push(part);
-		});
-		
-		if (parts.GetSize() >= 2) {
-			params.folderPath = parts[0];
-			params.layerName = parts[1];
-			params.baseID = GS::UniString(""); // ID не меняем
-		}
-		
-		if (BrowserRepl::HasInstance()) {
-			BrowserRepl::GetInstance().LogToBrowser(GS::UniString::Printf("[C++] Создание слоя: папка='%s', слой='%s', ID='%s'", 
-				params.folderPath.ToCStr().Get(), 
-				params.layerName.ToCStr().Get(), 
-				params.baseID.ToCStr().Get()));
-		}
-		
-		const bool success = LayerHelper::CreateLayerAndMoveElements(params);
-		return ConvertToJavaScriptVariable(success);
+	// Постраничная подгрузка: страница получает GUID-ы через SelectionDiff и запрашивает инфо порциями
+	jsACAPI->AddItem(new JS::Function("GetElementsInfo", [](GS::Ref<JS::Base> param) {
+		const GS::UniString guidList = GetStringFromJavaScriptVariable(param);
+		return ConvertToJavaScriptVariable(SelectionHelper::GetElementsInfo(guidList));
 		}));
 
-	// --- ΔZ API (двухшаговый буфер + совместимость со старым мостом) ---
-	jsACAPI->AddItem(new JS::Function("SetZDelta", [](GS::Ref<JS::Base> param) {
-		g_lastZDeltaMeters = GetDoubleFromJs(param, 0.0);
-		if (BrowserRepl::HasInstance())
-			BrowserRepl::GetInstance().LogToBrowser(GS::UniString::Printf("[JS] SetZDelta=%.3f m", g_lastZDeltaMeters));
+	jsACAPI->AddItem(new JS::Function("ResyncSelection", [](GS::Ref<JS::Base>) {
+		SelectionHelper::InvalidateCaches();
+		if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().UpdateSelectedElementsOnHTML();
 		return new JS::Value(true);
 		}));
 
-	jsACAPI->AddItem(new JS::Function("ApplyZDelta", [](GS::Ref<JS::Base> param) {
-		// Диагностика: проверяем что пришло
-		if (BrowserRepl::HasInstance()) {
-			if (param == nullptr) {
-				BrowserRepl::GetInstance().LogToBrowser("[JS] ApplyZDelta: param is nullptr!");
-			} else if (GS::Ref<JS::Value> v = GS::DynamicCast<JS::Value>(param)) {
-				const auto t = v->GetType();
-				if (t == JS::Value::DOUBLE || t == JS::Value::INTEGER) {
-					BrowserRepl::GetInstance().LogToBrowser(GS::UniString::Printf("[JS] ApplyZDelta: got number %.6f", v->GetDouble()));
-				} else if (t == JS::Value::STRING) {
-					BrowserRepl::GetInstance().LogToBrowser("[JS] ApplyZDelta: got string '" + v->GetString() + "'");
-				} else {
-					BrowserRepl::GetInstance().LogToBrowser(GS::UniString::Printf("[JS] ApplyZDelta: got type %d", (int)t));
-				}
-			} else {
-				BrowserRepl::GetInstance().LogToBrowser("[JS] ApplyZDelta: param is not JS::Value");
-			}
-		}
-		
-		const double val = (param != nullptr) ? GetDoubleFromJs(param, g_lastZDeltaMeters) : g_lastZDeltaMeters;
-		if (BrowserRepl::HasInstance())
-			BrowserRepl::GetInstance().LogToBrowser(GS::UniString::Printf("[JS] ApplyZDelta(%.3f m)", val));
-		const bool ok = GroundHelper::ApplyZDelta(val);
-		return new JS::Value(ok);
-		}));
-
-	// --- Ground API (посадка на Mesh) ---
-	jsACAPI->AddItem(new JS::Function("SetGroundSurface", [](GS::Ref<JS::Base>) {
-		if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser("[JS] SetGroundSurface()");
-		const bool ok = GroundHelper::SetGroundSurface();
-		return new JS::Value(ok);
-		}));
-
-	jsACAPI->AddItem(new JS::Function("SetGroundObjects", [](GS::Ref<JS::Base>) {
-		if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser("[JS] SetGroundObjects()");
-		const bool ok = GroundHelper::SetGroundObjects();
-		return new JS::Value(ok);
-		}));
-
-	jsACAPI->AddItem(new JS::Function("ApplyGroundOffset", [](GS::Ref<JS::Base> param) {
-		const double offset = GetDoubleFromJs(param, 0.0); // offset на C++ стороне сейчас игнорируется, но логируем
-		if (BrowserRepl::HasInstance())
-			BrowserRepl::GetInstance().LogToBrowser(GS::UniString::Printf("[JS] ApplyGroundOffset(%.3f m)", offset));
-		const bool ok = GroundHelper::ApplyGroundOffset(offset);
-		return new JS::Value(ok);
-		}));
-
-	// --- Rotate API ---
-	jsACAPI->AddItem(new JS::Function("RotateSelected", [](GS::Ref<JS::Base> param) {
-		const double angle = GetDoubleFromJs(param, 0.0);
-		if (BrowserRepl::HasInstance())
-			BrowserRepl::GetInstance().LogToBrowser(GS::UniString::Printf("[JS] RotateSelected angle=%.2f", angle));
-		return new JS::Value(RotateHelper::RotateSelected(angle));
-		}));
-
-	jsACAPI->AddItem(new JS::Function("AlignSelectedX", [](GS::Ref<JS::Base>) {
-		if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser("[JS] AlignSelectedX()");
-		return new JS::Value(RotateHelper::AlignSelectedX());
-		}));
-
-	jsACAPI->AddItem(new JS::Function("RandomizeSelectedAngles", [](GS::Ref<JS::Base>) {
-		if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser("[JS] RandomizeSelectedAngles()");
-		return new JS::Value(RotateHelper::RandomizeSelectedAngles());
-		}));
-
-	jsACAPI->AddItem(new JS::Function("OrientObjectsToPoint", [](GS::Ref<JS::Base>) {
-		if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser("[JS] OrientObjectsToPoint()");
-		return new JS::Value(RotateHelper::OrientObjectsToPoint());
+	// --- Старые функции моста: тонкие обёртки над командами CommandProtocol (проверка аргументов,
+	// Perf и запись макроса — там же). Новые вызовы страницы идут через Dispatch.
+	static const char* const kLegacyCommands[] = {
+		"AddElementToSelection", "RemoveElementFromSelection", "ChangeSelectedElementsID",
+		"CreateLayerAndMoveElements", "CreateLayersBatch",
+		"SetZDelta", "ApplyZDelta", "SetGroundSurface", "SetGroundObjects", "ApplyGroundOffset",
+		"RotateSelected", "AlignSelectedX", "RandomizeSelectedAngles", "SetRandomSettings",
+		"RandomizeSelected", "OrientObjectsToPoint",
+		"SetDistributionLine", "SetDistributionObject", "SetDistributionStep", "SetDistributionCount",
+		"SetDistributionClearance", "SetDistributionRandomize", "DistributeNow",
+		"SetColumns", "SetBeams", "SetMeshForColumns", "OrientColumnsToSurface", "OrientBeamsToSurface",
+		"RotateSelectedOrientation",
+		"SetMarkupStep", "CreateMarkupDimensions", "CreateDimensionsToLine",
+		"CreateDimensionsBetweenObjects", "CreateDimensionsToPoint",
+		"SetBaseLineForShell", "SetMeshSurfaceForShell", "BuildRoad"
+	};
+	for (const char* name : kLegacyCommands) {
+		jsACAPI->AddItem(new JS::Function(name, [name](GS::Ref<JS::Base> param) {
+			return new JS::Value(RunLegacyCommand(name, param));
+			}));
+	}
+	jsACAPI->AddItem(new JS::Function("CreateShellFromLine", [](GS::Ref<JS::Base> param) {
+		return new JS::Value(RunLegacyCommand("BuildRoad", param));
 		}));
 
 	// --- GDL Generator ---
@@ -368,107 +449,6 @@ void BrowserRepl::RegisterACAPIJavaScriptObject()
 		return new JS::Value(GDLHelper::GenerateGDLFromSelection());
 		}));
 
-	// --- Landscape API (заглушки с логом) ---
-	jsACAPI->AddItem(new JS::Function("SetDistributionLine", [](GS::Ref<JS::Base>) {
-		if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser("[JS] SetDistributionLine()");
-		return new JS::Value(LandscapeHelper::SetDistributionLine());
-		}));
-	jsACAPI->AddItem(new JS::Function("SetDistributionObject", [](GS::Ref<JS::Base>) {
-		if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser("[JS] SetDistributionObject()");
-		return new JS::Value(LandscapeHelper::SetDistributionObject());
-		}));
-	jsACAPI->AddItem(new JS::Function("SetDistributionStep", [](GS::Ref<JS::Base> param) {
-		const double step = GetDoubleFromJs(param, 0.0);
-		if (BrowserRepl::HasInstance())
-			BrowserRepl::GetInstance().LogToBrowser(GS::UniString::Printf("[JS] SetDistributionStep step=%.3f", step));
-		return new JS::Value(LandscapeHelper::SetDistributionStep(step));
-		}));
-	jsACAPI->AddItem(new JS::Function("SetDistributionCount", [](GS::Ref<JS::Base> param) {
-		const int count = (int)std::llround(GetDoubleFromJs(param, 0.0));
-		if (BrowserRepl::HasInstance())
-			BrowserRepl::GetInstance().LogToBrowser(GS::UniString::Printf("[JS] SetDistributionCount count=%d", count));
-		return new JS::Value(LandscapeHelper::SetDistributionCount(count));
-		}));
-	jsACAPI->AddItem(new JS::Function("DistributeNow", [](GS::Ref<JS::Base> param) {
-		// принимаем step/count в строке "step:.."/"count:.." или просто число
-		double step = 0.0; int count = 0;
-		if (GS::Ref<JS::Value> v = GS::DynamicCast<JS::Value>(param)) {
-			switch (v->GetType()) {
-			case JS::Value::DOUBLE:
-			case JS::Value::INTEGER: step = v->GetDouble(); break;
-			case JS::Value::STRING: {
-				GS::UniString s = v->GetString();
-				for (UIndex i = 0; i < s.GetLength(); ++i) if (s[i] == ',') s[i] = '.';
-				const char* c = s.ToCStr().Get();
-				if (std::strncmp(c, "step:", 5) == 0) { std::sscanf(c + 5, "%lf", &step); }
-				else if (std::strncmp(c, "count:", 6) == 0) { std::sscanf(c + 6, "%d", &count); }
-				else { std::sscanf(c, "%lf", &step); }
-				break;
-			}
-			default: break;
-			}
-		}
-		if (BrowserRepl::HasInstance()) {
-			BrowserRepl::GetInstance().LogToBrowser(GS::UniString::Printf("[JS] DistributeNow parsed: step=%.6f, count=%d", step, count));
-		}
-		return new JS::Value(LandscapeHelper::DistributeSelected(step, count));
-		}));
-
-	// --- Column/Beam Orientation API ---
-	jsACAPI->AddItem(new JS::Function("SetColumns", [](GS::Ref<JS::Base>) {
-		if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser("[JS] SetColumns()");
-		return new JS::Value(ColumnOrientHelper::SetColumns());
-		}));
-	jsACAPI->AddItem(new JS::Function("SetBeams", [](GS::Ref<JS::Base>) {
-		if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser("[JS] SetBeams()");
-		return new JS::Value(ColumnOrientHelper::SetBeams());
-		}));
-	jsACAPI->AddItem(new JS::Function("SetMeshForColumns", [](GS::Ref<JS::Base>) {
-		if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser("[JS] SetMeshForColumns()");
-		return new JS::Value(ColumnOrientHelper::SetMesh());
-		}));
-	jsACAPI->AddItem(new JS::Function("OrientColumnsToSurface", [](GS::Ref<JS::Base>) {
-		if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser("[JS] OrientColumnsToSurface()");
-		return new JS::Value(ColumnOrientHelper::OrientColumnsToSurface());
-		}));
-	jsACAPI->AddItem(new JS::Function("OrientBeamsToSurface", [](GS::Ref<JS::Base>) {
-		if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser("[JS] OrientBeamsToSurface()");
-		return new JS::Value(ColumnOrientHelper::OrientBeamsToSurface());
-		}));
-	jsACAPI->AddItem(new JS::Function("RotateSelectedOrientation", [](GS::Ref<JS::Base> param) {
-		// Диагностика параметра (для отладки)
-		double angleDeg = 0.0;
-		if (BrowserRepl::HasInstance()) {
-			if (param == nullptr) {
-				BrowserRepl::GetInstance().LogToBrowser("[JS] RotateSelectedOrientation: param is nullptr!");
-			} else if (GS::Ref<JS::Value> v = GS::DynamicCast<JS::Value>(param)) {
-				const auto t = v->GetType();
-				if (t == JS::Value::DOUBLE) {
-					angleDeg = v->GetDouble();
-					BrowserRepl::GetInstance().LogToBrowser(GS::UniString::Printf("[JS] RotateSelectedOrientation: got DOUBLE %.6f", angleDeg));
-				} else if (t == JS::Value::INTEGER) {
-					angleDeg = static_cast<double>(v->GetInteger());
-					BrowserRepl::GetInstance().LogToBrowser(GS::UniString::Printf("[JS] RotateSelectedOrientation: got INTEGER %d -> %.6f", (int)v->GetInteger(), angleDeg));
-				} else if (t == JS::Value::STRING) {
-					BrowserRepl::GetInstance().LogToBrowser("[JS] RotateSelectedOrientation: got string '" + v->GetString() + "'");
-					angleDeg = GetDoubleFromJs(param, 0.0);
-				} else {
-					BrowserRepl::GetInstance().LogToBrowser(GS::UniString::Printf("[JS] RotateSelectedOrientation: got unknown type %d", (int)t));
-					angleDeg = GetDoubleFromJs(param, 0.0);
-				}
-			} else {
-				BrowserRepl::GetInstance().LogToBrowser("[JS] RotateSelectedOrientation: param is not JS::Value, using GetDoubleFromJs");
-				angleDeg = GetDoubleFromJs(param, 0.0);
-			}
-		} else {
-			angleDeg = GetDoubleFromJs(param, 0.0);
-		}
-		
-		if (BrowserRepl::HasInstance())
-			BrowserRepl::GetInstance().LogToBrowser(GS::UniString::Printf("[JS] RotateSelectedOrientation final: angleDeg=%.3f", angleDeg));
-		return new JS::Value(ColumnOrientHelper::RotateSelected(angleDeg));
-		}));
-
 	// --- Help / Log ---
 	jsACAPI->AddItem(new JS::Function("OpenHelp", [](GS::Ref<JS::Base> param) {
 		GS::UniString url;
@@ -493,110 +473,37 @@ void BrowserRepl::RegisterACAPIJavaScriptObject()
 		return new JS::Value(true);
 		}));
 
-	// --- Markup API (разметка размерами) ---
-	jsACAPI->AddItem(new JS::Function("SetMarkupStep", [](GS::Ref<JS::Base> param) {
-		// Диагностика: проверяем что пришло
-		if (BrowserRepl::HasInstance()) {
-			if (param == nullptr) {
-				BrowserRepl::GetInstance().LogToBrowser("[JS] SetMarkupStep: param is nullptr!");
-			} else if (GS::Ref<JS::Value> v = GS::DynamicCast<JS::Value>(param)) {
-				const auto t = v->GetType();
-				if (t == JS::Value::DOUBLE || t == JS::Value::INTEGER) {
-					BrowserRepl::GetInstance().LogToBrowser(GS::UniString::Printf("[JS] SetMarkupStep: got number %.6f", v->GetDouble()));
-				} else if (t == JS::Value::STRING) {
-					BrowserRepl::GetInstance().LogToBrowser("[JS] SetMarkupStep: got string '" + v->GetString() + "'");
-				} else {
-					BrowserRepl::GetInstance().LogToBrowser(GS::UniString::Printf("[JS] SetMarkupStep: got type %d", (int)t));
-				}
-			} else {
-				BrowserRepl::GetInstance().LogToBrowser("[JS] SetMarkupStep: param is not JS::Value");
-			}
-		}
-		
-		const double stepMM = GetDoubleFromJs(param, 0.0);
-		if (BrowserRepl::HasInstance())
-			BrowserRepl::GetInstance().LogToBrowser(GS::UniString::Printf("[JS] SetMarkupStep parsed=%.1f mm", stepMM));
-		return new JS::Value(MarkupHelper::SetMarkupStep(stepMM));
+	// --- Пакет JSON-команд (CommandProtocol): один вызов на много операций ---
+	jsACAPI->AddItem(new JS::Function("Dispatch", [](GS::Ref<JS::Base> param) {
+		const std::string reply = CommandProtocol::Execute(CommandProtocol::ToUtf8(GetStringFromJavaScriptVariable(param)));
+		return new JS::Value(CommandProtocol::FromUtf8(reply));
 		}));
 
-	jsACAPI->AddItem(new JS::Function("CreateMarkupDimensions", [](GS::Ref<JS::Base>) {
-		return new JS::Value(MarkupHelper::CreateMarkupDimensions());
+	jsACAPI->AddItem(new JS::Function("DescribeCommands", [](GS::Ref<JS::Base>) {
+		return new JS::Value(CommandProtocol::FromUtf8(CommandProtocol::DescribeJson()));
 		}));
 
-	jsACAPI->AddItem(new JS::Function("CreateDimensionsToLine", [](GS::Ref<JS::Base>) {
-		if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser("[JS] CreateDimensionsToLine()");
-		return new JS::Value(MarkupHelper::CreateDimensionsToLine());
+	// --- REPL: скрипт целиком, одна команда Undo ---
+	jsACAPI->AddItem(new JS::Function("RunScript", [](GS::Ref<JS::Base> param) {
+		const std::string reply = ReplEngine::RunJson(CommandProtocol::ToUtf8(GetStringFromJavaScriptVariable(param)));
+		return new JS::Value(CommandProtocol::FromUtf8(reply));
 		}));
 
-	jsACAPI->AddItem(new JS::Function("CreateDimensionsBetweenObjects", [](GS::Ref<JS::Base>) {
-		if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser("[JS] CreateDimensionsBetweenObjects()");
-		return new JS::Value(MarkupHelper::CreateDimensionsBetweenObjects());
-		}));
-
-	jsACAPI->AddItem(new JS::Function("CreateDimensionsToPoint", [](GS::Ref<JS::Base>) {
-		if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser("[JS] CreateDimensionsToPoint()");
-		return new JS::Value(MarkupHelper::CreateDimensionsToPoint());
-		}));
-
-	// --- Road API (выбор осевой линии) ---
-	jsACAPI->AddItem(new JS::Function("SetBaseLineForShell", [](GS::Ref<JS::Base>) {
-		if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser("[JS] SetBaseLineForShell() [Road]");
-		
-		const bool success = RoadHelper::SetCenterLine();
-		return new JS::Value(success);
+	// --- Модуль вкладки (разметка + скрипт), страница вставляет его при первом открытии ---
+	jsACAPI->AddItem(new JS::Function("LoadModule", [](GS::Ref<JS::Base> param) {
+		const short resId = HtmlModuleResId(GetStringFromJavaScriptVariable(param));
+		if (resId == 0) return new JS::Value(GS::UniString());
+		return new JS::Value(LoadHtmlFromResource(resId));
 		}));
 
-	jsACAPI->AddItem(new JS::Function("SetMeshSurfaceForShell", [](GS::Ref<JS::Base>) {
-		if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser("[JS] SetMeshSurfaceForShell() [Road]");
-		
-		const bool success = RoadHelper::SetTerrainMesh();
-		return new JS::Value(success);
+	// --- Jobs (долгие команды без блокировки палитры) ---
+	jsACAPI->AddItem(new JS::Function("SubmitJob", [](GS::Ref<JS::Base> param) {
+		return new JS::Value((double)SubmitJobCommand(GetStringFromJavaScriptVariable(param)));
 		}));
 
-	// --- Road API (создание дорожки по линии) ---
-	jsACAPI->AddItem(new JS::Function("CreateShellFromLine", [](GS::Ref<JS::Base> param) {
-		// Парсим параметры: принимаем строку "width:..,step:.." или просто число
-		double width = 1000.0; // мм по умолчанию
-		double step = 500.0;   // мм по умолчанию
-		
-		if (param != nullptr) {
-			if (GS::Ref<JS::Value> v = GS::DynamicCast<JS::Value>(param)) {
-				switch (v->GetType()) {
-				case JS::Value::DOUBLE:
-				case JS::Value::INTEGER: 
-					width = v->GetDouble(); 
-					break;
-				case JS::Value::STRING: {
-					GS::UniString s = v->GetString();
-					for (UIndex i = 0; i < s.GetLength(); ++i) if (s[i] == ',') s[i] = '.';
-					const char* c = s.ToCStr().Get();
-					if (std::strncmp(c, "width:", 6) == 0) { 
-						std::sscanf(c + 6, "%lf", &width); 
-					}
-					if (std::strstr(c, "step:") != nullptr) {
-						const char* stepStart = std::strstr(c, "step:");
-						if (stepStart != nullptr) {
-							std::sscanf(stepStart + 5, "%lf", &step);
-						}
-					}
-					break;
-				}
-				default: break;
-				}
-			}
-		}
-		
-		if (BrowserRepl::HasInstance()) {
-			BrowserRepl::GetInstance().LogToBrowser(GS::UniString::Printf("[JS] CreateShellFromLine parsed: width=%.1fmm, step=%.1fmm", width, step));
-		}
-		
-		ACAPI_WriteReport("[BrowserRepl] Вызов RoadHelper::BuildRoad", false);
-		RoadHelper::RoadParams params;
-		params.widthMM = width;
-		params.sampleStepMM = step;
-		const bool success = RoadHelper::BuildRoad(params);
-		ACAPI_WriteReport("[BrowserRepl] RoadHelper::BuildRoad вернул: %s", false, success ? "true" : "false");
-		return new JS::Value(success);
+	jsACAPI->AddItem(new JS::Function("CancelJob", [](GS::Ref<JS::Base> param) {
+		const UInt32 jobId = (UInt32)std::llround(GetDoubleFromJs(param, 0.0));
+		return new JS::Value(JobManager::Cancel(jobId));
 		}));
 
 	// --- Register object in the browser ---
@@ -608,7 +515,59 @@ void BrowserRepl::RegisterACAPIJavaScriptObject()
 void BrowserRepl::UpdateSelectedElementsOnHTML()
 {
 	ACAPI_WriteReport("[BrowserRepl] UpdateSelectedElementsOnHTML()", false);
-	browser.ExecuteJS("UpdateSelectedElements()");
+	SyncSelectionToHTML(true);
+}
+
+void BrowserRepl::RequestSelectionSync()
+{
+	selSyncPending = true;
+	selSyncRequestedAt = std::chrono::steady_clock::now();
+}
+
+static bool GuidLess(const API_Guid& a, const API_Guid& b)
+{
+	return std::memcmp(&a, &b, sizeof(API_Guid)) < 0;
+}
+
+static void AppendGuidArray(GS::UniString& js, const std::vector<API_Guid>& guids)
+{
+	js += "[";
+	for (size_t i = 0; i < guids.size(); ++i) {
+		if (i > 0) js += ",";
+		js += "\"" + APIGuidToString(guids[i]) + "\"";
+	}
+	js += "]";
+}
+
+void BrowserRepl::SyncSelectionToHTML(bool full)
+{
+	selSyncPending = false;
+
+	const GS::Array<API_Guid> sel = SelectionHelper::GetSelectedGuids();
+	std::vector<API_Guid> current;
+	current.reserve(sel.GetSize());
+	for (const API_Guid& g : sel) current.push_back(g);
+	std::sort(current.begin(), current.end(), GuidLess);
+	current.erase(std::unique(current.begin(), current.end()), current.end());
+
+	if (full) lastSentSelection.clear();
+
+	std::vector<API_Guid> added, removed;
+	std::set_difference(current.begin(), current.end(), lastSentSelection.begin(), lastSentSelection.end(),
+		std::back_inserter(added), GuidLess);
+	std::set_difference(lastSentSelection.begin(), lastSentSelection.end(), current.begin(), current.end(),
+		std::back_inserter(removed), GuidLess);
+
+	if (!full && added.empty() && removed.empty()) return;
+
+	GS::UniString js = "SelectionDiff(";
+	AppendGuidArray(js, added);
+	js += ",";
+	AppendGuidArray(js, removed);
+	js += GS::UniString::Printf(",%u,%s);", (unsigned)current.size(), full ? "true" : "false");
+	browser.ExecuteJS(js);
+
+	lastSentSelection.swap(current);
 }
 
 void BrowserRepl::SetMenuItemCheckedState(bool isChecked)
@@ -642,9 +601,8 @@ void BrowserRepl::PanelCloseRequested(const DG::PanelCloseRequestEvent&, bool* a
 
 GSErrCode __ACENV_CALL BrowserRepl::SelectionChangeHandler(const API_Neig*)
 {
-	ACAPI_WriteReport("[BrowserRepl] Selection changed then update UI", false);
 	if (BrowserRepl::HasInstance())
-		BrowserRepl::GetInstance().UpdateSelectedElementsOnHTML();
+		BrowserRepl::GetInstance().RequestSelectionSync();
 	return NoError;
 }
 
@@ -8,6 +8,11 @@
 #include "DGDefs.h"
 #include "DGBrowser.hpp"
 
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 
 // Класс BrowserRepl управляет палитрой и встроенным браузером
 class BrowserRepl : public DG::Palette, public DG::PanelObserver {
@@ -24,25 +29,58 @@ public:
     void Hide();
     void InitBrowserControl();
 
-    void UpdateSelectedElementsOnHTML();
+    void UpdateSelectedElementsOnHTML();   // полная пересинхронизация выделения (страница получит всё как added)
+    void RequestSelectionSync();           // отложенная синхронизация (debounce), отработает в PanelIdle
+    void SyncSelectionToHTML(bool full);   // отправить в страницу SelectionDiff(added, removed, total)
     static GSErrCode __ACENV_CALL SelectionChangeHandler(const API_Neig*);
     static GSErrCode __ACENV_CALL PaletteControlCallBack(Int32 referenceID, API_PaletteMessageID messageID, GS::IntPtr param);
 
     static GSErrCode RegisterPaletteControlCallBack();
 
     // --- Новый публичный метод для логов ---
+    // Сообщение кладётся в кольцевой буфер (можно из любого потока); на странице оно
+    // появится пачкой при ближайшем сбросе — по таймеру или в idle палитры.
     void LogToBrowser(const GS::UniString& msg);
 
+    // Немедленно отправить накопленные сообщения (только главный поток)
+    void FlushLog();
+
+    // Событие задачи JobManager → JobEvent({...}) на странице (только главный поток)
+    void PostJobEvent(UInt32 jobId, const GS::UniString& name, const char* state,
+                      UInt32 done, UInt32 total, const GS::UniString& stage, double seconds);
+
 private:
     static GS::Ref<BrowserRepl> instance;
     DG::Browser browser;   // приватный браузер
 
+    // --- Буфер логов ---
+    static constexpr size_t LogCapacity = 2048;     // сообщений в кольце; при переполнении старые отбрасываются
+    static constexpr size_t LogMaxBatch = 512;      // сообщений за один ExecuteJS
+    static constexpr int    LogFlushIntervalMs = 200;
+
+    std::mutex                            logMutex;
+    std::vector<GS::UniString>            logRing;
+    size_t                                logHead = 0;   // индекс самого старого сообщения
+    size_t                                logCount = 0;
+    UInt32                                logDropped = 0; // отброшено с прошлого сброса
+    UInt64                                logDroppedTotal = 0; // за сессию, передаётся в AddLogBatch
+    std::chrono::steady_clock::time_point lastLogFlush;
+    std::thread::id                       mainThreadId;
+
+    // --- Синхронизация выделения ---
+    static constexpr int SelectionDebounceMs = 150;
+
+    bool                                  selSyncPending = false;
+    std::chrono::steady_clock::time_point selSyncRequestedAt;
+    std::vector<API_Guid>                 lastSentSelection; // отсортировано (GuidLess)
+
     void RegisterACAPIJavaScriptObject();
     void SetMenuItemCheckedState(bool isChecked);
 
     // DG overrides
     void PanelResized(const DG::PanelResizeEvent& ev) override;
     void PanelCloseRequested(const DG::PanelCloseRequestEvent& ev, bool* accepted) override;
+    void PanelIdle(const DG::PanelIdleEvent& ev) override;
 };
 
 #endif // BROWSERREPL_HPP
@@ -1,6 +1,9 @@
 ﻿#include "BuildHelper.hpp"
 #include "ACAPinc.h"
 #include "BrowserRepl.hpp"
+#include "Perf.hpp"
+#include "OffsetHelper.hpp"
+#include "PolygonHelper.hpp"
 
 #include <cmath>
 #include <algorithm>   // std::min/max
@@ -106,13 +109,19 @@ namespace BuildHelper {
 	}
 
 	// ------------------------------------------------------------
-	// Вспомогательное: создать плиту из одного внешнего контура
+	// Вспомогательное: создать плиту из внешнего контура (и дыр)
 	// ------------------------------------------------------------
-	static GSErrCode CreateSlabFromContour(const GS::Array<API_Coord>& contour)
+	static GSErrCode CreateSlabFromContour(const GS::Array<API_Coord>& contour,
+		const GS::Array<GS::Array<API_Coord>>& holes = GS::Array<GS::Array<API_Coord>>())
 	{
 		if (contour.GetSize() < 3)
 			return APIERR_GENERAL;
 
+		GS::Array<const GS::Array<API_Coord>*> rings;
+		rings.Push(&contour);
+		for (const auto& h : holes)
+			if (h.GetSize() >= 3) rings.Push(&h);
+
 		API_Element slab = {};
 		slab.header.type = API_SlabID;
 		GSErrCode e = ACAPI_Element_GetDefaults(&slab, nullptr);
@@ -123,8 +132,11 @@ namespace BuildHelper {
 		API_ElementMemo memo = {};
 		BNZeroMemory(&memo, sizeof(API_ElementMemo));
 
-		const Int32 nUnique = (Int32)contour.GetSize();
-		const Int32 nCoords = nUnique + 1; // + замыкающая точка
+		// Каждый контур замыкается повтором первой точки
+		const Int32 nSubPolys = (Int32)rings.GetSize();
+		Int32 nCoords = 0;
+		for (const auto* r : rings)
+			nCoords += (Int32)r->GetSize() + 1;
 
 		// coords — 1-based! (документация по API_Polygon / ElementMemo) :contentReference[oaicite:1]{index=1}
 		memo.coords = reinterpret_cast<API_Coord**>(BMAllocateHandle((nCoords + 1) * (GSSize)sizeof(API_Coord), ALLOCATE_CLEAR, 0));
@@ -132,27 +144,32 @@ namespace BuildHelper {
 			Log("Memory allocation failed (coords).");
 			return APIERR_MEMFULL;
 		}
-		for (Int32 i = 0; i < nUnique; ++i)
-			(*memo.coords)[i + 1] = contour[i];
-		(*memo.coords)[nCoords] = (*memo.coords)[1]; // замкнуть
 
-		// Один внешний контур: pends = [0, nCoords] (размер nSubPolys+1 = 2) :contentReference[oaicite:2]{index=2}
-		memo.pends = reinterpret_cast<Int32**>(BMAllocateHandle(2 * (GSSize)sizeof(Int32), ALLOCATE_CLEAR, 0));
+		// pends = [0, конец 1-го контура, конец 2-го, ...] (размер nSubPolys+1) :contentReference[oaicite:2]{index=2}
+		memo.pends = reinterpret_cast<Int32**>(BMAllocateHandle((nSubPolys + 1) * (GSSize)sizeof(Int32), ALLOCATE_CLEAR, 0));
 		if (memo.pends == nullptr) {
 			ACAPI_DisposeElemMemoHdls(&memo);
 			Log("Memory allocation failed (pends).");
 			return APIERR_MEMFULL;
 		}
 		(*memo.pends)[0] = 0;
-		(*memo.pends)[1] = nCoords;
+		Int32 idx = 0;
+		for (Int32 k = 0; k < nSubPolys; ++k) {
+			const GS::Array<API_Coord>& r = *rings[k];
+			const Int32 first = idx + 1;
+			for (const API_Coord& c : r)
+				(*memo.coords)[++idx] = c;
+			(*memo.coords)[++idx] = (*memo.coords)[first]; // замкнуть
+			(*memo.pends)[k + 1] = idx;
+		}
 		memo.parcs = nullptr; // без дуг
 
 		slab.slab.poly.nCoords = nCoords;
-		slab.slab.poly.nSubPolys = 1;
+		slab.slab.poly.nSubPolys = nSubPolys;
 		slab.slab.poly.nArcs = 0;
 
 		// Создать элемент
-		e = ACAPI_Element_Create(&slab, &memo);
+		e = Perf::ElementCreate(&slab, &memo);
 		ACAPI_DisposeElemMemoHdls(&memo);
 		return e;
 	}
@@ -178,6 +195,53 @@ namespace BuildHelper {
 		return CreateSlabFromContour(contour);
 	}
 
+	// ------------------------------------------------------------
+	// Вспомогательное: осевой путь кривой — отрезки и настоящие дуги
+	// ------------------------------------------------------------
+	bool CollectCurvePath(const API_Element& curve, OffsetHelper::Path& path)
+	{
+		const API_ElemTypeID tid = curve.header.type.typeID;
+		path.Clear();
+
+		if (tid == API_LineID) {
+			OffsetHelper::AddLine(path, curve.line.begC, curve.line.endC);
+		}
+		else if (tid == API_PolyLineID) {
+			API_ElementMemo pm = {};
+			if (Perf::ElementGetMemo(curve.header.guid, &pm, APIMemoMask_Polygon) == NoError && pm.coords != nullptr) {
+				const Int32 n = (Int32)(BMGetHandleSize((GSHandle)pm.coords) / sizeof(API_Coord)) - 1;
+				const Int32 nArcs = (pm.parcs != nullptr) ? (Int32)(BMGetHandleSize((GSHandle)pm.parcs) / sizeof(API_PolyArc)) : 0;
+				for (Int32 i = 1; i < n; ++i) {
+					double arcAngle = 0.0;
+					for (Int32 k = 0; k < nArcs; ++k)
+						if ((*pm.parcs)[k].begIndex == i) { arcAngle = (*pm.parcs)[k].arcAngle; break; }
+					OffsetHelper::AddPolylineArc(path, (*pm.coords)[i], (*pm.coords)[i + 1], arcAngle);
+				}
+			}
+			ACAPI_DisposeElemMemoHdls(&pm);
+		}
+		else if (tid == API_ArcID) {
+			// Дуга Archicad идёт против часовой от begAng к endAng
+			const API_ArcType& a = curve.arc;
+			double sweep = a.endAng - a.begAng;
+			if (sweep <= 0.0) sweep += 2.0 * 3.14159265358979323846;
+			OffsetHelper::AddArc(path, a.origC, a.r, a.begAng, sweep);
+		}
+		else if (tid == API_SplineID) {
+			// Для сплайна координаты тоже приходят через memo.coords (см. примеры в сообществе/доках) :contentReference[oaicite:3]{index=3}
+			API_ElementMemo pm = {};
+			if (Perf::ElementGetMemo(curve.header.guid, &pm, APIMemoMask_All) == NoError && pm.coords != nullptr) {
+				const Int32 n = (Int32)(BMGetHandleSize((GSHandle)pm.coords) / sizeof(API_Coord)) - 1;
+				GS::Array<API_Coord> pts;
+				for (Int32 i = 1; i <= n; ++i) pts.Push((*pm.coords)[i]);
+				OffsetHelper::AddPoints(path, pts);
+			}
+			ACAPI_DisposeElemMemoHdls(&pm);
+		}
+
+		return !path.IsEmpty();
+	}
+
 	// ------------------------------------------------------------
 	// Публичное: выбрать кривую для плиты
 	// ------------------------------------------------------------
@@ -216,9 +280,11 @@ namespace BuildHelper {
 			Log(m);
 		}
 
-		// Берём заранее сохранённую кривую, иначе — первую из текущего выделения
-		API_Guid curveGuid = g_slabCurveGuid;
-		if (!GuidIsValid(curveGuid)) {
+		// Берём заранее сохранённую кривую, иначе — все кривые из текущего выделения
+		GS::Array<API_Guid> curveGuids;
+		if (GuidIsValid(g_slabCurveGuid)) {
+			curveGuids.Push(g_slabCurveGuid);
+		} else {
 			API_SelectionInfo selInfo = {};
 			GS::Array<API_Neig> selNeigs;
 			ACAPI_Selection_Get(&selInfo, &selNeigs, false, false);
@@ -228,114 +294,65 @@ namespace BuildHelper {
 				Log("No curve selected.");
 				return false;
 			}
-			curveGuid = selNeigs[0].guid;
-		}
-
-		API_Element curve = {}; curve.header.guid = curveGuid;
-		if (ACAPI_Element_Get(&curve) != NoError) {
-			Log("Failed to get selected element.");
-			return false;
-		}
-		const API_ElemTypeID tid = curve.header.type.typeID;
-		if (!IsCurveType(tid)) {
-			Log("Selected element is not a curve (Line/Polyline/Arc/Spline).");
-			return false;
+			for (const API_Neig& n : selNeigs)
+				curveGuids.Push(n.guid);
 		}
 
-		// ---------- 1) собрать осевую ломаную pts ----------
-		GS::Array<API_Coord> pts;
-
-		if (tid == API_LineID) {
-			pts.Push(curve.line.begC);
-			pts.Push(curve.line.endC);
-		}
-		else if (tid == API_PolyLineID) {
-			API_ElementMemo pm = {};
-			if (ACAPI_Element_GetMemo(curve.header.guid, &pm, APIMemoMask_Polygon) == NoError && pm.coords != nullptr) {
-				const Int32 n = (Int32)(BMGetHandleSize((GSHandle)pm.coords) / sizeof(API_Coord)) - 1;
-				for (Int32 i = 1; i <= n; ++i) pts.Push((*pm.coords)[i]);
-			}
-			ACAPI_DisposeElemMemoHdls(&pm);
-		}
-		else if (tid == API_ArcID) {
-			const API_ArcType& a = curve.arc;
-			const double a0 = a.begAng, a1 = a.endAng;
-			const int    segs = 24;
-			const double dA = (a1 - a0) / segs;
-			for (int i = 0; i <= segs; ++i) {
-				const double ang = a0 + i * dA;
-				pts.Push({ a.origC.x + a.r * std::cos(ang), a.origC.y + a.r * std::sin(ang) });
-			}
-		}
-		else if (tid == API_SplineID) {
-			// Для сплайна координаты тоже приходят через memo.coords (см. примеры в сообществе/доках) :contentReference[oaicite:3]{index=3}
-			API_ElementMemo pm = {};
-			if (ACAPI_Element_GetMemo(curve.header.guid, &pm, APIMemoMask_All) == NoError && pm.coords != nullptr) {
-				const Int32 n = (Int32)(BMGetHandleSize((GSHandle)pm.coords) / sizeof(API_Coord)) - 1;
-				for (Int32 i = 1; i <= n; ++i) pts.Push((*pm.coords)[i]);
-			}
-			ACAPI_DisposeElemMemoHdls(&pm);
+		// ---------- 1) ленты по каждой кривой: офсет-кромки с честными дугами, петли на тугих изгибах срезаны ----------
+		GS::Array<PolygonHelper::Polygon> bands;
+		OffsetHelper::Path firstPath;
+		UInt32 nCurves = 0;
+		for (const API_Guid& g : curveGuids) {
+			API_Element curve = {}; curve.header.guid = g;
+			if (Perf::ElementGet(&curve) != NoError || !IsCurveType(curve.header.type.typeID))
+				continue;
+			OffsetHelper::Path path;
+			if (!CollectCurvePath(curve, path))
+				continue;
+			if (firstPath.IsEmpty())
+				firstPath = path;
+			++nCurves;
+			GS::Array<OffsetHelper::Polygon> band;
+			OffsetHelper::BandPolygons(path, width, band);
+			for (const auto& poly : band)
+				bands.Push(poly);
 		}
 
-		// Почистить повторы подряд, чтобы не было нулевых сегментов
-		auto almostEq = [](const API_Coord& a, const API_Coord& b) {
-			const double eps = 1e-9;
-			return std::fabs(a.x - b.x) < eps && std::fabs(a.y - b.y) < eps;
-			};
-		if (pts.GetSize() >= 2) {
-			GS::Array<API_Coord> clean; clean.Push(pts[0]);
-			for (UIndex i = 1; i < pts.GetSize(); ++i)
-				if (!almostEq(pts[i], pts[i - 1])) clean.Push(pts[i]);
-			pts = clean;
-		}
-		if (pts.GetSize() < 2) {
-			Log("Curve has too few points.");
+		if (firstPath.IsEmpty()) {
+			Log("Selected elements are not curves (Line/Polyline/Arc/Spline) or have too few points.");
 			return false;
 		}
 
-		// ---------- 2) построить ленту (две офсет-кромки), собрать внешний контур ----------
-		GS::Array<API_Coord> left, right;
-		for (UIndex i = 0; i + 1 < pts.GetSize(); ++i) {
-			const double dx = pts[i + 1].x - pts[i].x;
-			const double dy = pts[i + 1].y - pts[i].y;
-			const double len = std::sqrt(dx * dx + dy * dy);
-			if (len < 1e-9) continue;
-
-			const double nx = -dy / len;
-			const double ny = dx / len;
-			const double off = width * 0.5;
-
-			left.Push({ pts[i].x + nx * off,     pts[i].y + ny * off });
-			right.Push({ pts[i].x - nx * off,     pts[i].y - ny * off });
+		// ---------- 2) несколько кривых: ленты перекрываются на примыканиях — объединить до создания ----------
+		GS::Array<PolygonHelper::Polygon> footprints;
+		if (nCurves > 1)
+			PolygonHelper::Union(bands, footprints);
+		else
+			footprints = bands;
 
-			if (i + 1 == pts.GetSize() - 1) {
-				left.Push({ pts[i + 1].x + nx * off, pts[i + 1].y + ny * off });
-				right.Push({ pts[i + 1].x - nx * off, pts[i + 1].y - ny * off });
-			}
+		// ---------- 3) по плите на каждый контур; если не вышло — fallback прямоугольник ----------
+		GSErrCode err = APIERR_GENERAL;
+		UInt32 created = 0;
+		for (const auto& poly : footprints) {
+			err = CreateSlabFromContour(poly.outer, poly.holes);
+			if (err == NoError)
+				++created;
 		}
 
-		GS::Array<API_Coord> contour;
-		for (const auto& c : left) contour.Push(c);
-		for (Int32 i = (Int32)right.GetSize() - 1; i >= 0; --i) contour.Push(right[i]);
-
-		// ---------- 3) создать плиту; если не вышло — fallback прямоугольник ----------
-		GSErrCode err = APIERR_GENERAL;
-		if (contour.GetSize() >= 3)
-			err = CreateSlabFromContour(contour);
-
-		if (err != NoError) {
-			if (pts.GetSize() >= 2) {
-				err = CreateRectSlabAlongSegment(pts[0], pts[1], width);
-				if (err == NoError) {
-					Log("Slab created (fallback rectangle on first segment).");
-					return true;
-				}
+		if (created == 0) {
+			err = CreateRectSlabAlongSegment(firstPath[0].a, firstPath[0].b, width);
+			if (err == NoError) {
+				Log("Slab created (fallback rectangle on first segment).");
+				return true;
 			}
-			GS::UniString msg; msg.Printf("Slab creation failed (err=%d).", err);
-			Log(msg);
+			Log(GS::UniString::Printf("Slab creation failed (err=%d).", (int)err));
 			return false;
 		}
 
+		if (created > 1) {
+			Log(GS::UniString::Printf("%u slabs created from %u curves.", (unsigned)created, (unsigned)nCurves));
+			return true;
+		}
 		Log("Slab created successfully.");
 		return true;
 	}
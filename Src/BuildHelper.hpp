@@ -1,6 +1,7 @@
 ﻿#pragma once
 #include "APIEnvir.h"
 #include "ACAPinc.h"
+#include "OffsetHelper.hpp"
 
 namespace BuildHelper {
 	bool SetCurveForSlab();
@@ -8,4 +9,7 @@ namespace BuildHelper {
 	bool SetCurveForShell();
 	bool SetMeshForShell();
 	bool CreateShellAlongCurve(double width);
+
+	// Путь плана по Line / Polyline / Arc / Spline (дуги — точно); false — не кривая или нет точек
+	bool CollectCurvePath(const API_Element& curve, OffsetHelper::Path& path);
 }
@@ -0,0 +1,608 @@
+﻿#include "CommandProtocol.hpp"
+#include "BrowserRepl.hpp"
+#include "SelectionHelper.hpp"
+#include "LayerHelper.hpp"
+#include "GroundHelper.hpp"
+#include "RotateHelper.hpp"
+#include "RandomizeHelper.hpp"
+#include "LandscapeHelper.hpp"
+#include "ColumnOrientHelper.hpp"
+#include "MarkupHelper.hpp"
+#include "RoadHelper.hpp"
+#include "GDLHelper.hpp"
+#include "GDL3DHelper.hpp"
+#include "DrapeHelper.hpp"
+#include "JobManager.hpp"
+#include "ReplEngine.hpp"
+#include "MacroRecorder.hpp"
+#include "Perf.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <unordered_map>
+
+namespace CommandProtocol {
+
+static inline void Log (const GS::UniString& s)
+{
+    if (BrowserRepl::HasInstance())
+        BrowserRepl::GetInstance().LogToBrowser(s);
+}
+
+static inline double MsSince (const std::chrono::steady_clock::time_point& t0)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+GS::UniString FromUtf8 (const std::string& s)
+{
+    return GS::UniString(s.c_str(), CC_UTF8);
+}
+
+std::string ToUtf8 (const GS::UniString& s)
+{
+    return std::string(s.ToCStr(0, MaxUSize, CC_UTF8).Get());
+}
+
+// ---------------- Args ----------------
+double Args::Num (const char* name, double def) const
+{
+    const JsonLite::Value* v = m_obj.Find(name);
+    return (v != nullptr && v->IsNumber()) ? v->AsNumber() : def;
+}
+
+Int32 Args::Int (const char* name, Int32 def) const
+{
+    const JsonLite::Value* v = m_obj.Find(name);
+    return (v != nullptr && v->IsNumber()) ? (Int32)std::llround(v->AsNumber()) : def;
+}
+
+bool Args::Bool (const char* name, bool def) const
+{
+    const JsonLite::Value* v = m_obj.Find(name);
+    return (v != nullptr && v->IsBool()) ? v->AsBool() : def;
+}
+
+GS::UniString Args::Str (const char* name, const GS::UniString& def) const
+{
+    const JsonLite::Value* v = m_obj.Find(name);
+    return (v != nullptr && v->IsString()) ? FromUtf8(v->AsString()) : def;
+}
+
+// ---------------- Реестр ----------------
+static std::vector<Command>                   g_commands;
+static std::unordered_map<std::string, size_t> g_byName;
+static bool                                    g_builtinsRegistered = false;
+
+static void RegisterBuiltins ();
+
+void Register (const char* name, std::vector<ParamSpec> params, Handler handler)
+{
+    auto it = g_byName.find(name);
+    if (it != g_byName.end()) {
+        g_commands[it->second].params = std::move(params);
+        g_commands[it->second].handler = std::move(handler);
+        return;
+    }
+    g_byName.emplace(name, g_commands.size());
+    g_commands.push_back(Command{ name, std::move(params), std::move(handler) });
+}
+
+static void EnsureBuiltins ()
+{
+    if (g_builtinsRegistered) return;
+    g_builtinsRegistered = true;
+    RegisterBuiltins();
+}
+
+const Command* Find (const std::string& name)
+{
+    EnsureBuiltins();
+    auto it = g_byName.find(name);
+    return (it != g_byName.end()) ? &g_commands[it->second] : nullptr;
+}
+
+// ---------------- Проверка аргументов ----------------
+static const char* TypeName (ParamType t)
+{
+    switch (t) {
+    case ParamType::Number:  return "number";
+    case ParamType::Integer: return "integer";
+    case ParamType::Bool:    return "bool";
+    case ParamType::String:  return "string";
+    case ParamType::Array:   return "array";
+    case ParamType::Object:  return "object";
+    }
+    return "?";
+}
+
+// число из строки: "3.5", "3,5", " 12 "
+static bool NumberFromString (const std::string& s, double& out)
+{
+    std::string t;
+    for (char c : s) { if (c == ',') c = '.'; if (c != ' ') t += c; }
+    JsonLite::Value v;
+    std::string err;
+    if (t.empty() || !JsonLite::Parse(t, v, err) || !v.IsNumber()) return false;
+    out = v.AsNumber();
+    return true;
+}
+
+static bool Coerce (const JsonLite::Value& in, ParamType type, JsonLite::Value& out)
+{
+    switch (type) {
+    case ParamType::Number:
+    case ParamType::Integer: {
+        double d = 0.0;
+        if (in.IsNumber()) d = in.AsNumber();
+        else if (in.IsString() && NumberFromString(in.AsString(), d)) {}
+        else if (in.IsBool()) d = in.AsBool() ? 1.0 : 0.0;
+        else return false;
+        if (!std::isfinite(d)) return false;
+        out = JsonLite::Value::Number(type == ParamType::Integer ? (double)std::llround(d) : d);
+        return true;
+    }
+    case ParamType::Bool:
+        if (in.IsBool())   { out = in; return true; }
+        if (in.IsNumber()) { out = JsonLite::Value::Bool(in.AsNumber() != 0.0); return true; }
+        if (in.IsString()) {
+            const std::string& s = in.AsString();
+            if (s == "true" || s == "1")  { out = JsonLite::Value::Bool(true); return true; }
+            if (s == "false" || s == "0") { out = JsonLite::Value::Bool(false); return true; }
+        }
+        return false;
+    case ParamType::String:
+        if (in.IsString()) { out = in; return true; }
+        if (in.IsNumber()) { out = JsonLite::Value::String(JsonLite::ToString(in)); return true; }
+        return false;
+    case ParamType::Array:
+        if (!in.IsArray()) return false;
+        out = in;
+        return true;
+    case ParamType::Object:
+        if (!in.IsObject()) return false;
+        out = in;
+        return true;
+    }
+    return false;
+}
+
+static bool ValidateArgs (const Command& cmd, const JsonLite::Value* args, JsonLite::Value& normalized, std::string& error)
+{
+    normalized = JsonLite::Value::Object();
+    if (args != nullptr && !args->IsNull() && !args->IsObject()) { error = "args must be an object"; return false; }
+
+    if (args != nullptr && args->IsObject()) {
+        for (const JsonLite::Value::Member& m : args->Members()) {
+            const ParamSpec* spec = nullptr;
+            for (const ParamSpec& p : cmd.params) if (m.first == p.name) { spec = &p; break; }
+            if (spec == nullptr) { error = "unknown arg '" + m.first + "'"; return false; }
+
+            JsonLite::Value v;
+            if (!Coerce(m.second, spec->type, v)) {
+                error = "arg '" + m.first + "' must be " + TypeName(spec->type);
+                return false;
+            }
+            normalized.Set(spec->name, v);
+        }
+    }
+
+    for (const ParamSpec& p : cmd.params) {
+        if (p.required && normalized.Find(p.name) == nullptr) {
+            error = std::string("missing arg '") + p.name + "'";
+            return false;
+        }
+    }
+    return true;
+}
+
+// ---------------- Выполнение ----------------
+JsonLite::Value RunOne (const JsonLite::Value& cmdObj)
+{
+    const auto t0 = std::chrono::steady_clock::now();
+    JsonLite::Value res = JsonLite::Value::Object();
+
+    const JsonLite::Value* nameV = cmdObj.Find("cmd");
+    const std::string name = (nameV != nullptr && nameV->IsString()) ? nameV->AsString() : std::string();
+    res.Set("cmd", JsonLite::Value::String(name));
+
+    std::string error;
+    const Command* cmd = name.empty() ? nullptr : Find(name);
+    JsonLite::Value args;
+    bool ok = false;
+    if (!cmdObj.IsObject())       error = "command must be an object";
+    else if (name.empty())        error = "missing 'cmd'";
+    else if (cmd == nullptr)      error = "unknown command";
+    else if (ValidateArgs(*cmd, cmdObj.Find("args"), args, error)) {
+        Perf::CommandScope perf(name);
+        JsonLite::Value value;
+        ok = cmd->handler(Args(args), value);
+        if (!value.IsNull()) res.Set("value", value);
+        if (ok) {
+            // поставленная задача пишется в макрос по её успешному завершению
+            const JsonLite::Value* async = args.Find("async");
+            const JsonLite::Value* jobId = value.IsObject() ? value.Find("jobId") : nullptr;
+            if (async != nullptr && async->AsBool() && jobId != nullptr)
+                MacroRecorder::RecordJob((UInt32)jobId->AsNumber(), name, args);
+            else
+                MacroRecorder::Record(name, args);
+        }
+    }
+
+    res.Set("ok", JsonLite::Value::Bool(ok));
+    if (!error.empty()) {
+        res.Set("error", JsonLite::Value::String(error));
+        Log(FromUtf8("[Cmd] " + name + ": " + error));
+    }
+    res.Set("ms", JsonLite::Value::Number(std::round(MsSince(t0) * 1000.0) / 1000.0));
+    return res;
+}
+
+std::string Execute (const std::string& jsonText)
+{
+    const auto t0 = std::chrono::steady_clock::now();
+    JsonLite::Value reply = JsonLite::Value::Object();
+
+    JsonLite::Value root;
+    std::string error;
+    if (!JsonLite::Parse(jsonText, root, error)) {
+        Log(FromUtf8("[Cmd] parse error: " + error));
+        reply.Set("ok", JsonLite::Value::Bool(false));
+        reply.Set("error", JsonLite::Value::String("parse error: " + error));
+        return JsonLite::ToString(reply);
+    }
+
+    // форма пакета
+    bool stopOnError = false;
+    std::vector<const JsonLite::Value*> cmds;
+    if (root.IsArray()) {
+        for (const JsonLite::Value& c : root.Items()) cmds.push_back(&c);
+    } else if (const JsonLite::Value* list = root.Find("commands")) {
+        if (list->IsArray()) for (const JsonLite::Value& c : list->Items()) cmds.push_back(&c);
+        if (const JsonLite::Value* s = root.Find("stopOnError")) stopOnError = s->IsBool() && s->AsBool();
+    } else {
+        cmds.push_back(&root);
+    }
+
+    JsonLite::Value& results = reply.Set("results", JsonLite::Value::Array());
+    UInt32 nOk = 0, nRun = 0;
+    bool allOk = true;
+    for (const JsonLite::Value* c : cmds) {
+        JsonLite::Value r = RunOne(*c);
+        ++nRun;
+        const bool ok = r.Find("ok")->AsBool();
+        if (ok) ++nOk; else allOk = false;
+        results.Push(std::move(r));
+        if (!ok && stopOnError) break;
+    }
+
+    const double ms = MsSince(t0);
+    reply.Set("ok", JsonLite::Value::Bool(allOk));
+    reply.Set("ms", JsonLite::Value::Number(std::round(ms * 1000.0) / 1000.0));
+    // одна строка лога на пакет вместо строки на каждый вызов моста
+    Log(GS::UniString::Printf("[Cmd] batch %u/%u ok in %.1f ms", (unsigned)nOk, (unsigned)nRun, ms));
+    return JsonLite::ToString(reply);
+}
+
+std::string DescribeJson ()
+{
+    EnsureBuiltins();
+    JsonLite::Value list = JsonLite::Value::Array();
+    for (const Command& c : g_commands) {
+        JsonLite::Value& item = list.Push(JsonLite::Value::Object());
+        item.Set("cmd", JsonLite::Value::String(c.name));
+        JsonLite::Value& params = item.Set("args", JsonLite::Value::Array());
+        for (const ParamSpec& p : c.params) {
+            JsonLite::Value& pv = params.Push(JsonLite::Value::Object());
+            pv.Set("name", JsonLite::Value::String(p.name));
+            pv.Set("type", JsonLite::Value::String(TypeName(p.type)));
+            pv.Set("required", JsonLite::Value::Bool(p.required));
+        }
+    }
+    return JsonLite::ToString(list);
+}
+
+// ---------------- Встроенные команды ----------------
+using PT = ParamType;
+
+// команда без аргументов, результат — bool помощника
+static void RegisterSimple (const char* name, std::function<bool ()> fn)
+{
+    Register(name, {}, [fn](const Args&, JsonLite::Value&) { return fn(); });
+}
+
+// долгие команды: при "async":true — задача JobManager, в value — её ID
+static bool SubmitOrFail (UInt32 jobId, JsonLite::Value& value)
+{
+    JsonLite::Value v = JsonLite::Value::Object();
+    v.Set("jobId", JsonLite::Value::Number(jobId));
+    value = v;
+    return jobId != 0;
+}
+
+static void RegisterBuiltins ()
+{
+    // --- Selection ---
+    Register("GetSelectedElements", {}, [](const Args&, JsonLite::Value& value) {
+        value = JsonLite::Value::Array();
+        for (const SelectionHelper::ElementInfo& e : SelectionHelper::GetSelectedElements()) {
+            JsonLite::Value& o = value.Push(JsonLite::Value::Object());
+            o.Set("guid", JsonLite::Value::String(ToUtf8(e.guidStr)));
+            o.Set("type", JsonLite::Value::String(ToUtf8(e.typeName)));
+            o.Set("id", JsonLite::Value::String(ToUtf8(e.elemID)));
+            o.Set("layer", JsonLite::Value::String(ToUtf8(e.layerName)));
+        }
+        return true;
+    });
+    Register("AddElementToSelection", { { "guid", PT::String, true } }, [](const Args& a, JsonLite::Value&) {
+        SelectionHelper::ModifySelection(a.Str("guid"), SelectionHelper::AddToSelection);
+        return true;
+    });
+    Register("RemoveElementFromSelection", { { "guid", PT::String, true } }, [](const Args& a, JsonLite::Value&) {
+        SelectionHelper::ModifySelection(a.Str("guid"), SelectionHelper::RemoveFromSelection);
+        return true;
+    });
+    Register("ChangeSelectedElementsID", { { "baseId", PT::String, true } }, [](const Args& a, JsonLite::Value&) {
+        return SelectionHelper::ChangeSelectedElementsID(a.Str("baseId"));
+    });
+
+    // --- Layers ---
+    Register("CreateLayerAndMoveElements",
+        { { "folder", PT::String, false }, { "layer", PT::String, true }, { "baseId", PT::String, false } },
+        [](const Args& a, JsonLite::Value&) {
+            LayerHelper::LayerCreationParams params;
+            params.folderPath = a.Str("folder");
+            params.layerName = a.Str("layer");
+            params.baseID = a.Str("baseId");
+            return LayerHelper::CreateLayerAndMoveElements(params);
+        });
+    Register("CreateLayersBatch", { { "layers", PT::Array, true } }, [](const Args& a, JsonLite::Value& value) {
+        // [{"folder":"A/B","layer":"L"}, ...]
+        GS::Array<LayerHelper::LayerCreationParams> items;
+        for (const JsonLite::Value& it : a.Raw("layers")->Items()) {
+            const JsonLite::Value* layer = it.Find("layer");
+            if (layer == nullptr || !layer->IsString()) continue;
+            LayerHelper::LayerCreationParams p;
+            p.layerName = FromUtf8(layer->AsString());
+            if (const JsonLite::Value* folder = it.Find("folder"))
+                if (folder->IsString()) p.folderPath = FromUtf8(folder->AsString());
+            items.Push(p);
+        }
+        GS::Array<API_AttributeIndex> indices;
+        const UInt32 ready = LayerHelper::CreateLayersBatch(items, indices);
+        value = JsonLite::Value::Number(ready);
+        return ready == items.GetSize() && ready > 0;
+    });
+
+    // --- Ground ---
+    RegisterSimple("SetGroundSurface", [] { return GroundHelper::SetGroundSurface(); });
+    RegisterSimple("SetGroundObjects", [] { return GroundHelper::SetGroundObjects(); });
+    Register("ApplyGroundOffset", { { "offset", PT::Number, false }, { "async", PT::Bool, false } },
+        [](const Args& a, JsonLite::Value& value) {
+            const double offset = a.Num("offset", 0.0);
+            if (a.Bool("async")) return SubmitOrFail(GroundHelper::SubmitGroundOffset(offset), value);
+            return GroundHelper::ApplyGroundOffset(offset);
+        });
+    // ΔZ можно задать заранее (SetZDelta) и применить без аргумента
+    static double lastZDelta = 0.0;
+    Register("SetZDelta", { { "delta", PT::Number, true } }, [](const Args& a, JsonLite::Value&) {
+        lastZDelta = a.Num("delta");
+        return true;
+    });
+    Register("ApplyZDelta", { { "delta", PT::Number, false }, { "async", PT::Bool, false } },
+        [](const Args& a, JsonLite::Value& value) {
+            const double delta = a.Num("delta", lastZDelta);
+            if (a.Bool("async")) return SubmitOrFail(GroundHelper::SubmitZDelta(delta), value);
+            return GroundHelper::ApplyZDelta(delta);
+        });
+
+    // --- Rotate / Randomize ---
+    Register("RotateSelected", { { "angle", PT::Number, true } }, [](const Args& a, JsonLite::Value&) {
+        return RotateHelper::RotateSelected(a.Num("angle"));
+    });
+    RegisterSimple("AlignSelectedX",          [] { return RotateHelper::AlignSelectedX(); });
+    RegisterSimple("RandomizeSelectedAngles", [] { return RotateHelper::RandomizeSelectedAngles(); });
+    RegisterSimple("OrientObjectsToPoint",    [] { return RotateHelper::OrientObjectsToPoint(); });
+    Register("SetRandomSettings",
+        { { "seed", PT::Integer, false }, { "angle", PT::Number, false }, { "smin", PT::Number, false },
+          { "smax", PT::Number, false }, { "z", PT::Number, false } },
+        [](const Args& a, JsonLite::Value&) {
+            RandomizeHelper::Settings rs = RandomizeHelper::GetSettings();
+            rs.seed = (UInt32)a.Int("seed", (Int32)rs.seed);
+            rs.angleDeg = a.Num("angle", rs.angleDeg);
+            rs.scaleMin = a.Num("smin", rs.scaleMin);
+            rs.scaleMax = a.Num("smax", rs.scaleMax);
+            rs.zJitterMM = a.Num("z", rs.zJitterMM);
+            RandomizeHelper::SetSettings(rs);
+            return true;
+        });
+    RegisterSimple("RandomizeSelected", [] { return RandomizeHelper::RandomizeSelected(); });
+
+    // --- GDL ---
+    auto gdlOptions = [](const Args& a) {
+        GDLHelper::Options opt;
+        opt.compact = a.Bool("compact", opt.compact);
+        opt.tolerance = a.Num("tolerance", opt.tolerance);
+        return opt;
+    };
+    Register("GenerateGDLFromSelection", { { "compact", PT::Bool, false }, { "tolerance", PT::Number, false } },
+        [gdlOptions](const Args& a, JsonLite::Value& value) {
+            bool ok = false;
+            value = JsonLite::Value::String(GDLHelper::GenerateGDLUtf8(ok, gdlOptions(a)));
+            return ok;
+        });
+    // Большие чертежи — потоком в файл, текст в JS не передаётся
+    Register("GenerateGDLToFile", { { "path", PT::String, true }, { "compact", PT::Bool, false }, { "tolerance", PT::Number, false } },
+        [gdlOptions](const Args& a, JsonLite::Value& value) {
+            GS::UniString error;
+            const bool ok = GDLHelper::GenerateGDLToFile(IO::Location(a.Str("path")), error, gdlOptions(a));
+            if (!ok) value = JsonLite::Value::String(ToUtf8(error));
+            return ok;
+        });
+    // Много групп за раз: файлы скриптов в папку, в JS — только ID задачи
+    Register("GenerateGDLBatch", { { "folder", PT::String, true }, { "groupBy", PT::String, false },
+                                   { "compact", PT::Bool, false }, { "tolerance", PT::Number, false } },
+        [gdlOptions](const Args& a, JsonLite::Value& value) {
+            const GDLHelper::GroupBy by = (a.Str("groupBy") == "group") ? GDLHelper::GroupBy::Group : GDLHelper::GroupBy::Layer;
+            return SubmitOrFail(GDLHelper::SubmitBatch(IO::Location(a.Str("folder")), by, gdlOptions(a)), value);
+        });
+    auto gdl3DOptions = [](const Args& a) {
+        GDL3DHelper::Options opt;
+        opt.weldTolerance = a.Num("weld", opt.weldTolerance);
+        opt.smoothDeg = a.Num("smoothDeg", opt.smoothDeg);
+        return opt;
+    };
+    Register("GenerateGDL3D", { { "weld", PT::Number, false }, { "smoothDeg", PT::Number, false } },
+        [gdl3DOptions](const Args& a, JsonLite::Value& value) {
+            bool ok = false;
+            value = JsonLite::Value::String(GDL3DHelper::GenerateGDL3DUtf8(ok, gdl3DOptions(a)));
+            return ok;
+        });
+    Register("GenerateGDL3DToFile", { { "path", PT::String, true }, { "weld", PT::Number, false }, { "smoothDeg", PT::Number, false } },
+        [gdl3DOptions](const Args& a, JsonLite::Value& value) {
+            GS::UniString error;
+            const bool ok = GDL3DHelper::GenerateGDL3DToFile(IO::Location(a.Str("path")), error, gdl3DOptions(a));
+            if (!ok) value = JsonLite::Value::String(ToUtf8(error));
+            return ok;
+        });
+    // Кривые из выделения, уложенные на выделенный mesh (LIN_ с вершинами на рёбрах TIN)
+    auto drapeOptions = [](const Args& a) {
+        DrapeHelper::Options opt;
+        opt.tolerance = a.Num("tolerance", opt.tolerance);
+        opt.lift = a.Num("lift", opt.lift);
+        return opt;
+    };
+    Register("GenerateDrapedGDL", { { "tolerance", PT::Number, false }, { "lift", PT::Number, false } },
+        [drapeOptions](const Args& a, JsonLite::Value& value) {
+            bool ok = false;
+            value = JsonLite::Value::String(DrapeHelper::GenerateDrapedGDLUtf8(ok, drapeOptions(a)));
+            return ok;
+        });
+    Register("GenerateDrapedGDLToFile", { { "path", PT::String, true }, { "tolerance", PT::Number, false }, { "lift", PT::Number, false } },
+        [drapeOptions](const Args& a, JsonLite::Value& value) {
+            GS::UniString error;
+            const bool ok = DrapeHelper::GenerateDrapedGDLToFile(IO::Location(a.Str("path")), error, drapeOptions(a));
+            if (!ok) value = JsonLite::Value::String(ToUtf8(error));
+            return ok;
+        });
+    Register("DrapeSelectedCurves", { { "tolerance", PT::Number, false }, { "lift", PT::Number, false } },
+        [drapeOptions](const Args& a, JsonLite::Value& value) {
+            GS::UniString error;
+            const UInt32 n = DrapeHelper::CreateDrapedMorphs(error, drapeOptions(a));
+            value = (n > 0) ? JsonLite::Value::Number((double)n) : JsonLite::Value::String(ToUtf8(error));
+            return n > 0;
+        });
+
+    // --- Distribution ---
+    RegisterSimple("SetDistributionLine",   [] { return LandscapeHelper::SetDistributionLine(); });
+    RegisterSimple("SetDistributionObject", [] { return LandscapeHelper::SetDistributionObject(); });
+    Register("SetDistributionStep", { { "step", PT::Number, true } }, [](const Args& a, JsonLite::Value&) {
+        return LandscapeHelper::SetDistributionStep(a.Num("step"));
+    });
+    Register("SetDistributionCount", { { "count", PT::Integer, true } }, [](const Args& a, JsonLite::Value&) {
+        return LandscapeHelper::SetDistributionCount(a.Int("count"));
+    });
+    Register("SetDistributionClearance", { { "clearance", PT::Number, true } }, [](const Args& a, JsonLite::Value&) {
+        return LandscapeHelper::SetDistributionClearance(a.Num("clearance"));
+    });
+    Register("SetDistributionRandomize", { { "on", PT::Bool, true } }, [](const Args& a, JsonLite::Value&) {
+        return LandscapeHelper::SetDistributionRandomize(a.Bool("on"));
+    });
+    Register("DistributeNow", { { "step", PT::Number, false }, { "count", PT::Integer, false }, { "async", PT::Bool, false } },
+        [](const Args& a, JsonLite::Value& value) {
+            const double step = a.Num("step", 0.0);
+            const int count = (int)a.Int("count", 0);
+            if (a.Bool("async")) return SubmitOrFail(LandscapeHelper::SubmitDistribution(step, count), value);
+            return LandscapeHelper::DistributeSelected(step, count);
+        });
+
+    // --- Columns / Beams ---
+    RegisterSimple("SetColumns",             [] { return ColumnOrientHelper::SetColumns(); });
+    RegisterSimple("SetBeams",               [] { return ColumnOrientHelper::SetBeams(); });
+    RegisterSimple("SetMeshForColumns",      [] { return ColumnOrientHelper::SetMesh(); });
+    RegisterSimple("OrientColumnsToSurface", [] { return ColumnOrientHelper::OrientColumnsToSurface(); });
+    RegisterSimple("OrientBeamsToSurface",   [] { return ColumnOrientHelper::OrientBeamsToSurface(); });
+    Register("RotateSelectedOrientation", { { "angle", PT::Number, true } }, [](const Args& a, JsonLite::Value&) {
+        return ColumnOrientHelper::RotateSelected(a.Num("angle"));
+    });
+
+    // --- Markup ---
+    Register("SetMarkupStep", { { "step", PT::Number, true } }, [](const Args& a, JsonLite::Value&) {
+        return MarkupHelper::SetMarkupStep(a.Num("step"));
+    });
+    RegisterSimple("CreateMarkupDimensions",         [] { return MarkupHelper::CreateMarkupDimensions(); });
+    RegisterSimple("CreateDimensionsToLine",         [] { return MarkupHelper::CreateDimensionsToLine(); });
+    RegisterSimple("CreateDimensionsBetweenObjects", [] { return MarkupHelper::CreateDimensionsBetweenObjects(); });
+    RegisterSimple("CreateDimensionsToPoint",        [] { return MarkupHelper::CreateDimensionsToPoint(); });
+
+    // --- Road ---
+    RegisterSimple("SetBaseLineForShell",    [] { return RoadHelper::SetCenterLine(); });
+    RegisterSimple("SetMeshSurfaceForShell", [] { return RoadHelper::SetTerrainMesh(); });
+    Register("BuildRoad", { { "width", PT::Number, false }, { "step", PT::Number, false }, { "async", PT::Bool, false } },
+        [](const Args& a, JsonLite::Value& value) {
+            RoadHelper::RoadParams params;
+            params.widthMM = a.Num("width", 1000.0);
+            params.sampleStepMM = a.Num("step", 500.0);
+            if (a.Bool("async")) {
+                return SubmitOrFail(JobManager::Submit("Build Road", [params](JobManager::Context&) {
+                    return RoadHelper::BuildRoad(params) ? JobManager::Step::Done : JobManager::Step::Failed;
+                }), value);
+            }
+            return RoadHelper::BuildRoad(params);
+        });
+
+    // --- Script ---
+    Register("RunScript", { { "script", PT::String, true } }, [](const Args& a, JsonLite::Value& value) {
+        const ReplEngine::Result r = ReplEngine::Run(a.Str("script"));
+        value = ReplEngine::ToJson(r);
+        return r.ok;
+    });
+    Register("CheckScript", { { "script", PT::String, true } }, [](const Args& a, JsonLite::Value& value) {
+        const GS::UniString err = ReplEngine::Check(a.Str("script"));
+        if (!err.IsEmpty()) value = JsonLite::Value::String(ToUtf8(err));
+        return err.IsEmpty();
+    });
+
+    // --- Macro ---
+    RegisterSimple("MacroStart", [] { MacroRecorder::Start(); return true; });
+    Register("MacroStop", {}, [](const Args&, JsonLite::Value& value) {
+        value = JsonLite::Value::Number(MacroRecorder::Stop());
+        return true;
+    });
+    Register("MacroSave", { { "name", PT::String, true } }, [](const Args& a, JsonLite::Value&) {
+        return MacroRecorder::Save(a.Str("name"));
+    });
+    Register("MacroDelete", { { "name", PT::String, true } }, [](const Args& a, JsonLite::Value&) {
+        return MacroRecorder::Remove(a.Str("name"));
+    });
+    Register("MacroList", {}, [](const Args&, JsonLite::Value& value) {
+        value = JsonLite::Value::Array();
+        for (const GS::UniString& n : MacroRecorder::List()) value.Push(JsonLite::Value::String(ToUtf8(n)));
+        return true;
+    });
+    Register("MacroStatus", {}, [](const Args&, JsonLite::Value& value) {
+        value = JsonLite::Value::Object();
+        value.Set("recording", JsonLite::Value::Bool(MacroRecorder::IsRecording()));
+        value.Set("steps", JsonLite::Value::Number(MacroRecorder::StepCount()));
+        return true;
+    });
+    Register("MacroReplay", { { "name", PT::String, false } }, [](const Args& a, JsonLite::Value& value) {
+        const MacroRecorder::ReplayResult r = MacroRecorder::Replay(a.Str("name"));
+        value = MacroRecorder::ToJson(r);
+        return r.ok;
+    });
+
+    // --- Performance ---
+    Register("PerfStats", {}, [](const Args&, JsonLite::Value& value) {
+        std::string err;
+        return JsonLite::Parse(Perf::ToJson(), value, err);
+    });
+    RegisterSimple("PerfReset", [] { Perf::Reset(); return true; });
+
+    // --- Jobs ---
+    Register("CancelJob", { { "id", PT::Integer, false } }, [](const Args& a, JsonLite::Value&) {
+        return JobManager::Cancel((UInt32)a.Int("id", 0));
+    });
+}
+
+} // namespace CommandProtocol
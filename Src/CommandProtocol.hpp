@@ -0,0 +1,74 @@
+﻿#ifndef COMMANDPROTOCOL_HPP
+#define COMMANDPROTOCOL_HPP
+
+#include "APIEnvir.h"
+#include "ACAPinc.h"
+#include "GSRoot.hpp"
+#include "JsonLite.hpp"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// CommandProtocol — единая точка входа моста: пакет JSON-команд за один вызов
+//   вход:  [{"cmd":"RotateSelected","args":{"angle":15}}, ...]
+//          или {"commands":[...], "stopOnError":true}, или одна команда
+//   выход: {"ok":true,"ms":..,"results":[{"cmd":..,"ok":..,"ms":..,"value":..|"error":..}]}
+// Аргументы проверяются по схеме команды до вызова помощника; числа принимаются
+// и строкой ("3,5"), лишние ключи — ошибка.
+// ============================================================================
+namespace CommandProtocol {
+
+    enum class ParamType { Number, Integer, Bool, String, Array, Object };
+
+    struct ParamSpec {
+        const char* name;
+        ParamType   type;
+        bool        required;
+    };
+
+    // Аргументы после проверки по схеме (типы уже приведены)
+    class Args {
+    public:
+        explicit Args (const JsonLite::Value& obj) : m_obj(obj) {}
+
+        bool                   Has (const char* name) const { return m_obj.Find(name) != nullptr; }
+        double                 Num (const char* name, double def = 0.0) const;
+        Int32                  Int (const char* name, Int32 def = 0) const;
+        bool                   Bool (const char* name, bool def = false) const;
+        GS::UniString          Str (const char* name, const GS::UniString& def = GS::UniString()) const;
+        const JsonLite::Value* Raw (const char* name) const { return m_obj.Find(name); }
+
+    private:
+        const JsonLite::Value& m_obj;
+    };
+
+    // Обработчик: true — успех; value — результат команды (по умолчанию ok)
+    using Handler = std::function<bool (const Args& args, JsonLite::Value& value)>;
+
+    struct Command {
+        std::string            name;
+        std::vector<ParamSpec> params;
+        Handler                handler;
+    };
+
+    void           Register (const char* name, std::vector<ParamSpec> params, Handler handler);
+    const Command* Find (const std::string& name);
+
+    // Одна команда {"cmd":..,"args":{..}} → {"cmd","ok","ms","value"|"error"}
+    JsonLite::Value RunOne (const JsonLite::Value& cmd);
+
+    // Пакет (текст JSON) → ответ (текст JSON)
+    std::string Execute (const std::string& jsonText);
+
+    // Список команд со схемами аргументов
+    std::string DescribeJson ();
+
+    // UTF-8 <-> UniString
+    GS::UniString FromUtf8 (const std::string& s);
+    std::string   ToUtf8 (const GS::UniString& s);
+
+}
+
+#endif // COMMANDPROTOCOL_HPP
@@ -0,0 +1,234 @@
+// ============================================================================
+// DrapeHelper.cpp — кривые на рельефе: вершины на рёбрах TIN, морфы из рёбер и LIN_ в 3D GDL
+// ============================================================================
+#include "DrapeHelper.hpp"
+#include "GDLWriter.hpp"
+#include "BrowserRepl.hpp"
+#include "BuildHelper.hpp"
+#include "MeshIntersectionHelper.hpp"
+#include "OffsetHelper.hpp"
+#include "Perf.hpp"
+#include "SelectionHelper.hpp"
+#include "CommandProtocol.hpp"
+#include "UndoScope.hpp"
+#include "ACAPinc.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace DrapeHelper {
+
+	static void Log(const GS::UniString& s)
+	{
+		if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser(s);
+	}
+
+	static bool IsCurve(const API_ElemTypeID t)
+	{
+		return t == API_LineID || t == API_PolyLineID || t == API_ArcID || t == API_SplineID;
+	}
+
+	// Уложенные кривые выделения: абсолютные Z (с подъёмом), bbox и этаж mesh
+	struct Draped {
+		std::vector<std::vector<API_Coord3D>> lines;
+		double minX = 1e300, minY = 1e300, minZ = 1e300;
+		double maxX = -1e300, maxY = -1e300, maxZ = -1e300;
+		size_t nIn = 0, nOut = 0;
+		short  meshFloor = 0;
+	};
+
+	static bool DrapeCurves(const GS::Array<API_Guid>& guids, Draped& r, GS::UniString& error, const Options& opt)
+	{
+		if (guids.IsEmpty()) {
+			error = "Нет элементов для генерации.";
+			return false;
+		}
+
+		// mesh и кривые — из одного выделения (mesh берётся первый)
+		API_Guid meshGuid = APINULLGuid;
+		GS::Array<API_Element> curves;
+		for (const API_Guid& guid : guids) {
+			API_Element e = {};
+			e.header.guid = guid;
+			if (Perf::ElementGet(&e) != NoError)
+				continue;
+			const API_ElemTypeID t = e.header.type.typeID;
+			if (t == API_MeshID && meshGuid == APINULLGuid) {
+				meshGuid = guid;
+				r.meshFloor = e.header.floorInd;
+			}
+			else if (IsCurve(t))
+				curves.Push(e);
+		}
+		if (meshGuid == APINULLGuid) {
+			error = "В выделении нет mesh.";
+			return false;
+		}
+		if (curves.IsEmpty()) {
+			error = "В выделении нет линий, дуг, полилиний или сплайнов.";
+			return false;
+		}
+
+		const std::shared_ptr<const TerrainQuery> tin = MeshIntersectionHelper::Acquire(meshGuid);
+		if (tin == nullptr) {
+			error = "Не удалось построить TIN по mesh.";
+			return false;
+		}
+
+		for (const API_Element& curve : curves) {
+			OffsetHelper::Path path;
+			if (!BuildHelper::CollectCurvePath(curve, path))
+				continue;
+			GS::Array<API_Coord> flat;
+			OffsetHelper::Flatten(path, flat, opt.tolerance);
+			std::vector<API_Coord> pts;
+			pts.reserve(flat.GetSize());
+			for (const API_Coord& c : flat)
+				pts.push_back(c);
+
+			std::vector<API_Coord3D> draped;
+			if (!tin->Drape(pts, draped))
+				continue;
+			for (API_Coord3D& p : draped) {
+				p.z += opt.lift;
+				r.minX = std::min(r.minX, p.x); r.maxX = std::max(r.maxX, p.x);
+				r.minY = std::min(r.minY, p.y); r.maxY = std::max(r.maxY, p.y);
+				r.minZ = std::min(r.minZ, p.z); r.maxZ = std::max(r.maxZ, p.z);
+			}
+			r.nIn += pts.size();
+			r.nOut += draped.size();
+			r.lines.push_back(std::move(draped));
+		}
+		if (r.lines.empty()) {
+			error = "Кривые не удалось уложить на mesh.";
+			return false;
+		}
+		return true;
+	}
+
+	// Морф из одних рёбер: вершины ломаной и рёбра между соседними; Z — от уровня этажа
+	static GSErrCode CreateEdgeMorph(const std::vector<API_Coord3D>& line, short floorInd, double storyZ)
+	{
+		API_Element morph = {};
+		morph.header.type = API_MorphID;
+		GSErrCode err = ACAPI_Element_GetDefaults(&morph, nullptr);
+		if (err != NoError) return err;
+		morph.header.floorInd = floorInd;
+		for (int i = 0; i < 12; ++i) morph.morph.tranmat.tmx[i] = 0.0;
+		morph.morph.tranmat.tmx[0] = morph.morph.tranmat.tmx[5] = morph.morph.tranmat.tmx[10] = 1.0;
+
+		void* bodyData = nullptr;
+		err = ACAPI_Body_Create(nullptr, nullptr, &bodyData);
+		if (err != NoError || bodyData == nullptr) return err != NoError ? err : APIERR_MEMFULL;
+
+		UInt32 prev = 0;
+		for (size_t i = 0; i < line.size() && err == NoError; ++i) {
+			const API_Coord3D c = { line[i].x, line[i].y, line[i].z - storyZ };
+			UInt32 v = 0;
+			err = ACAPI_Body_AddVertex(bodyData, c, v);
+			if (err == NoError && i > 0) {
+				Int32 edge = 0;
+				err = ACAPI_Body_AddEdge(bodyData, prev, v, edge);
+			}
+			prev = v;
+		}
+
+		API_ElementMemo memo = {};
+		if (err == NoError)
+			err = ACAPI_Body_Finish(bodyData, &memo.morphBody, &memo.morphMaterialMapTable);
+		ACAPI_Body_Dispose(&bodyData);
+		if (err == NoError)
+			err = Perf::ElementCreate(&morph, &memo);
+		ACAPI_DisposeElemMemoHdls(&memo);
+		return err;
+	}
+
+	UInt32 CreateDrapedMorphs(GS::UniString& error, const Options& opt)
+	{
+		const auto t0 = std::chrono::steady_clock::now();
+		Draped r;
+		if (!DrapeCurves(SelectionHelper::GetSelectedGuids(), r, error, opt))
+			return 0;
+
+		const double storyZ = StoryLevels().Get(r.meshFloor);   // то же правило, что у базы TIN
+		UInt32 created = 0;
+		UndoScope::Call("Drape Curves", [&]() -> GSErrCode {
+			for (const std::vector<API_Coord3D>& l : r.lines) {
+				const GSErrCode err = CreateEdgeMorph(l, r.meshFloor, storyZ);
+				if (err == NoError) ++created;
+				else Log(GS::UniString::Printf("[Drape] morph create failed err=%d", (int)err));
+			}
+			return NoError;
+		});
+		if (created == 0) {
+			error = "Не удалось создать морфы.";
+			return 0;
+		}
+
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+		Log(GS::UniString::Printf("[Drape] %u of %u morphs, %u -> %u points, %.0f ms",
+			(unsigned)created, (unsigned)r.lines.size(), (unsigned)r.nIn, (unsigned)r.nOut, ms));
+		return created;
+	}
+
+	bool WriteDrapedGDL(const GS::Array<API_Guid>& guids, GDLWriter& w, GS::UniString& error, const Options& opt)
+	{
+		const auto t0 = std::chrono::steady_clock::now();
+		Draped r;
+		if (!DrapeCurves(guids, r, error, opt))
+			return false;
+		const std::vector<std::vector<API_Coord3D>>& lines = r.lines;
+		const double minX = r.minX, minY = r.minY, minZ = r.minZ;
+		const double maxX = r.maxX, maxY = r.maxY, maxZ = r.maxZ;
+
+		// Тот же заголовок, что у 3D GDL по модели: центр bbox -> (0,0), низ -> 0
+		const double ox = (minX + maxX) * 0.5, oy = (minY + maxY) * 0.5, oz = minZ;
+		w.Raw("! === Кривые на рельефе: центр bbox по X,Y -> (0,0), низ -> 0; масштаб по A,B,ZZYZX ===\n");
+		w.Raw("baseW = ").Num(maxX - minX).Nl();
+		w.Raw("baseH = ").Num(maxY - minY).Nl();
+		w.Raw("baseZ = ").Num(maxZ - minZ).Nl();
+		w.Raw("sx = 1\n");
+		w.Raw("IF baseW <> 0 THEN sx = A / baseW\n");
+		w.Raw("sy = 1\n");
+		w.Raw("IF baseH <> 0 THEN sy = B / baseH\n");
+		w.Raw("sz = 1\n");
+		w.Raw("IF baseZ <> 0 THEN sz = ZZYZX / baseZ\n\n");
+		w.Raw("MUL sx, sy, sz\n\n");
+		for (size_t k = 0; k < lines.size(); ++k) {
+			const std::vector<API_Coord3D>& l = lines[k];
+			w.Raw("! кривая ").Int((Int64)k + 1).Nl();
+			for (size_t i = 1; i < l.size(); ++i)
+				w.Stmt("LIN_", l[i - 1].x - ox, l[i - 1].y - oy, l[i - 1].z - oz, l[i].x - ox, l[i].y - oy, l[i].z - oz);
+		}
+		w.Raw("DEL 1\n");
+		if (!w.Finish()) {
+			error = "Ошибка записи GDL.";
+			return false;
+		}
+
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+		Log(GS::UniString::Printf("[Drape] %u curves, %u -> %u points, %llu bytes, %.0f ms",
+			(unsigned)lines.size(), (unsigned)r.nIn, (unsigned)r.nOut, (unsigned long long)w.Bytes(), ms));
+		return true;
+	}
+
+	std::string GenerateDrapedGDLUtf8(bool& ok, const Options& opt)
+	{
+		GDLWriter w;
+		GS::UniString error;
+		ok = WriteDrapedGDL(SelectionHelper::GetSelectedGuids(), w, error, opt);
+		return ok ? w.Text() : CommandProtocol::ToUtf8(error);
+	}
+
+	bool GenerateDrapedGDLToFile(const IO::Location& file, GS::UniString& error, const Options& opt)
+	{
+		GDLWriter w(file);
+		if (w.HasError()) {
+			error = "Не удалось открыть файл.";
+			return false;
+		}
+		return WriteDrapedGDL(SelectionHelper::GetSelectedGuids(), w, error, opt);
+	}
+} // namespace DrapeHelper
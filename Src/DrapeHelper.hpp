@@ -0,0 +1,36 @@
+#pragma once
+#include "APIEnvir.h"
+#include "ACAPinc.h"
+#include "Location.hpp"
+
+#include <string>
+
+class GDLWriter;
+
+// ============================================================================
+// DrapeHelper — линии, дуги, полилинии и сплайны из выделения, уложенные на mesh.
+// В выделении — mesh и кривые. Кривая становится ломаной (дуги — хорды по допуску), ломаная
+// обходом по соседним треугольникам TIN получает вершину на каждом пересечённом ребре и
+// повторяет поверхность точно, без передискретизации. Результат — морф из одних рёбер на
+// каждую кривую (отдельного элемента «3D-полилиния» в Archicad нет); 3D-скрипт GDL из LIN_ —
+// дополнительный вывод для библиотечного объекта.
+// ============================================================================
+namespace DrapeHelper {
+	struct Options {
+		double tolerance = 0.002;   // м: наибольшее отклонение хорды от дуги
+		double lift = 0.0;          // м: подъём линий над поверхностью
+	};
+
+	// По выделению: морф из рёбер на каждую уложенную кривую, одним шагом Undo.
+	// Возвращает число созданных морфов; 0 — error содержит причину
+	UInt32 CreateDrapedMorphs(GS::UniString& error, const Options& opt = Options());
+
+	// false — в выделении нет mesh или кривых, либо ошибка записи (error — текст для пользователя)
+	bool WriteDrapedGDL(const GS::Array<API_Guid>& guids, GDLWriter& w, GS::UniString& error, const Options& opt = Options());
+
+	// По выделению: текст скрипта (UTF-8) или сообщение об ошибке
+	std::string GenerateDrapedGDLUtf8(bool& ok, const Options& opt = Options());
+
+	// По выделению потоком в файл
+	bool GenerateDrapedGDLToFile(const IO::Location& file, GS::UniString& error, const Options& opt = Options());
+}
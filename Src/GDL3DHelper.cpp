@@ -0,0 +1,363 @@
+// ============================================================================
+// GDL3DHelper.cpp — 3D GDL по модели: тело на элемент, общие таблицы вершин/рёбер
+// ============================================================================
+#include "GDL3DHelper.hpp"
+#include "GDLWriter.hpp"
+#include "BrowserRepl.hpp"
+#include "Perf.hpp"
+#include "SelectionHelper.hpp"
+#include "CommandProtocol.hpp"
+#include "ACAPinc.h"
+#include "APICommon.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <unordered_map>
+#include <vector>
+
+namespace GDL3DHelper {
+
+	constexpr double PI = 3.14159265358979323846;
+
+	static void Log(const GS::UniString& s)
+	{
+		if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser(s);
+	}
+
+	// ----------------------------------------------------------------------------
+	// Таблицы тела
+	// ----------------------------------------------------------------------------
+	struct Edge3D {
+		Int32 v1, v2;        // 1-based, v1 < v2 (направление в PGON — знак индекса)
+		Int32 p1 = 0, p2 = 0; // смежные многоугольники (1-based), 0 — нет
+	};
+
+	struct Body3D {
+		std::vector<API_Coord3D>  verts;
+		std::vector<Edge3D>       edges;
+		std::vector<Int32>        pgonEdges;  // рёбра всех PGON подряд: ±индекс, 0 — начало отверстия
+		std::vector<UInt32>       pgonStart;  // начало каждого PGON в pgonEdges
+		std::vector<API_Vector3D> normals;    // по PGON (внешний контур, Newell)
+		std::vector<bool>         hasHoles;
+
+		size_t PgonCount() const { return pgonStart.size(); }
+	};
+
+	struct Bounds {
+		double minX = 1e300, minY = 1e300, minZ = 1e300;
+		double maxX = -1e300, maxY = -1e300, maxZ = -1e300;
+
+		void Add(const API_Coord3D& c)
+		{
+			if (c.x < minX) minX = c.x;
+			if (c.x > maxX) maxX = c.x;
+			if (c.y < minY) minY = c.y;
+			if (c.y > maxY) maxY = c.y;
+			if (c.z < minZ) minZ = c.z;
+			if (c.z > maxZ) maxZ = c.z;
+		}
+	};
+
+	struct VertKey {
+		Int64 x, y, z;
+		bool operator==(const VertKey& o) const { return x == o.x && y == o.y && z == o.z; }
+	};
+
+	struct VertKeyHash {
+		size_t operator()(const VertKey& k) const
+		{
+			UInt64 h = (UInt64)k.x * 0x9E3779B97F4A7C15ull;
+			h ^= (UInt64)k.y + 0x7F4A7C159E3779B9ull + (h << 6) + (h >> 2);
+			h ^= (UInt64)k.z + 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+			return (size_t)h;
+		}
+	};
+
+	static bool IsExportable(const API_ElemTypeID t)
+	{
+		return t == API_MeshID || t == API_ShellID || t == API_SlabID || t == API_MorphID;
+	}
+
+	static API_Coord3D Transform(const API_Tranmat& tm, double x, double y, double z)
+	{
+		return {
+			tm.tmx[0] * x + tm.tmx[1] * y + tm.tmx[2] * z + tm.tmx[3],
+			tm.tmx[4] * x + tm.tmx[5] * y + tm.tmx[6] * z + tm.tmx[7],
+			tm.tmx[8] * x + tm.tmx[9] * y + tm.tmx[10] * z + tm.tmx[11]
+		};
+	}
+
+	// Начальная вершина ребра со знаком (в направлении обхода PGON)
+	static Int32 EdgeStart(const Body3D& b, Int32 signedEdge)
+	{
+		const Edge3D& e = b.edges[std::abs(signedEdge) - 1];
+		return signedEdge > 0 ? e.v1 : e.v2;
+	}
+
+	// Нормаль внешнего контура по Ньюэлу (устойчиво для невыпуклых многоугольников)
+	static API_Vector3D ContourNormal(const Body3D& b, size_t from, size_t to)
+	{
+		API_Vector3D n = { 0.0, 0.0, 0.0 };
+		for (size_t i = from; i < to; ++i) {
+			const API_Coord3D& p = b.verts[EdgeStart(b, b.pgonEdges[i]) - 1];
+			const API_Coord3D& q = b.verts[EdgeStart(b, b.pgonEdges[i + 1 < to ? i + 1 : from]) - 1];
+			n.x += (p.y - q.y) * (p.z + q.z);
+			n.y += (p.z - q.z) * (p.x + q.x);
+			n.z += (p.x - q.x) * (p.y + q.y);
+		}
+		const double len = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+		if (len > 1e-15) { n.x /= len; n.y /= len; n.z /= len; }
+		return n;
+	}
+
+	// ----------------------------------------------------------------------------
+	// Чтение 3D-модели элемента (все его тела — в одну таблицу)
+	// ----------------------------------------------------------------------------
+	static bool ReadElement(const API_Elem_Head& head, double weld, Body3D& b, Bounds& bounds)
+	{
+		API_ElemInfo3D info3D = {};
+		if (ACAPI_ModelAccess_Get3DInfo(head, &info3D) != NoError || info3D.fbody <= 0)
+			return false;
+
+		std::unordered_map<VertKey, Int32, VertKeyHash> vertIdx;
+		std::unordered_map<UInt64, Int32> edgeIdx;
+
+		for (Int32 ib = info3D.fbody; ib <= info3D.lbody; ++ib) {
+			API_Component3D comp = {};
+			comp.header.typeID = API_BodyID;
+			comp.header.index = ib;
+			if (ACAPI_ModelAccess_GetComponent(&comp) != NoError)
+				continue;
+
+			const Int32 nVert = comp.body.nVert;
+			const Int32 nEdge = comp.body.nEdge;
+			const Int32 nPgon = comp.body.nPgon;
+			const API_Tranmat tm = comp.body.tranmat;
+
+			// вершины тела → общий индекс (сварка по сетке weld)
+			std::vector<Int32> vmap(nVert + 1, 0);
+			for (Int32 iv = 1; iv <= nVert; ++iv) {
+				comp.header.typeID = API_VertID;
+				comp.header.index = iv;
+				if (ACAPI_ModelAccess_GetComponent(&comp) != NoError)
+					continue;
+				const API_Coord3D c = Transform(tm, comp.vert.x, comp.vert.y, comp.vert.z);
+				const VertKey key = { std::llround(c.x / weld), std::llround(c.y / weld), std::llround(c.z / weld) };
+				const auto it = vertIdx.find(key);
+				if (it != vertIdx.end()) {
+					vmap[iv] = it->second;
+					continue;
+				}
+				b.verts.push_back(c);
+				bounds.Add(c);
+				vmap[iv] = (Int32)b.verts.size();
+				vertIdx.emplace(key, vmap[iv]);
+			}
+
+			// рёбра тела → общий индекс со знаком; вырожденные (концы сварились) — 0
+			std::vector<Int32> emap(nEdge + 1, 0);
+			for (Int32 ie = 1; ie <= nEdge; ++ie) {
+				comp.header.typeID = API_EdgeID;
+				comp.header.index = ie;
+				if (ACAPI_ModelAccess_GetComponent(&comp) != NoError)
+					continue;
+				const Int32 a = (comp.edge.vert1 >= 1 && comp.edge.vert1 <= nVert) ? vmap[comp.edge.vert1] : 0;
+				const Int32 c = (comp.edge.vert2 >= 1 && comp.edge.vert2 <= nVert) ? vmap[comp.edge.vert2] : 0;
+				if (a == 0 || c == 0 || a == c)
+					continue;
+				const Int32 lo = a < c ? a : c;
+				const Int32 hi = a < c ? c : a;
+				const UInt64 key = ((UInt64)(UInt32)lo << 32) | (UInt32)hi;
+				Int32 idx;
+				const auto it = edgeIdx.find(key);
+				if (it != edgeIdx.end()) {
+					idx = it->second;
+				}
+				else {
+					b.edges.push_back({ lo, hi });
+					idx = (Int32)b.edges.size();
+					edgeIdx.emplace(key, idx);
+				}
+				emap[ie] = (a == lo) ? idx : -idx;
+			}
+
+			// многоугольники: рёбра по pedg, 0 в pedg — разделитель контура отверстия
+			for (Int32 ip = 1; ip <= nPgon; ++ip) {
+				comp.header.typeID = API_PgonID;
+				comp.header.index = ip;
+				if (ACAPI_ModelAccess_GetComponent(&comp) != NoError)
+					continue;
+				const Int32 fpedg = comp.pgon.fpedg;
+				const Int32 lpedg = comp.pgon.lpedg;
+
+				const size_t start = b.pgonEdges.size();
+				size_t outerEnd = 0;
+				size_t contourLen = 0;
+				bool holes = false;
+				for (Int32 k = fpedg; k <= lpedg; ++k) {
+					comp.header.typeID = API_PedgID;
+					comp.header.index = k;
+					if (ACAPI_ModelAccess_GetComponent(&comp) != NoError)
+						continue;
+					const Int32 pedg = comp.pedg.pedg;
+					if (pedg == 0) {
+						if (contourLen == 0) continue;
+						if (outerEnd == 0) outerEnd = b.pgonEdges.size();
+						b.pgonEdges.push_back(0);
+						holes = true;
+						contourLen = 0;
+						continue;
+					}
+					const Int32 ie = std::abs(pedg);
+					const Int32 e = (ie <= nEdge) ? emap[ie] : 0;
+					if (e == 0) continue;
+					b.pgonEdges.push_back(pedg < 0 ? -e : e);
+					++contourLen;
+				}
+				while (b.pgonEdges.size() > start && b.pgonEdges.back() == 0)
+					b.pgonEdges.pop_back();
+				if (outerEnd == 0 || outerEnd > b.pgonEdges.size()) outerEnd = b.pgonEdges.size();
+
+				if (outerEnd - start < 3) {
+					b.pgonEdges.resize(start);   // выродился после сварки
+					continue;
+				}
+
+				const Int32 pgonNo = (Int32)b.pgonStart.size() + 1;
+				b.pgonStart.push_back((UInt32)start);
+				b.normals.push_back(ContourNormal(b, start, outerEnd));
+				b.hasHoles.push_back(holes && outerEnd < b.pgonEdges.size());
+				for (size_t i = start; i < b.pgonEdges.size(); ++i) {
+					if (b.pgonEdges[i] == 0) continue;
+					Edge3D& e = b.edges[std::abs(b.pgonEdges[i]) - 1];
+					if (e.p1 == 0) e.p1 = pgonNo;
+					else if (e.p2 == 0) e.p2 = pgonNo;
+				}
+			}
+		}
+		return b.PgonCount() > 0;
+	}
+
+	// ----------------------------------------------------------------------------
+	// Вывод тела
+	// ----------------------------------------------------------------------------
+	static void EmitBody(const Body3D& b, const API_Coord3D& origin, double smoothCos, GDLWriter& w)
+	{
+		w.Raw("BASE\n");
+		for (const API_Coord3D& v : b.verts)
+			w.Stmt("VERT", v.x - origin.x, v.y - origin.y, v.z - origin.z);
+
+		// гладкое ребро (status 2) — между гранями с малым изломом, чтобы рельеф тонировался без граней
+		for (const Edge3D& e : b.edges) {
+			int status = 0;
+			if (e.p1 != 0 && e.p2 != 0) {
+				const API_Vector3D& n1 = b.normals[e.p1 - 1];
+				const API_Vector3D& n2 = b.normals[e.p2 - 1];
+				if (n1.x * n2.x + n1.y * n2.y + n1.z * n2.z >= smoothCos) status = 2;
+			}
+			w.Stmt("EDGE", e.v1, e.v2, -1, -1, status);
+		}
+
+		for (size_t p = 0; p < b.PgonCount(); ++p) {
+			const size_t from = b.pgonStart[p];
+			const size_t to = (p + 1 < b.PgonCount()) ? b.pgonStart[p + 1] : b.pgonEdges.size();
+			const size_t n = to - from;
+			// status: 2 — может быть невыпуклым, 16 — с отверстиями
+			const int status = (n > 3 ? 2 : 0) | (b.hasHoles[p] ? 16 : 0);
+			w.Raw("PGON ").Int((Int64)n).Raw(", 0, ").Int(status);
+			for (size_t i = from; i < to; ++i)
+				w.Raw(", ").Int(b.pgonEdges[i]);
+			w.Nl();
+		}
+		w.Raw("BODY -1\n\n");
+	}
+
+	// ----------------------------------------------------------------------------
+	// Публичные функции
+	// ----------------------------------------------------------------------------
+	bool WriteGDL3D(const GS::Array<API_Guid>& guids, GDLWriter& w, GS::UniString& error, const Options& opt)
+	{
+		if (guids.IsEmpty()) {
+			error = "Нет элементов для генерации.";
+			return false;
+		}
+
+		const auto t0 = std::chrono::steady_clock::now();
+		const double weld = std::max(opt.weldTolerance, 1e-9);
+
+		std::vector<Body3D> bodies;
+		Bounds bounds;
+		size_t nPgon = 0, nVert = 0, nEdge = 0;
+		for (const API_Guid& guid : guids) {
+			API_Element e = {};
+			e.header.guid = guid;
+			if (Perf::ElementGet(&e) != NoError || !IsExportable(e.header.type.typeID))
+				continue;
+			Body3D b;
+			if (!ReadElement(e.header, weld, b, bounds))
+				continue;
+			nPgon += b.PgonCount();
+			nVert += b.verts.size();
+			nEdge += b.edges.size();
+			bodies.push_back(std::move(b));
+		}
+
+		if (bodies.empty()) {
+			error = "Нет mesh, оболочек, перекрытий или морфов с 3D-моделью.";
+			return false;
+		}
+
+		const double baseW = bounds.maxX - bounds.minX;
+		const double baseH = bounds.maxY - bounds.minY;
+		const double baseZ = bounds.maxZ - bounds.minZ;
+		const API_Coord3D origin = { (bounds.minX + bounds.maxX) * 0.5, (bounds.minY + bounds.maxY) * 0.5, bounds.minZ };
+
+		w.Raw("! === 3D: центр bbox по X,Y -> (0,0), низ -> 0; масштаб по A,B,ZZYZX ===\n");
+		w.Raw("baseW = ").Num(baseW).Nl();
+		w.Raw("baseH = ").Num(baseH).Nl();
+		w.Raw("baseZ = ").Num(baseZ).Nl();
+		w.Raw("sx = 1\n");
+		w.Raw("IF baseW <> 0 THEN sx = A / baseW\n");
+		w.Raw("sy = 1\n");
+		w.Raw("IF baseH <> 0 THEN sy = B / baseH\n");
+		w.Raw("sz = 1\n");
+		w.Raw("IF baseZ <> 0 THEN sz = ZZYZX / baseZ\n\n");
+		w.Raw("MUL sx, sy, sz\n\n");
+
+		const double smoothCos = std::cos(opt.smoothDeg * PI / 180.0);
+		for (const Body3D& b : bodies)
+			EmitBody(b, origin, smoothCos, w);
+
+		w.Raw("DEL 1\n");
+		if (!w.Finish()) {
+			error = "Ошибка записи GDL.";
+			return false;
+		}
+
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+		Log(GS::UniString::Printf("[GDL3D] %u bodies, %u vertices, %u edges, %u polygons, %llu bytes, %.0f ms",
+			(unsigned)bodies.size(), (unsigned)nVert, (unsigned)nEdge, (unsigned)nPgon, (unsigned long long)w.Bytes(), ms));
+		return true;
+	}
+
+	std::string GenerateGDL3DUtf8(bool& ok, const Options& opt)
+	{
+		GDLWriter w;
+		GS::UniString error;
+		ok = WriteGDL3D(SelectionHelper::GetSelectedGuids(), w, error, opt);
+		return ok ? w.Text() : CommandProtocol::ToUtf8(error);
+	}
+
+	bool GenerateGDL3DToFile(const IO::Location& file, GS::UniString& error, const Options& opt)
+	{
+		GDLWriter w(file);
+		if (w.HasError()) {
+			error = "Не удалось открыть файл.";
+			return false;
+		}
+		return WriteGDL3D(SelectionHelper::GetSelectedGuids(), w, error, opt);
+	}
+
+} // namespace GDL3DHelper
@@ -0,0 +1,30 @@
+#pragma once
+#include "APIEnvir.h"
+#include "ACAPinc.h"
+#include "Location.hpp"
+
+#include <string>
+
+class GDLWriter;
+
+// ============================================================================
+// GDL3DHelper — 3D-скрипт GDL по модели выбранных mesh / оболочек / перекрытий / морфов.
+// Геометрия берётся из 3D-модели (тела, вершины, рёбра, многоугольники); на элемент —
+// одно тело BASE / VERT / EDGE / PGON / BODY с общими таблицами вершин и рёбер
+// (совпадающие вершины и рёбра выводятся один раз, PGON ссылается на рёбра со знаком).
+// ============================================================================
+namespace GDL3DHelper {
+	struct Options {
+		double weldTolerance = 0.0001;   // м: вершины ближе — одна вершина
+		double smoothDeg = 15.0;         // ребро между гранями с меньшим изломом — гладкое (status 2)
+	};
+
+	// false — нет подходящих элементов или ошибка записи (error — текст для пользователя)
+	bool WriteGDL3D(const GS::Array<API_Guid>& guids, GDLWriter& w, GS::UniString& error, const Options& opt = Options());
+
+	// По выделению: текст скрипта (UTF-8) или сообщение об ошибке
+	std::string GenerateGDL3DUtf8(bool& ok, const Options& opt = Options());
+
+	// По выделению потоком в файл (100k треугольников — десятки МБ текста)
+	bool GenerateGDL3DToFile(const IO::Location& file, GS::UniString& error, const Options& opt = Options());
+}
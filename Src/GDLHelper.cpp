@@ -3,13 +3,23 @@
 // (берём только pen у линий; типы линий не трогаем; POLY2_ без ENDPOLY)
 // ============================================================================
 #include "GDLHelper.hpp"
+#include "GDLWriter.hpp"
 #include "BrowserRepl.hpp"
+#include "JobManager.hpp"
+#include "Perf.hpp"
+#include "SelectionHelper.hpp"
+#include "CommandProtocol.hpp"
 #include "ACAPinc.h"
 #include "APICommon.h"
 
 #include <cmath>
-#include <cstdarg>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace GDLHelper {
 
@@ -22,120 +32,129 @@ namespace GDLHelper {
 
 	constexpr double PI = 3.14159265358979323846;
 
-	static void Log(const GS::UniString& s)
-	{
-		// if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser(s);
-	}
+	// Рабочие потоки пакетной генерации в браузер не пишут: итог и ошибки групп
+	// выводит шаг задания в главном потоке
+	static thread_local bool t_workerThread = false;
 
-	static void AppendFormat(GS::UniString& dst, const char* fmt, ...)
+	static void Log(const GS::UniString& s)
 	{
-		char buf[2048];
-		va_list args; va_start(args, fmt);
-#if defined(_MSC_VER)
-		_vsnprintf_s(buf, sizeof(buf), _TRUNCATE, fmt, args);
-#else
-		vsnprintf(buf, sizeof(buf), fmt, args);
-#endif
-		va_end(args);
-		dst.Append(GS::UniString(buf, CC_UTF8));
+		if (t_workerThread) return;
+		if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().LogToBrowser(s);
 	}
 
 	// ----------------------------------------------------------------------------
-	// Основной генератор
+	// Геометрические записи
 	// ----------------------------------------------------------------------------
-	GS::UniString GenerateGDLFromSelection()
-	{
-		GS::Array<API_Neig> selNeigs;
-		API_SelectionInfo selInfo = {};
-		ACAPI_Selection_Get(&selInfo, &selNeigs, false);
-		BMKillHandle((GSHandle*)&selInfo.marquee.coords);
-
-		if (selNeigs.IsEmpty())
-			return "Нет элементов для генерации.";
-
-		// Геометрические записи
-		struct LineRec {
-			double x1, y1, x2, y2;
-			int    pen;
-			int    drawIndex;
-		};
-
-		struct ArcRec {
-			double cx, cy, r;
-			double sDeg, eDeg;
-			int    pen;
-			int    drawIndex;
-		};
-
-		struct CircleRec {
-			double cx, cy, r;
-			int    pen;
-			int    drawIndex;
-		};
+	struct LineRec {
+		double x1, y1, x2, y2;
+		int    pen;
+		int    drawIndex;
+	};
+
+	struct ArcRec {
+		double cx, cy, r;
+		double sDeg, eDeg;
+		int    pen;
+		int    drawIndex;
+	};
+
+	struct CircleRec {
+		double cx, cy, r;
+		int    pen;
+		int    drawIndex;
+	};
+
+	// Полилиния / штриховка: POLY2_ замкнутый контур без дуг (poly2_b{5} не используем)
+	struct PolyRec {
+		GS::Array<API_Coord> pts;
+		int    pen;
+		bool   wantFill;
+		int    drawIndex;
+	};
+
+	// Цепочка соединённых отрезков одного пера (после Compact): POLY2_ без заливки
+	struct ChainRec {
+		std::vector<API_Coord> pts;
+		bool   closed;
+		int    pen;
+		int    drawIndex;
+	};
+
+	enum class PrimKind : UInt8 { Line, Arc, Circle, Poly, Chain };
+
+	// Ссылка на запись для общего порядка вывода
+	struct PrimRef {
+		int      drawIndex;
+		PrimKind kind;
+		UInt32   idx;
+	};
+
+	struct Drawing {
+		std::vector<LineRec>   lines;
+		std::vector<ArcRec>    arcs;
+		std::vector<CircleRec> circles;
+		std::vector<PolyRec>   polys;
+		std::vector<ChainRec>  chains;
+		std::vector<PrimRef>   order;
 
-		struct PolyRec {
-			GS::Array<API_Coord> pts;
-			int    pen;
-			int    frameFill;   // битовая маска 1 контур /2 заливка /4 замкнуть
-			int    drawIndex;
-		};
+		double minX = 1e300, minY = 1e300;
+		double maxX = -1e300, maxY = -1e300;
 
-		// ComplexPolyRec раньше был poly2_b{5} с дугами и penAttribute_*
-		// сейчас мы упростим: будем выводить как POLY2_ замкнутый контур без дуг
-		struct ComplexPolyRec {
-			GS::Array<API_Coord> pts;
-			int    pen;
-			bool   wantFill;
-			int    drawIndex;
-		};
+		void UpdBBox(double x, double y)
+		{
+			if (x < minX) minX = x;
+			if (x > maxX) maxX = x;
+			if (y < minY) minY = y;
+			if (y > maxY) maxY = y;
+		}
+	};
 
-		GS::Array<LineRec>         lines;
-		GS::Array<ArcRec>          arcs;
-		GS::Array<CircleRec>       circles;
-		GS::Array<PolyRec>         polys;
-		GS::Array<ComplexPolyRec>  complexPolys;
+	static int PenOf(short penIndex)
+	{
+		return penIndex < 0 ? 0 : (int)penIndex;
+	}
 
-		constexpr double PI = 3.14159265358979323846;
+	// ----------------------------------------------------------------------------
+	// Сбор примитивов по элементам
+	// ----------------------------------------------------------------------------
+	static void Collect(const GS::Array<API_Guid>& guids, Drawing& d)
+	{
+		int drawIndex = 1;
 
-		auto NormDeg = [](double d) -> double {
-			d = std::fmod(d, 360.0);
-			if (d < 0.0) d += 360.0;
-			return d;
+		auto AddLine = [&](const API_Coord& a, const API_Coord& b, int pen) {
+			d.order.push_back({ drawIndex, PrimKind::Line, (UInt32)d.lines.size() });
+			d.lines.push_back({ a.x, a.y, b.x, b.y, pen, drawIndex });
+			d.UpdBBox(a.x, a.y);
+			d.UpdBBox(b.x, b.y);
+			++drawIndex;
 			};
 
-		double minX = 1e300, minY = 1e300;
-		double maxX = -1e300, maxY = -1e300;
-
-		auto UpdBBox = [&](double x, double y) {
-			if (x < minX) minX = x; if (x > maxX) maxX = x;
-			if (y < minY) minY = y; if (y > maxY) maxY = y;
+		auto AddPoly = [&](const API_ElementMemo& memo, Int32 nPts, int pen, bool wantFill) {
+			PolyRec cp;
+			cp.pen = pen;
+			cp.wantFill = wantFill;
+			cp.drawIndex = drawIndex;
+			cp.pts.SetSize(nPts);
+			for (Int32 i = 1; i <= nPts; ++i) {
+				cp.pts[i - 1] = (*memo.coords)[i];
+				d.UpdBBox(cp.pts[i - 1].x, cp.pts[i - 1].y);
+			}
+			d.order.push_back({ drawIndex, PrimKind::Poly, (UInt32)d.polys.size() });
+			d.polys.push_back(std::move(cp));
+			++drawIndex;
 			};
 
-		UInt32 appended = 0;
-		int drawIndex = 1;
-
-		for (const API_Neig& n : selNeigs) {
+		for (const API_Guid& guid : guids) {
 			API_Element e = {};
-			e.header.guid = n.guid;
-			if (ACAPI_Element_Get(&e) != NoError)
+			e.header.guid = guid;
+			if (Perf::ElementGet(&e) != NoError)
 				continue;
 
 			switch (e.header.type.typeID) {
 
 			case API_LineID:
-			{
-				const API_Coord a = e.line.begC;
-				const API_Coord b = e.line.endC;
-				int pen = (int)e.line.linePen.penIndex;
-				if (pen < 0) pen = 0;
-
-				lines.Push({ a.x, a.y, b.x, b.y, pen, drawIndex });
-				UpdBBox(a.x, a.y);
-				UpdBBox(b.x, b.y);
-				++appended;
-				++drawIndex;
+				AddLine(e.line.begC, e.line.endC, PenOf(e.line.linePen.penIndex));
 				break;
-			}
 
 			case API_ArcID:
 			{
@@ -150,26 +169,12 @@ namespace GDLHelper {
 				if (delta < 0.0)
 					std::swap(sa, ea);
 
-				const double sDeg = NormDeg(sa * 180.0 / PI);
-				const double eDeg = NormDeg(ea * 180.0 / PI);
-
-				int pen = (int)e.arc.linePen.penIndex;
-				if (pen < 0) pen = 0;
-
-				arcs.Push({
-					a.origC.x,
-					a.origC.y,
-					a.r,
-					sDeg,
-					eDeg,
-					pen,
-					drawIndex
-					});
-
-				UpdBBox(a.origC.x - a.r, a.origC.y - a.r);
-				UpdBBox(a.origC.x + a.r, a.origC.y + a.r);
-
-				++appended;
+				d.order.push_back({ drawIndex, PrimKind::Arc, (UInt32)d.arcs.size() });
+				d.arcs.push_back({ a.origC.x, a.origC.y, a.r,
+					NormDeg(sa * 180.0 / PI), NormDeg(ea * 180.0 / PI),
+					PenOf(a.linePen.penIndex), drawIndex });
+				d.UpdBBox(a.origC.x - a.r, a.origC.y - a.r);
+				d.UpdBBox(a.origC.x + a.r, a.origC.y + a.r);
 				++drawIndex;
 				break;
 			}
@@ -177,273 +182,575 @@ namespace GDLHelper {
 			case API_CircleID:
 			{
 				const API_CircleType& c = e.circle;
-				int pen = (int)e.circle.linePen.penIndex;
-				if (pen < 0) pen = 0;
-
-				circles.Push({ c.origC.x, c.origC.y, c.r, pen, drawIndex });
-
-				UpdBBox(c.origC.x - c.r, c.origC.y - c.r);
-				UpdBBox(c.origC.x + c.r, c.origC.y + c.r);
-
-				++appended;
+				d.order.push_back({ drawIndex, PrimKind::Circle, (UInt32)d.circles.size() });
+				d.circles.push_back({ c.origC.x, c.origC.y, c.r, PenOf(c.linePen.penIndex), drawIndex });
+				d.UpdBBox(c.origC.x - c.r, c.origC.y - c.r);
+				d.UpdBBox(c.origC.x + c.r, c.origC.y + c.r);
 				++drawIndex;
 				break;
 			}
 
 			case API_PolyLineID:
+			case API_SplineID:
+			case API_HatchID:
 			{
 				API_ElementMemo memo = {};
-				if (ACAPI_Element_GetMemo(n.guid, &memo, APIMemoMask_Polygon) == NoError &&
-					memo.coords != nullptr)
-				{
-					const Int32 nSegs = BMGetHandleSize((GSHandle)memo.coords) / sizeof(API_Coord) - 1;
-					int pen = (int)e.polyLine.linePen.penIndex;
-					if (pen < 0) pen = 0;
-
-					// Мы НЕ будем городить poly2_b{5} для полилинии с дугами.
-					// Мы просто сохраним её как ComplexPolyRec без дуг (контур).
-					// В 2D потом выведем POLY2_ замкнутый.
-
-					ComplexPolyRec cp;
-					cp.pen = pen;
-					cp.wantFill = false;        // полилиния без заливки
-					cp.drawIndex = drawIndex;
-
-					cp.pts.SetSize(nSegs);
-					for (Int32 i = 1; i <= nSegs; ++i) {
-						cp.pts[i - 1] = (*memo.coords)[i];
-						UpdBBox(cp.pts[i - 1].x, cp.pts[i - 1].y);
+				if (Perf::ElementGetMemo(guid, &memo, APIMemoMask_Polygon) == NoError && memo.coords != nullptr) {
+					const Int32 nCoords = BMGetHandleSize((GSHandle)memo.coords) / sizeof(API_Coord);
+					if (e.header.type.typeID == API_SplineID) {
+						// сплайн — ломаная из отрезков
+						const int pen = PenOf(e.spline.linePen.penIndex);
+						for (Int32 i = 1; i + 1 < nCoords; ++i)
+							AddLine((*memo.coords)[i], (*memo.coords)[i + 1], pen);
+					}
+					else if (e.header.type.typeID == API_PolyLineID) {
+						if (nCoords >= 2)
+							AddPoly(memo, nCoords - 1, PenOf(e.polyLine.linePen.penIndex), false);
+					}
+					else if (nCoords >= 2) {
+						// штриховку отдаём как замкнутый POLY2_ с заливкой
+						AddPoly(memo, nCoords - 1, PenOf(e.hatch.contPen.penIndex), true);
 					}
-
-					complexPolys.Push(cp);
-					++appended;
-					++drawIndex;
 				}
 				ACAPI_DisposeElemMemoHdls(&memo);
 				break;
 			}
 
-			case API_SplineID:
-			{
-				API_ElementMemo memo = {};
-				if (ACAPI_Element_GetMemo(n.guid, &memo, APIMemoMask_Polygon) == NoError &&
-					memo.coords != nullptr)
-				{
-					const Int32 nPts = BMGetHandleSize((GSHandle)memo.coords) / sizeof(API_Coord) - 1;
-					int pen = (int)e.spline.linePen.penIndex;
-					if (pen < 0) pen = 0;
+			default:
+				break;
+			}
+		}
 
-					// как ломанные отрезки
-					for (Int32 i = 1; i < nPts; ++i) {
-						const API_Coord& A = (*memo.coords)[i];
-						const API_Coord& B = (*memo.coords)[i + 1];
+		// общий порядок вывода по drawIndex, O(n log n); равные индексы сохраняют порядок сбора
+		std::stable_sort(d.order.begin(), d.order.end(),
+			[](const PrimRef& a, const PrimRef& b) { return a.drawIndex < b.drawIndex; });
+	}
 
-						lines.Push({ A.x, A.y, B.x, B.y, pen, drawIndex });
+	// ----------------------------------------------------------------------------
+	// Compact: сжатие линий
+	//   1) коллинеарные отрезки одного пера сливаются (перекрытия и касания — в один);
+	//   2) отрезки, сходящиеся концами, собираются в цепочки POLY2_;
+	//   3) drawindex — два уровня (заливки под линиями), операторы сортируются по перу,
+	//      и Emit пишет pen/drawindex только при смене.
+	// Дуги, окружности и полилинии не меняются. Исходный порядок наложения (drawIndex на
+	// каждый примитив) не сохраняется — режим включается явно (Options::compact).
+	// ----------------------------------------------------------------------------
+	constexpr int kFillDrawIndex = 1;
+	constexpr int kLineDrawIndex = 2;
+
+	struct GridKey {
+		Int64 a, b, c;
+		int   pen;
+		bool operator==(const GridKey& o) const { return a == o.a && b == o.b && c == o.c && pen == o.pen; }
+	};
+
+	struct GridKeyHash {
+		size_t operator()(const GridKey& k) const
+		{
+			UInt64 h = (UInt64)k.a * 0x9E3779B97F4A7C15ull;
+			h ^= (UInt64)k.b + 0x7F4A7C159E3779B9ull + (h << 6) + (h >> 2);
+			h ^= (UInt64)k.c + 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+			h ^= (UInt64)k.pen + (h << 6) + (h >> 2);
+			return (size_t)h;
+		}
+	};
 
-						UpdBBox(A.x, A.y);
-						UpdBBox(B.x, B.y);
+	static Int64 Quant(double v, double step)
+	{
+		return (Int64)std::llround(v / step);
+	}
 
-						++appended;
-						++drawIndex;
-					}
-				}
-				ACAPI_DisposeElemMemoHdls(&memo);
-				break;
+	struct Segment {
+		API_Coord a, b;
+		int       pen;
+	};
+
+	// 1) слияние коллинеарных отрезков: группа = (перо, направление, смещение прямой),
+	//    внутри группы интервалы по параметру вдоль прямой сортируются и склеиваются
+	static std::vector<Segment> MergeCollinear(const std::vector<LineRec>& lines, double tol)
+	{
+		struct Span { double t0, t1; API_Coord p0, p1; };
+		std::unordered_map<GridKey, std::vector<Span>, GridKeyHash> groups;
+		std::vector<GridKey> groupOrder;
+
+		std::vector<Segment> out;
+		for (const LineRec& L : lines) {
+			double ux = L.x2 - L.x1, uy = L.y2 - L.y1;
+			const double len = std::sqrt(ux * ux + uy * uy);
+			if (len < tol) continue; // вырожденный отрезок
+			ux /= len; uy /= len;
+			API_Coord p0 = { L.x1, L.y1 }, p1 = { L.x2, L.y2 };
+			// направление без знака: одна прямая — один ключ
+			if (ux < -1e-12 || (std::fabs(ux) <= 1e-12 && uy < 0.0)) {
+				ux = -ux; uy = -uy;
+				std::swap(p0, p1);
+			}
+			const double off = -uy * p0.x + ux * p0.y;
+			const GridKey key = { Quant(ux, 1e-7), Quant(uy, 1e-7), Quant(off, tol), L.pen };
+			auto it = groups.find(key);
+			if (it == groups.end()) {
+				it = groups.emplace(key, std::vector<Span>()).first;
+				groupOrder.push_back(key);
 			}
+			it->second.push_back({ ux * p0.x + uy * p0.y, ux * p1.x + uy * p1.y, p0, p1 });
+		}
 
-			case API_HatchID:
-			{
-				API_ElementMemo memo = {};
-				if (ACAPI_Element_GetMemo(n.guid, &memo, APIMemoMask_Polygon) == NoError &&
-					memo.coords != nullptr)
-				{
-					const Int32 nCoords = BMGetHandleSize((GSHandle)memo.coords) / sizeof(API_Coord);
-					if (nCoords >= 2) {
-						// штриховку отдаём как замкнутый POLY2_ с заливкой
-						ComplexPolyRec cp;
-						cp.pen = (int)e.hatch.contPen.penIndex;
-						if (cp.pen < 0) cp.pen = 0;
-						cp.wantFill = true;
-						cp.drawIndex = drawIndex;
-
-						cp.pts.SetSize(nCoords - 1);
-						for (Int32 i = 1; i <= nCoords - 1; ++i) {
-							cp.pts[i - 1] = (*memo.coords)[i];
-							UpdBBox(cp.pts[i - 1].x, cp.pts[i - 1].y);
-						}
-
-						complexPolys.Push(cp);
-						++appended;
-						++drawIndex;
-					}
+		for (const GridKey& key : groupOrder) {
+			std::vector<Span>& spans = groups[key];
+			std::sort(spans.begin(), spans.end(), [](const Span& x, const Span& y) { return x.t0 < y.t0; });
+			Span cur = spans[0];
+			for (size_t i = 1; i <= spans.size(); ++i) {
+				if (i < spans.size() && spans[i].t0 <= cur.t1 + tol) {
+					if (spans[i].t1 > cur.t1) { cur.t1 = spans[i].t1; cur.p1 = spans[i].p1; }
+					continue;
 				}
-				ACAPI_DisposeElemMemoHdls(&memo);
-				break;
+				out.push_back({ cur.p0, cur.p1, key.pen });
+				if (i < spans.size()) cur = spans[i];
 			}
+		}
+		return out;
+	}
 
-			default:
-				break;
-			}
+	// 2) цепочки: узлы — концы отрезков на сетке tol, обход по узлам степени 2
+	static void BuildChains(const std::vector<Segment>& segs, double tol, Drawing& d)
+	{
+		std::unordered_map<GridKey, UInt32, GridKeyHash> nodeOf;
+		std::vector<API_Coord> nodePos;
+		std::vector<std::vector<UInt32>> adj;   // узел → отрезки
+		std::vector<UInt32> segA(segs.size()), segB(segs.size());
+
+		auto Node = [&](const API_Coord& c, int pen) -> UInt32 {
+			const GridKey key = { Quant(c.x, tol), Quant(c.y, tol), 0, pen };
+			const auto it = nodeOf.find(key);
+			if (it != nodeOf.end()) return it->second;
+			const UInt32 id = (UInt32)nodePos.size();
+			nodeOf.emplace(key, id);
+			nodePos.push_back(c);
+			adj.emplace_back();
+			return id;
+			};
+
+		// отрезки короче допуска или с концами в одном узле сетки в цепочки не идут:
+		// иначе получаются петли из одной точки
+		std::vector<bool> used(segs.size(), false);
+		for (size_t i = 0; i < segs.size(); ++i) {
+			if (std::hypot(segs[i].b.x - segs[i].a.x, segs[i].b.y - segs[i].a.y) < tol) { used[i] = true; continue; }
+			segA[i] = Node(segs[i].a, segs[i].pen);
+			segB[i] = Node(segs[i].b, segs[i].pen);
+			if (segB[i] == segA[i]) { used[i] = true; continue; }
+			adj[segA[i]].push_back((UInt32)i);
+			adj[segB[i]].push_back((UInt32)i);
 		}
 
-		if (appended == 0 || minX > maxX || minY > maxY)
-			return "Нет поддерживаемых элементов.";
+		auto Walk = [&](UInt32 startNode, UInt32 firstSeg) {
+			ChainRec ch;
+			ch.pen = segs[firstSeg].pen;
+			ch.drawIndex = kLineDrawIndex;
+			ch.closed = false;
+			ch.pts.push_back(nodePos[startNode]);
+			UInt32 node = startNode, seg = firstSeg;
+			for (;;) {
+				used[seg] = true;
+				node = (segA[seg] == node) ? segB[seg] : segA[seg];
+				if (node == startNode) { ch.closed = true; break; }
+				ch.pts.push_back(nodePos[node]);
+				if (adj[node].size() != 2) break;
+				const UInt32 next = (adj[node][0] == seg) ? adj[node][1] : adj[node][0];
+				if (used[next]) break;
+				seg = next;
+			}
+			if (ch.pts.size() == 2 && !ch.closed) {
+				d.order.push_back({ kLineDrawIndex, PrimKind::Line, (UInt32)d.lines.size() });
+				d.lines.push_back({ ch.pts[0].x, ch.pts[0].y, ch.pts[1].x, ch.pts[1].y, ch.pen, kLineDrawIndex });
+				return;
+			}
+			d.order.push_back({ kLineDrawIndex, PrimKind::Chain, (UInt32)d.chains.size() });
+			d.chains.push_back(std::move(ch));
+			};
 
-		const double cx = (minX + maxX) * 0.5;
-		const double cy = (minY + maxY) * 0.5;
+		// сначала открытые цепочки от концов и развилок, затем оставшиеся циклы
+		for (UInt32 n = 0; n < (UInt32)adj.size(); ++n) {
+			if (adj[n].size() == 2) continue;
+			for (UInt32 sIdx : adj[n])
+				if (!used[sIdx]) Walk(n, sIdx);
+		}
+		for (UInt32 i = 0; i < (UInt32)segs.size(); ++i)
+			if (!used[i]) Walk(segA[i], i);
+	}
 
-		const double baseW = std::max(0.0, maxX - minX);
-		const double baseH = std::max(0.0, maxY - minY);
+	static void Compact(Drawing& d, double tol)
+	{
+		const size_t linesIn = d.lines.size();
+		const std::vector<Segment> segs = MergeCollinear(d.lines, tol);
+
+		std::vector<LineRec> oldLines;
+		oldLines.swap(d.lines);
+		std::vector<PrimRef> oldOrder;
+		oldOrder.swap(d.order);
+
+		for (const PrimRef& ref : oldOrder) {
+			if (ref.kind == PrimKind::Line) continue;
+			const bool fill = ref.kind == PrimKind::Poly && d.polys[ref.idx].wantFill;
+			d.order.push_back({ fill ? kFillDrawIndex : kLineDrawIndex, ref.kind, ref.idx });
+		}
+		BuildChains(segs, tol, d);
+
+		// по уровню, затем по перу — смена состояния только на границах групп
+		auto RefPen = [&](const PrimRef& r) -> int {
+			switch (r.kind) {
+			case PrimKind::Line:   return d.lines[r.idx].pen;
+			case PrimKind::Arc:    return d.arcs[r.idx].pen;
+			case PrimKind::Circle: return d.circles[r.idx].pen;
+			case PrimKind::Poly:   return d.polys[r.idx].pen;
+			case PrimKind::Chain:  return d.chains[r.idx].pen;
+			}
+			return 0;
+			};
+		std::stable_sort(d.order.begin(), d.order.end(), [&](const PrimRef& a, const PrimRef& b) {
+			if (a.drawIndex != b.drawIndex) return a.drawIndex < b.drawIndex;
+			return RefPen(a) < RefPen(b);
+			});
 
-		if (baseW < 1e-9 || baseH < 1e-9)
-			return "Недопустимые размеры bbox.";
+		Log(GS::UniString::Printf("[GDL] compact: %u lines -> %u segments -> %u lines + %u chains",
+			(unsigned)linesIn, (unsigned)segs.size(), (unsigned)d.lines.size(), (unsigned)d.chains.size()));
+	}
 
-		auto AppendFormat = [](GS::UniString& dst, const char* fmt, ...) {
-			char buf[2048];
-			va_list args; va_start(args, fmt);
-#if defined(_MSC_VER)
-			_vsnprintf_s(buf, sizeof(buf), _TRUNCATE, fmt, args);
-#else
-			vsnprintf(buf, sizeof(buf), fmt, args);
-#endif
-			va_end(args);
-			dst.Append(GS::UniString(buf, CC_UTF8));
+	// ----------------------------------------------------------------------------
+	// Вывод GDL: центр bbox -> (0,0), масштаб по A,B
+	// ----------------------------------------------------------------------------
+	static void Emit(const Drawing& d, GDLWriter& w, bool compact)
+	{
+		const double cx = (d.minX + d.maxX) * 0.5;
+		const double cy = (d.minY + d.maxY) * 0.5;
+
+		w.Raw("! === Масштабируемый код по A,B (центр в (0,0)) ===\n");
+		w.Raw("baseW = ").Num(d.maxX - d.minX).Nl();
+		w.Raw("baseH = ").Num(d.maxY - d.minY).Nl();
+		w.Raw("sx = 1\n");
+		w.Raw("IF baseW <> 0 THEN sx = A / baseW\n");
+		w.Raw("sy = 1\n");
+		w.Raw("IF baseH <> 0 THEN sy = B / baseH\n\n");
+		w.Raw("MUL2 sx, sy\n\n");
+
+		// состояние интерпретатора: без compact пишется перед каждым оператором (как раньше)
+		int  curDrawIndex = -1;
+		int  curPen = -1;
+		bool linePropSet = false;
+		bool fillSet = false;
+
+		auto Preamble = [&](int drawIndex, int pen, bool fill) {
+			if (!compact || drawIndex != curDrawIndex) w.Stmt("drawindex", drawIndex);
+			if (!compact || pen != curPen) w.Stmt("pen", pen);
+			if (fill && (!compact || !fillSet)) w.Raw("set fill 1\n");
+			if (!compact || !linePropSet) w.Raw("line_property 0\n");
+			curDrawIndex = drawIndex;
+			curPen = pen;
+			linePropSet = true;
+			fillSet = fillSet || fill;
+			};
+		auto End = [&]() {
+			if (!compact) w.Nl();
 			};
 
-		// сортировки по drawIndex (пузыри оставим как было, норм)
-		auto sortByDrawIndex = [](auto& arr) {
-			for (UIndex i = 0; i < arr.GetSize(); ++i) {
-				for (UIndex j = i + 1; j < arr.GetSize(); ++j) {
-					if (arr[i].drawIndex > arr[j].drawIndex) {
-						auto tmp = arr[i];
-						arr[i] = arr[j];
-						arr[j] = tmp;
-					}
+		for (const PrimRef& ref : d.order) {
+			switch (ref.kind) {
+			case PrimKind::Line:
+			{
+				const LineRec& L = d.lines[ref.idx];
+				Preamble(ref.drawIndex, L.pen, false);
+				w.Stmt("LINE2", L.x1 - cx, L.y1 - cy, L.x2 - cx, L.y2 - cy);
+				End();
+				break;
+			}
+			case PrimKind::Arc:
+			{
+				const ArcRec& A = d.arcs[ref.idx];
+				Preamble(ref.drawIndex, A.pen, false);
+				w.Stmt("ARC2", A.cx - cx, A.cy - cy, A.r, A.sDeg, A.eDeg);
+				End();
+				break;
+			}
+			case PrimKind::Circle:
+			{
+				const CircleRec& C = d.circles[ref.idx];
+				Preamble(ref.drawIndex, C.pen, false);
+				w.Stmt("CIRCLE2", C.cx - cx, C.cy - cy, C.r);
+				End();
+				break;
+			}
+			case PrimKind::Poly:
+			{
+				const PolyRec& P = d.polys[ref.idx];
+				const UIndex N = P.pts.GetSize();
+				if (N == 0)
+					break;
+				Preamble(ref.drawIndex, P.pen, P.wantFill);
+				// 7 = контур + заливка + замкнуть
+				w.Raw("POLY2_ ").Int(N).Raw(", 7,\n");
+				for (UIndex i = 0; i < N; ++i)
+					w.Row(i + 1 == N, P.pts[i].x - cx, P.pts[i].y - cy, 1);
+				End();
+				break;
+			}
+			case PrimKind::Chain:
+			{
+				// только контур; у открытой цепочки скрыто замыкающее ребро (статус последней точки 0)
+				const ChainRec& C = d.chains[ref.idx];
+				const size_t N = C.pts.size();
+				Preamble(ref.drawIndex, C.pen, false);
+				w.Raw("POLY2_ ").Int((Int64)N).Raw(", 1,\n");
+				for (size_t i = 0; i < N; ++i) {
+					const bool last = i + 1 == N;
+					w.Row(last, C.pts[i].x - cx, C.pts[i].y - cy, (last && !C.closed) ? 0 : 1);
 				}
+				End();
+				break;
+			}
 			}
-			};
-		sortByDrawIndex(lines);
-		sortByDrawIndex(arcs);
-		sortByDrawIndex(circles);
-		sortByDrawIndex(polys);
-		sortByDrawIndex(complexPolys);
-
-		// === финальный вывод GDL ===
-		GS::UniString out;
-		out.Append("! === Масштабируемый код по A,B (центр в (0,0)) ===\n");
-		AppendFormat(out, "baseW = %.6f\nbaseH = %.6f\n", baseW, baseH);
-
-		out.Append("sx = 1\n");
-		out.Append("IF baseW <> 0 THEN sx = A / baseW\n");
-		out.Append("sy = 1\n");
-		out.Append("IF baseH <> 0 THEN sy = B / baseH\n\n");
-
-		out.Append("MUL2 sx, sy\n\n");
-
-		// ЛИНИИ
-		for (const auto& L : lines) {
-			AppendFormat(out, "drawindex %d\n", L.drawIndex);
-			AppendFormat(out, "pen %d\n", L.pen);
-			out.Append("line_property 0\n");
-			AppendFormat(out,
-				"LINE2 %.6f, %.6f, %.6f, %.6f\n\n",
-				L.x1 - cx, L.y1 - cy,
-				L.x2 - cx, L.y2 - cy
-			);
 		}
 
-		// ДУГИ
-		for (const auto& A : arcs) {
-			AppendFormat(out, "drawindex %d\n", A.drawIndex);
-			AppendFormat(out, "pen %d\n", A.pen);
-			out.Append("line_property 0\n");
-			AppendFormat(out,
-				"ARC2 %.6f, %.6f, %.6f, %.6f, %.6f\n\n",
-				A.cx - cx, A.cy - cy,
-				A.r,
-				A.sDeg,
-				A.eDeg
-			);
+		w.Raw("DEL 1\n");
+	}
+
+	// Проверка, сжатие и вывод собранного чертежа. ACAPI не вызывает — можно из рабочего потока
+	static bool Finalize(Drawing& d, GDLWriter& w, GS::UniString& error, const Options& opt)
+	{
+		if (d.order.empty() || d.minX > d.maxX || d.minY > d.maxY) {
+			error = "Нет поддерживаемых элементов.";
+			return false;
+		}
+		if (d.maxX - d.minX < 1e-9 || d.maxY - d.minY < 1e-9) {
+			error = "Недопустимые размеры bbox.";
+			return false;
 		}
 
-		// ОКРУЖНОСТИ
-		for (const auto& C : circles) {
-			AppendFormat(out, "drawindex %d\n", C.drawIndex);
-			AppendFormat(out, "pen %d\n", C.pen);
-			out.Append("line_property 0\n");
-			AppendFormat(out,
-				"CIRCLE2 %.6f, %.6f, %.6f\n\n",
-				C.cx - cx, C.cy - cy,
-				C.r
-			);
+		if (opt.compact)
+			Compact(d, std::max(opt.tolerance, 1e-9));
+		Emit(d, w, opt.compact);
+		if (!w.Finish()) {
+			error = "Ошибка записи GDL.";
+			return false;
 		}
+		return true;
+	}
 
-		// ПРОСТЫЕ POLY2_ (если вдруг появятся; сейчас polys не заполняется,
-		// но оставим на будущее)
-		for (const auto& P : polys) {
-			const UIndex N = P.pts.GetSize();
-			if (N == 0)
-				continue;
+	// ----------------------------------------------------------------------------
+	// Публичные функции
+	// ----------------------------------------------------------------------------
+	bool WriteGDL(const GS::Array<API_Guid>& guids, GDLWriter& w, GS::UniString& error, const Options& opt)
+	{
+		if (guids.IsEmpty()) {
+			error = "Нет элементов для генерации.";
+			return false;
+		}
 
-			AppendFormat(out, "drawindex %d\n", P.drawIndex);
-			AppendFormat(out, "pen %d\n", P.pen);
+		Drawing d;
+		Collect(guids, d);
+		if (!Finalize(d, w, error, opt))
+			return false;
+		Log(GS::UniString::Printf("[GDL] %u primitives, %llu bytes", (unsigned)d.order.size(), (unsigned long long)w.Bytes()));
+		return true;
+	}
 
-			// нарисуем как замкнутый с заливкой если frameFill & 2
-			const bool wantFill = ((P.frameFill & 2) != 0);
-			if (wantFill) {
-				out.Append("set fill 1\n");
-			}
+	std::string GenerateGDLUtf8(bool& ok, const Options& opt)
+	{
+		GDLWriter w;
+		GS::UniString error;
+		ok = WriteGDL(SelectionHelper::GetSelectedGuids(), w, error, opt);
+		return ok ? w.Text() : CommandProtocol::ToUtf8(error);
+	}
 
-			// frameFill: используем 7 = контур+заливка+замкнуть (надёжно)
-			out.Append("line_property 0\n");
-			AppendFormat(out, "POLY2_ %u, 7,\n", (unsigned)N);
-
-			for (UIndex i = 0; i < N; ++i) {
-				const auto& c = P.pts[i];
-				bool last = (i + 1 == N);
-				AppendFormat(out,
-					"    %.6f, %.6f, 1%s\n",
-					c.x - cx, c.y - cy,
-					last ? "" : ","
-				);
-			}
-			out.Append("\n");
+	GS::UniString GenerateGDLFromSelection()
+	{
+		bool ok = false;
+		return CommandProtocol::FromUtf8(GenerateGDLUtf8(ok));
+	}
+
+	bool GenerateGDLToFile(const IO::Location& file, GS::UniString& error, const Options& opt)
+	{
+		GDLWriter w(file);
+		if (w.HasError()) {
+			error = "Не удалось открыть файл.";
+			return false;
 		}
+		return WriteGDL(SelectionHelper::GetSelectedGuids(), w, error, opt);
+	}
+
+	// ----------------------------------------------------------------------------
+	// Пакет: группа выделения → отдельный файл скрипта
+	//   1) группировка по слою / корневой группе (главный поток, только заголовки);
+	//   2) сбор примитивов группы — по одной группе за шаг задачи (главный поток, ACAPI);
+	//   3) сжатие и запись файлов — пулом рабочих потоков, по группе на поток.
+	// ----------------------------------------------------------------------------
+	struct BatchGroup {
+		GS::UniString       name;
+		GS::Array<API_Guid> guids;
+		IO::Location        file;
+		Drawing             d;
+		GS::UniString       error;
+		bool                ok = false;
+	};
+
+	struct BatchState {
+		enum Phase { Group, Collect, Generate } phase = Group;
+		IO::Location            folder;
+		GroupBy                 by = GroupBy::Layer;
+		Options                 opt;
+		GS::Array<API_Guid>     guids;
+		std::vector<BatchGroup> groups;
+		size_t                  next = 0;
+		std::atomic<UInt32>     done { 0 };
+		std::chrono::steady_clock::time_point t0;
+	};
+
+	static GS::UniString FileNameFor(const GS::UniString& name, std::vector<GS::UniString>& used)
+	{
+		GS::UniString clean = name;
+		for (const char* bad : { "/", "\\", ":", "*", "?", "\"", "<", ">", "|" })
+			clean.ReplaceAll(GS::UniString(bad), GS::UniString("_"));
+		clean.Trim();
+		if (clean.IsEmpty()) clean = "Group";
+
+		// одинаковые имена (в т.ч. без учёта регистра) получают суффикс " (2)", " (3)"...
+		auto taken = [&used](const GS::UniString& c) {
+			return std::any_of(used.begin(), used.end(), [&c](const GS::UniString& u) { return u.IsEqual(c, GS::CaseInsensitive); });
+		};
+		GS::UniString candidate = clean;
+		for (UInt32 n = 2; taken(candidate); ++n)
+			candidate = clean + GS::UniString::Printf(" (%u)", (unsigned)n);
+		used.push_back(candidate);
+		return candidate + ".gdl";
+	}
 
-		// COMPLEX POLYS → тоже как POLY2_ без дуг
-		for (const auto& CP : complexPolys) {
-			const UIndex N = CP.pts.GetSize();
-			if (N == 0)
+	static void GroupSelection(BatchState& s)
+	{
+		// ключ группы: индекс слоя или GUID корневой группы; линейный поиск — групп немного
+		std::vector<API_AttributeIndex> layerKeys;
+		std::vector<API_Guid> groupKeys;
+
+		for (const API_Guid& guid : s.guids) {
+			API_Elem_Head head = {};
+			head.guid = guid;
+			if (ACAPI_Element_GetHeader(&head) != NoError)
 				continue;
 
-			AppendFormat(out, "drawindex %d\n", CP.drawIndex);
-			AppendFormat(out, "pen %d\n", CP.pen);
-			if (CP.wantFill) {
-				out.Append("set fill 1\n");
+			size_t gi = 0;
+			if (s.by == GroupBy::Layer) {
+				for (; gi < layerKeys.size() && !(layerKeys[gi] == head.layer); ++gi) {}
+				if (gi == layerKeys.size()) {
+					layerKeys.push_back(head.layer);
+					API_Attribute attr = {};
+					attr.header.typeID = API_LayerID;
+					attr.header.index = head.layer;
+					BatchGroup g;
+					g.name = (ACAPI_Attribute_Get(&attr) == NoError) ? GS::UniString(attr.header.name) : GS::UniString("Layer");
+					s.groups.push_back(std::move(g));
+				}
 			}
-
-			out.Append("line_property 0\n");
-			// всегда закрываем контур и даём заливку если wantFill:
-			// 7 = контур + заливка + замкнуть
-			out.Append("POLY2_ ");
-			AppendFormat(out, "%u, 7,\n", (unsigned)N);
-
-			for (UIndex i = 0; i < N; ++i) {
-				const auto& c = CP.pts[i];
-				bool last = (i + 1 == N);
-				AppendFormat(out,
-					"    %.6f, %.6f, 1%s\n",
-					c.x - cx, c.y - cy,
-					last ? "" : ","
-				);
+			else {
+				API_Guid root = APINULLGuid;
+				if (ACAPI_Grouping_GetRootGroup(guid, &root) != NoError)
+					root = APINULLGuid;   // вне групп — общая группа "Ungrouped"
+				for (; gi < groupKeys.size() && groupKeys[gi] != root; ++gi) {}
+				if (gi == groupKeys.size()) {
+					groupKeys.push_back(root);
+					BatchGroup g;
+					g.name = (root == APINULLGuid) ? GS::UniString("Ungrouped")
+						: GS::UniString::Printf("Group %u", (unsigned)groupKeys.size());
+					s.groups.push_back(std::move(g));
+				}
 			}
-			out.Append("\n");
+			s.groups[gi].guids.Push(guid);
 		}
 
-		out.Append("DEL 1\n");
+		std::vector<GS::UniString> used;
+		for (BatchGroup& g : s.groups) {
+			g.file = s.folder;
+			g.file.AppendToLocal(IO::Name(FileNameFor(g.name, used)));
+		}
+	}
 
-		return out;
+	// Рабочие потоки берут группы по одной; Drawing после записи освобождается
+	static void GenerateParallel(BatchState& s, JobManager::Context& ctx)
+	{
+		const size_t n = s.groups.size();
+		const size_t hw = std::max<size_t>(1, (size_t)std::thread::hardware_concurrency());
+		const size_t nThreads = std::min(hw, n);
+
+		std::atomic<size_t> next(0);
+		Perf::Sink* sink = Perf::SinkScope::Current();
+		auto worker = [&]() {
+			Perf::SinkScope perf(sink);
+			t_workerThread = true;
+			for (size_t i = next.fetch_add(1); i < n; i = next.fetch_add(1)) {
+				BatchGroup& g = s.groups[i];
+				if (ctx.IsCancelled()) break;
+				if (!g.d.order.empty()) {
+					GDLWriter w(g.file);
+					if (w.HasError()) g.error = "Не удалось открыть файл.";
+					else              g.ok = Finalize(g.d, w, g.error, s.opt);
+				}
+				g.d = Drawing();
+				ctx.Report(++s.done, (UInt32)n, "write");
+			}
+		};
+
+		if (nThreads <= 1) { worker(); t_workerThread = false; return; }
+		std::vector<std::thread> pool;
+		pool.reserve(nThreads);
+		for (size_t t = 0; t < nThreads; ++t) pool.emplace_back(worker);
+		for (std::thread& th : pool) th.join();
 	}
 
+	UInt32 SubmitBatch(const IO::Location& folder, GroupBy by, const Options& opt)
+	{
+		auto state = std::make_shared<BatchState>();
+		state->folder = folder;
+		state->by = by;
+		state->opt = opt;
+		state->guids = SelectionHelper::GetSelectedGuids();
+		if (state->guids.IsEmpty())
+			return 0;
+		IO::fileSystem.CreateFolder(folder); // уже есть — не ошибка; запись файлов покажет
+
+		return JobManager::Submit("Generate GDL Batch", [state](JobManager::Context& ctx) -> JobManager::Step {
+			BatchState& s = *state;
+
+			switch (s.phase) {
+			case BatchState::Group:
+				s.t0 = std::chrono::steady_clock::now();
+				GroupSelection(s);
+				if (s.groups.empty()) return JobManager::Step::Failed;
+				s.phase = BatchState::Collect;
+				ctx.Report(0, (UInt32)s.groups.size(), "collect");
+				return JobManager::Step::Continue;
+
+			case BatchState::Collect: {
+				BatchGroup& g = s.groups[s.next];
+				GDLHelper::Collect(g.guids, g.d);
+				ctx.Report((UInt32)++s.next, (UInt32)s.groups.size(), "collect");
+				if (s.next < s.groups.size()) return JobManager::Step::Continue;
+
+				s.phase = BatchState::Generate;
+				ctx.Report(0, (UInt32)s.groups.size(), "write");
+				JobManager::Context* c = &ctx;
+				ctx.RunAsync([state, c]() { GenerateParallel(*state, *c); });
+				return JobManager::Step::Continue;
+			}
+
+			case BatchState::Generate: {
+				UInt32 written = 0;
+				for (const BatchGroup& g : s.groups) {
+					if (g.ok) ++written;
+					else if (!g.error.IsEmpty()) Log(GS::UniString("[GDL batch] ") + g.name + ": " + g.error);
+				}
+				const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - s.t0).count();
+				Log(GS::UniString::Printf("[GDL batch] %u of %u files written, %.0f ms", (unsigned)written, (unsigned)s.groups.size(), ms));
+				return written > 0 ? JobManager::Step::Done : JobManager::Step::Failed;
+			}
+			}
+			return JobManager::Step::Failed;
+		});
+	}
 
 } // namespace GDLHelper
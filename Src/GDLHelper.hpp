@@ -1,7 +1,37 @@
 #pragma once
 #include "APIEnvir.h"
 #include "ACAPinc.h"
+#include "Location.hpp"
+
+#include <string>
+
+class GDLWriter;
 
 namespace GDLHelper {
+	struct Options {
+		// слить коллинеарные отрезки, собрать цепочки POLY2_, не повторять pen/drawindex.
+		// Порядок отрисовки при этом сводится к двум уровням (заливки под линиями), поэтому по умолчанию выключено
+		bool   compact = false;
+		double tolerance = 0.0005;   // м: совпадение концов и коллинеарность при сжатии
+	};
+
+	// 2D-примитивы элементов (линии, дуги, окружности, полилинии, сплайны, штриховки) → GDL в w.
+	// false — нечего выводить или ошибка записи (error — текст для пользователя)
+	bool WriteGDL(const GS::Array<API_Guid>& guids, GDLWriter& w, GS::UniString& error, const Options& opt = Options());
+
+	// GDL по выделению: текст скрипта или сообщение об ошибке (как раньше)
 	GS::UniString GenerateGDLFromSelection();
+
+	// То же сразу в UTF-8 (для CommandProtocol без перекодировки через UniString)
+	std::string GenerateGDLUtf8(bool& ok, const Options& opt = Options());
+
+	// Потоковая запись GDL по выделению в файл: скрипт не собирается в памяти целиком
+	bool GenerateGDLToFile(const IO::Location& file, GS::UniString& error, const Options& opt = Options());
+
+	enum class GroupBy { Layer, Group };
+
+	// Пакет задачей JobManager: выделение делится на группы (по слою или корневой группе элементов),
+	// каждая — в свой файл <folder>/<имя>.gdl. Чтение элементов — в главном потоке,
+	// сжатие и запись — параллельно в рабочих потоках. ID задачи (0 — выделение пусто)
+	UInt32 SubmitBatch(const IO::Location& folder, GroupBy by, const Options& opt = Options());
 }
@@ -0,0 +1,102 @@
+#include "GDLWriter.hpp"
+
+#include "File.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+GDLWriter::GDLWriter ()
+{
+    m_buf.reserve(64 * 1024);
+}
+
+GDLWriter::GDLWriter (const IO::Location& file)
+{
+    m_toFile = true;
+    m_buf.reserve(FlushBytes + 4096);
+    m_file.reset(new IO::File(file, IO::File::Create));
+    if (m_file->GetStatus() != NoError || m_file->Open(IO::File::WriteEmptyMode) != NoError) {
+        m_error = true;
+        m_file.reset();
+    }
+}
+
+GDLWriter::~GDLWriter ()
+{
+    if (m_file != nullptr) Finish();
+}
+
+GDLWriter& GDLWriter::Raw (const char* s)
+{
+    return Raw(s, std::strlen(s));
+}
+
+GDLWriter& GDLWriter::Raw (const char* s, size_t n)
+{
+    m_buf.append(s, n);
+    MaybeFlush();
+    return *this;
+}
+
+GDLWriter& GDLWriter::Int (Int64 v)
+{
+    char tmp[24];
+    char* p = tmp + sizeof(tmp);
+    UInt64 u = v < 0 ? (UInt64)0 - (UInt64)v : (UInt64)v;
+    do { *--p = (char)('0' + u % 10); u /= 10; } while (u != 0);
+    if (v < 0) *--p = '-';
+    return Raw(p, (size_t)(tmp + sizeof(tmp) - p));
+}
+
+// Как "%.6f", но без хвостовых нулей: 1.500000 -> 1.5, 2.000000 -> 2, -0.0000001 -> 0
+GDLWriter& GDLWriter::Num (double v)
+{
+    if (!std::isfinite(v)) return Put('0');
+
+    const double a = std::fabs(v);
+    if (a >= 9.0e12) {
+        // за пределами точных целых в микроединицах — обычный printf
+        char tmp[64];
+        const int n = std::snprintf(tmp, sizeof(tmp), "%.6f", v);
+        return Raw(tmp, n > 0 ? (size_t)n : 0);
+    }
+
+    const UInt64 scaled = (UInt64)std::llround(a * 1.0e6);
+    if (scaled == 0) return Put('0');
+    if (v < 0.0) Put('-');
+    Int((Int64)(scaled / 1000000));
+
+    UInt64 frac = scaled % 1000000;
+    if (frac == 0) return *this;
+    char digits[7] = { '.', '0', '0', '0', '0', '0', '0' };
+    for (int i = 6; i >= 1; --i) { digits[i] = (char)('0' + frac % 10); frac /= 10; }
+    size_t len = 7;
+    while (digits[len - 1] == '0') --len;
+    return Raw(digits, len);
+}
+
+void GDLWriter::MaybeFlush ()
+{
+    if (!m_toFile || m_buf.size() < FlushBytes) return;
+    if (m_file != nullptr) FlushToFile();
+    else m_buf.clear(); // файл не открылся — текст некуда писать, Finish() вернёт false
+}
+
+void GDLWriter::FlushToFile ()
+{
+    if (m_buf.empty()) return;
+    if (m_file->WriteBin(m_buf.data(), (USize)m_buf.size()) != NoError) m_error = true;
+    m_flushed += m_buf.size();
+    m_buf.clear();
+}
+
+bool GDLWriter::Finish ()
+{
+    if (m_file != nullptr) {
+        FlushToFile();
+        m_file->Close();
+        m_file.reset();
+    }
+    return !m_error;
+}
@@ -0,0 +1,94 @@
+#ifndef GDLWRITER_HPP
+#define GDLWRITER_HPP
+
+#include "APIEnvir.h"
+#include "ACAPinc.h"
+#include "GSRoot.hpp"
+#include "Location.hpp"
+
+#include <memory>
+#include <string>
+
+namespace IO { class File; }
+
+// ============================================================================
+// GDLWriter — текст GDL-скрипта в растущем UTF-8 буфере.
+// Числа пишутся без printf (6 знаков после точки, хвостовые нули убираются),
+// операторы — без временных GS::UniString. В режиме файла буфер сбрасывается
+// на диск порциями по FlushBytes, и скрипт любого размера не держится в памяти.
+//
+//   GDLWriter w;
+//   w.Stmt("LINE2", x1, y1, x2, y2);   // "LINE2 x1, y1, x2, y2\n"
+// ============================================================================
+class GDLWriter {
+public:
+    static constexpr size_t FlushBytes = 1 << 20;
+
+    GDLWriter ();                                   // в память
+    explicit GDLWriter (const IO::Location& file);  // поток в файл (перезапись)
+    ~GDLWriter ();
+
+    GDLWriter (const GDLWriter&) = delete;
+    GDLWriter& operator= (const GDLWriter&) = delete;
+
+    GDLWriter& Raw (const char* s);
+    GDLWriter& Raw (const char* s, size_t n);
+    GDLWriter& Raw (const std::string& s) { return Raw(s.data(), s.size()); }
+    GDLWriter& Int (Int64 v);
+    GDLWriter& Num (double v);
+    GDLWriter& Nl () { return Put('\n'); }
+
+    // Оператор с аргументами через ", " и переводом строки
+    template <typename... T>
+    GDLWriter& Stmt (const char* keyword, T... args)
+    {
+        Raw(keyword);
+        const char* sep = " ";
+        ((Raw(sep), Arg(args), sep = ", "), ...);
+        return Nl();
+    }
+
+    // Строка списка координат POLY2_ и т.п.: "    a, b, c,\n" (last — без запятой в конце)
+    template <typename... T>
+    GDLWriter& Row (bool last, T... args)
+    {
+        Raw("    ");
+        const char* sep = "";
+        ((Raw(sep), Arg(args), sep = ", "), ...);
+        if (!last) Put(',');
+        return Nl();
+    }
+
+    // Сбросить остаток и закрыть файл; false — ошибка записи
+    bool Finish ();
+
+    bool               IsFile () const { return m_toFile; }
+    bool               HasError () const { return m_error; }
+    UInt64             Bytes () const { return m_flushed + m_buf.size(); }
+    const std::string& Text () const { return m_buf; }   // режим памяти: весь скрипт
+
+private:
+    GDLWriter& Put (char c)
+    {
+        m_buf.push_back(c);
+        return *this;
+    }
+
+    void Arg (double v) { Num(v); }
+    void Arg (int v) { Int(v); }
+    void Arg (unsigned v) { Int((Int64)v); }
+    void Arg (Int64 v) { Int(v); }
+    void Arg (UInt64 v) { Int((Int64)v); }
+    void Arg (const char* s) { Raw(s); }
+
+    void MaybeFlush ();
+    void FlushToFile ();
+
+    std::string               m_buf;
+    std::unique_ptr<IO::File> m_file;
+    UInt64                    m_flushed = 0;
+    bool                      m_toFile = false;
+    bool                      m_error = false;
+};
+
+#endif // GDLWRITER_HPP
@@ -9,6 +9,7 @@ public:
     static bool SetGroundSurface();
     static bool SetGroundSurfaceByGuid(const API_Guid& meshGuid);  // Установить mesh напрямую по GUID
     static bool SetGroundObjects();
+    static bool SetGroundObjectsByGuids(const GS::Array<API_Guid>& guids); // объекты/лампы/колонны/балки из списка
     static bool GetGroundZAndNormal(const API_Coord3D& pos3D, double& z, API_Vector3D& normal);
 
     // Приземлить на mesh (offset игнорируется, ставим ровно на поверхность)
@@ -16,6 +17,11 @@ public:
 
     // Смещение по Z без mesh/TIN
     static bool ApplyZDelta(double deltaMeters);
+    static bool ApplyZDeltaToElements(const GS::Array<API_Guid>& guids, double deltaMeters);
+
+    // То же задачами JobManager (палитра не ждёт); возвращают ID задачи, 0 — нечего делать
+    static UInt32 SubmitGroundOffset(double offset);
+    static UInt32 SubmitZDelta(double deltaMeters);
 
     static bool DebugOneSelection();
 };
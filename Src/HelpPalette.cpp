@@ -61,10 +61,8 @@ const GS::Guid HelpPalette::s_guid("{06a4b1bb-f5ca-400b-bab5-ce65186d5d7e}");
 HelpPalette::HelpPalette()
 	: DG::Palette(ACAPI_GetOwnResModule(), HelpPaletteResId, ACAPI_GetOwnResModule(), s_guid)
 {
-	m_browserCtrl = new DG::Browser(GetReference(), HelpBrowserCtrlId);
 	Attach(*this);
 	BeginEventProcessing();
-	Init();
 }
 
 HelpPalette::~HelpPalette()
@@ -93,15 +91,26 @@ HelpPalette& HelpPalette::GetInstance()
 void HelpPalette::DestroyInstance() { s_instance = nullptr; }
 
 // -------------------- internals --------------------
-void HelpPalette::Init()
+// Браузер создаётся при первой загрузке страницы: палитра, открытая без URL, его не держит.
+// Изменения размера до этого копятся и применяются при создании.
+DG::Browser& HelpPalette::Browser()
 {
-	// if (m_browserCtrl) m_browserCtrl->LoadHTML ("<html><body>Help</body></html>");
+	if (m_browserCtrl == nullptr) {
+		m_browserCtrl = new DG::Browser(GetReference(), HelpBrowserCtrlId);
+		if (m_pendingDx != 0 || m_pendingDy != 0) {
+			BeginMoveResizeItems();
+			m_browserCtrl->Resize(m_pendingDx, m_pendingDy);
+			EndMoveResizeItems();
+			m_pendingDx = m_pendingDy = 0;
+		}
+	}
+	return *m_browserCtrl;
 }
 
 void HelpPalette::SetURL(const GS::UniString& url)
 {
-	if (m_browserCtrl == nullptr || url.IsEmpty()) return;
-	m_browserCtrl->LoadURL(url);
+	if (url.IsEmpty()) return;
+	Browser().LoadURL(url);
 }
 
 // -------------------- public API --------------------
@@ -127,9 +136,13 @@ void HelpPalette::HidePalette()
 // -------------------- DG::PanelObserver --------------------
 void HelpPalette::PanelResized(const DG::PanelResizeEvent& ev)
 {
+	if (m_browserCtrl == nullptr) {
+		m_pendingDx += ev.GetHorizontalChange();
+		m_pendingDy += ev.GetVerticalChange();
+		return;
+	}
 	BeginMoveResizeItems();
-	if (m_browserCtrl != nullptr)
-		m_browserCtrl->Resize(ev.GetHorizontalChange(), ev.GetVerticalChange());
+	m_browserCtrl->Resize(ev.GetHorizontalChange(), ev.GetVerticalChange());
 	EndMoveResizeItems();
 }
 
@@ -29,7 +29,7 @@ public:
 
 private:
 	HelpPalette();
-	void        Init();
+	DG::Browser& Browser();   // создаёт контрол при первом обращении
 	void        SetURL(const GS::UniString& url);
 
 	// DG::PanelObserver
@@ -41,4 +41,6 @@ private:
 	static const GS::Guid       s_guid;
 
 	DG::Browser* m_browserCtrl = nullptr;
+	short        m_pendingDx = 0;   // изменение размера палитры до создания браузера
+	short        m_pendingDy = 0;
 };
\ No newline at end of file
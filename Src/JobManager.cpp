@@ -0,0 +1,215 @@
+﻿#include "JobManager.hpp"
+#include "BrowserRepl.hpp"
+#include "Perf.hpp"
+#include "MacroRecorder.hpp"
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace JobManager {
+
+static inline void Log (const GS::UniString& s)
+{
+    if (BrowserRepl::HasInstance())
+        BrowserRepl::GetInstance().LogToBrowser(s);
+}
+
+// Сколько шагов подряд можно выполнить за один idle, прежде чем отдать управление Archicad
+static constexpr int SliceMs = 40;
+// Частота событий прогресса
+static constexpr int ProgressIntervalMs = 100;
+
+struct Job {
+    Context                               ctx;
+    GS::UniString                         name;
+    StepFn                                step;
+    State                                 state = State::Queued;
+    std::thread                           worker;
+    Perf::Sink                            perf;      // счётчики расчёта в RunAsync
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point lastEvent;
+};
+
+static std::deque<std::unique_ptr<Job>> g_jobs;
+static UInt32                           g_nextId = 1;
+
+const char* StateName (State s)
+{
+    switch (s) {
+    case State::Queued:    return "queued";
+    case State::Running:   return "running";
+    case State::Done:      return "done";
+    case State::Failed:    return "failed";
+    case State::Cancelled: return "cancelled";
+    }
+    return "unknown";
+}
+
+// ---------------- Context ----------------
+void Context::Report (UInt32 done, UInt32 total, const char* stage)
+{
+    m_done.store(done);
+    m_total.store(total);
+    if (stage != nullptr) {
+        std::lock_guard<std::mutex> lock(m_stageMutex);
+        const GS::UniString s(stage);
+        if (s != m_stage) { m_stage = s; m_stageChanged = true; }
+    }
+}
+
+// Доступ к внутренностям Context и Job для менеджера
+struct Runner {
+    static void StartAsync (Job& job, std::function<void ()> work)
+    {
+        if (job.worker.joinable()) job.worker.join();
+        job.ctx.m_asyncRunning.store(true);
+        Context* ctx = &job.ctx;
+        Perf::Sink* sink = &job.perf;
+        job.worker = std::thread([ctx, sink, work]() {
+            Perf::SinkScope perf(sink);
+            work();
+            ctx->m_asyncRunning.store(false);
+        });
+    }
+
+    static bool AsyncRunning (const Job& job) { return job.ctx.m_asyncRunning.load(); }
+
+    static void Post (Job& job, bool force)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        bool stageChanged = false;
+        GS::UniString stage;
+        {
+            std::lock_guard<std::mutex> lock(job.ctx.m_stageMutex);
+            stageChanged = job.ctx.m_stageChanged;
+            job.ctx.m_stageChanged = false;
+            stage = job.ctx.m_stage;
+        }
+        if (!force && !stageChanged && now - job.lastEvent < std::chrono::milliseconds(ProgressIntervalMs))
+            return;
+        job.lastEvent = now;
+
+        if (!BrowserRepl::HasInstance()) return;
+        const double sec = (job.state == State::Queued) ? 0.0
+            : std::chrono::duration<double>(now - job.started).count();
+        BrowserRepl::GetInstance().PostJobEvent(job.ctx.m_id, job.name, StateName(job.state),
+            job.ctx.m_done.load(), job.ctx.m_total.load(), stage, sec);
+    }
+
+    static void Cancel (Job& job) { job.ctx.m_cancel.store(true); }
+    static void SetId (Job& job, UInt32 id) { job.ctx.m_id = id; }
+};
+
+// Context::RunAsync вызывается только из шага текущей задачи — она всегда первая в очереди
+void Context::RunAsync (std::function<void ()> work)
+{
+    for (auto& job : g_jobs) {
+        if (&job->ctx == this) { Runner::StartAsync(*job, std::move(work)); return; }
+    }
+    work(); // задача уже снята — выполняем синхронно
+}
+
+// ---------------- Очередь ----------------
+UInt32 Submit (const GS::UniString& name, StepFn step)
+{
+    if (step == nullptr) return 0;
+
+    std::unique_ptr<Job> job(new Job());
+    const UInt32 id = g_nextId++;
+    Runner::SetId(*job, id);
+    job->name = name;
+    job->step = std::move(step);
+    job->lastEvent = std::chrono::steady_clock::now();
+
+    Log(GS::UniString::Printf("[Job] #%u queued: ", (unsigned)id) + name);
+    Runner::Post(*job, true);
+    g_jobs.push_back(std::move(job));
+    return id;
+}
+
+static void Finish (State state)
+{
+    std::unique_ptr<Job> job = std::move(g_jobs.front());
+    g_jobs.pop_front();
+    if (job->worker.joinable()) job->worker.join();
+
+    job->state = state;
+    const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - job->started).count();
+    Log(GS::UniString::Printf("[Job] #%u %s in %.3f s: ", (unsigned)job->ctx.Id(), StateName(state), sec) + job->name);
+    MacroRecorder::JobFinished(job->ctx.Id(), state == State::Done);
+    if (BrowserRepl::HasInstance()) BrowserRepl::GetInstance().FlushLog();
+    Runner::Post(*job, true);
+}
+
+bool Cancel (UInt32 jobId)
+{
+    bool found = false;
+    for (size_t i = 0; i < g_jobs.size(); ) {
+        Job& job = *g_jobs[i];
+        if (jobId != 0 && job.ctx.Id() != jobId) { ++i; continue; }
+        found = true;
+        if (i == 0 && job.state == State::Running) {
+            // текущая задача остановится перед следующим шагом
+            Runner::Cancel(job);
+            ++i;
+            continue;
+        }
+        job.state = State::Cancelled;
+        Log(GS::UniString::Printf("[Job] #%u cancelled before start: ", (unsigned)job.ctx.Id()) + job.name);
+        MacroRecorder::JobFinished(job.ctx.Id(), false);
+        Runner::Post(job, true);
+        g_jobs.erase(g_jobs.begin() + i);
+    }
+    return found;
+}
+
+bool IsBusy ()
+{
+    return !g_jobs.empty();
+}
+
+void Pump ()
+{
+    if (g_jobs.empty()) return;
+
+    Job* job = g_jobs.front().get();
+    if (Runner::AsyncRunning(*job)) { Runner::Post(*job, false); return; }
+    if (job->worker.joinable()) job->worker.join();
+
+    const bool firstSlice = (job->state == State::Queued);
+    if (firstSlice) {
+        job->state = State::Running;
+        job->started = std::chrono::steady_clock::now();
+        Runner::Post(*job, true);
+    }
+
+    // время шагов задачи — в статистику команды "job:<имя>"; счётчики расчёта в потоке копились
+    // в job->perf и добавляются сюда, в шаг после его завершения
+    Perf::CommandScope perf("job:" + std::string(job->name.ToCStr(0, MaxUSize, CC_UTF8).Get()), firstSlice);
+    job->perf.Drain();
+    const auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(SliceMs);
+    for (;;) {
+        if (job->ctx.IsCancelled()) { Finish(State::Cancelled); return; }
+
+        const Step r = job->step(job->ctx);
+        if (r == Step::Done)   { Finish(State::Done); return; }
+        if (r == Step::Failed) { Finish(State::Failed); return; }
+
+        if (Runner::AsyncRunning(*job) || std::chrono::steady_clock::now() >= until) break;
+    }
+    Runner::Post(*job, false);
+}
+
+void Shutdown ()
+{
+    for (auto& job : g_jobs) {
+        Runner::Cancel(*job);
+        if (job->worker.joinable()) job->worker.join();
+    }
+    g_jobs.clear();
+}
+
+} // namespace JobManager
@@ -0,0 +1,69 @@
+﻿#ifndef JOBMANAGER_HPP
+#define JOBMANAGER_HPP
+
+#include "APIEnvir.h"
+#include "ACAPinc.h"
+#include "GSRoot.hpp"
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+// ============================================================================
+// JobManager — долгие команды палитры без блокировки вызова из JS
+//   Submit() сразу возвращает ID; задача выполняется шагами в idle палитры (главный поток),
+//   тяжёлый расчёт шаг может отдать в рабочий поток (Context::RunAsync).
+//   Отмена проверяется между шагами; запись элементов всегда в главном потоке.
+//   Состояние уходит в страницу событиями JobEvent({...}).
+// ============================================================================
+namespace JobManager {
+
+    enum class State { Queued, Running, Done, Failed, Cancelled };
+
+    enum class Step { Continue, Done, Failed };
+
+    struct Runner;
+
+    class Context {
+    public:
+        UInt32 Id () const { return m_id; }
+        bool   IsCancelled () const { return m_cancel.load(); }
+
+        // Прогресс (можно из рабочего потока); stage — короткое имя фазы ("fetch", "compute", ...)
+        void Report (UInt32 done, UInt32 total, const char* stage = nullptr);
+
+        // Выполнить work в рабочем потоке; следующий шаг задачи будет вызван после его завершения.
+        // Внутри work нельзя вызывать ACAPI.
+        void RunAsync (std::function<void ()> work);
+
+    private:
+        friend struct Runner;
+
+        UInt32              m_id = 0;
+        std::atomic<bool>   m_cancel { false };
+        std::atomic<bool>   m_asyncRunning { false };
+        std::atomic<UInt32> m_done { 0 };
+        std::atomic<UInt32> m_total { 0 };
+        std::mutex          m_stageMutex;
+        GS::UniString       m_stage;
+        bool                m_stageChanged = false;
+    };
+
+    // Шаг задачи: вызывается в главном потоке, пока возвращает Continue
+    using StepFn = std::function<Step (Context& ctx)>;
+
+    UInt32 Submit (const GS::UniString& name, StepFn step);
+    bool   Cancel (UInt32 jobId);      // 0 — отменить все
+    bool   IsBusy ();
+
+    // Выполнить очередной шаг текущей задачи (BrowserRepl::PanelIdle)
+    void Pump ();
+
+    // Отменить всё и дождаться рабочих потоков (закрытие палитры)
+    void Shutdown ();
+
+    const char* StateName (State s);
+
+}
+
+#endif // JOBMANAGER_HPP
@@ -0,0 +1,299 @@
+﻿#include "JsonLite.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace JsonLite {
+
+// ---------------- Value ----------------
+const Value* Value::Find (const char* key) const
+{
+    if (m_type != Type::Object) return nullptr;
+    for (const Member& m : m_members)
+        if (m.first == key) return &m.second;
+    return nullptr;
+}
+
+Value& Value::Set (const char* key, Value v)
+{
+    m_type = Type::Object;
+    for (Member& m : m_members) {
+        if (m.first == key) { m.second = std::move(v); return m.second; }
+    }
+    m_members.emplace_back(key, std::move(v));
+    return m_members.back().second;
+}
+
+// ---------------- Разбор ----------------
+class Parser {
+public:
+    Parser (const std::string& text) : m_p(text.c_str()), m_begin(text.c_str()), m_end(text.c_str() + text.size()) {}
+
+    bool Run (Value& out, std::string& error)
+    {
+        SkipWs();
+        if (!ParseValue(out, 0)) { error = m_error; return false; }
+        SkipWs();
+        if (m_p != m_end) { Fail("trailing characters"); error = m_error; return false; }
+        return true;
+    }
+
+private:
+    static constexpr int MaxDepth = 64;
+
+    const char* m_p;
+    const char* m_begin;
+    const char* m_end;
+    std::string m_error;
+
+    bool Fail (const char* what)
+    {
+        char buf[96];
+        std::snprintf(buf, sizeof(buf), "%s at %u", what, (unsigned)(m_p - m_begin));
+        m_error = buf;
+        return false;
+    }
+
+    void SkipWs ()
+    {
+        while (m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r')) ++m_p;
+    }
+
+    bool Literal (const char* word)
+    {
+        const size_t n = std::strlen(word);
+        if ((size_t)(m_end - m_p) < n || std::strncmp(m_p, word, n) != 0) return Fail("invalid literal");
+        m_p += n;
+        return true;
+    }
+
+    bool ParseValue (Value& v, int depth)
+    {
+        if (depth > MaxDepth) return Fail("nesting too deep");
+        if (m_p >= m_end) return Fail("unexpected end");
+        switch (*m_p) {
+        case '{': return ParseObject(v, depth);
+        case '[': return ParseArray(v, depth);
+        case '"': v.m_type = Type::String; return ParseString(v.m_str);
+        case 't': v.m_type = Type::Bool; v.m_bool = true;  return Literal("true");
+        case 'f': v.m_type = Type::Bool; v.m_bool = false; return Literal("false");
+        case 'n': v.m_type = Type::Null; return Literal("null");
+        default:  v.m_type = Type::Number; return ParseNumber(v.m_num);
+        }
+    }
+
+    bool ParseObject (Value& v, int depth)
+    {
+        v.m_type = Type::Object;
+        ++m_p; SkipWs();
+        if (m_p < m_end && *m_p == '}') { ++m_p; return true; }
+        for (;;) {
+            SkipWs();
+            if (m_p >= m_end || *m_p != '"') return Fail("expected key");
+            std::string key;
+            if (!ParseString(key)) return false;
+            SkipWs();
+            if (m_p >= m_end || *m_p != ':') return Fail("expected ':'");
+            ++m_p; SkipWs();
+            v.m_members.emplace_back(std::move(key), Value());
+            if (!ParseValue(v.m_members.back().second, depth + 1)) return false;
+            SkipWs();
+            if (m_p < m_end && *m_p == ',') { ++m_p; continue; }
+            if (m_p < m_end && *m_p == '}') { ++m_p; return true; }
+            return Fail("expected ',' or '}'");
+        }
+    }
+
+    bool ParseArray (Value& v, int depth)
+    {
+        v.m_type = Type::Array;
+        ++m_p; SkipWs();
+        if (m_p < m_end && *m_p == ']') { ++m_p; return true; }
+        for (;;) {
+            SkipWs();
+            v.m_items.emplace_back();
+            if (!ParseValue(v.m_items.back(), depth + 1)) return false;
+            SkipWs();
+            if (m_p < m_end && *m_p == ',') { ++m_p; continue; }
+            if (m_p < m_end && *m_p == ']') { ++m_p; return true; }
+            return Fail("expected ',' or ']'");
+        }
+    }
+
+    static void AppendUtf8 (std::string& s, unsigned cp)
+    {
+        if (cp < 0x80) { s += (char)cp; }
+        else if (cp < 0x800) { s += (char)(0xC0 | (cp >> 6)); s += (char)(0x80 | (cp & 0x3F)); }
+        else if (cp < 0x10000) { s += (char)(0xE0 | (cp >> 12)); s += (char)(0x80 | ((cp >> 6) & 0x3F)); s += (char)(0x80 | (cp & 0x3F)); }
+        else { s += (char)(0xF0 | (cp >> 18)); s += (char)(0x80 | ((cp >> 12) & 0x3F)); s += (char)(0x80 | ((cp >> 6) & 0x3F)); s += (char)(0x80 | (cp & 0x3F)); }
+    }
+
+    bool Hex4 (unsigned& cp)
+    {
+        if (m_end - m_p < 4) return Fail("bad \\u escape");
+        cp = 0;
+        for (int i = 0; i < 4; ++i, ++m_p) {
+            const char c = *m_p;
+            cp <<= 4;
+            if (c >= '0' && c <= '9') cp |= (unsigned)(c - '0');
+            else if (c >= 'a' && c <= 'f') cp |= (unsigned)(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F') cp |= (unsigned)(c - 'A' + 10);
+            else return Fail("bad \\u escape");
+        }
+        return true;
+    }
+
+    bool ParseString (std::string& s)
+    {
+        ++m_p; // '"'
+        for (;;) {
+            // участок без экранирования копируем целиком
+            const char* run = m_p;
+            while (m_p < m_end && *m_p != '"' && *m_p != '\\') ++m_p;
+            s.append(run, m_p - run);
+            if (m_p >= m_end) return Fail("unterminated string");
+            if (*m_p == '"') { ++m_p; return true; }
+
+            ++m_p; // '\\'
+            if (m_p >= m_end) return Fail("unterminated string");
+            const char e = *m_p++;
+            switch (e) {
+            case '"':  s += '"';  break;
+            case '\\': s += '\\'; break;
+            case '/':  s += '/';  break;
+            case 'b':  s += '\b'; break;
+            case 'f':  s += '\f'; break;
+            case 'n':  s += '\n'; break;
+            case 'r':  s += '\r'; break;
+            case 't':  s += '\t'; break;
+            case 'u': {
+                unsigned cp = 0;
+                if (!Hex4(cp)) return false;
+                if (cp >= 0xD800 && cp <= 0xDBFF && m_end - m_p >= 6 && m_p[0] == '\\' && m_p[1] == 'u') {
+                    m_p += 2;
+                    unsigned lo = 0;
+                    if (!Hex4(lo)) return false;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                }
+                AppendUtf8(s, cp);
+                break;
+            }
+            default: return Fail("bad escape");
+            }
+        }
+    }
+
+    bool ParseNumber (double& out)
+    {
+        const char* start = m_p;
+        bool neg = false;
+        if (m_p < m_end && *m_p == '-') { neg = true; ++m_p; }
+        if (m_p >= m_end || *m_p < '0' || *m_p > '9') { m_p = start; return Fail("invalid value"); }
+
+        double mant = 0.0;
+        while (m_p < m_end && *m_p >= '0' && *m_p <= '9') mant = mant * 10.0 + (*m_p++ - '0');
+
+        int exp10 = 0;
+        if (m_p < m_end && *m_p == '.') {
+            ++m_p;
+            if (m_p >= m_end || *m_p < '0' || *m_p > '9') return Fail("invalid number");
+            while (m_p < m_end && *m_p >= '0' && *m_p <= '9') { mant = mant * 10.0 + (*m_p++ - '0'); --exp10; }
+        }
+        if (m_p < m_end && (*m_p == 'e' || *m_p == 'E')) {
+            ++m_p;
+            bool eneg = false;
+            if (m_p < m_end && (*m_p == '+' || *m_p == '-')) eneg = (*m_p++ == '-');
+            if (m_p >= m_end || *m_p < '0' || *m_p > '9') return Fail("invalid number");
+            int e = 0;
+            while (m_p < m_end && *m_p >= '0' && *m_p <= '9') { if (e < 10000) e = e * 10 + (*m_p - '0'); ++m_p; }
+            exp10 += eneg ? -e : e;
+        }
+
+        out = (exp10 == 0) ? mant : (exp10 < 0 ? mant / std::pow(10.0, -exp10) : mant * std::pow(10.0, exp10));
+        if (neg) out = -out;
+        return true;
+    }
+};
+
+bool Parse (const std::string& text, Value& out, std::string& error)
+{
+    out = Value();
+    Parser p(text);
+    return p.Run(out, error);
+}
+
+// ---------------- Запись ----------------
+static void WriteString (const std::string& s, std::string& out)
+{
+    out += '"';
+    for (const char ch : s) {
+        const unsigned char c = (unsigned char)ch;
+        switch (c) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n";  break;
+        case '\r': out += "\\r";  break;
+        case '\t': out += "\\t";  break;
+        default:
+            if (c < 0x20) { char buf[8]; std::snprintf(buf, sizeof(buf), "\\u%04x", c); out += buf; }
+            else out += ch;
+        }
+    }
+    out += '"';
+}
+
+void Write (const Value& v, std::string& out)
+{
+    switch (v.Kind()) {
+    case Type::Null:   out += "null"; break;
+    case Type::Bool:   out += v.AsBool() ? "true" : "false"; break;
+    case Type::Number: {
+        const double d = v.AsNumber();
+        if (!std::isfinite(d)) { out += "null"; break; }
+        char buf[32];
+        if (d == std::floor(d) && std::fabs(d) < 1e15) {
+            std::snprintf(buf, sizeof(buf), "%.0f", d);
+        } else {
+            // короткая запись, если она возвращает то же число
+            std::snprintf(buf, sizeof(buf), "%.15g", d);
+            if (std::strtod(buf, nullptr) != d) std::snprintf(buf, sizeof(buf), "%.17g", d);
+        }
+        // на случай локали с запятой
+        for (char* c = buf; *c; ++c) if (*c == ',') *c = '.';
+        out += buf;
+        break;
+    }
+    case Type::String: WriteString(v.AsString(), out); break;
+    case Type::Array: {
+        out += '[';
+        bool first = true;
+        for (const Value& it : v.Items()) { if (!first) out += ','; first = false; Write(it, out); }
+        out += ']';
+        break;
+    }
+    case Type::Object: {
+        out += '{';
+        bool first = true;
+        for (const Value::Member& m : v.Members()) {
+            if (!first) out += ',';
+            first = false;
+            WriteString(m.first, out);
+            out += ':';
+            Write(m.second, out);
+        }
+        out += '}';
+        break;
+    }
+    }
+}
+
+std::string ToString (const Value& v)
+{
+    std::string out;
+    Write(v, out);
+    return out;
+}
+
+} // namespace JsonLite
@@ -0,0 +1,69 @@
+﻿#ifndef JSONLITE_HPP
+#define JSONLITE_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// ============================================================================
+// JsonLite — маленький JSON для моста палитры: разбор за один проход без
+// зависимостей (строки — UTF-8), сборка ответа в std::string.
+// Числа разбираются вручную — не зависят от локали (десятичная точка).
+// ============================================================================
+namespace JsonLite {
+
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    class Value {
+    public:
+        using Member = std::pair<std::string, Value>;
+
+        Value () = default;
+        static Value Bool (bool b)                 { Value v; v.m_type = Type::Bool; v.m_bool = b; return v; }
+        static Value Number (double d)             { Value v; v.m_type = Type::Number; v.m_num = d; return v; }
+        static Value String (const std::string& s) { Value v; v.m_type = Type::String; v.m_str = s; return v; }
+        static Value Array ()                      { Value v; v.m_type = Type::Array; return v; }
+        static Value Object ()                     { Value v; v.m_type = Type::Object; return v; }
+
+        Type Kind () const     { return m_type; }
+        bool IsNull () const   { return m_type == Type::Null; }
+        bool IsBool () const   { return m_type == Type::Bool; }
+        bool IsNumber () const { return m_type == Type::Number; }
+        bool IsString () const { return m_type == Type::String; }
+        bool IsArray () const  { return m_type == Type::Array; }
+        bool IsObject () const { return m_type == Type::Object; }
+
+        bool               AsBool () const   { return m_bool; }
+        double             AsNumber () const { return m_num; }
+        const std::string& AsString () const { return m_str; }
+
+        // Массив
+        const std::vector<Value>& Items () const { return m_items; }
+        Value&                    Push (Value v) { m_items.push_back(std::move(v)); return m_items.back(); }
+
+        // Объект (порядок ключей сохраняется; поиск линейный — объекты команд маленькие)
+        const std::vector<Member>& Members () const { return m_members; }
+        const Value*               Find (const char* key) const;
+        Value&                     Set (const char* key, Value v);
+
+    private:
+        friend class Parser;
+
+        Type                m_type = Type::Null;
+        bool                m_bool = false;
+        double              m_num = 0.0;
+        std::string         m_str;
+        std::vector<Value>  m_items;
+        std::vector<Member> m_members;
+    };
+
+    // Разобрать текст; при ошибке false и сообщение с позицией
+    bool Parse (const std::string& text, Value& out, std::string& error);
+
+    // Записать значение компактно (без пробелов)
+    void        Write (const Value& v, std::string& out);
+    std::string ToString (const Value& v);
+
+}
+
+#endif // JSONLITE_HPP
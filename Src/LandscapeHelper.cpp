@@ -2,12 +2,21 @@
 #include "APIEnvir.h"
 #include "ACAPinc.h"
 #include "LandscapeHelper.hpp"
+#include "UndoScope.hpp"
+#include "Perf.hpp"
 #include "BrowserRepl.hpp"
 #include "APICommon.h"
+#include "RandomizeHelper.hpp"
+#include "JobManager.hpp"
 
 #include <cmath>
 #include <vector>
 #include <algorithm>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
 
 namespace LandscapeHelper {
 
@@ -18,6 +27,8 @@ namespace LandscapeHelper {
 	static API_Guid  g_protoGuid = APINULLGuid;
 	static double    g_stepM = 0.0; // ВНУТРИ: метры (UI → мм → м)
 	static int       g_count = 1;
+	static double    g_clearanceM = 0.0; // 0 = режим зазора выключен
+	static bool      g_randomize = false; // разброс угла/масштаба/Z по настройкам RandomizeHelper
 
 	static inline void LogA(const char* s) {
 		if (BrowserRepl::HasInstance())
@@ -76,24 +87,39 @@ namespace LandscapeHelper {
 				 b0 * P0.y + b1 * C1.y + b2 * C2.y + b3 * P3.y };
 	}
 
-	// ============= Полилиния (coords + parcs + pends(Int32)) =============
-	static void BuildFromPolyMemo(std::vector<Seg>& out, API_ElementMemo& memo)
+	// ============= Исходные данные пути =============
+	// Снимаются с элемента в главном потоке (ACAPI из рабочих потоков не вызываем),
+	// дальше сегменты и станции считаются на чистых данных — параллельно по путям.
+	struct PathSource {
+		API_Guid                   guid = APINULLGuid;
+		API_ElemTypeID             tid = API_ZombieElemID;
+		std::vector<Seg>           direct;  // Line/Arc/Circle — сегменты готовы сразу
+		std::vector<API_Coord>     coords;  // PolyLine: 1-based как в memo; Spline: 0-based
+		std::vector<Int32>         pends;
+		std::vector<API_PolyArc>   parcs;
+		std::vector<API_SplineDir> dirs;
+	};
+
+	template <typename T, typename H>
+	static void CopyHandle(std::vector<T>& out, H h)
 	{
-		if (memo.coords == nullptr) return;
+		out.clear();
+		if (h == nullptr) return;
+		const size_t n = (size_t)(BMGetHandleSize((GSHandle)h) / sizeof(T));
+		out.assign(*h, *h + n);
+	}
 
-		const Int32 nAll = (Int32)(BMGetHandleSize((GSHandle)memo.coords) / sizeof(API_Coord));
+	// ============= Полилиния (coords + parcs + pends(Int32)) =============
+	static void BuildFromPolyData(std::vector<Seg>& out, const PathSource& src)
+	{
+		const Int32 nAll = (Int32)src.coords.size();
 		const Int32 nPts = std::max<Int32>(0, nAll - 1);            // валидные 1..nPts
 		if (nPts < 2) return;
 
 		// «концы» цепочек (многоконтур/разрывы) — Int32
 		std::vector<Int32> ends;
-		if (memo.pends != nullptr) {
-			const Int32 nEnds = (Int32)(BMGetHandleSize((GSHandle)memo.pends) / sizeof(Int32));
-			for (Int32 k = 0; k < nEnds; ++k) {
-				const Int32 ind = (*memo.pends)[k];
-				if (ind >= 1 && ind <= nPts) ends.push_back(ind);
-			}
-		}
+		for (Int32 ind : src.pends)
+			if (ind >= 1 && ind <= nPts) ends.push_back(ind);
 		if (ends.empty()) ends.push_back(nPts); // одна открытая цепочка 1..nPts
 
 		auto isEnd = [&](Int32 i) -> bool {
@@ -102,21 +128,17 @@ namespace LandscapeHelper {
 
 		// карта дуг по begIndex (разрешаем только рёбра 1..nPts-1)
 		std::vector<double> arcByBeg(nPts + 1, 0.0);
-		if (memo.parcs != nullptr) {
-			const Int32 nArcs = (Int32)(BMGetHandleSize((GSHandle)memo.parcs) / sizeof(API_PolyArc));
-			for (Int32 k = 0; k < nArcs; ++k) {
-				const API_PolyArc& pa = (*memo.parcs)[k];
-				if (pa.begIndex >= 1 && pa.begIndex <= nPts - 1)
-					arcByBeg[pa.begIndex] = pa.arcAngle; // со знаком
-			}
+		for (const API_PolyArc& pa : src.parcs) {
+			if (pa.begIndex >= 1 && pa.begIndex <= nPts - 1)
+				arcByBeg[pa.begIndex] = pa.arcAngle; // со знаком
 		}
 
 		for (Int32 i = 1; i <= nPts - 1; ++i) {
 			if (isEnd(i)) continue;               // не соединяем через конец цепочки
 
 			const Int32 j = i + 1;
-			const API_Coord& A = (*memo.coords)[i];
-			const API_Coord& B = (*memo.coords)[j];
+			const API_Coord& A = src.coords[i];
+			const API_Coord& B = src.coords[j];
 
 			const double angArc = arcByBeg[i];
 			if (std::fabs(angArc) < 1e-9) { PushLine(out, A, B); continue; }
@@ -153,18 +175,43 @@ namespace LandscapeHelper {
 		}
 	}
 
-	// ============= Сборка пути по элементу =============
-	static bool BuildPathSegments(const API_Guid& pathGuid, std::vector<Seg>& segs, double* totalLen)
+	// ============= Сплайн: кубические Безье по bezierDirs =============
+	static void BuildFromSplineData(std::vector<Seg>& out, const PathSource& src)
 	{
-		segs.clear();
-		if (totalLen) *totalLen = 0.0;
+		const Int32 n = (Int32)src.coords.size();
+		if (n < 2 || (Int32)src.dirs.size() < n) return;
+		for (Int32 i = 0; i < n - 1; ++i) {
+			const API_Coord P0 = src.coords[i];
+			const API_Coord P3 = src.coords[i + 1];
+			const API_SplineDir d0 = src.dirs[i];
+			const API_SplineDir d1 = src.dirs[i + 1];
+			const API_Coord C1 = Add(P0, FromAngLen(d0.dirAng, d0.lenNext));
+			const API_Coord C2 = Sub(P3, FromAngLen(d1.dirAng, d1.lenPrev));
+
+			const int N = 32; // сабсегментов на ребро
+			API_Coord prev = P0;
+			for (int k = 1; k <= N; ++k) {
+				const double t = (double)k / (double)N;
+				const API_Coord pt = BezierPoint(P0, C1, C2, P3, t);
+				PushLine(out, prev, pt);
+				prev = pt;
+			}
+		}
+	}
+
+	// ============= Чтение пути с элемента (только главный поток) =============
+	static bool ReadPathSource(const API_Guid& pathGuid, PathSource& src)
+	{
+		src = PathSource();
+		src.guid = pathGuid;
 
 		API_Element e = {}; e.header.guid = pathGuid;
-		if (ACAPI_Element_Get(&e) != NoError) return false;
+		if (Perf::ElementGet(&e) != NoError) return false;
+		src.tid = e.header.type.typeID;
 
-		switch (e.header.type.typeID) {
+		switch (src.tid) {
 		case API_LineID:
-			PushLine(segs, e.line.begC, e.line.endC);
+			PushLine(src.direct, e.line.begC, e.line.endC);
 			break;
 
 		case API_ArcID: {
@@ -174,56 +221,57 @@ namespace LandscapeHelper {
 			while (sweep <= -2.0 * PI) sweep += 2.0 * PI;
 			while (sweep > 2.0 * PI) sweep -= 2.0 * PI;
 			s.a0 = a0; s.a1 = a0 + sweep; s.L = s.r * std::fabs(sweep);
-			if (s.L > 1e-9) segs.push_back(s);
+			if (s.L > 1e-9) src.direct.push_back(s);
 			break;
 		}
 
 		case API_CircleID: {
 			Seg s; s.kind = Seg::Arc; s.c = e.circle.origC; s.r = e.circle.r;
 			s.a0 = 0.0; s.a1 = 2.0 * PI; s.L = 2.0 * PI * s.r;
-			segs.push_back(s);
+			src.direct.push_back(s);
 			break;
 		}
 
 		case API_PolyLineID: {
 			API_ElementMemo memo = {};
-			if (ACAPI_Element_GetMemo(pathGuid, &memo) == NoError && memo.coords != nullptr)
-				BuildFromPolyMemo(segs, memo);
+			if (Perf::ElementGetMemo(pathGuid, &memo) == NoError && memo.coords != nullptr) {
+				CopyHandle(src.coords, memo.coords);
+				CopyHandle(src.pends, memo.pends);
+				CopyHandle(src.parcs, memo.parcs);
+			}
 			ACAPI_DisposeElemMemoHdls(&memo);
 			break;
 		}
 
 		case API_SplineID: {
-			// Кубические Безье по bezierDirs (качественно + предсказуемо)
 			API_ElementMemo memo = {};
-			if (ACAPI_Element_GetMemo(pathGuid, &memo, APIMemoMask_Polygon) == NoError &&
+			if (Perf::ElementGetMemo(pathGuid, &memo, APIMemoMask_Polygon) == NoError &&
 				memo.coords != nullptr && memo.bezierDirs != nullptr)
 			{
-				const Int32 n = (Int32)(BMGetHandleSize((GSHandle)memo.coords) / sizeof(API_Coord));
-				if (n >= 2) {
-					for (Int32 i = 0; i < n - 1; ++i) {
-						const API_Coord P0 = (*memo.coords)[i];
-						const API_Coord P3 = (*memo.coords)[i + 1];
-						const API_SplineDir d0 = (*memo.bezierDirs)[i];
-						const API_SplineDir d1 = (*memo.bezierDirs)[i + 1];
-						const API_Coord C1 = Add(P0, FromAngLen(d0.dirAng, d0.lenNext));
-						const API_Coord C2 = Sub(P3, FromAngLen(d1.dirAng, d1.lenPrev));
-
-						const int N = 32; // сабсегментов на ребро
-						API_Coord prev = P0;
-						for (int k = 1; k <= N; ++k) {
-							const double t = (double)k / (double)N;
-							const API_Coord pt = BezierPoint(P0, C1, C2, P3, t);
-							PushLine(segs, prev, pt);
-							prev = pt;
-						}
-					}
-				}
+				CopyHandle(src.coords, memo.coords);
+				CopyHandle(src.dirs, memo.bezierDirs);
 			}
 			ACAPI_DisposeElemMemoHdls(&memo);
 			break;
 		}
 
+		default: return false;
+		}
+		return true;
+	}
+
+	// ============= Сборка сегментов (чистая геометрия, потокобезопасно) =============
+	static bool BuildPathSegments(const PathSource& src, std::vector<Seg>& segs, double* totalLen)
+	{
+		segs.clear();
+		if (totalLen) *totalLen = 0.0;
+
+		switch (src.tid) {
+		case API_LineID:
+		case API_ArcID:
+		case API_CircleID:   segs = src.direct;              break;
+		case API_PolyLineID: BuildFromPolyData(segs, src);   break;
+		case API_SplineID:   BuildFromSplineData(segs, src); break;
 		default: return false;
 		}
 
@@ -231,9 +279,6 @@ namespace LandscapeHelper {
 
 		double sum = 0.0; for (const Seg& s : segs) sum += s.L;
 		if (totalLen) *totalLen = sum;
-
-		GS::UniString dbg; dbg.Printf("[Distrib] path len=%.3f, segs=%u", sum, (unsigned)segs.size());
-		Log(dbg);
 		return sum > 1e-9;
 	}
 
@@ -269,6 +314,216 @@ namespace LandscapeHelper {
 		}
 	}
 
+	// ============= Зазор: пространственный хэш занятых мест =============
+	struct Box2 { double xMin, yMin, xMax, yMax; };
+
+	static inline bool BoxOverlap(const Box2& a, const Box2& b) {
+		return a.xMin < b.xMax && b.xMin < a.xMax && a.yMin < b.yMax && b.yMin < a.yMax;
+	}
+
+	// Равномерная сетка: ячейка -> индексы боксов. Очень большие боксы (плиты, длинные балки)
+	// держим отдельным списком, чтобы не забивать тысячи ячеек.
+	class ClearanceGrid {
+	public:
+		explicit ClearanceGrid(double cell) : m_cell(std::max(cell, 0.05)) {}
+
+		void Insert(const Box2& b)
+		{
+			const UInt32 idx = (UInt32)m_boxes.size();
+			m_boxes.push_back(b);
+			const Int32 ix0 = CellOf(b.xMin), ix1 = CellOf(b.xMax);
+			const Int32 iy0 = CellOf(b.yMin), iy1 = CellOf(b.yMax);
+			if ((double)(ix1 - ix0 + 1) * (double)(iy1 - iy0 + 1) > 1024.0) {
+				m_big.push_back(idx);
+				return;
+			}
+			for (Int32 ix = ix0; ix <= ix1; ++ix)
+				for (Int32 iy = iy0; iy <= iy1; ++iy)
+					m_cells[Key(ix, iy)].push_back(idx);
+		}
+
+		bool Hits(const Box2& q) const
+		{
+			for (UInt32 i : m_big)
+				if (BoxOverlap(m_boxes[i], q)) return true;
+			const Int32 ix0 = CellOf(q.xMin), ix1 = CellOf(q.xMax);
+			const Int32 iy0 = CellOf(q.yMin), iy1 = CellOf(q.yMax);
+			for (Int32 ix = ix0; ix <= ix1; ++ix) {
+				for (Int32 iy = iy0; iy <= iy1; ++iy) {
+					auto it = m_cells.find(Key(ix, iy));
+					if (it == m_cells.end()) continue;
+					for (UInt32 i : it->second)
+						if (BoxOverlap(m_boxes[i], q)) return true;
+				}
+			}
+			return false;
+		}
+
+		size_t Size() const { return m_boxes.size(); }
+
+	private:
+		Int32 CellOf(double v) const { return (Int32)std::floor(v / m_cell); }
+		static inline Int64 Key(Int32 ix, Int32 iy) { return ((Int64)ix << 32) ^ (Int64)(UInt32)iy; }
+
+		double m_cell;
+		std::vector<Box2> m_boxes;
+		std::vector<UInt32> m_big;
+		std::unordered_map<Int64, std::vector<UInt32>> m_cells;
+	};
+
+	static bool GetPlanBox(const API_Elem_Head& head, Box2& out)
+	{
+		API_Box3D b = {};
+		if (ACAPI_Element_CalcBounds(&head, &b) != NoError) return false;
+		out = { b.xMin, b.yMin, b.xMax, b.yMax };
+		return out.xMax >= out.xMin && out.yMax >= out.yMin;
+	}
+
+	// Собираем габариты существующих Object/Lamp/Column/Beam на слое и этаже прототипа
+	static void BuildClearanceGrid(const API_Element& proto, ClearanceGrid& grid)
+	{
+		static const API_ElemTypeID kTypes[] = { API_ObjectID, API_LampID, API_ColumnID, API_BeamID };
+		UInt32 scanned = 0;
+		for (API_ElemTypeID t : kTypes) {
+			GS::Array<API_Guid> guids;
+			if (ACAPI_Element_GetElemList(API_ElemType(t), &guids) != NoError) continue;
+			for (const API_Guid& g : guids) {
+				++scanned;
+				API_Elem_Head h = {}; h.guid = g;
+				if (ACAPI_Element_GetHeader(&h) != NoError) continue;
+				if (h.layer != proto.header.layer || h.floorInd != proto.header.floorInd) continue;
+				Box2 b;
+				if (GetPlanBox(h, b)) grid.Insert(b);
+			}
+		}
+		GS::UniString dbg; dbg.Printf("[Distrib] clearance: scanned=%u, obstacles=%u",
+			(unsigned)scanned, (unsigned)grid.Size());
+		Log(dbg);
+	}
+
+	static inline Box2 BoxAround(const API_Coord& p, double r) {
+		return { p.x - r, p.y - r, p.x + r, p.y + r };
+	}
+
+	// Габарит прототипа относительно его точки вставки и угла: по нему строится бокс
+	// кандидата на станции (балка тянется от begC, объект не обязательно центрирован)
+	struct ProtoFootprint {
+		bool   valid = false;
+		Box2   rel = { 0.0, 0.0, 0.0, 0.0 }; // относительно точки вставки прототипа
+		double ang0 = 0.0;                   // угол прототипа
+		double r = 0.0;                      // полуразмер в плане (шаг сдвига)
+	};
+
+	static ProtoFootprint MakeProtoFootprint(const API_Element& proto)
+	{
+		ProtoFootprint fp;
+		Box2 pb;
+		if (!GetPlanBox(proto.header, pb)) return fp;
+		API_Coord o = { 0.0, 0.0 };
+		switch (proto.header.type.typeID) {
+		case API_ObjectID: o = proto.object.pos;       fp.ang0 = proto.object.angle; break;
+		case API_LampID:   o = proto.lamp.pos;         fp.ang0 = proto.lamp.angle;   break;
+		case API_ColumnID: o = proto.column.origoPos;  fp.ang0 = proto.column.axisRotationAngle; break;
+		case API_BeamID:
+			o = proto.beam.begC;
+			fp.ang0 = std::atan2(proto.beam.endC.y - proto.beam.begC.y, proto.beam.endC.x - proto.beam.begC.x);
+			break;
+		default: return fp;
+		}
+		fp.rel = { pb.xMin - o.x, pb.yMin - o.y, pb.xMax - o.x, pb.yMax - o.y };
+		fp.r = 0.5 * std::max(pb.xMax - pb.xMin, pb.yMax - pb.yMin);
+		fp.valid = true;
+		return fp;
+	}
+
+	// Бокс прототипа, поставленного в P с углом ang (осевой бокс повёрнутого прямоугольника) + зазор
+	static Box2 PlacedBox(const ProtoFootprint& fp, const API_Coord& P, double ang, double extra)
+	{
+		if (!fp.valid) return BoxAround(P, fp.r + extra);
+		const double c = std::cos(ang - fp.ang0), s = std::sin(ang - fp.ang0);
+		const double xs[2] = { fp.rel.xMin, fp.rel.xMax };
+		const double ys[2] = { fp.rel.yMin, fp.rel.yMax };
+		Box2 b = { 1e300, 1e300, -1e300, -1e300 };
+		for (double x : xs) {
+			for (double y : ys) {
+				const double px = P.x + x * c - y * s;
+				const double py = P.y + x * s + y * c;
+				b.xMin = std::min(b.xMin, px); b.xMax = std::max(b.xMax, px);
+				b.yMin = std::min(b.yMin, py); b.yMax = std::max(b.yMax, py);
+			}
+		}
+		return { b.xMin - extra, b.yMin - extra, b.xMax + extra, b.yMax + extra };
+	}
+
+	// ============= Подготовка путей: сегменты + станции (параллельно) =============
+	struct Station {
+		double    s = 0.0;
+		API_Coord P{};
+		double    ang = 0.0;
+	};
+
+	struct PathJob {
+		PathSource           src;
+		std::vector<Seg>     segs;
+		double               totalLen = 0.0;
+		std::vector<Station> stations;
+		bool                 ok = false;
+	};
+
+	static void PreparePathJob(PathJob& job, double useStepM, int useCount)
+	{
+		job.ok = BuildPathSegments(job.src, job.segs, &job.totalLen) && job.totalLen >= 1e-6;
+		if (!job.ok) return;
+
+		// точки размещения
+		std::vector<double> sVals;
+		if (useStepM > 1e-9) {
+			for (double s = 0.0; s <= job.totalLen + 1e-9; s += useStepM)
+				sVals.push_back(std::min(s, job.totalLen));
+		}
+		else {
+			if (useCount == 1) sVals.push_back(0.0);
+			else {
+				const double st = job.totalLen / (double)(useCount - 1);
+				for (int i = 0; i < useCount; ++i)
+					sVals.push_back(std::min(st * i, job.totalLen));
+			}
+		}
+
+		job.stations.resize(sVals.size());
+		for (size_t i = 0; i < sVals.size(); ++i) {
+			Station& st = job.stations[i];
+			st.s = sVals[i];
+			EvalOnPath(job.segs, st.s, &st.P, &st.ang);
+		}
+	}
+
+	// Пул потоков на время вызова: каждый поток берёт следующий путь по атомарному счётчику.
+	// Внутри только чистая геометрия — ни ACAPI, ни логов в палитру.
+	static void PreparePathJobsParallel(std::vector<PathJob>& jobs, double useStepM, int useCount)
+	{
+		const size_t n = jobs.size();
+		const size_t hw = std::max<size_t>(1, (size_t)std::thread::hardware_concurrency());
+		const size_t nThreads = std::min(n, hw);
+		if (nThreads <= 1) {
+			for (PathJob& j : jobs) PreparePathJob(j, useStepM, useCount);
+			return;
+		}
+
+		std::atomic<size_t> next(0);
+		Perf::Sink* sink = Perf::SinkScope::Current();
+		std::vector<std::thread> pool;
+		pool.reserve(nThreads);
+		for (size_t t = 0; t < nThreads; ++t) {
+			pool.emplace_back([&]() {
+				Perf::SinkScope perf(sink);
+				for (size_t i = next.fetch_add(1); i < n; i = next.fetch_add(1))
+					PreparePathJob(jobs[i], useStepM, useCount);
+				});
+		}
+		for (std::thread& th : pool) th.join();
+	}
+
 	// ---------- Утилиты выбора ----------
 	static inline bool IsPathType(API_ElemTypeID tid) {
 		switch (tid) {
@@ -342,16 +597,22 @@ namespace LandscapeHelper {
 	// ---------- Публичные API ----------
 	bool SetDistributionLine()
 	{
-		g_pathGuids.clear();
-
 		API_SelectionInfo si = {}; GS::Array<API_Neig> neigs;
 		ACAPI_Selection_Get(&si, &neigs, false, false);
 		BMKillHandle((GSHandle*)&si.marquee.coords);
 
-		for (const API_Neig& n : neigs) {
-			API_Element el = {}; el.header.guid = n.guid;
+		GS::Array<API_Guid> guids;
+		for (const API_Neig& n : neigs) guids.Push(n.guid);
+		return SetDistributionPaths(guids);
+	}
+
+	bool SetDistributionPaths(const GS::Array<API_Guid>& guids)
+	{
+		g_pathGuids.clear();
+		for (const API_Guid& g : guids) {
+			API_Element el = {}; el.header.guid = g;
 			if (ACAPI_Element_GetHeader(&el.header) != NoError) continue;
-			if (IsPathType(el.header.type.typeID)) g_pathGuids.push_back(n.guid);
+			if (IsPathType(el.header.type.typeID)) g_pathGuids.push_back(g);
 		}
 
 		if (!g_pathGuids.empty()) {
@@ -395,6 +656,21 @@ namespace LandscapeHelper {
 		return false;
 	}
 
+	bool SetDistributionProto(const API_Guid& guid)
+	{
+		API_Elem_Head head = {}; head.guid = guid;
+		if (ACAPI_Element_GetHeader(&head) != NoError) { LogA("[Distrib] ERR no-proto"); return false; }
+		const API_ElemTypeID tid = head.type.typeID;
+		if (tid != API_ObjectID && tid != API_LampID && tid != API_ColumnID && tid != API_BeamID) {
+			LogA("[Distrib] ERR proto-type");
+			return false;
+		}
+		g_protoGuid = guid;
+		GS::UniString protoDbg; protoDbg.Printf("[Distrib] PROTO SET: %s (type=%d)", APIGuidToString(guid).ToCStr().Get(), (int)tid);
+		Log(protoDbg);
+		return true;
+	}
+
 	bool SetDistributionStep(double stepMM)
 	{
 		if (stepMM > 0.0) {
@@ -413,68 +689,128 @@ namespace LandscapeHelper {
 		}
 		return false;
 	}
+	bool SetDistributionClearance(double clearanceMM)
+	{
+		if (clearanceMM < 0.0) return false;
+		g_clearanceM = UiStepToMeters(clearanceMM);
+		GS::UniString m; m.Printf("[Distrib] clearance(mm)=%.3f%s", clearanceMM, g_clearanceM > 0.0 ? "" : " (off)"); Log(m);
+		return true;
+	}
+	bool SetDistributionRandomize(bool on)
+	{
+		g_randomize = on;
+		GS::UniString m; m.Printf("[Distrib] randomize=%s", on ? "on" : "off"); Log(m);
+		return true;
+	}
 
-	static bool DistributeOnSinglePath(const API_Element& proto, API_ElemTypeID tid,
-		const std::vector<Seg>& segs, double totalLen,
-		const double useStepM, const int useCount,
-		API_ElementMemo* protoMemo, UInt32* outCreated)
+	// Memo прототипа — только то, что нужно для Create данного типа (без полного APIMemoMask_All):
+	// для GDL-объектов это addPars, для колонн/балок — сегменты и схемы сборки.
+	static GSErrCode LoadProtoMemo(const API_Guid& guid, API_ElemTypeID tid, API_ElementMemo& memo)
 	{
-		// точки размещения
-		std::vector<double> sVals;
-		if (useStepM > 1e-9) {
-			for (double s = 0.0; s <= totalLen + 1e-9; s += useStepM)
-				sVals.push_back(std::min(s, totalLen));
+		UInt64 mask = 0;
+		switch (tid) {
+		case API_ObjectID:
+		case API_LampID:   mask = APIMemoMask_AddPars; break;
+		case API_ColumnID: mask = APIMemoMask_ColumnSegment | APIMemoMask_AssemblySegmentScheme | APIMemoMask_AssemblySegmentCut; break;
+		case API_BeamID:   mask = APIMemoMask_BeamSegment | APIMemoMask_AssemblySegmentScheme | APIMemoMask_AssemblySegmentCut | APIMemoMask_BeamHole; break;
+		default:           return APIERR_BADPARS;
 		}
-		else {
-			if (useCount == 1) sVals.push_back(0.0);
-			else {
-				const double st = totalLen / (double)(useCount - 1);
-				for (int i = 0; i < useCount; ++i)
-					sVals.push_back(std::min(st * i, totalLen));
-			}
+		GSErrCode err = Perf::ElementGetMemo(guid, &memo, mask);
+		if (err != NoError) {
+			ACAPI_DisposeElemMemoHdls(&memo);
+			memo = {};
+			err = Perf::ElementGetMemo(guid, &memo); // запасной путь — полный memo
 		}
+		return err;
+	}
 
-		UInt32 created = 0;
-		for (double s : sVals) {
-			API_Coord P; double ang = 0.0;
-			EvalOnPath(segs, s, &P, &ang);
+	// work — рабочая копия прототипа, общая для всех путей: копируем API_Element один раз,
+	// на каждую станцию правим только позицию/угол и сбрасываем GUID
+	static bool DistributeOnSinglePath(const API_Element& proto, API_Element& work, API_ElemTypeID tid,
+		const PathJob& job, API_ElementMemo* protoMemo, UInt32* outCreated,
+		ClearanceGrid* grid = nullptr, const ProtoFootprint* fp = nullptr)
+	{
+		const std::vector<Seg>& segs = job.segs;
+		const double totalLen = job.totalLen;
+
+		// при зазоре точку можно сдвинуть вдоль пути не дальше половины шага (порядок сохраняется)
+		const size_t nSt = job.stations.size();
+		const double spacing = (nSt > 1) ? (totalLen / (double)(nSt - 1)) : totalLen;
+		const ProtoFootprint noFp;
+		const ProtoFootprint& foot = (fp != nullptr) ? *fp : noFp;
+		const double shiftStep = std::max(0.25 * (foot.r + g_clearanceM), 0.05);
+		const int    maxShift = (int)std::floor(0.5 * spacing / shiftStep);
+
+		const double beamLen = (tid == API_BeamID)
+			? std::hypot(proto.beam.endC.x - proto.beam.begC.x, proto.beam.endC.y - proto.beam.begC.y)
+			: 0.0;
+
+		UInt32 created = 0, skipped = 0, shifted = 0;
+		for (UInt32 si = 0; si < (UInt32)job.stations.size(); ++si) {
+			const Station& st = job.stations[si];
+			API_Coord P = st.P; double ang = st.ang;
+
+			if (grid != nullptr && grid->Hits(PlacedBox(foot, P, ang, g_clearanceM))) {
+				bool found = false;
+				for (int k = 1; k <= maxShift && !found; ++k) {
+					for (int sign = -1; sign <= 1; sign += 2) {
+						const double s2 = st.s + sign * k * shiftStep;
+						if (s2 < 0.0 || s2 > totalLen) continue;
+						API_Coord P2; double ang2 = 0.0;
+						EvalOnPath(segs, s2, &P2, &ang2);
+						if (!grid->Hits(PlacedBox(foot, P2, ang2, g_clearanceM))) { P = P2; ang = ang2; found = true; break; }
+					}
+				}
+				if (!found) { ++skipped; continue; }
+				++shifted;
+			}
 
-			API_Element e = proto; 
+			API_Element& e = work;
+			e.header = proto.header;
 			e.header.guid = APINULLGuid;  // Важно: сбрасываем GUID для создания нового элемента
 
+			// work общий для всех станций и путей: поля, которые меняет разброс, каждый раз
+			// возвращаем к прототипу, чтобы выборка предыдущей станции не накапливалась
 			if (tid == API_ObjectID) { 
 				e.object.pos = P;  
 				e.object.angle = ang; 
+				e.object.xRatio = proto.object.xRatio;
+				e.object.yRatio = proto.object.yRatio;
+				e.object.level = proto.object.level;
 			}
 			else if (tid == API_LampID) { 
 				e.lamp.pos = P;  
 				e.lamp.angle = ang; 
+				e.lamp.xRatio = proto.lamp.xRatio;
+				e.lamp.yRatio = proto.lamp.yRatio;
+				e.lamp.level = proto.lamp.level;
 			}
 			else if (tid == API_BeamID) {
-				// Балка: вычисляем конечную точку на основе длины из прототипа и угла
-				const double beamLen = std::hypot(
-					proto.beam.endC.x - proto.beam.begC.x,
-					proto.beam.endC.y - proto.beam.begC.y);
+				// Балка: конечная точка по длине прототипа и углу
 				e.beam.begC = P;
 				e.beam.endC.x = P.x + beamLen * std::cos(ang);
 				e.beam.endC.y = P.y + beamLen * std::sin(ang);
+				e.beam.level = proto.beam.level;
 			}
 			else if (tid == API_ColumnID) { 
-				// Колонна: устанавливаем позицию и угол поворота
-				// Важно: сохраняем все параметры из прототипа (bottomOffset, topOffset, floorInd и т.д.)
+				// Колонна: позиция и угол; остальное (bottomOffset, topOffset, floorInd) — из прототипа
 				e.column.origoPos = P; 
 				e.column.axisRotationAngle = ang;
-				// Явно сохраняем этаж из прототипа (должен скопироваться, но для надежности)
-				// e.header.floorInd уже скопирован из proto через e = proto
 			}
 
-			const GSErrCode ce = ACAPI_Element_Create(&e, protoMemo);
+			// разброс: ключ = (GUID пути, номер станции) — повторная раскладка с тем же seed совпадает
+			if (g_randomize)
+				(void)RandomizeHelper::ApplySample(e, proto,
+					RandomizeHelper::SampleFor(RandomizeHelper::KeyFromGuidIndex(job.src.guid, si)), nullptr);
+
+			const GSErrCode ce = Perf::ElementCreate(&e, protoMemo);
 			if (ce == NoError) {
 				++created;
-				if (tid == API_ColumnID) {
-					GS::UniString colDbg; colDbg.Printf("[Distrib] Column created at (%.3f, %.3f), floor=%d, ang=%.3fdeg", 
-						P.x, P.y, (int)e.header.floorInd, ang * 180.0 / PI);
-					Log(colDbg);
+				// в сетку — фактический габарит созданного элемента (с учётом разброса),
+				// чтобы следующие станции этого и остальных путей обходили его
+				if (grid != nullptr) {
+					Box2 cb;
+					grid->Insert(GetPlanBox(e.header, cb) ? cb : PlacedBox(foot, P, ang, 0.0));
 				}
 			}
 			else {
@@ -486,37 +822,51 @@ namespace LandscapeHelper {
 		}
 
 		if (outCreated) *outCreated += created;
-		GS::UniString dbg; dbg.Printf("[Distrib] path created=%u", (unsigned)created); Log(dbg);
+		GS::UniString dbg;
+		if (grid != nullptr) dbg.Printf("[Distrib] path created=%u, shifted=%u, skipped=%u", (unsigned)created, (unsigned)shifted, (unsigned)skipped);
+		else                 dbg.Printf("[Distrib] path created=%u", (unsigned)created);
+		Log(dbg);
 		return created > 0;
 	}
 
-	bool DistributeSelected(double stepMM, int count)
+	// ---------- Раскладка: подготовка / расчёт / запись ----------
+	// Три фазы общие для синхронного вызова и задачи JobManager
+	struct DistributionRun {
+		API_Element          proto = {};
+		API_ElemTypeID       tid = API_ZombieElemID;
+		double               useStepM = 0.0;
+		int                  useCount = 0;
+		std::vector<PathJob> jobs;
+	};
+
+	// Главный поток: режим, автоподхваты, прототип, чтение путей
+	static bool PrepareDistribution(double stepMM, int count, DistributionRun& run)
 	{
 		// режим
-		double useStepM = 0.0;
-		int    useCount = 0;
-		if (stepMM > 1e-9) { g_stepM = UiStepToMeters(stepMM); useStepM = g_stepM; useCount = 0; }
-		else if (count >= 1) { g_count = count; useStepM = 0.0; useCount = count; }
-		else { useStepM = g_stepM; useCount = g_count; }
+		if (stepMM > 1e-9) { g_stepM = UiStepToMeters(stepMM); run.useStepM = g_stepM; run.useCount = 0; }
+		else if (count >= 1) { g_count = count; run.useStepM = 0.0; run.useCount = count; }
+		else { run.useStepM = g_stepM; run.useCount = g_count; }
 
 		{
 			GS::UniString dbg; dbg.Printf("[Distrib] use: %s, step(m)=%.6f, count=%d",
-				useStepM > 0.0 ? "STEP" : "COUNT", useStepM, useCount); Log(dbg);
+				run.useStepM > 0.0 ? "STEP" : "COUNT", run.useStepM, run.useCount); Log(dbg);
 		}
 
 		// автоподхваты
 		if (!AutoGrabPathsIfNeeded()) { LogA("[Distrib] ERR no-paths");  return false; }
 		if (!AutoGrabProtoIfNeeded()) { LogA("[Distrib] ERR no-proto");  return false; }
-		if (useStepM <= 0.0 && useCount < 1) { LogA("[Distrib] ERR invalid-params"); return false; }
+		if (run.useStepM <= 0.0 && run.useCount < 1) { LogA("[Distrib] ERR invalid-params"); return false; }
 
 		// прототип
-		API_Element proto = {}; proto.header.guid = g_protoGuid;
-		if (ACAPI_Element_Get(&proto) != NoError) { 
+		API_Element& proto = run.proto;
+		proto.header.guid = g_protoGuid;
+		if (Perf::ElementGet(&proto) != NoError) { 
 			GS::UniString errMsg; errMsg.Printf("[Distrib] ERR proto-get, guid=%s", APIGuidToString(g_protoGuid).ToCStr().Get());
 			Log(errMsg);
 			return false; 
 		}
 		const API_ElemTypeID tid = proto.header.type.typeID;
+		run.tid = tid;
 		GS::UniString protoDbg; protoDbg.Printf("[Distrib] Proto: type=%d, floor=%d, guid=%s", 
 			(int)tid, (int)proto.header.floorInd, APIGuidToString(g_protoGuid).ToCStr().Get());
 		Log(protoDbg);
@@ -530,37 +880,74 @@ namespace LandscapeHelper {
 			return false; 
 		}
 
+		// Пути: чтение с элементов в главном потоке, сегменты и станции — параллельно (PreparePathJobsParallel)
+		run.jobs.resize(g_pathGuids.size());
+		for (size_t i = 0; i < run.jobs.size(); ++i) {
+			if (!ReadPathSource(g_pathGuids[i], run.jobs[i].src)) {
+				GS::UniString rd; rd.Printf("[Distrib] path read failed, guid=%s", APIGuidToString(g_pathGuids[i]).ToCStr().Get());
+				Log(rd);
+			}
+		}
+		return true;
+	}
+
+	// Главный поток: создание элементов одной командой Undo
+	static bool CommitDistribution(DistributionRun& run)
+	{
+		const API_Element& proto = run.proto;
+		const API_ElemTypeID tid = run.tid;
+		std::vector<PathJob>& jobs = run.jobs;
+
 		// Undo + общий мемо
-		GSErrCode err = ACAPI_CallUndoableCommand("Distribute Along Multiple Paths", [&]() -> GSErrCode {
+		GSErrCode err = UndoScope::Call("Distribute Along Multiple Paths", [&]() -> GSErrCode {
 			API_ElementMemo memo = {}; bool hasMemo = false;
-			// Загружаем memo для всех типов, которые могут его требовать
-			if (tid == API_ObjectID || tid == API_LampID || tid == API_BeamID || tid == API_ColumnID) {
-				GSErrCode memoErr = ACAPI_Element_GetMemo(proto.header.guid, &memo);
-				if (memoErr == NoError) {
-					hasMemo = true;
-					GS::UniString memoDbg; memoDbg.Printf("[Distrib] Memo loaded OK for type=%d", (int)tid);
-					Log(memoDbg);
-				} else {
-					GS::UniString memoDbg; memoDbg.Printf("[Distrib] Memo load failed err=%d for type=%d (continuing without memo)", (int)memoErr, (int)tid);
-					Log(memoDbg);
-				}
+			// memo прототипа читаем один раз (минимальная маска) и отдаём во все Create
+			GSErrCode memoErr = LoadProtoMemo(proto.header.guid, tid, memo);
+			if (memoErr == NoError) {
+				hasMemo = true;
+				GS::UniString memoDbg; memoDbg.Printf("[Distrib] Memo loaded OK for type=%d", (int)tid);
+				Log(memoDbg);
+			} else {
+				GS::UniString memoDbg; memoDbg.Printf("[Distrib] Memo load failed err=%d for type=%d (continuing without memo)", (int)memoErr, (int)tid);
+				Log(memoDbg);
 			}
 
 			UInt32 totalCreated = 0;
 
-			for (const API_Guid& pg : g_pathGuids) {
-				std::vector<Seg> segs; double totalLen = 0.0;
-				if (!BuildPathSegments(pg, segs, &totalLen) || totalLen < 1e-6) {
-					LogA("[Distrib] skip: empty/invalid path");
+			// режим зазора: сетка занятых мест (общая для всех путей) + габарит прототипа
+			ClearanceGrid grid(1.0);
+			ClearanceGrid* gridPtr = nullptr;
+			ProtoFootprint fp;
+			if (g_clearanceM > 0.0) {
+				fp = MakeProtoFootprint(proto);
+				grid = ClearanceGrid(std::max(2.0 * (fp.r + g_clearanceM), 0.5));
+				BuildClearanceGrid(proto, grid);
+				gridPtr = &grid;
+			}
+
+			// единая фаза создания: пути по порядку, прогресс по каждому
+			API_Element work = proto;
+			const auto t0 = std::chrono::steady_clock::now();
+			const size_t nJobs = jobs.size();
+			for (size_t i = 0; i < nJobs; ++i) {
+				const PathJob& job = jobs[i];
+				if (!job.ok) {
+					GS::UniString skip; skip.Printf("[Distrib] path %u/%u skip: empty/invalid path", (unsigned)(i + 1), (unsigned)nJobs);
+					Log(skip);
 					continue;
 				}
-				(void)DistributeOnSinglePath(proto, tid, segs, totalLen, useStepM, useCount,
-					hasMemo ? &memo : nullptr, &totalCreated);
+				GS::UniString prog; prog.Printf("[Distrib] path %u/%u: len=%.3f, segs=%u, stations=%u",
+					(unsigned)(i + 1), (unsigned)nJobs, job.totalLen, (unsigned)job.segs.size(), (unsigned)job.stations.size());
+				Log(prog);
+				(void)DistributeOnSinglePath(proto, work, tid, job,
+					hasMemo ? &memo : nullptr, &totalCreated, gridPtr, &fp);
 			}
 
 			if (hasMemo) ACAPI_DisposeElemMemoHdls(&memo);
 
-			GS::UniString fin; fin.Printf("[Distrib] DONE, total created=%u", (unsigned)totalCreated);
+			const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+			GS::UniString fin; fin.Printf("[Distrib] DONE, total created=%u in %.3f s (%.1f placements/s)",
+				(unsigned)totalCreated, sec, sec > 1e-9 ? totalCreated / sec : 0.0);
 			Log(fin);
 			return NoError;
 			});
@@ -568,4 +955,32 @@ namespace LandscapeHelper {
 		return err == NoError;
 	}
 
+	bool DistributeSelected(double stepMM, int count)
+	{
+		DistributionRun run;
+		if (!PrepareDistribution(stepMM, count, run)) return false;
+		PreparePathJobsParallel(run.jobs, run.useStepM, run.useCount);
+		return CommitDistribution(run);
+	}
+
+	UInt32 SubmitDistribution(double stepMM, int count)
+	{
+		// подготовка сразу (нужны выделение и прототип на момент вызова), расчёт и запись — задачей
+		auto run = std::make_shared<DistributionRun>();
+		if (!PrepareDistribution(stepMM, count, *run)) return 0;
+
+		auto computed = std::make_shared<bool>(false);
+		return JobManager::Submit("Distribute Along Multiple Paths",
+			[run, computed](JobManager::Context& ctx) -> JobManager::Step {
+				if (!*computed) {
+					*computed = true;
+					ctx.Report(0, (UInt32)run->jobs.size(), "compute");
+					ctx.RunAsync([run]() { PreparePathJobsParallel(run->jobs, run->useStepM, run->useCount); });
+					return JobManager::Step::Continue;
+				}
+				ctx.Report((UInt32)run->jobs.size(), (UInt32)run->jobs.size(), "commit");
+				return CommitDistribution(*run) ? JobManager::Step::Done : JobManager::Step::Failed;
+			});
+	}
+
 } // namespace LandscapeHelper
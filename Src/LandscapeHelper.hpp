@@ -13,15 +13,30 @@ namespace LandscapeHelper {
 	// Выбрать "прототип" (Object/Lamp/Column) из выделения
 	bool SetDistributionObject();
 
+	// То же по готовому списку GUID (скрипты REPL, макросы)
+	bool SetDistributionPaths(const GS::Array<API_Guid>& guids);
+	bool SetDistributionProto(const API_Guid& guid);
+
 	// Задать шаг (плановые единицы проекта; >0 активирует режим шага)
 	bool SetDistributionStep(double step);
 
 	// Задать количество (>=1 активирует режим количества; перекрывает шаг)
 	bool SetDistributionCount(int count);
 
+	// Задать зазор до существующих элементов (мм; 0 выключает). Точки, попавшие на занятые места
+	// на слое прототипа, сдвигаются вдоль пути или пропускаются
+	bool SetDistributionClearance(double clearanceMM);
+
+	// Включить разброс угла/масштаба/Z для новых элементов (настройки и seed — RandomizeHelper)
+	bool SetDistributionRandomize(bool on);
+
 	// Выполнить раскладку (если step/count переданы - перекрывают сохранённые)
 	bool DistributeSelected(double step, int count);
 
+	// То же задачей JobManager: пути и прототип читаются сразу, станции считаются в рабочем потоке,
+	// создание — в idle одной командой Undo. Возвращает ID задачи (0 — ошибка подготовки)
+	UInt32 SubmitDistribution(double step, int count);
+
 } // namespace LandscapeHelper
 
 #endif // LANDSCAPEHELPER_HPP
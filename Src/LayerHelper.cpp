@@ -1,8 +1,98 @@
 #include "LayerHelper.hpp"
+#include "UndoScope.hpp"
+#include "Perf.hpp"
+#include "SelectionHelper.hpp"
 #include "APICommon.h"
 
+#include <string>
+#include <unordered_map>
+
 namespace LayerHelper {
 
+// ---------------- Кэш: имя слоя -> индекс, путь папки -> GUID ----------------
+// Строится лениво при первом поиске. Наши создания дописываются сразу; чужие изменения
+// ловятся по количеству слоёв, по проверке имени найденного слоя и через InvalidateCache()
+// (смена проекта / приём изменений Teamwork в BrowserRepl).
+static std::unordered_map<std::string, API_AttributeIndex> g_layerByName;
+static std::unordered_map<std::string, GS::Guid>           g_folderByPath;
+static GS::UInt32                                          g_cachedLayerCount = 0;
+static bool                                                g_layerMapBuilt = false;
+
+static std::string CacheKey(const GS::UniString& s)
+{
+    return std::string(s.ToCStr(0, MaxUSize, CC_UTF8).Get());
+}
+
+void InvalidateCache()
+{
+    g_layerByName.clear();
+    g_folderByPath.clear();
+    g_cachedLayerCount = 0;
+    g_layerMapBuilt = false;
+}
+
+static GS::UInt32 GetLayerCount()
+{
+    GS::UInt32 layerCount = 0;
+    if (ACAPI_Attribute_GetNum(API_LayerID, layerCount) != NoError)
+        return 0;
+    return layerCount;
+}
+
+static void EnsureLayerMap()
+{
+    const GS::UInt32 layerCount = GetLayerCount();
+    if (g_layerMapBuilt && layerCount == g_cachedLayerCount)
+        return;
+
+    g_layerByName.clear();
+    g_layerByName.reserve(layerCount);
+    for (Int32 i = 1; i <= static_cast<Int32>(layerCount); ++i) {
+        API_Attribute attr = {};
+        attr.header.typeID = API_LayerID;
+        attr.header.index = ACAPI_CreateAttributeIndex(i);
+        if (ACAPI_Attribute_Get(&attr) != NoError)
+            continue;
+        g_layerByName.emplace(CacheKey(GS::UniString(attr.header.name)), attr.header.index); // первый при дубликатах, как раньше
+    }
+
+    g_cachedLayerCount = layerCount;
+    g_layerMapBuilt = true;
+    ACAPI_WriteReport("[LayerHelper] Кэш слоёв построен: %d", false, (int)g_layerByName.size());
+}
+
+// Полная перечитка карты слоёв (папки не трогаем)
+static void RebuildLayerMap()
+{
+    g_layerMapBuilt = false;
+    EnsureLayerMap();
+}
+
+static void RememberLayer(const GS::UniString& layerName, API_AttributeIndex layerIndex)
+{
+    if (!g_layerMapBuilt) return;
+    g_layerByName[CacheKey(layerName)] = layerIndex;
+    g_cachedLayerCount = GetLayerCount();
+}
+
+static bool LayerHasName(API_AttributeIndex layerIndex, const GS::UniString& layerName)
+{
+    API_Attribute attr = {};
+    attr.header.typeID = API_LayerID;
+    attr.header.index = layerIndex;
+    return ACAPI_Attribute_Get(&attr) == NoError && GS::UniString(attr.header.name) == layerName;
+}
+
+static GS::UniString JoinFolderPath(const GS::Array<GS::UniString>& parts)
+{
+    GS::UniString joined;
+    for (UIndex i = 0; i < parts.GetSize(); ++i) {
+        if (i > 0) joined += "/";
+        joined += parts[i];
+    }
+    return joined;
+}
+
 // ---------------- Разбить путь к папке на массив ----------------
 GS::Array<GS::UniString> ParseFolderPath(const GS::UniString& folderPath)
 {
@@ -52,10 +142,23 @@ bool CreateLayerFolder(const GS::UniString& folderPath, GS::Guid& folderGuid)
         return true;
     }
 
-    // Создаем папки пошагово
+    // Самый длинный уже известный префикс — дальше идём только по недостающим частям
     GS::Array<GS::UniString> currentPath;
-    
-    for (UIndex i = 0; i < pathParts.GetSize(); ++i) {
+    UIndex firstMissing = 0;
+    for (UIndex i = pathParts.GetSize(); i > 0; --i) {
+        GS::Array<GS::UniString> prefix;
+        for (UIndex j = 0; j < i; ++j) prefix.Push(pathParts[j]);
+        auto it = g_folderByPath.find(CacheKey(JoinFolderPath(prefix)));
+        if (it != g_folderByPath.end()) {
+            folderGuid = it->second;
+            currentPath = prefix;
+            firstMissing = i;
+            break;
+        }
+    }
+
+    // Создаем папки пошагово
+    for (UIndex i = firstMissing; i < pathParts.GetSize(); ++i) {
         currentPath.Push(pathParts[i]);
         
         // Проверяем, существует ли папка
@@ -73,53 +176,46 @@ bool CreateLayerFolder(const GS::UniString& folderPath, GS::Guid& folderGuid)
             err = ACAPI_Attribute_CreateFolder(folder);
             if (err != NoError) {
                 ACAPI_WriteReport("[LayerHelper] Ошибка создания папки '%s' (код: %d)", true, 
-                    GS::UniString::Printf("%s", currentPath[0].ToCStr().Get()).ToCStr().Get(), err);
+                    JoinFolderPath(currentPath).ToCStr().Get(), err);
                 return false;
             }
-            ACAPI_WriteReport("[LayerHelper] Создана папка: %s", false, 
-                GS::UniString::Printf("%s", currentPath[0].ToCStr().Get()).ToCStr().Get());
+            ACAPI_WriteReport("[LayerHelper] Создана папка: %s", false, JoinFolderPath(currentPath).ToCStr().Get());
             
             // Используем GUID созданной папки
             folderGuid = folder.guid;
-            ACAPI_WriteReport("[LayerHelper] GUID созданной папки получен", false);
-            ACAPI_WriteReport("[LayerHelper] Папка создана успешно, GUID не пустой: %s", false, 
-                (folderGuid != GS::Guid()) ? "да" : "нет");
         } else {
             // Папка существует, используем её GUID
             folderGuid = existingFolder.guid;
-            ACAPI_WriteReport("[LayerHelper] Папка уже существует: %s", false, 
-                GS::UniString::Printf("%s", currentPath[0].ToCStr().Get()).ToCStr().Get());
         }
+        g_folderByPath[CacheKey(JoinFolderPath(currentPath))] = folderGuid;
     }
 
     return true;
 }
 
 // ---------------- Найти слой по имени, вернуть его индекс (0 если не найден) ----------------
-static API_AttributeIndex FindLayerByName(const GS::UniString& layerName)
+// refreshOnMiss: при промахе перечитать карту и искать ещё раз — слой могли переименовать
+// в искомое имя без изменения количества слоёв. По умолчанию нет: новое имя всегда промах,
+// а отставший кэш CreateLayer ловит по APIERR_NAMEALREADYUSED. Пакет перечитывает карту один раз в начале.
+static API_AttributeIndex FindLayerByName(const GS::UniString& layerName, bool refreshOnMiss = false)
 {
-    API_AttributeIndex foundIndex = APIInvalidAttributeIndex;
-
-    // Получаем количество слоев
-    GS::UInt32 layerCount = 0;
-    if (ACAPI_Attribute_GetNum(API_LayerID, layerCount) != NoError || layerCount == 0)
-        return foundIndex;
-
-    // Перебираем все слои и ищем совпадение по имени
-    for (Int32 i = 1; i <= static_cast<Int32>(layerCount); ++i) {
-        API_Attribute attr = {};
-        attr.header.typeID = API_LayerID;
-        attr.header.index = ACAPI_CreateAttributeIndex(i);
-        if (ACAPI_Attribute_Get(&attr) != NoError)
-            continue;
-
-        if (GS::UniString(attr.header.name) == layerName) {
-            foundIndex = ACAPI_CreateAttributeIndex(i);
-            break;
-        }
+    EnsureLayerMap();
+
+    auto it = g_layerByName.find(CacheKey(layerName));
+    if (it == g_layerByName.end()) {
+        if (!refreshOnMiss) return APIInvalidAttributeIndex;
+        RebuildLayerMap();
+        it = g_layerByName.find(CacheKey(layerName));
+        return (it != g_layerByName.end()) ? it->second : APIInvalidAttributeIndex;
     }
 
-    return foundIndex;
+    // Слой могли переименовать/удалить без изменения количества — одна проверка вместо полного перебора
+    if (LayerHasName(it->second, layerName))
+        return it->second;
+
+    RebuildLayerMap();
+    it = g_layerByName.find(CacheKey(layerName));
+    return (it != g_layerByName.end()) ? it->second : APIInvalidAttributeIndex;
 }
 
 // ---------------- Создать слой в указанной папке ---------------- 
@@ -129,7 +225,7 @@ bool CreateLayer(const GS::UniString& folderPath, const GS::UniString& layerName
     // не создаём новый слой, а только переносим существующий в указанную папку
     if (!layerName.IsEmpty() && (layerName == folderPath)) {
         ACAPI_WriteReport("[LayerHelper] Имя слоя совпадает с именем папки: '%s' — пропускаем создание", false, layerName.ToCStr().Get());
-        API_AttributeIndex existingIdx = FindLayerByName(layerName);
+        API_AttributeIndex existingIdx = FindLayerByName(layerName, false);
         if (existingIdx.IsPositive()) {
             layerIndex = existingIdx;
             if (!folderPath.IsEmpty()) {
@@ -142,7 +238,7 @@ bool CreateLayer(const GS::UniString& folderPath, const GS::UniString& layerName
     } else {
         // Даже если имена не совпадают, стоит проверить существование слоя с таким именем,
         // чтобы избежать ошибки создания дубликата
-        API_AttributeIndex existingIdx = FindLayerByName(layerName);
+        API_AttributeIndex existingIdx = FindLayerByName(layerName, false);
         if (existingIdx.IsPositive()) {
             ACAPI_WriteReport("[LayerHelper] Слой '%s' уже существует — используем его и переносим при необходимости", false, layerName.ToCStr().Get());
             layerIndex = existingIdx;
@@ -172,12 +268,24 @@ bool CreateLayer(const GS::UniString& folderPath, const GS::UniString& layerName
 
     // Создаем слой
     GSErrCode err = ACAPI_Attribute_Create(&layer, nullptr);
+    if (err == APIERR_NAMEALREADYUSED) {
+        // кэш отстал от проекта: перечитываем и берём существующий слой
+        RebuildLayerMap();
+        const API_AttributeIndex existingIdx = FindLayerByName(layerName, false);
+        if (existingIdx.IsPositive()) {
+            layerIndex = existingIdx;
+            if (!folderPath.IsEmpty()) MoveLayerToFolder(layerIndex, folderPath);
+            return true;
+        }
+    }
     if (err != NoError) {
         ACAPI_WriteReport("[LayerHelper] Ошибка создания слоя: %s", true, layerName.ToCStr().Get());
         return false;
     }
 
     layerIndex = layer.header.index;
+    RememberLayer(layerName, layerIndex);
+    SelectionHelper::InvalidateCaches();
     
     // Перемещаем слой в папку, если папка указана
     if (!folderPath.IsEmpty()) {
@@ -200,21 +308,29 @@ bool MoveSelectedElementsToLayer(API_AttributeIndex layerIndex)
     ACAPI_Selection_Get(&selectionInfo, &selNeigs, false, false);
     BMKillHandle((GSHandle*)&selectionInfo.marquee.coords);
 
-    if (selNeigs.IsEmpty()) {
+    GS::Array<API_Guid> guids;
+    for (const API_Neig& neig : selNeigs) guids.Push(neig.guid);
+    return MoveElementsToLayer(guids, layerIndex);
+}
+
+// ---------------- Переместить элементы из списка в указанный слой ----------------
+bool MoveElementsToLayer(const GS::Array<API_Guid>& guids, API_AttributeIndex layerIndex)
+{
+    if (guids.IsEmpty()) {
         ACAPI_WriteReport("[LayerHelper] Нет выделенных элементов", false);
         return false;
     }
 
-    ACAPI_WriteReport("[LayerHelper] Перемещаем %d элементов в слой %s", false, (int)selNeigs.GetSize(), layerIndex.ToUniString().ToCStr().Get());
+    ACAPI_WriteReport("[LayerHelper] Перемещаем %d элементов в слой %s", false, (int)guids.GetSize(), layerIndex.ToUniString().ToCStr().Get());
 
     // Перемещаем каждый элемент
-    for (const API_Neig& neig : selNeigs) {
+    for (const API_Guid& guid : guids) {
         API_Element element = {};
-        element.header.guid = neig.guid;
+        element.header.guid = guid;
         
-        GSErrCode err = ACAPI_Element_Get(&element);
+        GSErrCode err = Perf::ElementGet(&element);
         if (err != NoError) {
-            ACAPI_WriteReport("[LayerHelper] Ошибка получения элемента: %s", true, APIGuidToString(neig.guid).ToCStr().Get());
+            ACAPI_WriteReport("[LayerHelper] Ошибка получения элемента: %s", true, APIGuidToString(guid).ToCStr().Get());
             continue;
         }
 
@@ -225,11 +341,11 @@ bool MoveSelectedElementsToLayer(API_AttributeIndex layerIndex)
         element.header.layer = layerIndex;
         ACAPI_ELEMENT_MASK_SET(mask, API_Elem_Head, layer);
 
-        err = ACAPI_Element_Change(&element, &mask, nullptr, 0, true);
+        err = Perf::ElementChange(&element, &mask, nullptr, 0, true);
         if (err != NoError) {
-            ACAPI_WriteReport("[LayerHelper] Ошибка изменения слоя элемента: %s", true, APIGuidToString(neig.guid).ToCStr().Get());
+            ACAPI_WriteReport("[LayerHelper] Ошибка изменения слоя элемента: %s", true, APIGuidToString(guid).ToCStr().Get());
         } else {
-            ACAPI_WriteReport("[LayerHelper] Элемент перемещен в слой: %s", false, APIGuidToString(neig.guid).ToCStr().Get());
+            ACAPI_WriteReport("[LayerHelper] Элемент перемещен в слой: %s", false, APIGuidToString(guid).ToCStr().Get());
         }
     }
 
@@ -239,29 +355,37 @@ bool MoveSelectedElementsToLayer(API_AttributeIndex layerIndex)
 // ---------------- Изменить ID всех выделенных элементов ----------------
 bool ChangeSelectedElementsID(const GS::UniString& baseID)
 {
-    if (baseID.IsEmpty()) return false;
-
     API_SelectionInfo selectionInfo = {};
     GS::Array<API_Neig> selNeigs;
     ACAPI_Selection_Get(&selectionInfo, &selNeigs, false, false);
     BMKillHandle((GSHandle*)&selectionInfo.marquee.coords);
 
-    if (selNeigs.IsEmpty()) return false;
+    GS::Array<API_Guid> guids;
+    for (const API_Neig& neig : selNeigs) guids.Push(neig.guid);
+    return ChangeElementsID(guids, baseID);
+}
 
-    ACAPI_WriteReport("[LayerHelper] Изменяем ID %d элементов с базовым названием: %s", false, (int)selNeigs.GetSize(), baseID.ToCStr().Get());
+// ---------------- Изменить ID элементов из списка ----------------
+bool ChangeElementsID(const GS::Array<API_Guid>& guids, const GS::UniString& baseID)
+{
+    if (baseID.IsEmpty()) return false;
+    if (guids.IsEmpty()) return false;
+
+    ACAPI_WriteReport("[LayerHelper] Изменяем ID %d элементов с базовым названием: %s", false, (int)guids.GetSize(), baseID.ToCStr().Get());
 
     // Используем Undo-группу для возможности отмены
-    GSErrCode err = ACAPI_CallUndoableCommand("Change Elements ID", [&]() -> GSErrCode {
-        for (UIndex i = 0; i < selNeigs.GetSize(); ++i) {
+    GSErrCode err = UndoScope::Call("Change Elements ID", [&]() -> GSErrCode {
+        for (UIndex i = 0; i < guids.GetSize(); ++i) {
             // Создаем новый ID: baseID-01, baseID-02, etc.
             GS::UniString newID = baseID;
-            if (selNeigs.GetSize() > 1) {
+            if (guids.GetSize() > 1) {
                 newID += GS::UniString::Printf("-%02d", (int)(i + 1));
             }
 
             // Изменяем ID элемента
-            if (ACAPI_Element_ChangeElementInfoString(&selNeigs[i].guid, &newID) != NoError) {
-                ACAPI_WriteReport("[LayerHelper] Ошибка изменения ID элемента: %s", true, APIGuidToString(selNeigs[i].guid).ToCStr().Get());
+            API_Guid guid = guids[i];
+            if (ACAPI_Element_ChangeElementInfoString(&guid, &newID) != NoError) {
+                ACAPI_WriteReport("[LayerHelper] Ошибка изменения ID элемента: %s", true, APIGuidToString(guid).ToCStr().Get());
                 continue;
             } else {
                 ACAPI_WriteReport("[LayerHelper] ID изменен: %s", false, newID.ToCStr().Get());
@@ -283,7 +407,7 @@ bool CreateLayerAndMoveElements(const LayerCreationParams& params)
         params.baseID.ToCStr().Get());
 
     // Используем Undo-группу для возможности отмены всей операции
-    GSErrCode err = ACAPI_CallUndoableCommand("Create Layer and Move Elements", [&]() -> GSErrCode {
+    GSErrCode err = UndoScope::Call("Create Layer and Move Elements", [&]() -> GSErrCode {
         // 1. Создаем слой
         API_AttributeIndex layerIndex;
         if (!CreateLayer(params.folderPath, params.layerName, layerIndex)) {
@@ -378,6 +502,7 @@ bool MoveLayerToFolder(API_AttributeIndex layerIndex, const GS::UniString& folde
     ACAPI_WriteReport("[LayerHelper] ACAPI_Attribute_Move вернул код: %d", false, err);
     
     if (err != NoError) {
+        InvalidateCache(); // папку могли удалить — GUID из кэша больше не годится
         ACAPI_WriteReport("[LayerHelper] Ошибка перемещения слоя в папку '%s' (код: %d, hex: 0x%X)", true, 
             folderPath.ToCStr().Get(), err, (unsigned int)err);
         ACAPI_WriteReport("[LayerHelper] Слой остался в корне, но папка создана: %s", false, folderPath.ToCStr().Get());
@@ -388,7 +513,88 @@ bool MoveLayerToFolder(API_AttributeIndex layerIndex, const GS::UniString& folde
     return true;
 }
 
+// ---------------- Пакетное создание слоёв и папок ----------------
+UInt32 CreateLayersBatch(const GS::Array<LayerCreationParams>& items, GS::Array<API_AttributeIndex>& outIndices)
+{
+    outIndices.Clear();
+    for (UIndex i = 0; i < items.GetSize(); ++i)
+        outIndices.Push(APIInvalidAttributeIndex);
+    if (items.IsEmpty()) return 0;
+
+    // Перенос в папки — одним ACAPI_Attribute_Move на папку
+    struct FolderMove { GS::Guid folder; GS::Array<GS::Guid> layers; };
+    std::unordered_map<std::string, FolderMove> moves;
+
+    UInt32 created = 0, reused = 0, failed = 0;
+    GSErrCode err = UndoScope::Call("Create Layers", [&]() -> GSErrCode {
+        // одна перечитка на пакет: дальше промахи — действительно новые имена, свои создания дописываются
+        RebuildLayerMap();
+
+        for (UIndex i = 0; i < items.GetSize(); ++i) {
+            const LayerCreationParams& item = items[i];
+            if (item.layerName.IsEmpty()) { ++failed; continue; }
+
+            GS::Guid folderGuid;
+            if (!CreateLayerFolder(item.folderPath, folderGuid)) { ++failed; continue; }
+
+            API_AttributeIndex layerIndex = FindLayerByName(item.layerName, false);
+            API_Attribute layer = {};
+            layer.header.typeID = API_LayerID;
+            bool isNew = false;
+            if (!layerIndex.IsPositive()) {
+                strcpy(layer.header.name, item.layerName.ToCStr().Get());
+                layer.layer.conClassId = 1;
+                const GSErrCode ce = ACAPI_Attribute_Create(&layer, nullptr);
+                if (ce == NoError) {
+                    layerIndex = layer.header.index;
+                    RememberLayer(item.layerName, layerIndex);
+                    isNew = true;
+                    ++created;
+                } else if (ce == APIERR_NAMEALREADYUSED) {
+                    RebuildLayerMap();
+                    layerIndex = FindLayerByName(item.layerName, false);
+                }
+                if (!layerIndex.IsPositive()) {
+                    ACAPI_WriteReport("[LayerHelper] Ошибка создания слоя: %s", true, item.layerName.ToCStr().Get());
+                    ++failed;
+                    continue;
+                }
+            }
+            if (!isNew) {
+                layer = {};
+                layer.header.typeID = API_LayerID;
+                layer.header.index = layerIndex;
+                if (ACAPI_Attribute_Get(&layer) != NoError) { ++failed; continue; }
+                ++reused;
+            }
+            outIndices[i] = layerIndex;
+
+            if (folderGuid != GS::Guid()) {
+                FolderMove& mv = moves[CacheKey(JoinFolderPath(ParseFolderPath(item.folderPath)))];
+                mv.folder = folderGuid;
+                mv.layers.Push(GS::Guid(APIGuidToString(layer.header.guid)));
+            }
+        }
 
+        for (auto& kv : moves) {
+            API_AttributeFolder targetFolder = {};
+            targetFolder.typeID = API_LayerID;
+            targetFolder.guid = kv.second.folder;
+            GS::Array<API_AttributeFolder> foldersToMove;
+            const GSErrCode mvErr = ACAPI_Attribute_Move(foldersToMove, kv.second.layers, targetFolder);
+            if (mvErr != NoError) {
+                ACAPI_WriteReport("[LayerHelper] Ошибка перемещения %d слоёв в папку '%s' (код: %d)", true,
+                    (int)kv.second.layers.GetSize(), kv.first.c_str(), mvErr);
+                InvalidateCache();
+            }
+        }
+        return NoError;
+    });
 
+    SelectionHelper::InvalidateCaches();
+    ACAPI_WriteReport("[LayerHelper] Пакет слоёв: создано %u, существующих %u, ошибок %u, папок %u", false,
+        (unsigned)created, (unsigned)reused, (unsigned)failed, (unsigned)moves.size());
+    return (err == NoError) ? created + reused : 0;
+}
 
 } // namespace LayerHelper
@@ -22,9 +22,11 @@ namespace LayerHelper {
 
     // Переместить выделенные элементы в указанный слой
     bool MoveSelectedElementsToLayer(API_AttributeIndex layerIndex);
+    bool MoveElementsToLayer(const GS::Array<API_Guid>& guids, API_AttributeIndex layerIndex);
 
     // Изменить ID всех выделенных элементов
     bool ChangeSelectedElementsID(const GS::UniString& baseID);
+    bool ChangeElementsID(const GS::Array<API_Guid>& guids, const GS::UniString& baseID);
 
     // Основная функция: создать папку, слой и переместить элементы
     bool CreateLayerAndMoveElements(const LayerCreationParams& params);
@@ -35,6 +37,13 @@ namespace LayerHelper {
     // Переместить слой в папку
     bool MoveLayerToFolder(API_AttributeIndex layerIndex, const GS::UniString& folderPath);
 
+    // Создать много слоёв (и их папок) одной командой Undo; baseID не используется.
+    // outIndices[i] — индекс слоя для items[i] (APIInvalidAttributeIndex при ошибке). Возвращает число готовых слоёв.
+    UInt32 CreateLayersBatch(const GS::Array<LayerCreationParams>& items, GS::Array<API_AttributeIndex>& outIndices);
+
+    // Сбросить кэш имён слоёв и путей папок (смена проекта, внешние изменения атрибутов)
+    void InvalidateCache();
+
 } // namespace LayerHelper
 
 #endif // LAYERHELPER_HPP
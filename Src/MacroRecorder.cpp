@@ -0,0 +1,366 @@
+#include "MacroRecorder.hpp"
+#include "BrowserRepl.hpp"
+#include "UndoScope.hpp"
+#include "Perf.hpp"
+#include "CommandProtocol.hpp"
+#include "SelectionHelper.hpp"
+
+#include "File.hpp"
+#include "FileSystem.hpp"
+#include "Folder.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <vector>
+
+namespace MacroRecorder {
+
+static inline void Log (const GS::UniString& s)
+{
+    if (BrowserRepl::HasInstance())
+        BrowserRepl::GetInstance().LogToBrowser(s);
+}
+
+static const char* kExt = ".brmacro";
+
+// ---------------- Модель ----------------
+struct Step {
+    std::string     cmd;
+    JsonLite::Value args = JsonLite::Value::Object();
+    Int32           sel = -1;   // индекс в Macro::sels, -1 — выделение не нужно
+};
+
+struct Macro {
+    std::vector<GS::Array<API_Guid>> sels;
+    std::vector<Step>                steps;
+};
+
+static Macro g_rec;
+static bool  g_recording = false;
+static std::map<UInt32, Step> g_pendingJobs; // ID задачи -> шаг, ждущий завершения
+
+// не пишутся: чтение, управление выделением/задачами, сами макросы
+static const char* const kSkip[] = {
+    "GetSelectedElements", "AddElementToSelection", "RemoveElementFromSelection",
+    "CancelJob", "CheckScript", "GenerateGDLFromSelection",
+};
+
+// не зависят от выделения (работают с ранее запомненными mesh/путями/настройками)
+static const char* const kNoSelection[] = {
+    "SetDistributionStep", "SetDistributionCount", "SetDistributionClearance", "SetDistributionRandomize",
+    "SetRandomSettings", "SetMarkupStep", "ApplyGroundOffset", "BuildRoad", "RunScript", "CreateLayersBatch",
+};
+
+template <size_t N>
+static bool InList (const char* const (&list)[N], const std::string& name)
+{
+    for (const char* s : list) if (name == s) return true;
+    return false;
+}
+
+static bool SameGuids (const GS::Array<API_Guid>& a, const GS::Array<API_Guid>& b)
+{
+    if (a.GetSize() != b.GetSize()) return false;
+    for (UIndex i = 0; i < a.GetSize(); ++i) if (a[i] != b[i]) return false;
+    return true;
+}
+
+// ---------------- Запись ----------------
+void Start ()
+{
+    g_rec = Macro();
+    g_pendingJobs.clear();
+    g_recording = true;
+    Log("[Macro] recording started");
+}
+
+UInt32 Stop ()
+{
+    g_recording = false;
+    Log(GS::UniString::Printf("[Macro] recording stopped: %u steps, %u selections",
+        (unsigned)g_rec.steps.size(), (unsigned)g_rec.sels.size()));
+    return (UInt32)g_rec.steps.size();
+}
+
+bool IsRecording ()
+{
+    return g_recording;
+}
+
+UInt32 StepCount ()
+{
+    return (UInt32)g_rec.steps.size();
+}
+
+// Шаг по вызову; false — вызов не пишется
+static bool MakeStep (const std::string& cmd, const JsonLite::Value& args, Step& step)
+{
+    if (!g_recording || UndoScope::IsOpen()) return false;
+    if (cmd.compare(0, 5, "Macro") == 0 || InList(kSkip, cmd)) return false;
+
+    step.cmd = cmd;
+    if (args.IsObject()) {
+        for (const JsonLite::Value::Member& m : args.Members())
+            if (m.first != "async") step.args.Set(m.first.c_str(), m.second);
+    }
+
+    if (!InList(kNoSelection, cmd)) {
+        const GS::Array<API_Guid> sel = SelectionHelper::GetSelectedGuids();
+        // выделение между шагами обычно не меняется — ищем с конца
+        for (Int32 i = (Int32)g_rec.sels.size() - 1; i >= 0 && step.sel < 0; --i)
+            if (SameGuids(g_rec.sels[i], sel)) step.sel = i;
+        if (step.sel < 0) {
+            step.sel = (Int32)g_rec.sels.size();
+            g_rec.sels.push_back(sel);
+        }
+    }
+    return true;
+}
+
+void Record (const std::string& cmd, const JsonLite::Value& args)
+{
+    Step step;
+    if (!MakeStep(cmd, args, step)) return;
+    g_rec.steps.push_back(std::move(step));
+    Log(GS::UniString::Printf("[Macro] + %s", cmd.c_str()));
+}
+
+void RecordJob (UInt32 jobId, const std::string& cmd, const JsonLite::Value& args)
+{
+    Step step;
+    if (jobId == 0 || !MakeStep(cmd, args, step)) return;
+    g_pendingJobs[jobId] = std::move(step);
+}
+
+void JobFinished (UInt32 jobId, bool done)
+{
+    auto it = g_pendingJobs.find(jobId);
+    if (it == g_pendingJobs.end()) return;
+    if (done && g_recording) {
+        Log(GS::UniString::Printf("[Macro] + %s (job #%u)", it->second.cmd.c_str(), (unsigned)jobId));
+        g_rec.steps.push_back(std::move(it->second));
+    }
+    g_pendingJobs.erase(it);
+}
+
+// ---------------- JSON ----------------
+static JsonLite::Value MacroToJson (const Macro& m)
+{
+    JsonLite::Value root = JsonLite::Value::Object();
+    root.Set("v", JsonLite::Value::Number(1));
+    JsonLite::Value& sels = root.Set("sels", JsonLite::Value::Array());
+    for (const GS::Array<API_Guid>& s : m.sels) {
+        JsonLite::Value& list = sels.Push(JsonLite::Value::Array());
+        for (const API_Guid& g : s) list.Push(JsonLite::Value::String(APIGuidToString(g).ToCStr().Get()));
+    }
+    JsonLite::Value& steps = root.Set("steps", JsonLite::Value::Array());
+    for (const Step& st : m.steps) {
+        JsonLite::Value& o = steps.Push(JsonLite::Value::Object());
+        o.Set("c", JsonLite::Value::String(st.cmd));
+        if (!st.args.Members().empty()) o.Set("a", st.args);
+        if (st.sel >= 0)                o.Set("s", JsonLite::Value::Number(st.sel));
+    }
+    return root;
+}
+
+static bool MacroFromJson (const JsonLite::Value& root, Macro& m, std::string& err)
+{
+    m = Macro();
+    const JsonLite::Value* steps = root.Find("steps");
+    if (!root.IsObject() || steps == nullptr || !steps->IsArray()) { err = "not a macro file"; return false; }
+
+    if (const JsonLite::Value* sels = root.Find("sels")) {
+        for (const JsonLite::Value& list : sels->Items()) {
+            GS::Array<API_Guid> guids;
+            for (const JsonLite::Value& g : list.Items())
+                if (g.IsString()) guids.Push(APIGuidFromString(g.AsString().c_str()));
+            m.sels.push_back(guids);
+        }
+    }
+
+    for (const JsonLite::Value& o : steps->Items()) {
+        const JsonLite::Value* c = o.Find("c");
+        if (c == nullptr || !c->IsString()) { err = "step without command"; return false; }
+        Step st;
+        st.cmd = c->AsString();
+        if (const JsonLite::Value* a = o.Find("a")) if (a->IsObject()) st.args = *a;
+        if (const JsonLite::Value* s = o.Find("s")) {
+            if (s->IsNumber()) st.sel = (Int32)std::llround(s->AsNumber());
+            if (st.sel >= (Int32)m.sels.size()) { err = "bad selection index in step " + std::to_string(m.steps.size() + 1); return false; }
+        }
+        m.steps.push_back(std::move(st));
+    }
+    return true;
+}
+
+// ---------------- Файлы ----------------
+static bool MacroFolder (IO::Location& loc)
+{
+    if (IO::fileSystem.GetSpecialLocation(IO::FileSystem::UserDocuments, &loc) != NoError) return false;
+    loc.AppendToLocal(IO::Name("BrowserReplInt Macros"));
+    IO::fileSystem.CreateFolder(loc); // уже есть — ошибка не важна, запись/чтение файла её покажут
+    return true;
+}
+
+static bool MacroFile (const GS::UniString& name, IO::Location& loc)
+{
+    GS::UniString clean = name;
+    for (const char* bad : { "/", "\\", ":", "*", "?", "\"", "<", ">", "|" })
+        clean.ReplaceAll(GS::UniString(bad), GS::UniString("_"));
+    clean.Trim();
+    if (clean.IsEmpty() || !MacroFolder(loc)) return false;
+    loc.AppendToLocal(IO::Name(clean + kExt));
+    return true;
+}
+
+static bool WriteText (const IO::Location& loc, const std::string& text)
+{
+    IO::File f(loc, IO::File::Create);
+    if (f.GetStatus() != NoError || f.Open(IO::File::WriteEmptyMode) != NoError) return false;
+    const GSErrCode err = f.WriteBin(text.data(), (USize)text.size());
+    f.Close();
+    return err == NoError;
+}
+
+static bool ReadText (const IO::Location& loc, std::string& text)
+{
+    IO::File f(loc);
+    if (f.GetStatus() != NoError || f.Open(IO::File::ReadMode) != NoError) return false;
+    UInt64 len = 0;
+    GSErrCode err = f.GetDataLength(&len);
+    if (err == NoError) {
+        text.assign((size_t)len, '\0');
+        if (len > 0) err = f.ReadBin(&text[0], (USize)len);
+    }
+    f.Close();
+    return err == NoError;
+}
+
+bool Save (const GS::UniString& name)
+{
+    IO::Location loc;
+    if (g_rec.steps.empty() || !MacroFile(name, loc)) { Log("[Macro] nothing to save or bad name"); return false; }
+    const bool ok = WriteText(loc, JsonLite::ToString(MacroToJson(g_rec)));
+    Log(GS::UniString::Printf("[Macro] save \"%s\": %s", CommandProtocol::ToUtf8(name).c_str(), ok ? "ok" : "FAILED"));
+    return ok;
+}
+
+bool Remove (const GS::UniString& name)
+{
+    IO::Location loc;
+    if (!MacroFile(name, loc)) return false;
+    return IO::fileSystem.Delete(loc) == NoError;
+}
+
+GS::Array<GS::UniString> List ()
+{
+    GS::Array<GS::UniString> names;
+    IO::Location dir;
+    if (!MacroFolder(dir)) return names;
+
+    const GS::UniString ext(kExt);
+    IO::Folder folder(dir);
+    folder.Enumerate([&](const IO::Name& entry, bool isFolder) {
+        if (isFolder) return;
+        GS::UniString n;
+        entry.ToString(&n);
+        if (n.GetLength() > ext.GetLength() && n.EndsWith(ext))
+            names.Push(n.GetSubstring(0, n.GetLength() - ext.GetLength()));
+    });
+    return names;
+}
+
+// ---------------- Воспроизведение ----------------
+static void ApplySelection (const GS::Array<API_Guid>& guids)
+{
+    ACAPI_Selection_DeselectAll();
+    if (guids.IsEmpty()) return;
+    GS::Array<API_Neig> neigs;
+    for (const API_Guid& g : guids) neigs.Push(API_Neig(g));
+    ACAPI_Selection_Select(neigs, true);
+}
+
+ReplayResult Replay (const GS::UniString& name)
+{
+    Perf::CommandScope perf("MacroReplay");
+    const auto t0 = std::chrono::steady_clock::now();
+    ReplayResult res;
+    if (g_recording) Stop(); // воспроизведение не должно попадать в запись
+
+    Macro m;
+    std::string err;
+    if (name.IsEmpty()) {
+        m = g_rec;
+    } else {
+        IO::Location loc;
+        std::string text;
+        JsonLite::Value root;
+        if (!MacroFile(name, loc) || !ReadText(loc, text)) err = "cannot read macro file";
+        else if (!JsonLite::Parse(text, root, err) || !MacroFromJson(root, m, err)) err = "bad macro file: " + err;
+    }
+    res.total = (UInt32)m.steps.size();
+    if (err.empty() && m.steps.empty()) err = "macro is empty";
+
+    if (err.empty()) {
+        // удалённые с момента записи элементы отбрасываем один раз на выделение, а не на шаг
+        for (GS::Array<API_Guid>& s : m.sels) {
+            GS::Array<API_Guid> alive;
+            for (const API_Guid& g : s) {
+                API_Elem_Head h = {}; h.guid = g;
+                if (ACAPI_Element_GetHeader(&h) == NoError) alive.Push(g);
+                else ++res.missing;
+            }
+            s = alive;
+        }
+
+        const GSErrCode undoErr = UndoScope::Call("Replay Macro", [&]() -> GSErrCode {
+            Int32 applied = -1; // индекс текущего выделения
+            for (size_t i = 0; i < m.steps.size(); ++i) {
+                const Step& st = m.steps[i];
+                const std::string where = "step " + std::to_string(i + 1) + " (" + st.cmd + "): ";
+
+                if (st.sel >= 0 && st.sel != applied) {
+                    ApplySelection(m.sels[st.sel]);
+                    applied = st.sel;
+                }
+
+                JsonLite::Value c = JsonLite::Value::Object();
+                c.Set("cmd", JsonLite::Value::String(st.cmd));
+                c.Set("args", st.args);
+                const JsonLite::Value r = CommandProtocol::RunOne(c);
+                if (!r.Find("ok")->AsBool()) {
+                    const JsonLite::Value* e = r.Find("error");
+                    err = where + ((e != nullptr && e->IsString()) ? e->AsString() : std::string("failed"));
+                    break;
+                }
+                ++res.steps;
+            }
+            return NoError; // выполненные шаги остаются одной командой Undo
+        });
+        // команда Undo не открылась (идёт другая команда, проект только для чтения)
+        if (undoErr != NoError && err.empty())
+            err = "undoable command failed, err=" + std::to_string((int)undoErr);
+    }
+
+    res.ok = err.empty();
+    res.error = CommandProtocol::FromUtf8(err);
+    res.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    Log(GS::UniString::Printf("[Macro] replay %u/%u steps, missing=%u, %.1f ms", (unsigned)res.steps, (unsigned)res.total,
+        (unsigned)res.missing, res.ms) + (res.ok ? GS::UniString() : " | " + res.error));
+    return res;
+}
+
+JsonLite::Value ToJson (const ReplayResult& r)
+{
+    JsonLite::Value v = JsonLite::Value::Object();
+    v.Set("ok", JsonLite::Value::Bool(r.ok));
+    v.Set("steps", JsonLite::Value::Number(r.steps));
+    v.Set("total", JsonLite::Value::Number(r.total));
+    v.Set("missing", JsonLite::Value::Number(r.missing));
+    v.Set("ms", JsonLite::Value::Number(std::round(r.ms * 1000.0) / 1000.0));
+    if (!r.ok) v.Set("error", JsonLite::Value::String(CommandProtocol::ToUtf8(r.error)));
+    return v;
+}
+
+} // namespace MacroRecorder
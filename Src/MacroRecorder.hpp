@@ -0,0 +1,58 @@
+#ifndef MACRORECORDER_HPP
+#define MACRORECORDER_HPP
+
+#include "APIEnvir.h"
+#include "ACAPinc.h"
+#include "GSRoot.hpp"
+#include "JsonLite.hpp"
+
+#include <string>
+
+// ============================================================================
+// MacroRecorder — запись вызовов моста (команды CommandProtocol и задачи) с
+// аргументами и выделением на момент вызова; воспроизведение целиком в C++.
+//
+// Файл "<Документы>/BrowserReplInt Macros/<имя>.brmacro" (JSON):
+//   {"v":1,"sels":[["guid",...],...],
+//    "steps":[{"c":"SetGroundSurface","s":0},{"c":"ApplyGroundOffset","a":{"offset":0}},...]}
+// Одинаковые выделения хранятся один раз ("s" — индекс в "sels").
+// Задачи JobManager попадают в запись, когда задача завершилась успешно
+// (выделение — на момент запуска).
+//
+// Воспроизведение: одна команда Undo, "async" снимается — тяжёлые шаги идут
+// подряд синхронно; выделение меняется только когда шаг требует другое.
+// ============================================================================
+namespace MacroRecorder {
+
+    struct ReplayResult {
+        bool          ok = false;
+        UInt32        steps = 0;    // выполнено шагов
+        UInt32        total = 0;
+        UInt32        missing = 0;  // GUID из файла, которых нет в проекте
+        double        ms = 0.0;
+        GS::UniString error;
+    };
+
+    void   Start ();
+    UInt32 Stop ();                // число записанных шагов
+    bool   IsRecording ();
+    UInt32 StepCount ();
+
+    // Записать успешный вызов (вложенные вызовы внутри открытой команды Undo не пишутся)
+    void Record (const std::string& cmd, const JsonLite::Value& args);
+
+    // Вызов, поставленный задачей: шаг готовится сейчас, а в запись попадает в JobFinished(done=true)
+    void RecordJob (UInt32 jobId, const std::string& cmd, const JsonLite::Value& args);
+    void JobFinished (UInt32 jobId, bool done);
+
+    // Текущая запись <-> файл; пустое имя в Replay — текущая запись без файла
+    bool                     Save (const GS::UniString& name);
+    bool                     Remove (const GS::UniString& name);
+    GS::Array<GS::UniString> List ();
+    ReplayResult             Replay (const GS::UniString& name);
+
+    JsonLite::Value ToJson (const ReplayResult& r);
+
+}
+
+#endif // MACRORECORDER_HPP
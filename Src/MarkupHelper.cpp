@@ -3,6 +3,8 @@
 // ============================================================================
 
 #include "MarkupHelper.hpp"
+#include "UndoScope.hpp"
+#include "Perf.hpp"
 #include "BrowserRepl.hpp"
 
 #include "ACAPinc.h"
@@ -252,7 +254,7 @@ namespace MarkupHelper {
 
 		API_Element elem = {};
 		elem.header.guid = guid;
-		if (ACAPI_Element_Get(&elem) != NoError) {
+		if (Perf::ElementGet(&elem) != NoError) {
 			// Log("Failed to get element " + APIGuidToString(guid));
 			return false;
 		}
@@ -262,7 +264,7 @@ namespace MarkupHelper {
 		// Для стен - получаем полный контур через memo (включая дуги)
 		if (tid == API_WallID) {
 			API_ElementMemo memo = {};
-			GSErrCode e = ACAPI_Element_GetMemo(guid, &memo, APIMemoMask_Polygon);
+			GSErrCode e = Perf::ElementGetMemo(guid, &memo, APIMemoMask_Polygon);
 			
 			if (e == NoError && memo.coords != nullptr) {
 				// Строим контур с правильной обработкой дуг
@@ -307,7 +309,7 @@ namespace MarkupHelper {
 
 		// Для остальных элементов (Mesh, Slab, Shell) - получаем контур через memo
 		API_ElementMemo memo = {};
-		GSErrCode e = ACAPI_Element_GetMemo(guid, &memo, APIMemoMask_Polygon);
+		GSErrCode e = Perf::ElementGetMemo(guid, &memo, APIMemoMask_Polygon);
 		
 		if (e == NoError && memo.coords != nullptr) {
 			// Строим контур с правильной обработкой дуг
@@ -571,7 +573,7 @@ namespace MarkupHelper {
 		e2.base.base.special = false;
 		e2.pos = pt2;  // <- на базовой линии
 
-		err = ACAPI_Element_Create(&dim, &memo);
+		err = Perf::ElementCreate(&dim, &memo);
 		ACAPI_DisposeElemMemoHdls(&memo);
 
 		return (err == NoError);
@@ -706,7 +708,7 @@ namespace MarkupHelper {
 
 		// 5) Undo-группа
 		int createdCount = 0;
-		err = ACAPI_CallUndoableCommand("Разметка", [&]() -> GSErrCode {
+		err = UndoScope::Call("Разметка", [&]() -> GSErrCode {
 			for (const auto& pr : dimensionPairs) {
 				const Vec2& A = pr.first;
 				const Vec2& B = pr.second;
@@ -762,7 +764,7 @@ namespace MarkupHelper {
 		for (const API_Neig& n : selNeigs) {
 			API_Element elem = {};
 			elem.header.guid = n.guid;
-			if (ACAPI_Element_Get(&elem) != NoError) continue;
+			if (Perf::ElementGet(&elem) != NoError) continue;
 
 			const API_ElemTypeID tid = elem.header.type.typeID;
 			ObjectAnchor obj;
@@ -866,7 +868,7 @@ namespace MarkupHelper {
 
 		// 4) Создаём размеры в Undo-группе
 		int createdCount = 0;
-		err = ACAPI_CallUndoableCommand("Проставить размеры", [&]() -> GSErrCode {
+		err = UndoScope::Call("Проставить размеры", [&]() -> GSErrCode {
 			for (const auto& pair : dimensionPairs) {
 				if (CreateDimensionBetweenPoints(pair.first.toCoord(), pair.second.toCoord())) {
 					++createdCount;
@@ -928,7 +930,7 @@ namespace MarkupHelper {
 			// Получаем элемент
 			API_Element element = {};
 			element.header.guid = neig.guid;
-			if (ACAPI_Element_Get(&element) != NoError) {
+			if (Perf::ElementGet(&element) != NoError) {
 				Log(GS::UniString::Printf("WARN: не удалось получить элемент %d", (int)i));
 				continue;
 			}
@@ -994,7 +996,7 @@ namespace MarkupHelper {
 
 		// 4) Создаем размеры последовательно (1→2, 2→3, 3→4...)
 		int createdCount = 0;
-		GSErrCode err = ACAPI_CallUndoableCommand("Размеры между объектами", [&]() -> GSErrCode {
+		GSErrCode err = UndoScope::Call("Размеры между объектами", [&]() -> GSErrCode {
 			for (size_t i = 0; i < objects.size() - 1; ++i) {
 				const API_Coord& pt1 = objects[i].coord;
 				const API_Coord& pt2 = objects[i + 1].coord;
@@ -1061,7 +1063,7 @@ namespace MarkupHelper {
 			// Получаем элемент
 			API_Element element = {};
 			element.header.guid = neig.guid;
-			if (ACAPI_Element_Get(&element) != NoError) {
+			if (Perf::ElementGet(&element) != NoError) {
 				Log(GS::UniString::Printf("WARN: не удалось получить элемент %d", (int)i));
 				continue;
 			}
@@ -1129,7 +1131,7 @@ namespace MarkupHelper {
 
 		// 4) Создаем размеры от каждого объекта до целевой точки
 		int createdCount = 0;
-		err = ACAPI_CallUndoableCommand("Размеры до точки", [&]() -> GSErrCode {
+		err = UndoScope::Call("Размеры до точки", [&]() -> GSErrCode {
 			for (size_t i = 0; i < objects.size(); ++i) {
 				const API_Coord& objCoord = objects[i].coord;
 				
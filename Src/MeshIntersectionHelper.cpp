@@ -1,18 +1,904 @@
 // ============================================================================
 // MeshIntersectionHelper.cpp — пересечение с Mesh поверхностью через TIN
-// Получает Z координату и нормаль поверхности по координатам XY
+// TerrainQuery: построение TIN (CDT + level-точки), индекс, запросы Z/нормали;
+// реестр построенных TIN по GUID mesh
 // ============================================================================
 
 #include "MeshIntersectionHelper.hpp"
-#include "GroundHelper.hpp"
+#include "BrowserRepl.hpp"
+#include "Perf.hpp"
 
-bool MeshIntersectionHelper::GetZAndNormal(const API_Coord& xy, double& outZ, API_Vector3D& outNormal)
+#include "ACAPinc.h"
+#include "APICommon.h"
+#include "APIdefs_Goodies.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+// ====================== switches ======================
+#define MAX_LEVEL_POINTS      5000  // лимит level-точек из Mesh
+#define MAX_CACHED_TINS          8  // сколько mesh держит реестр
+
+// ------------------ Logging ------------------
+static inline void Log(const char* fmt, ...)
+{
+    va_list vl;
+    va_start(vl, fmt);
+    char buf[4096];
+    std::vsnprintf(buf, sizeof(buf), fmt, vl);
+    va_end(vl);
+
+    GS::UniString s(buf);
+    if (BrowserRepl::HasInstance())
+        BrowserRepl::GetInstance().LogToBrowser(s);
+    ACAPI_WriteReport("%s", false, s.ToCStr().Get());
+}
+
+// ================================================================
+// Stories
+// ================================================================
+StoryLevels::StoryLevels()
+{
+    API_StoryInfo si{}; const GSErr e = ACAPI_ProjectSetting_GetStorySettings(&si);
+    if (e != NoError || si.data == nullptr) {
+        Log("[Story] GetStorySettings failed err=%d", (int)e);
+        return;
+    }
+    const Int32 cnt = (Int32)(BMGetHandleSize((GSHandle)si.data) / sizeof(API_StoryType));
+    m_first = si.firstStory;
+    m_levels.reserve(cnt);
+    for (Int32 i = 0; i < cnt; ++i) m_levels.push_back((*si.data)[i].level);
+    BMKillHandle((GSHandle*)&si.data);
+}
+
+// Индекс от firstStory: подземные этажи (floorInd < 0) тоже в таблице
+double StoryLevels::Get(short floorInd) const
+{
+    const Int32 idx = (Int32)floorInd - (Int32)m_first;
+    return (0 <= idx && idx < (Int32)m_levels.size()) ? m_levels[idx] : 0.0;
+}
+
+// ================================================================
+// Small math helpers
+// ================================================================
+static inline void Normalize(API_Vector3D& v)
+{
+    const double L = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+    if (L > 1e-12) { v.x /= L; v.y /= L; v.z /= L; }
+}
+static inline double Cross2D(double ax, double ay, double bx, double by, double cx, double cy)
+{
+    return (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+}
+static inline double TriArea2Dxy(double ax, double ay, double bx, double by, double cx, double cy)
+{
+    return 0.5 * Cross2D(ax, ay, bx, by, cx, cy);
+}
+static inline bool PointInTriStrictXY(double px, double py, double ax, double ay, double bx, double by, double cx, double cy, double eps = 1e-12)
+{
+    const double c1 = Cross2D(ax, ay, bx, by, px, py);
+    const double c2 = Cross2D(bx, by, cx, cy, px, py);
+    const double c3 = Cross2D(cx, cy, ax, ay, px, py);
+    const bool s1 = (c1 > -eps), s2 = (c2 > -eps), s3 = (c3 > -eps);
+    const bool s1n = (c1 < +eps), s2n = (c2 < +eps), s3n = (c3 < +eps);
+    return ((s1 && s2 && s3) || (s1n && s2n && s3n));
+}
+
+// ================================================================
+// TIN structures
+// ================================================================
+using TINNode = TerrainQuery::Node;
+using TINTri = TerrainQuery::Tri;
+
+static inline double TriArea2D(const TINNode& A, const TINNode& B, const TINNode& C)
+{
+    return TriArea2Dxy(A.x, A.y, B.x, B.y, C.x, C.y);
+}
+static inline bool IsCCW_Poly(const std::vector<TINNode>& poly)
+{
+    double A = 0.0;
+    for (size_t i = 0, n = poly.size(); i < n; ++i) {
+        const TINNode& p = poly[i], & q = poly[(i + 1) % n];
+        A += p.x * q.y - p.y * q.x;
+    }
+    return A > 0.0;
+}
+static inline API_Vector3D TriNormal3D(const TINNode& A, const TINNode& B, const TINNode& C)
+{
+    const double ux = B.x - A.x, uy = B.y - A.y, uz = B.z - A.z;
+    const double vx = C.x - A.x, vy = C.y - A.y, vz = C.z - A.z;
+    API_Vector3D n{ uy * vz - uz * vy, uz * vx - ux * vz, ux * vy - uy * vx };
+    Normalize(n); if (n.z < 0.0) { n.x = -n.x; n.y = -n.y; n.z = -n.z; }
+    return n;
+}
+
+// ================================================================
+// Ear clipping
+// ================================================================
+static std::vector<TINTri> TriangulateEarClipping(const std::vector<TINNode>& poly)
+{
+    std::vector<TINTri> tris; const size_t n = poly.size(); if (n < 3) return tris;
+    std::vector<int> idx(n); for (size_t i = 0;i < n;++i) idx[i] = (int)i;
+
+    const bool ccw = IsCCW_Poly(poly);
+    auto isConvex = [&](int i0, int i1, int i2) {
+        const TINNode& A = poly[idx[i0]], & B = poly[idx[i1]], & C = poly[idx[i2]];
+        const double cross = Cross2D(A.x, A.y, B.x, B.y, C.x, C.y);
+        return ccw ? (cross > 0.0) : (cross < 0.0);
+        };
+
+    size_t guard = 0;
+    while (idx.size() > 3 && guard++ < n * n) {
+        bool clipped = false;
+        for (size_t i = 0;i < idx.size();++i) {
+            const int i0 = (int)((i + idx.size() - 1) % idx.size());
+            const int i1 = (int)i;
+            const int i2 = (int)((i + 1) % idx.size());
+            if (!isConvex(i0, i1, i2)) continue;
+
+            const TINNode& A = poly[idx[i0]], & B = poly[idx[i1]], & C = poly[idx[i2]];
+            bool empty = true;
+            for (size_t k = 0;k < idx.size();++k) {
+                if (k == i0 || k == i1 || k == i2) continue;
+                if (PointInTriStrictXY(poly[idx[k]].x, poly[idx[k]].y, A.x, A.y, B.x, B.y, C.x, C.y)) { empty = false; break; }
+            }
+            if (!empty) continue;
+            TINTri t{ idx[i0], idx[i1], idx[i2] }; if (!ccw) std::swap(t.b, t.c);
+            tris.push_back(t); idx.erase(idx.begin() + i1); clipped = true; break;
+        }
+        if (!clipped) break;
+    }
+    if (idx.size() == 3) {
+        TINTri t{ idx[0], idx[1], idx[2] };
+        if (TriArea2D(poly[t.a], poly[t.b], poly[t.c]) < 0.0) std::swap(t.b, t.c);
+        tris.push_back(t);
+    }
+    return tris;
+}
+
+// ================================================================
+// Find tri & split by Steiner point
+// ================================================================
+static int FindTriContaining(const std::vector<TINNode>& nodes,
+    const std::vector<TINTri>& tris,
+    const TINNode& P)
+{
+    constexpr double EPS = 1e-12;
+    for (int ti = 0; ti < (int)tris.size(); ++ti) {
+        const TINTri& t = tris[ti];
+        const TINNode& A = nodes[t.a], & B = nodes[t.b], & C = nodes[t.c];
+        const bool outside =
+            (Cross2D(A.x, A.y, B.x, B.y, P.x, P.y) < -EPS) ||
+            (Cross2D(B.x, B.y, C.x, C.y, P.x, P.y) < -EPS) ||
+            (Cross2D(C.x, C.y, A.x, A.y, P.x, P.y) < -EPS);
+        if (!outside) return ti;
+    }
+    return -1;
+}
+static void SplitTriByPoint(std::vector<TINNode>& nodes, std::vector<TINTri>& tris,
+    int triIndex, int pIdx, int& t0, int& t1, int& t2)
+{
+    const TINTri t = tris[triIndex];
+    TINTri A{ t.a, t.b, pIdx }, B{ t.b, t.c, pIdx }, C{ t.c, t.a, pIdx };
+    if (TriArea2D(nodes[A.a], nodes[A.b], nodes[A.c]) < 0.0) std::swap(A.b, A.c);
+    if (TriArea2D(nodes[B.a], nodes[B.b], nodes[B.c]) < 0.0) std::swap(B.b, B.c);
+    if (TriArea2D(nodes[C.a], nodes[C.b], nodes[C.c]) < 0.0) std::swap(C.b, C.c);
+    tris[triIndex] = A; t0 = triIndex; tris.push_back(B); t1 = (int)tris.size() - 1; tris.push_back(C); t2 = (int)tris.size() - 1;
+}
+
+// ================================================================
+// CDT legalization (constraints по границе)
+// ================================================================
+struct Edge { int u, v; };
+static inline Edge MkE(int a, int b) { if (a > b) std::swap(a, b); return { a,b }; }
+struct EdgeLess { bool operator()(const Edge& a, const Edge& b) const { return a.u < b.u || (a.u == b.u && a.v < b.v); } };
+using EdgeSet = std::set<Edge, EdgeLess>;
+
+static inline bool InCircleCCW(const TINNode& A, const TINNode& B, const TINNode& C, const TINNode& P)
+{
+    double ax = A.x - P.x, ay = A.y - P.y;
+    double bx = B.x - P.x, by = B.y - P.y;
+    double cx = C.x - P.x, cy = C.y - P.y;
+    double det = (ax * ax + ay * ay) * (bx * cy - by * cx)
+        - (bx * bx + by * by) * (ax * cy - ay * cx)
+        + (cx * cx + cy * cy) * (ax * by - ay * bx);
+    const double areaABC = Cross2D(A.x, A.y, B.x, B.y, C.x, C.y);
+    if (areaABC < 0.0) det = -det;
+    return det > 0.0;
+}
+static inline int Opposite(const TINTri& t, int u, int v)
+{
+    if (t.a != u && t.a != v) return t.a;
+    if (t.b != u && t.b != v) return t.b;
+    return t.c;
+}
+static inline void MakeCCW(const std::vector<TINNode>& nodes, TINTri& t)
+{
+    if (TriArea2D(nodes[t.a], nodes[t.b], nodes[t.c]) < 0.0) std::swap(t.b, t.c);
+}
+
+static void GlobalConstrainedDelaunayLegalize(std::vector<TINNode>& nodes,
+    std::vector<TINTri>& tris,
+    const EdgeSet& constraints)
+{
+    auto buildAdj = [&](std::map<Edge, std::vector<int>, EdgeLess>& adj) {
+        adj.clear();
+        for (int ti = 0; ti < (int)tris.size(); ++ti) {
+            const TINTri& t = tris[ti];
+            adj[MkE(t.a, t.b)].push_back(ti);
+            adj[MkE(t.b, t.c)].push_back(ti);
+            adj[MkE(t.c, t.a)].push_back(ti);
+        }
+        };
+
+    int guard = 0; const int GUARD_MAX = 10000; bool flipped = true;
+    while (flipped && guard++ < GUARD_MAX) {
+        flipped = false;
+        std::map<Edge, std::vector<int>, EdgeLess> adj; buildAdj(adj);
+        for (const auto& kv : adj) {
+            const Edge e = kv.first; const auto& owners = kv.second;
+            if ((int)owners.size() != 2) continue;
+            if (constraints.count(e) > 0) continue;
+
+            const int t0 = owners[0], t1 = owners[1];
+            const TINTri& A = tris[t0]; const TINTri& B = tris[t1];
+            const int p = Opposite(A, e.u, e.v), q = Opposite(B, e.u, e.v);
+
+            const bool viol = InCircleCCW(nodes[e.u], nodes[e.v], nodes[p], nodes[q])
+                || InCircleCCW(nodes[e.v], nodes[e.u], nodes[q], nodes[p]);
+            if (!viol) continue;
+
+            TINTri NA{ p, e.u, q }, NB{ p, q, e.v };
+            if (std::fabs(TriArea2D(nodes[NA.a], nodes[NA.b], nodes[NA.c])) < 1e-14) continue;
+            if (std::fabs(TriArea2D(nodes[NB.a], nodes[NB.b], nodes[NB.c])) < 1e-14) continue;
+
+            tris[t0] = NA; MakeCCW(nodes, tris[t0]);
+            tris[t1] = NB; MakeCCW(nodes, tris[t1]);
+            flipped = true; break;
+        }
+    }
+    if (guard >= GUARD_MAX) Log("[CDT] legalization reached guard limit");
+}
+
+// ================================================================
+// Mesh base Z (Archicad 27): storyZ + mesh.level
+// ================================================================
+static double GetMeshBaseZ(const API_Element& meshElem)
 {
-    // Используем существующий функционал из GroundHelper
-    // Преобразуем API_Coord в API_Coord3D (z = 0, т.к. игнорируется)
-    API_Coord3D pos3D = { xy.x, xy.y, 0.0 };
+    const double storyZ = StoryLevels().Get(meshElem.header.floorInd);
+    const double baseZ = storyZ + meshElem.mesh.level;
+    Log("[MeshBase] floor=%d storyZ=%.6f mesh.level=%.6f -> baseZ=%.6f",
+        (int)meshElem.header.floorInd, storyZ, meshElem.mesh.level, baseZ);
+    return baseZ;
+}
+
+// ================================================================
+// Build contour nodes (outer) with absolute Z
+// ================================================================
+struct MeshPolyData { std::vector<TINNode> contour; bool ok = false; };
+
+static MeshPolyData BuildContourNodes(const API_Element& elem, const API_ElementMemo& memo, double baseZ)
+{
+    MeshPolyData out{};
+    if (memo.coords == nullptr || memo.meshPolyZ == nullptr || elem.mesh.poly.nCoords < 3) return out;
+
+    const API_Coord* coords = *memo.coords;
+    const Int32 nCoords = elem.mesh.poly.nCoords; // includes closing
+    const bool coords1 = ((Int32)(BMGetHandleSize((GSHandle)memo.coords) / sizeof(API_Coord)) == nCoords + 1);
+
+    const double* zH = *memo.meshPolyZ;
+    const Int32 zCnt = (Int32)(BMGetHandleSize((GSHandle)memo.meshPolyZ) / sizeof(double));
+    const bool  z1 = (zCnt % (nCoords + 1) == 0);
+
+    // Логируем первые несколько Z для отладки
+    Log("[BuildContour] baseZ=%.6f nCoords=%d zCnt=%d coords1=%d z1=%d", baseZ, nCoords, zCnt, (int)coords1, (int)z1);
+    for (Int32 i = 1; i <= std::min(nCoords, (Int32)5); ++i) {
+        const API_Coord& c = coords[coords1 ? i : (i - 1)];
+        const Int32 zi = z1 ? i : (i - 1);
+        const double rawZ = zH[zi];
+        const double absZ = baseZ + rawZ;
+        Log("[BuildContour] i=%d XY=(%.3f,%.3f) rawZ=%.3f baseZ+rawZ=%.3f", i, c.x, c.y, rawZ, absZ);
+    }
+
+    out.contour.reserve((size_t)(nCoords - 1));
+    for (Int32 i = 1; i <= nCoords - 1; ++i) {
+        const API_Coord& c = coords[coords1 ? i : (i - 1)];
+        const Int32 zi = z1 ? i : (i - 1);
+        const double absZ = baseZ + zH[zi];
+        // убираем только строго совпавшие подряд
+        if (!out.contour.empty()) {
+            const TINNode& last = out.contour.back();
+            if (std::fabs(c.x - last.x) < 1e-12 && std::fabs(c.y - last.y) < 1e-12) continue;
+        }
+        out.contour.push_back({ c.x, c.y, absZ });
+    }
+    out.ok = true;
     
-    // Вызываем GroundHelper, который использует mesh, выбранный через SetGroundSurface()
-    return GroundHelper::GetGroundZAndNormal(pos3D, outZ, outNormal);
+    return out;
+}
+
+// ================================================================
+// Barycentric helpers
+// ================================================================
+static inline void BaryXY(const TINNode& P, const TINNode& A, const TINNode& B, const TINNode& C,
+    double& wA, double& wB, double& wC)
+{
+    const double areaABC = TriArea2D(A, B, C);
+    if (std::fabs(areaABC) < 1e-14) { wA = wB = wC = 0.0; return; }
+    const double areaPBC = TriArea2D(P, B, C);
+    const double areaPCA = TriArea2D(P, C, A);
+    wA = areaPBC / areaABC; wB = areaPCA / areaABC; wC = 1.0 - wA - wB;
+}
+
+// ================================================================
+// Ray casting (Möllер–Trumbore)
+// ================================================================
+static inline bool RayTriHit_MT(const API_Coord3D& orig, const API_Vector3D& dirUnit,
+    const API_Coord3D& A, const API_Coord3D& B, const API_Coord3D& C,
+    double& outT)
+{
+    const double EPS = 1e-12;
+    API_Vector3D e1{ B.x - A.x, B.y - A.y, B.z - A.z };
+    API_Vector3D e2{ C.x - A.x, C.y - A.y, C.z - A.z };
+
+    API_Vector3D p{
+        dirUnit.y * e2.z - dirUnit.z * e2.y,
+        dirUnit.z * e2.x - dirUnit.x * e2.z,
+        dirUnit.x * e2.y - dirUnit.y * e2.x
+    };
+    const double det = e1.x * p.x + e1.y * p.y + e1.z * p.z;
+    if (std::fabs(det) < EPS) return false;
+    const double invDet = 1.0 / det;
+
+    API_Vector3D tvec{ orig.x - A.x, orig.y - A.y, orig.z - A.z };
+    const double u = (tvec.x * p.x + tvec.y * p.y + tvec.z * p.z) * invDet;
+    if (u < -EPS || u > 1.0 + EPS) return false;
+
+    API_Vector3D q{
+        tvec.y * e1.z - tvec.z * e1.y,
+        tvec.z * e1.x - tvec.x * e1.z,
+        tvec.x * e1.y - tvec.y * e1.x
+    };
+    const double v = (dirUnit.x * q.x + dirUnit.y * q.y + dirUnit.z * q.z) * invDet;
+    if (v < -EPS || u + v > 1.0 + EPS) return false;
+
+    outT = (e2.x * q.x + e2.y * q.y + e2.z * q.z) * invDet;
+    return outT > EPS;
+}
+
+// ================================================================
+// Build TIN from memo (contour + optional level points + CDT)
+// ================================================================
+static bool BuildTIN_FromMemo(const API_Element& elem, const API_ElementMemo& memo,
+    std::vector<TINNode>& nodes, std::vector<TINTri>& tris,
+    double& outBaseZ)
+{
+    nodes.clear(); tris.clear(); outBaseZ = 0.0;
+
+    const double baseZ = GetMeshBaseZ(elem);
+    outBaseZ = baseZ;
+
+    // 1) Контур
+    MeshPolyData mp = BuildContourNodes(elem, memo, baseZ);
+    if (!mp.ok || mp.contour.size() < 3) { Log("[TIN] contour build failed"); return false; }
+
+    nodes = mp.contour;
+    Log("[TIN] Contour nodes=%u before triangulation", (unsigned)nodes.size());
+    for (size_t i = 0; i < std::min(nodes.size(), (size_t)5); ++i) {
+        Log("[TIN] node[%u]=(%.3f,%.3f,%.3f)", (unsigned)i, nodes[i].x, nodes[i].y, nodes[i].z);
+    }
+    
+    tris = TriangulateEarClipping(nodes);
+    if (tris.empty()) { Log("[TIN] triangulation failed"); return false; }
+    Log("[TIN] Triangulated: %u tris", (unsigned)tris.size());
+
+    // Запоминаем границу ДО вставки level-точек
+    const int boundaryCount = (int)mp.contour.size();
+    EdgeSet constraints;
+    if (boundaryCount > 0) {
+        for (int i = 0; i < boundaryCount; ++i) constraints.insert(MkE(i, (i + 1) % boundaryCount));
+    }
+
+    // 2) Level-точки (врезка)
+    const int lvlCnt = memo.meshLevelCoords ? (int)(BMGetHandleSize((GSHandle)memo.meshLevelCoords) / sizeof(API_MeshLevelCoord)) : 0;
+    Log("[TIN] Adding level points: %d available", lvlCnt);
+    if (lvlCnt > 0) {
+        const API_MeshLevelCoord* lvl = *memo.meshLevelCoords;
+        const int maxN = std::min(lvlCnt, (int)MAX_LEVEL_POINTS);
+        auto key = [](double x, double y) { return std::pair<long long, long long>{
+            (long long)std::llround(x * 1e6), (long long)std::llround(y * 1e6)}; };
+        
+        // Сначала добавляем контурные узлы в seen
+        std::set<std::pair<long long, long long>> seen;
+        for (const auto& n : nodes) {
+            seen.insert(key(n.x, n.y));
+        }
+        
+        int inserted = 0;
+        for (int i = 0; i < maxN; ++i) {
+            if (!seen.insert(key(lvl[i].c.x, lvl[i].c.y)).second) continue;
+            const TINNode P{ lvl[i].c.x, lvl[i].c.y, baseZ + lvl[i].c.z };
+            const int triIdx = FindTriContaining(nodes, tris, P);
+            if (triIdx >= 0) {
+                const int pIdx = (int)nodes.size(); nodes.push_back(P);
+                int t0, t1, t2; SplitTriByPoint(nodes, tris, triIdx, pIdx, t0, t1, t2);
+                inserted++;
+                if (inserted <= 5) Log("[TIN] inserted level[%d]: XY=(%.3f,%.3f) rawZ=%.3f absZ=%.3f", i, lvl[i].c.x, lvl[i].c.y, lvl[i].c.z, P.z);
+            }
+        }
+        Log("[TIN] Inserted %d level points", inserted);
+        if (lvlCnt > MAX_LEVEL_POINTS) Log("[TIN] level points truncated: %d -> %d", lvlCnt, (int)MAX_LEVEL_POINTS);
+    }
+
+    // 3) CDT по границе
+    GlobalConstrainedDelaunayLegalize(nodes, tris, constraints);
+
+    return !nodes.empty() && !tris.empty();
 }
 
+// ================================================================
+// Sample Z at XY using TIN (barycentric, then vertical raycast)
+// ================================================================
+// verbose=false — без логов (вызов из рабочих потоков)
+static bool SampleZ_OnTIN(const std::vector<TINNode>& nodes, const std::vector<TINTri>& tris,
+    const API_Coord3D& posXY, double& outZ, API_Vector3D& outN, bool verbose = true)
+{
+    Perf::Add(Perf::Counter::Samples);
+    const TINNode P{ posXY.x, posXY.y, 0.0 };
+    int triHit = FindTriContaining(nodes, tris, P);
+
+    if (triHit >= 0) {
+        const TINTri& t = tris[triHit];
+        double wA, wB, wC; BaryXY(P, nodes[t.a], nodes[t.b], nodes[t.c], wA, wB, wC);
+        outZ = wA * nodes[t.a].z + wB * nodes[t.b].z + wC * nodes[t.c].z;
+        outN = TriNormal3D(nodes[t.a], nodes[t.b], nodes[t.c]);
+        
+        if (verbose)
+            Log("[SampleZ] P=(%.3f,%.3f) -> tri[%d]=%d,%d,%d weights=(%.3f,%.3f,%.3f) Z=(%.3f,%.3f,%.3f) -> %.3f",
+                P.x, P.y, triHit, t.a, t.b, t.c, wA, wB, wC,
+                nodes[t.a].z, nodes[t.b].z, nodes[t.c].z, outZ);
+        
+        return true;
+    }
+    
+    if (verbose) Log("[SampleZ] P=(%.3f,%.3f) -> NO TRIANGLE FOUND", P.x, P.y);
+
+    // вертикальный луч вниз
+    API_Coord3D orig{ posXY.x, posXY.y, 1e9 };
+    API_Vector3D dir{ 0,0,-1 };
+    double bestT = 1e100; int bestIdx = -1;
+    for (int i = 0; i < (int)tris.size(); ++i) {
+        const TINTri& t = tris[i];
+        const API_Coord3D A{ nodes[t.a].x, nodes[t.a].y, nodes[t.a].z };
+        const API_Coord3D B{ nodes[t.b].x, nodes[t.b].y, nodes[t.b].z };
+        const API_Coord3D C{ nodes[t.c].x, nodes[t.c].y, nodes[t.c].z };
+        double tp;
+        if (RayTriHit_MT(orig, dir, A, B, C, tp)) {
+            if (tp < bestT) { bestT = tp; bestIdx = i; }
+        }
+    }
+    if (bestIdx >= 0) {
+        outZ = orig.z + dir.z * bestT;
+        const TINTri& bt = tris[bestIdx];
+        outN = TriNormal3D(nodes[bt.a], nodes[bt.b], nodes[bt.c]);
+        return true;
+    }
+
+    // фолбэк: ближайшая вершина
+    double best = 1e12, bestZ = 0.0; int bestN = -1;
+    for (int i = 0;i < (int)nodes.size();++i) {
+        const double d = std::hypot(P.x - nodes[i].x, P.y - nodes[i].y);
+        if (d < best) { best = d; bestZ = nodes[i].z; bestN = i; }
+    }
+    if (bestN >= 0) { outZ = bestZ; outN = { 0,0,1 }; return true; }
+    return false;
+}
+
+// Отсечение многоугольника полуплоскостью слева от A→B (Сазерленд — Ходжмен)
+static void ClipByEdge(const std::vector<API_Coord>& in, const TINNode& A, const TINNode& B, std::vector<API_Coord>& out)
+{
+    out.clear();
+    const size_t n = in.size();
+    for (size_t i = 0; i < n; ++i) {
+        const API_Coord& P = in[i];
+        const API_Coord& Q = in[(i + 1) % n];
+        const double dp = Cross2D(A.x, A.y, B.x, B.y, P.x, P.y);
+        const double dq = Cross2D(A.x, A.y, B.x, B.y, Q.x, Q.y);
+        if (dp >= 0.0) out.push_back(P);
+        if ((dp >= 0.0) != (dq >= 0.0)) {
+            const double t = dp / (dp - dq);
+            out.push_back({ P.x + (Q.x - P.x) * t, P.y + (Q.y - P.y) * t });
+        }
+    }
+}
+
+static double PolyArea(const std::vector<API_Coord>& poly)
+{
+    double a = 0.0;
+    for (size_t i = 0, n = poly.size(); i < n; ++i) {
+        const API_Coord& p = poly[i], & q = poly[(i + 1) % n];
+        a += p.x * q.y - p.y * q.x;
+    }
+    return 0.5 * a;
+}
+
+// ================================================================
+// TerrainQuery
+// ================================================================
+static inline int TriCorner(const TINTri& t, int k) { return k == 0 ? t.a : (k == 1 ? t.b : t.c); }
+
+// Z на ребре (U,V) в точке плана — по доле проекции вдоль ребра
+static inline double ZOnEdge(const TINNode& U, const TINNode& V, double x, double y)
+{
+    const double dx = V.x - U.x, dy = V.y - U.y, l2 = dx * dx + dy * dy;
+    if (l2 < 1e-24) return U.z;
+    const double s = std::max(0.0, std::min(1.0, ((x - U.x) * dx + (y - U.y) * dy) / l2));
+    return U.z + (V.z - U.z) * s;
+}
+
+std::shared_ptr<const TerrainQuery> TerrainQuery::Build(const API_Guid& meshGuid)
+{
+    Log("[TIN] Building TIN...");
+    API_Element elem{}; elem.header.guid = meshGuid;
+    if (Perf::ElementGet(&elem) != NoError) { Log("[TIN] Element_Get(mesh) failed"); return nullptr; }
+    if (elem.header.type.typeID != API_MeshID) { Log("[TIN] not a mesh, typeID=%d", (int)elem.header.type.typeID); return nullptr; }
+
+    API_ElementMemo memo{};
+    const GSErr mErr = Perf::ElementGetMemo(meshGuid, &memo,
+        APIMemoMask_MeshLevel | APIMemoMask_Polygon | APIMemoMask_MeshPolyZ);
+    if (mErr != NoError) { Log("[TIN] GetMemo failed err=%d", (int)mErr); return nullptr; }
+
+    auto tin = std::make_shared<TerrainQuery>();
+    tin->m_meshGuid = meshGuid;
+    tin->m_modiStamp = elem.header.modiStamp;
+
+    bool okTIN = false;
+    {
+        Perf::ScopedTimer timer(Perf::Timer::TinBuild);
+        double baseZ = 0.0;
+        okTIN = BuildTIN_FromMemo(elem, memo, tin->m_nodes, tin->m_tris, baseZ);
+        if (okTIN) tin->BuildIndex();
+    }
+    Perf::Add(Perf::Counter::TinBuilds);
+    ACAPI_DisposeElemMemoHdls(&memo);
+    if (!okTIN) { Log("[TIN] BuildTIN failed"); return nullptr; }
+
+    Log("[TIN] Built: %u nodes, %u tris, grid %dx%d", (unsigned)tin->m_nodes.size(), (unsigned)tin->m_tris.size(), tin->m_nx, tin->m_ny);
+    return tin;
+}
+
+void TerrainQuery::CellRange(double x0, double y0, double x1, double y1, int& i0, int& j0, int& i1, int& j1) const
+{
+    auto clampI = [](double v, int n) { return std::max(0, std::min(n - 1, (int)std::floor(v))); };
+    i0 = clampI((x0 - m_minX) / m_cell, m_nx); i1 = clampI((x1 - m_minX) / m_cell, m_nx);
+    j0 = clampI((y0 - m_minY) / m_cell, m_ny); j1 = clampI((y1 - m_minY) / m_cell, m_ny);
+}
+
+void TerrainQuery::BuildIndex()
+{
+    if (m_tris.empty()) return;
+    double maxX = -1e300, maxY = -1e300;
+    m_minX = m_minY = 1e300;
+    for (const Node& n : m_nodes) {
+        m_minX = std::min(m_minX, n.x); maxX = std::max(maxX, n.x);
+        m_minY = std::min(m_minY, n.y); maxY = std::max(maxY, n.y);
+    }
+    // ~2 треугольника на ячейку, не больше 1024 ячеек по стороне
+    const double w = std::max(maxX - m_minX, 1e-6), h = std::max(maxY - m_minY, 1e-6);
+    m_cell = std::max(std::sqrt(w * h / (double)m_tris.size()) * 1.5, std::max(w, h) / 1024.0);
+    m_nx = (int)std::ceil(w / m_cell) + 1;
+    m_ny = (int)std::ceil(h / m_cell) + 1;
+    m_cells.assign((size_t)m_nx * m_ny, std::vector<int>());
+    for (int ti = 0; ti < (int)m_tris.size(); ++ti) {
+        const Node& A = m_nodes[m_tris[ti].a], & B = m_nodes[m_tris[ti].b], & C = m_nodes[m_tris[ti].c];
+        int i0, j0, i1, j1;
+        CellRange(std::min({ A.x, B.x, C.x }), std::min({ A.y, B.y, C.y }),
+                  std::max({ A.x, B.x, C.x }), std::max({ A.y, B.y, C.y }), i0, j0, i1, j1);
+        for (int j = j0; j <= j1; ++j)
+            for (int i = i0; i <= i1; ++i) m_cells[(size_t)j * m_nx + i].push_back(ti);
+    }
+
+    // соседи через рёбра: ребро ищет пару по ключу (меньшая вершина, большая)
+    m_adj.assign(m_tris.size() * 3, -1);
+    std::unordered_map<UInt64, int> open;
+    open.reserve(m_tris.size() * 2);
+    for (int ti = 0; ti < (int)m_tris.size(); ++ti) {
+        for (int k = 0; k < 3; ++k) {
+            const int u = TriCorner(m_tris[ti], k), v = TriCorner(m_tris[ti], (k + 1) % 3);
+            const UInt64 key = ((UInt64)(UInt32)std::min(u, v) << 32) | (UInt64)(UInt32)std::max(u, v);
+            auto it = open.find(key);
+            if (it == open.end()) { open.emplace(key, ti * 3 + k); continue; }
+            m_adj[(size_t)ti * 3 + k] = it->second / 3;
+            m_adj[(size_t)it->second] = ti;
+            open.erase(it);
+        }
+    }
+}
+
+void TerrainQuery::Candidates(double x0, double y0, double x1, double y1, std::vector<int>& out) const
+{
+    out.clear();
+    if (m_cells.empty()) return;
+    int i0, j0, i1, j1;
+    CellRange(x0, y0, x1, y1, i0, j0, i1, j1);
+    if (i0 == i1 && j0 == j1) {
+        const std::vector<int>& c = m_cells[(size_t)j0 * m_nx + i0];
+        out.assign(c.begin(), c.end());
+        return;
+    }
+    for (int j = j0; j <= j1; ++j)
+        for (int i = i0; i <= i1; ++i) {
+            const std::vector<int>& c = m_cells[(size_t)j * m_nx + i];
+            out.insert(out.end(), c.begin(), c.end());
+        }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+// Треугольник, содержащий точку, по ячейке индекса; -1 — вне TIN
+int TerrainQuery::FindTri(double x, double y) const
+{
+    if (m_cells.empty() || x < m_minX || y < m_minY) return -1;
+    const int i = (int)std::floor((x - m_minX) / m_cell);
+    const int j = (int)std::floor((y - m_minY) / m_cell);
+    if (i >= m_nx || j >= m_ny) return -1;
+
+    constexpr double EPS = 1e-12;
+    for (int ti : m_cells[(size_t)j * m_nx + i]) {
+        const Tri& t = m_tris[ti];
+        const Node& A = m_nodes[t.a], & B = m_nodes[t.b], & C = m_nodes[t.c];
+        const bool outside =
+            (Cross2D(A.x, A.y, B.x, B.y, x, y) < -EPS) ||
+            (Cross2D(B.x, B.y, C.x, C.y, x, y) < -EPS) ||
+            (Cross2D(C.x, C.y, A.x, A.y, x, y) < -EPS);
+        if (!outside) return ti;
+    }
+    return -1;
+}
+
+bool TerrainQuery::ZAndNormal(double x, double y, double& outZ, API_Vector3D& outNormal) const
+{
+    outZ = 0.0; outNormal = { 0,0,1 };
+    const int ti = FindTri(x, y);
+    if (ti < 0) // вне индекса — прежний путь: луч и ближайшая вершина
+        return SampleZ_OnTIN(m_nodes, m_tris, { x, y, 0.0 }, outZ, outNormal, false);
+
+    Perf::Add(Perf::Counter::Samples);
+    const Tri& t = m_tris[ti];
+    double wA, wB, wC; BaryXY({ x, y, 0.0 }, m_nodes[t.a], m_nodes[t.b], m_nodes[t.c], wA, wB, wC);
+    outZ = wA * m_nodes[t.a].z + wB * m_nodes[t.b].z + wC * m_nodes[t.c].z;
+    outNormal = TriNormal3D(m_nodes[t.a], m_nodes[t.b], m_nodes[t.c]);
+    return true;
+}
+
+bool TerrainQuery::FootprintNormal(const std::vector<API_Coord>& footprint, API_Vector3D& outNormal) const
+{
+    outNormal = { 0,0,1 };
+    if (footprint.empty() || m_tris.empty()) return false;
+
+    double x0 = 1e300, y0 = 1e300, x1 = -1e300, y1 = -1e300, cx = 0.0, cy = 0.0;
+    for (const API_Coord& c : footprint) {
+        x0 = std::min(x0, c.x); x1 = std::max(x1, c.x);
+        y0 = std::min(y0, c.y); y1 = std::max(y1, c.y);
+        cx += c.x; cy += c.y;
+    }
+    cx /= (double)footprint.size();
+    cy /= (double)footprint.size();
+
+    std::vector<API_Coord> subject(footprint);
+    const double area = PolyArea(subject);
+    if (area < 0.0) std::reverse(subject.begin(), subject.end());
+
+    // сумма нормалей треугольников с весом — площадью их пересечения с основанием
+    API_Vector3D sum{ 0,0,0 };
+    double weight = 0.0;
+    if (std::fabs(area) > 1e-12) {
+        std::vector<int> cand;
+        Candidates(x0, y0, x1, y1, cand);
+        std::vector<API_Coord> a, b;
+        for (int ti : cand) {
+            const Tri& t = m_tris[ti];
+            const Node& A = m_nodes[t.a], & B = m_nodes[t.b], & C = m_nodes[t.c];
+            if (std::max({ A.x, B.x, C.x }) < x0 || std::min({ A.x, B.x, C.x }) > x1 ||
+                std::max({ A.y, B.y, C.y }) < y0 || std::min({ A.y, B.y, C.y }) > y1) continue;
+
+            ClipByEdge(subject, A, B, a);
+            if (a.size() >= 3) ClipByEdge(a, B, C, b); else continue;
+            if (b.size() >= 3) ClipByEdge(b, C, A, a); else continue;
+            const double w = (a.size() >= 3) ? PolyArea(a) : 0.0;
+            if (w <= 0.0) continue;
+
+            const API_Vector3D n = TriNormal3D(A, B, C);
+            sum.x += n.x * w; sum.y += n.y * w; sum.z += n.z * w;
+            weight += w;
+        }
+    }
+    if (weight > 1e-12) {
+        Normalize(sum);
+        outNormal = sum;
+        return true;
+    }
+
+    double z = 0.0;
+    return ZAndNormal(cx, cy, z, outNormal);
+}
+
+double TerrainQuery::ZInTri(int ti, double x, double y) const
+{
+    const Tri& t = m_tris[ti];
+    double wA, wB, wC; BaryXY({ x, y, 0.0 }, m_nodes[t.a], m_nodes[t.b], m_nodes[t.c], wA, wB, wC);
+    return wA * m_nodes[t.a].z + wB * m_nodes[t.b].z + wC * m_nodes[t.c].z;
+}
+
+// Отрезок p + t·d, t ∈ [tIn, tOut], отсечь треугольником ti (Cyrus–Beck по трём рёбрам).
+// exitEdge — ребро k (вершины k, k+1), через которое отрезок выходит раньше tOut, иначе -1;
+// false — отрезок треугольник не задевает
+bool TerrainQuery::ClipToTri(int ti, const API_Coord& p, const API_Coord& d, double& tIn, double& tOut, int& exitEdge) const
+{
+    constexpr double EPS = 1e-12;
+    exitEdge = -1;
+    const Tri& t = m_tris[ti];
+    for (int k = 0; k < 3; ++k) {
+        const Node& U = m_nodes[TriCorner(t, k)], & V = m_nodes[TriCorner(t, (k + 1) % 3)];
+        // f(t) = f0 + t·fd ≥ 0 — слева от ребра, т.е. внутри (обход против часовой)
+        const double f0 = Cross2D(U.x, U.y, V.x, V.y, p.x, p.y);
+        const double fd = (V.x - U.x) * d.y - (V.y - U.y) * d.x;
+        if (std::fabs(fd) < 1e-300) {
+            if (f0 < -EPS) return false;
+            continue;
+        }
+        const double tk = -f0 / fd;
+        if (fd > 0.0) { if (tk > tIn) tIn = tk; }
+        else if (tk < tOut) { tOut = tk; exitEdge = k; }
+    }
+    return tIn <= tOut;
+}
+
+// Треугольник, в который отрезок входит первым после t (идём вне TIN); -1 — больше не входит.
+// Перебор кандидатов по bbox остатка отрезка — только на участках вне TIN
+int TerrainQuery::EnterTri(const API_Coord& p, const API_Coord& d, double t, double tEps, double& tEnter) const
+{
+    const double x0 = p.x + d.x * t, y0 = p.y + d.y * t, x1 = p.x + d.x, y1 = p.y + d.y;
+    std::vector<int> cand;
+    Candidates(std::min(x0, x1), std::min(y0, y1), std::max(x0, x1), std::max(y0, y1), cand);
+    int best = -1;
+    tEnter = 2.0;
+    for (int ti : cand) {
+        double tIn = t, tOut = 1.0; int k;
+        if (!ClipToTri(ti, p, d, tIn, tOut, k) || tOut <= t + tEps) continue;
+        if (tIn < tEnter) { tEnter = tIn; best = ti; }
+    }
+    return best;
+}
+
+bool TerrainQuery::Drape(const std::vector<API_Coord>& line, std::vector<API_Coord3D>& out) const
+{
+    out.clear();
+    if (line.size() < 2 || m_tris.empty()) return false;
+
+    auto push = [&out](double x, double y, double z) {
+        if (!out.empty() && std::fabs(out.back().x - x) < 1e-9 && std::fabs(out.back().y - y) < 1e-9) return;
+        out.push_back({ x, y, z });
+    };
+    auto zOutside = [this](double x, double y) {
+        double z = 0.0; API_Vector3D n;
+        ZAndNormal(x, y, z, n);
+        return z;
+    };
+
+    int cur = FindTri(line[0].x, line[0].y);
+    push(line[0].x, line[0].y, cur >= 0 ? ZInTri(cur, line[0].x, line[0].y) : zOutside(line[0].x, line[0].y));
+
+    const size_t maxSteps = m_tris.size() * 4 + 16;
+    for (size_t i = 1; i < line.size(); ++i) {
+        const API_Coord& p = line[i - 1], & q = line[i];
+        const API_Coord d = { q.x - p.x, q.y - p.y };
+        const double len = std::sqrt(d.x * d.x + d.y * d.y);
+        if (len < 1e-9) continue;
+        const double tEps = 1e-9 / len;
+
+        double t = 0.0;
+        int stalled = 0;
+        size_t step = 0;
+        for (; step < maxSteps && t < 1.0 - tEps; ++step) {
+            if (cur < 0) {
+                // вне TIN: прямо до точки входа, если отрезок ещё заходит на TIN
+                double tEnter = 0.0;
+                cur = EnterTri(p, d, t, tEps, tEnter);
+                if (cur < 0) break;
+                if (tEnter > t) {
+                    t = tEnter;
+                    push(p.x + d.x * t, p.y + d.y * t, ZInTri(cur, p.x + d.x * t, p.y + d.y * t));
+                }
+                continue;
+            }
+
+            double tIn = t, tOut = 1.0; int k = -1;
+            const bool hit = ClipToTri(cur, p, d, tIn, tOut, k);
+            if (hit && (k < 0 || tOut >= 1.0 - tEps)) break;   // конец отрезка в этом треугольнике
+
+            if (!hit || stalled >= 2) {
+                // топчемся у вершины (отрезок проходит через неё) — найти треугольник чуть впереди
+                const double ta = std::min(1.0, t + 1e-7 / len);
+                cur = FindTri(p.x + d.x * ta, p.y + d.y * ta);
+                stalled = 0;
+                continue;
+            }
+
+            if (tOut > t + tEps) {
+                t = tOut;
+                stalled = 0;
+                const Tri& tri = m_tris[cur];
+                const double x = p.x + d.x * t, y = p.y + d.y * t;
+                push(x, y, ZOnEdge(m_nodes[TriCorner(tri, k)], m_nodes[TriCorner(tri, (k + 1) % 3)], x, y));
+            }
+            else {
+                ++stalled;
+            }
+            cur = m_adj[(size_t)cur * 3 + k];
+        }
+
+        // обход не дошёл до конца за maxSteps — cur может быть чужим треугольником
+        if (step >= maxSteps) cur = FindTri(q.x, q.y);
+        push(q.x, q.y, cur >= 0 ? ZInTri(cur, q.x, q.y) : zOutside(q.x, q.y));
+    }
+    return out.size() >= 2;
+}
+
+// ================================================================
+// Registry (главный поток)
+// ================================================================
+struct CachedTIN {
+    std::shared_ptr<const TerrainQuery> tin;
+    UInt64                              lastUse = 0;
+};
+
+static std::vector<CachedTIN> g_tins;
+static UInt64                 g_useCounter = 0;
+
+std::shared_ptr<const TerrainQuery> MeshIntersectionHelper::Acquire(const API_Guid& meshGuid)
+{
+    if (meshGuid == APINULLGuid) return nullptr;
+
+    // изменения mesh видны по modiStamp заголовка — дешевле, чем перечитывать memo
+    API_Elem_Head head{}; head.guid = meshGuid;
+    if (ACAPI_Element_GetHeader(&head) != NoError) return nullptr;
+
+    for (auto it = g_tins.begin(); it != g_tins.end(); ++it) {
+        if (it->tin->MeshGuid() != meshGuid) continue;
+        if (it->tin->ModiStamp() == head.modiStamp) {
+            it->lastUse = ++g_useCounter;
+            return it->tin;
+        }
+        g_tins.erase(it); // mesh изменился — держатели старого объекта дорабатывают с ним
+        break;
+    }
+
+    std::shared_ptr<const TerrainQuery> tin = TerrainQuery::Build(meshGuid);
+    if (tin == nullptr) return nullptr;
+
+    if (g_tins.size() >= MAX_CACHED_TINS) {
+        g_tins.erase(std::min_element(g_tins.begin(), g_tins.end(),
+            [](const CachedTIN& a, const CachedTIN& b) { return a.lastUse < b.lastUse; }));
+    }
+    g_tins.push_back({ tin, ++g_useCounter });
+    return tin;
+}
+
+void MeshIntersectionHelper::ClearCache()
+{
+    g_tins.clear();
+}
+
+bool MeshIntersectionHelper::GetZAndNormal(const API_Guid& meshGuid, const API_Coord& xy, double& outZ, API_Vector3D& outNormal)
+{
+    const std::shared_ptr<const TerrainQuery> tin = Acquire(meshGuid);
+    if (tin == nullptr) return false;
+    return tin->ZAndNormal(xy.x, xy.y, outZ, outNormal);
+}
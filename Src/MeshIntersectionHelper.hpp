@@ -2,20 +2,100 @@
 #define MESHINTERSECTIONHELPER_HPP
 
 #include "APIdefs_3D.h"
+#include "APIdefs_Elements.h"
+#include "API_Guid.hpp"
+
+#include <memory>
+#include <vector>
+
+// ============================================================================
+// TerrainQuery — построенный TIN mesh (контур + level-точки, CDT) с сеточным индексом
+// треугольников. После построения не меняется: все запросы const, без ACAPI и логов,
+// поэтому один объект можно одновременно опрашивать из разных инструментов и потоков.
+// ============================================================================
+class TerrainQuery {
+public:
+    struct Node { double x, y, z; };  // абсолютные координаты
+    struct Tri  { int a, b, c; };     // индексы Node, против часовой стрелки в плане
+
+    // Построить TIN по mesh (только главный поток); nullptr — не mesh или TIN не построился
+    static std::shared_ptr<const TerrainQuery> Build(const API_Guid& meshGuid);
+
+    // Z и нормаль (единичная, вверх) в точке плана. Вне TIN — луч по всем треугольникам,
+    // затем ближайшая вершина; false — TIN пуст
+    bool ZAndNormal(double x, double y, double& outZ, API_Vector3D& outNormal) const;
+
+    // Нормаль, усреднённая по площади пересечения основания (многоугольник в плане) с треугольниками.
+    // Вырожденное основание или основание вне TIN — нормаль в его центре
+    bool FootprintNormal(const std::vector<API_Coord>& footprint, API_Vector3D& outNormal) const;
+
+    // Ломаная плана, уложенная на TIN: к её вершинам добавляется точка на каждом пересечении
+    // с ребром треугольника (обход по соседним треугольникам, без передискретизации), поэтому
+    // линия точно повторяет поверхность. Участки вне TIN — прямые между точками с Z как у
+    // ZAndNormal; false — TIN пуст или в ломаной меньше двух точек
+    bool Drape(const std::vector<API_Coord>& line, std::vector<API_Coord3D>& out) const;
+
+    // Треугольники, чей bbox-индекс задевает прямоугольник (без повторов)
+    void Candidates(double x0, double y0, double x1, double y1, std::vector<int>& out) const;
+
+    const API_Guid&          MeshGuid () const { return m_meshGuid; }
+    UInt64                   ModiStamp () const { return m_modiStamp; }
+    const std::vector<Node>& Nodes () const { return m_nodes; }
+    const std::vector<Tri>&  Tris () const { return m_tris; }
+
+private:
+    void BuildIndex ();
+    void CellRange (double x0, double y0, double x1, double y1, int& i0, int& j0, int& i1, int& j1) const;
+    int  FindTri (double x, double y) const;
+    double ZInTri (int ti, double x, double y) const;
+    bool ClipToTri (int ti, const API_Coord& p, const API_Coord& d, double& tIn, double& tOut, int& exitEdge) const;
+    int  EnterTri (const API_Coord& p, const API_Coord& d, double t, double tEps, double& tEnter) const;
+
+    API_Guid          m_meshGuid = APINULLGuid;
+    UInt64            m_modiStamp = 0;
+    std::vector<Node> m_nodes;
+    std::vector<Tri>  m_tris;
+
+    double m_minX = 0.0, m_minY = 0.0, m_cell = 1.0;
+    int    m_nx = 0, m_ny = 0;
+    std::vector<std::vector<int>> m_cells;  // ячейка → треугольники, задевающие её
+    std::vector<int> m_adj;                 // 3 на треугольник: сосед через ребро (a,b), (b,c), (c,a); -1 — край TIN
+};
+
+// ============================================================================
+// StoryLevels — отметки этажей, читаются один раз при создании (только главный поток).
+// Общее правило для абсолютных Z: TIN mesh и элементы, которые на него ставятся,
+// считают уровень этажа одинаково, включая подземные этажи
+// ============================================================================
+class StoryLevels {
+public:
+    StoryLevels ();
+
+    // Отметка этажа floorInd; неизвестный этаж — 0
+    double Get (short floorInd) const;
+
+private:
+    short               m_first = 0;
+    std::vector<double> m_levels;
+};
 
 // ============================================================================
 // MeshIntersectionHelper — пересечение с Mesh поверхностью через TIN
-// Получает Z координату и нормаль поверхности по координатам XY
+// Общий реестр TerrainQuery по GUID mesh: пока mesh не изменился (modiStamp), все инструменты
+// получают один и тот же построенный объект; глобальная «текущая поверхность» не нужна.
 // ============================================================================
 class MeshIntersectionHelper {
 public:
-    // Получить Z координату и нормаль поверхности в точке
-    // xy: входная точка с координатами XY (z игнорируется)
-    // outZ: выходная абсолютная Z координата поверхности
-    // outNormal: выходная нормаль поверхности в точке (единичный вектор)
-    // Возвращает true если пересечение найдено
-    static bool GetZAndNormal(const API_Coord& xy, double& outZ, API_Vector3D& outNormal);
+    // TIN для mesh из реестра или новый (только главный поток). Результат можно держать
+    // и передавать в рабочие потоки; nullptr — не mesh или TIN не построился
+    static std::shared_ptr<const TerrainQuery> Acquire(const API_Guid& meshGuid);
+
+    // Забыть построенные TIN (уже выданные объекты продолжают работать)
+    static void ClearCache();
+
+    // Получить Z координату и нормаль поверхности mesh в точке плана (только главный поток)
+    // outZ: абсолютная Z, outNormal: единичная нормаль. Возвращает true если точка найдена
+    static bool GetZAndNormal(const API_Guid& meshGuid, const API_Coord& xy, double& outZ, API_Vector3D& outNormal);
 };
 
 #endif // MESHINTERSECTIONHELPER_HPP
-
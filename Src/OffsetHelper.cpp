@@ -0,0 +1,362 @@
+// ============================================================================
+// OffsetHelper.cpp — эквидистанты пути (отрезки + дуги), стыки miter/round,
+// лента как объединение кусков (PolygonHelper)
+// ============================================================================
+
+#include "OffsetHelper.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace OffsetHelper {
+
+namespace {
+
+constexpr double kPI   = 3.14159265358979323846;
+constexpr double kEps  = 1e-12;
+constexpr double kSnap = 1e-7;   // м: встречный сектор уже этого не строится
+
+// ------------------ Векторная арифметика ------------------
+inline API_Coord Sub (const API_Coord& a, const API_Coord& b) { return { a.x - b.x, a.y - b.y }; }
+inline double    Dot (const API_Coord& a, const API_Coord& b) { return a.x * b.x + a.y * b.y; }
+inline double    Cross (const API_Coord& a, const API_Coord& b) { return a.x * b.y - a.y * b.x; }
+inline double    Len (const API_Coord& a) { return std::sqrt(a.x * a.x + a.y * a.y); }
+inline API_Coord Off (const API_Coord& p, const API_Coord& n, double k) { return { p.x + n.x * k, p.y + n.y * k }; }
+inline API_Coord LeftN (const API_Coord& t) { return { -t.y, t.x }; }
+inline API_Coord ArcPt (const API_Coord& c, double r, double ang) { return { c.x + r * std::cos(ang), c.y + r * std::sin(ang) }; }
+
+inline bool Near (const API_Coord& a, const API_Coord& b, double tol)
+{
+    return std::fabs(a.x - b.x) <= tol && std::fabs(a.y - b.y) <= tol;
+}
+
+inline API_Coord Unit (const API_Coord& v)
+{
+    const double l = Len(v);
+    return (l < kEps) ? API_Coord{ 1.0, 0.0 } : API_Coord{ v.x / l, v.y / l };
+}
+
+// Касательные (единичные) в начале и в конце сегмента
+API_Coord StartTan (const Segment& s)
+{
+    if (!s.isArc) return Unit(Sub(s.b, s.a));
+    const double sg = (s.sweep >= 0.0) ? 1.0 : -1.0;
+    return { -std::sin(s.a0) * sg, std::cos(s.a0) * sg };
+}
+
+API_Coord EndTan (const Segment& s)
+{
+    if (!s.isArc) return Unit(Sub(s.b, s.a));
+    const double sg = (s.sweep >= 0.0) ? 1.0 : -1.0;
+    const double a1 = s.a0 + s.sweep;
+    return { -std::sin(a1) * sg, std::cos(a1) * sg };
+}
+
+// Точки дуги i = from..n (радиус может быть отрицательным — тогда по другую сторону центра)
+void PushArc (std::vector<API_Coord>& out, const API_Coord& c, double r, double a0, double sweep, int n, int from)
+{
+    for (int i = from; i <= n; ++i)
+        out.push_back(ArcPt(c, r, a0 + sweep * (double)i / (double)n));
+}
+
+// ------------------ Стык двух сегментов ------------------
+// Внешняя сторона поворота s (±1 — множитель левой нормали), угол поворота phi.
+// Одинаково считается для кусков ленты и для кромок, чтобы точки совпадали побитно
+struct JoinInfo {
+    bool      needed = false;
+    API_Coord P{}, n0{}, n1{};
+    double    s = 1.0, phi = 0.0;
+};
+
+JoinInfo MakeJoin (const Segment& s0, const Segment& s1)
+{
+    JoinInfo j;
+    if (!Near(s0.b, s1.a, 1e-6)) return j;         // разрыв — стыка нет
+    const API_Coord t0 = EndTan(s0), t1 = StartTan(s1);
+    const double cr = Cross(t0, t1), dt = Dot(t0, t1);
+    if (std::fabs(cr) < 1e-9 && dt > 0.0) return j; // продолжение по прямой
+    j.needed = true;
+    j.P = s0.b;
+    j.n0 = LeftN(t0);
+    j.n1 = LeftN(t1);
+    j.s = (cr > 0.0) ? -1.0 : 1.0;                  // поворот влево — внешняя сторона справа
+    j.phi = std::atan2(cr, dt);
+    if (std::fabs(cr) < 1e-9) j.phi = (j.s > 0.0) ? kPI : -kPI; // разворот на 180°
+    return j;
+}
+
+// Внешняя кромка стыка на расстоянии dd = s·h: точки после E до S включительно
+void PushJoinOuter (std::vector<API_Coord>& out, const JoinInfo& j, double dd, const Options& opt)
+{
+    const double h = std::fabs(dd);
+    const API_Coord E = Off(j.P, j.n0, dd);
+    const API_Coord S = Off(j.P, j.n1, dd);
+    if (opt.join == Join::Round) {
+        const double a0 = std::atan2(E.y - j.P.y, E.x - j.P.x);
+        const int n = PolygonHelper::ArcSegments(h, j.phi, opt.tolerance);
+        PushArc(out, j.P, h, a0, j.phi, n, 1);
+        out.back() = S;
+        return;
+    }
+    const double denom = 1.0 + Dot(j.n0, j.n1);
+    if (denom > 1e-9) {
+        const double k = dd / denom;
+        const API_Coord M = { j.P.x + (j.n0.x + j.n1.x) * k, j.P.y + (j.n0.y + j.n1.y) * k };
+        if (Len(Sub(M, j.P)) <= opt.miterLimit * h)
+            out.push_back(M);
+    }
+    out.push_back(S);   // срез не поместился в предел — скос E → S
+}
+
+// ------------------ Куски ленты ------------------
+// Кусок без самопересечений; вырожденный клин (почти прямой стык) не нужен
+void AddPiece (GS::Array<Polygon>& pieces, const std::vector<API_Coord>& pts)
+{
+    if (pts.size() < 3) return;
+    double area = 0.0;
+    for (size_t i = 0; i < pts.size(); ++i)
+        area += Cross(pts[i], pts[(i + 1) % pts.size()]) * 0.5;
+    if (std::fabs(area) <= 1e-14) return;
+    Polygon poly;
+    for (const API_Coord& p : pts) poly.outer.Push(p);
+    pieces.Push(poly);
+}
+
+// Замкнут, если конец совпал с началом и контур что-то охватывает:
+// линия «туда-обратно» тоже возвращается в начало, но петлёй не является
+bool IsClosed (const Path& path)
+{
+    if (path.GetSize() < 2 || !Near(path[path.GetSize() - 1].b, path[0].a, 1e-6))
+        return false;
+    double area = 0.0;
+    for (const Segment& s : path) {
+        area += Cross(s.a, s.b) * 0.5;
+        if (s.isArc)
+            area += 0.5 * s.r * s.r * (s.sweep - std::sin(s.sweep));   // сегмент между хордой и дугой
+    }
+    return std::fabs(area) > 1e-12;
+}
+
+// Douglas–Peucker по точкам pts[i0..i1]: keep[i] — точка остаётся
+void SimplifyRun (const std::vector<API_Coord>& pts, size_t i0, size_t i1, double tol, std::vector<bool>& keep)
+{
+    std::vector<std::pair<size_t, size_t>> stack = { { i0, i1 } };
+    while (!stack.empty()) {
+        const size_t a = stack.back().first, b = stack.back().second;
+        stack.pop_back();
+        if (b <= a + 1) continue;
+        const API_Coord ab = Sub(pts[b], pts[a]);
+        const double l = Len(ab);
+        double worst = -1.0;
+        size_t wi = a;
+        for (size_t i = a + 1; i < b; ++i) {
+            const API_Coord ap = Sub(pts[i], pts[a]);
+            const double dist = (l < kEps) ? Len(ap) : std::fabs(Cross(ab, ap)) / l;
+            if (dist > worst) { worst = dist; wi = i; }
+        }
+        if (worst > tol) {
+            keep[wi] = true;
+            stack.push_back({ a, wi });
+            stack.push_back({ wi, b });
+        }
+    }
+}
+
+// Густые ломаные (сплайны, полилинии из тысяч точек) дают тысячи почти коллинеарных кусков,
+// которые перекрываются по всей ширине ленты. Подряд идущие отрезки прореживаются
+// в пределах четверти допуска; дуги не трогаются
+Path Simplify (const Path& path, double tol)
+{
+    Path res;
+    const UIndex n = path.GetSize();
+    UIndex i = 0;
+    while (i < n) {
+        if (path[i].isArc) { res.Push(path[i++]); continue; }
+        std::vector<API_Coord> pts = { path[i].a, path[i].b };
+        UIndex j = i + 1;
+        while (j < n && !path[j].isArc && Near(path[j].a, pts.back(), 1e-9))
+            pts.push_back(path[j++].b);
+        std::vector<bool> keep(pts.size(), false);
+        keep.front() = keep.back() = true;
+        SimplifyRun(pts, 0, pts.size() - 1, tol, keep);
+        size_t last = 0;
+        for (size_t k = 1; k < pts.size(); ++k)
+            if (keep[k]) { AddLine(res, pts[last], pts[k]); last = k; }
+        i = j;
+    }
+    return res;
+}
+
+// Сегмент × [-h, h] и внешние клинья стыков; лента = объединение этих кусков
+void BuildPieces (const Path& path, double h, const Options& opt, GS::Array<Polygon>& pieces)
+{
+    const UIndex n = path.GetSize();
+    std::vector<API_Coord> pts;
+    for (UIndex i = 0; i < n; ++i) {
+        const Segment& s = path[i];
+        if (!s.isArc) {
+            const API_Coord nl = LeftN(Unit(Sub(s.b, s.a)));
+            AddPiece(pieces, { Off(s.a, nl, h), Off(s.b, nl, h), Off(s.b, nl, -h), Off(s.a, nl, -h) });
+        } else {
+            const int steps = PolygonHelper::ArcSegments(s.r + h, s.sweep, opt.tolerance);
+            if (s.r >= h) {
+                // Кольцевой сектор: внешняя дуга вперёд, внутренняя назад
+                pts.clear();
+                PushArc(pts, s.c, s.r + h, s.a0, s.sweep, steps, 0);
+                for (int k = steps; k >= 0; --k)
+                    pts.push_back(ArcPt(s.c, s.r - h, s.a0 + s.sweep * (double)k / (double)steps));
+                AddPiece(pieces, pts);
+            } else {
+                // Радиус меньше полуширины: сектор радиуса r+h и встречный сектор радиуса h-r
+                pts.assign(1, s.c);
+                PushArc(pts, s.c, s.r + h, s.a0, s.sweep, steps, 0);
+                AddPiece(pieces, pts);
+                if (h - s.r > kSnap) {
+                    pts.assign(1, s.c);
+                    PushArc(pts, s.c, s.r - h, s.a0, s.sweep, steps, 0);
+                    AddPiece(pieces, pts);
+                }
+            }
+        }
+    }
+
+    const UIndex nj = IsClosed(path) ? n : (n > 0 ? n - 1 : 0);
+    for (UIndex i = 0; i < nj; ++i) {
+        const JoinInfo j = MakeJoin(path[i], path[(i + 1) % n]);
+        if (!j.needed) continue;
+        const double dd = j.s * h;
+        pts.clear();
+        pts.push_back(j.P);
+        pts.push_back(Off(j.P, j.n0, dd));
+        PushJoinOuter(pts, j, dd, opt);
+        AddPiece(pieces, pts);
+    }
+}
+
+// Сырая кромка на d: смещённые сегменты, на внешних сторонах стыков — miter/round,
+// на внутренних — прямая перемычка (её и петли потом срежет классификация)
+void BuildRawSide (const Path& path, double d, const Options& opt, std::vector<API_Coord>& out)
+{
+    const UIndex n = path.GetSize();
+    const double h = std::fabs(d);
+    for (UIndex i = 0; i < n; ++i) {
+        const Segment& s = path[i];
+        if (!s.isArc) {
+            const API_Coord nl = LeftN(Unit(Sub(s.b, s.a)));
+            out.push_back(Off(s.a, nl, d));
+            out.push_back(Off(s.b, nl, d));
+        } else {
+            const double sg = (s.sweep >= 0.0) ? 1.0 : -1.0;
+            const int steps = PolygonHelper::ArcSegments(s.r + h, s.sweep, opt.tolerance);
+            PushArc(out, s.c, s.r - d * sg, s.a0, s.sweep, steps, 0);
+        }
+        if (i + 1 < n || IsClosed(path)) {
+            const JoinInfo j = MakeJoin(s, path[(i + 1) % n]);
+            if (j.needed && j.s * d > 0.0)
+                PushJoinOuter(out, j, d, opt);
+        }
+    }
+}
+
+} // namespace
+
+// ================================================================
+// Построение пути
+// ================================================================
+void AddLine (Path& path, const API_Coord& a, const API_Coord& b)
+{
+    if (Near(a, b, 1e-9)) return;
+    Segment s;
+    s.a = a;
+    s.b = b;
+    path.Push(s);
+}
+
+void AddArc (Path& path, const API_Coord& c, double r, double a0, double sweep)
+{
+    if (r < 1e-9 || std::fabs(sweep) < 1e-9) return;
+    Segment s;
+    s.isArc = true;
+    s.c = c;
+    s.r = r;
+    s.a0 = a0;
+    s.sweep = sweep;
+    s.a = ArcPt(c, r, a0);
+    s.b = ArcPt(c, r, a0 + sweep);
+    path.Push(s);
+}
+
+void AddPolylineArc (Path& path, const API_Coord& a, const API_Coord& b, double arcAngle)
+{
+    const double chord = Len(Sub(b, a));
+    if (chord < 1e-9) return;
+    if (std::fabs(arcAngle) < 1e-9) { AddLine(path, a, b); return; }
+
+    // Центр на серединном перпендикуляре: слева от хорды для дуги против часовой
+    const double r = chord / (2.0 * std::sin(std::fabs(arcAngle) / 2.0));
+    const double h = chord / (2.0 * std::tan(arcAngle / 2.0));
+    const API_Coord m = { (a.x + b.x) * 0.5, (a.y + b.y) * 0.5 };
+    const API_Coord nl = LeftN(Unit(Sub(b, a)));
+    const API_Coord c = Off(m, nl, h);
+
+    const size_t before = path.GetSize();
+    AddArc(path, c, r, std::atan2(a.y - c.y, a.x - c.x), arcAngle);
+    if (path.GetSize() > before) {
+        path[path.GetSize() - 1].a = a;   // концы — ровно точки полилинии
+        path[path.GetSize() - 1].b = b;
+    }
+}
+
+void AddPoints (Path& path, const GS::Array<API_Coord>& pts)
+{
+    for (UIndex i = 1; i < pts.GetSize(); ++i)
+        AddLine(path, pts[i - 1], pts[i]);
+}
+
+void Flatten (const Path& path, GS::Array<API_Coord>& pts, double tolerance)
+{
+    pts.Clear();
+    for (UIndex i = 0; i < path.GetSize(); ++i) {
+        const Segment& s = path[i];
+        if (pts.IsEmpty() || !Near(pts[pts.GetSize() - 1], s.a, 1e-9)) pts.Push(s.a);
+        if (!s.isArc) { pts.Push(s.b); continue; }
+        PolygonHelper::AppendArc(pts, s.c, s.r, s.a0, s.sweep, tolerance);
+        pts[pts.GetSize() - 1] = s.b;
+    }
+}
+
+// ================================================================
+// Эквидистанта одной стороны
+// ================================================================
+bool OffsetSide (const Path& path, double d, GS::Array<GS::Array<API_Coord>>& runs, const Options& opt)
+{
+    runs.Clear();
+    if (path.IsEmpty() || std::fabs(d) < 1e-9) return false;
+
+    const Path simple = Simplify(path, opt.tolerance * 0.25);
+    GS::Array<Polygon> pieces;
+    BuildPieces(simple, std::fabs(d), opt, pieces);
+    std::vector<API_Coord> raw;
+    BuildRawSide(simple, d, opt, raw);
+    GS::Array<API_Coord> line;
+    for (const API_Coord& p : raw) line.Push(p);
+
+    // Кромка — куски сырой линии, не попавшие внутрь ленты (лежащие на её границе)
+    return PolygonHelper::ClipPolyline(line, IsClosed(simple), pieces, false, runs);
+}
+
+// ================================================================
+// Лента вдоль пути
+// ================================================================
+bool BandPolygons (const Path& path, double width, GS::Array<Polygon>& out, const Options& opt)
+{
+    out.Clear();
+    if (path.IsEmpty() || width <= 1e-9) return false;
+
+    GS::Array<Polygon> pieces;
+    BuildPieces(Simplify(path, opt.tolerance * 0.25), width * 0.5, opt, pieces);
+    return PolygonHelper::Union(pieces, out);
+}
+
+} // namespace OffsetHelper
@@ -0,0 +1,57 @@
+#ifndef OFFSETHELPER_HPP
+#define OFFSETHELPER_HPP
+
+#include "APIdefs_Elements.h"
+#include "PolygonHelper.hpp"
+
+// ============================================================================
+// OffsetHelper — эквидистанты пути из отрезков и дуг.
+// Дуги смещаются точно (тот же центр, радиус ± d) и дробятся на хорды только на выходе,
+// по допуску; стыки — срез (miter, с ограничением длины) или скругление.
+// Лента вокруг пути — объединение «кусков» (сегмент × ширина, стыки) через PolygonHelper,
+// поэтому контур получается без самопересечений и его не нужно регуляризовать.
+// Без ACAPI-вызовов: можно звать из любого потока.
+// ============================================================================
+namespace OffsetHelper {
+
+    enum class Join { Miter, Round };
+
+    struct Options {
+        Join   join = Join::Miter;
+        double miterLimit = 4.0;    // длина среза / полуширина; длиннее — срез скашивается
+        double tolerance = 0.002;   // м: наибольшее отклонение хорды от дуги
+    };
+
+    // Отрезок (a → b) или дуга: центр c, радиус r, от угла a0 на sweep (> 0 — против часовой)
+    struct Segment {
+        bool      isArc = false;
+        API_Coord a{}, b{};
+        API_Coord c{};
+        double    r = 0.0, a0 = 0.0, sweep = 0.0;
+    };
+
+    using Path = GS::Array<Segment>;
+
+    // Внешний контур против часовой, дыры по часовой (без замыкающей точки)
+    using Polygon = PolygonHelper::Polygon;
+
+    void AddLine (Path& path, const API_Coord& a, const API_Coord& b);
+    void AddArc (Path& path, const API_Coord& c, double r, double a0, double sweep);
+    // Дуга полилинии по концам и центральному углу (API_PolyArc::arcAngle, > 0 — против часовой)
+    void AddPolylineArc (Path& path, const API_Coord& a, const API_Coord& b, double arcAngle);
+    // Ломаная по точкам (повторы подряд пропускаются)
+    void AddPoints (Path& path, const GS::Array<API_Coord>& pts);
+
+    // Сам путь ломаной: дуги — хорды по допуску, концы сегментов — точно
+    void Flatten (const Path& path, GS::Array<API_Coord>& pts, double tolerance = 0.002);
+
+    // Эквидистанта одной стороны на d (> 0 — слева по ходу). Петли на внутренних сторонах
+    // поворотов вырезаны; если путь пересекает сам себя, кромка распадается на куски (runs)
+    bool OffsetSide (const Path& path, double d, GS::Array<GS::Array<API_Coord>>& runs, const Options& opt = Options());
+
+    // Лента шириной width вдоль пути с плоскими торцами. Обычно один многоугольник;
+    // путь, замкнутый в петлю, даёт дыру. Первым идёт наибольший
+    bool BandPolygons (const Path& path, double width, GS::Array<Polygon>& out, const Options& opt = Options());
+}
+
+#endif // OFFSETHELPER_HPP
@@ -0,0 +1,172 @@
+#include "Perf.hpp"
+#include "JsonLite.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <ctime>
+#include <map>
+
+namespace Perf {
+
+static constexpr size_t NCounters = (size_t)Counter::Count_;
+static constexpr size_t NTimers = (size_t)Timer::Count_;
+
+static const char* const kCounterNames[NCounters] = {
+    "elementGet", "elementChange", "elementCreate", "memoFetch", "memoBytes", "tinBuilds", "samples",
+};
+static const char* const kTimerNames[NTimers] = {
+    "tinBuildMs", "undoMs", "fetchMs", "computeMs", "commitMs",
+};
+
+// монотонные суммы; таймеры — в микросекундах, чтобы остаться в целых атомиках
+static std::atomic<UInt64> g_counters[NCounters];
+static std::atomic<UInt64> g_timersUs[NTimers];
+
+struct Snapshot {
+    UInt64 counters[NCounters] = {};
+    UInt64 timersUs[NTimers] = {};
+};
+
+static Snapshot Take ()
+{
+    Snapshot s;
+    for (size_t i = 0; i < NCounters; ++i) s.counters[i] = g_counters[i].load(std::memory_order_relaxed);
+    for (size_t i = 0; i < NTimers; ++i)   s.timersUs[i] = g_timersUs[i].load(std::memory_order_relaxed);
+    return s;
+}
+
+struct CommandStats {
+    UInt64 calls = 0;
+    double totalMs = 0.0;
+    double maxMs = 0.0;
+    UInt64 counters[NCounters] = {};
+    UInt64 timersUs[NTimers] = {};
+};
+
+// только главный поток
+static std::map<std::string, CommandStats> g_commands;
+static int                                 g_depth = 0;
+static std::string                         g_name;
+static bool                                g_newCall = true;
+static Snapshot                            g_start;
+static std::chrono::steady_clock::time_point g_t0;
+static std::time_t                         g_since = std::time(nullptr);
+
+static thread_local Sink* t_sink = nullptr;
+
+void Add (Counter c, UInt64 n)
+{
+    std::atomic<UInt64>* counters = (t_sink != nullptr) ? t_sink->counters : g_counters;
+    counters[(size_t)c].fetch_add(n, std::memory_order_relaxed);
+}
+
+void AddTime (Timer t, double ms)
+{
+    if (ms <= 0.0) return;
+    std::atomic<UInt64>* timers = (t_sink != nullptr) ? t_sink->timersUs : g_timersUs;
+    timers[(size_t)t].fetch_add((UInt64)std::llround(ms * 1000.0), std::memory_order_relaxed);
+}
+
+Sink::Sink ()
+{
+    for (auto& c : counters) c.store(0, std::memory_order_relaxed);
+    for (auto& t : timersUs) t.store(0, std::memory_order_relaxed);
+}
+
+void Sink::Drain ()
+{
+    for (size_t i = 0; i < NCounters; ++i) g_counters[i].fetch_add(counters[i].exchange(0), std::memory_order_relaxed);
+    for (size_t i = 0; i < NTimers; ++i)   g_timersUs[i].fetch_add(timersUs[i].exchange(0), std::memory_order_relaxed);
+}
+
+SinkScope::SinkScope (Sink* sink)
+    : m_prev(t_sink)
+{
+    t_sink = sink;
+}
+
+SinkScope::~SinkScope ()
+{
+    t_sink = m_prev;
+}
+
+Sink* SinkScope::Current ()
+{
+    return t_sink;
+}
+
+ScopedTimer::~ScopedTimer ()
+{
+    AddTime(m_timer, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_t0).count());
+}
+
+CommandScope::CommandScope (const std::string& name, bool newCall)
+    : m_outer(g_depth++ == 0)
+{
+    if (!m_outer) return;
+    g_name = name;
+    g_newCall = newCall;
+    g_start = Take();
+    g_t0 = std::chrono::steady_clock::now();
+}
+
+CommandScope::~CommandScope ()
+{
+    --g_depth;
+    if (!m_outer) return;
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - g_t0).count();
+    const Snapshot end = Take();
+    CommandStats& cs = g_commands[g_name];
+    if (g_newCall) ++cs.calls;
+    cs.totalMs += ms;
+    if (ms > cs.maxMs) cs.maxMs = ms;
+    for (size_t i = 0; i < NCounters; ++i) cs.counters[i] += end.counters[i] - g_start.counters[i];
+    for (size_t i = 0; i < NTimers; ++i)   cs.timersUs[i] += end.timersUs[i] - g_start.timersUs[i];
+}
+
+UInt64 MemoBytes (const API_ElementMemo& memo)
+{
+    UInt64 n = 0;
+    if (memo.coords != nullptr)    n += BMGetHandleSize((GSHandle)memo.coords);
+    if (memo.pends != nullptr)     n += BMGetHandleSize((GSHandle)memo.pends);
+    if (memo.parcs != nullptr)     n += BMGetHandleSize((GSHandle)memo.parcs);
+    if (memo.vertexIDs != nullptr) n += BMGetHandleSize((GSHandle)memo.vertexIDs);
+    if (memo.meshPolyZ != nullptr) n += BMGetHandleSize((GSHandle)memo.meshPolyZ);
+    if (memo.params != nullptr)    n += BMGetHandleSize((GSHandle)memo.params);
+    return n;
+}
+
+static double Round3 (double v)
+{
+    return std::round(v * 1000.0) / 1000.0;
+}
+
+std::string ToJson ()
+{
+    JsonLite::Value root = JsonLite::Value::Object();
+    root.Set("since", JsonLite::Value::Number((double)g_since));
+    JsonLite::Value& list = root.Set("commands", JsonLite::Value::Array());
+    for (const auto& kv : g_commands) {
+        const CommandStats& cs = kv.second;
+        JsonLite::Value& o = list.Push(JsonLite::Value::Object());
+        o.Set("name", JsonLite::Value::String(kv.first));
+        o.Set("calls", JsonLite::Value::Number((double)cs.calls));
+        o.Set("totalMs", JsonLite::Value::Number(Round3(cs.totalMs)));
+        o.Set("avgMs", JsonLite::Value::Number(cs.calls > 0 ? Round3(cs.totalMs / cs.calls) : 0.0));
+        o.Set("maxMs", JsonLite::Value::Number(Round3(cs.maxMs)));
+        for (size_t i = 0; i < NCounters; ++i) o.Set(kCounterNames[i], JsonLite::Value::Number((double)cs.counters[i]));
+        for (size_t i = 0; i < NTimers; ++i)   o.Set(kTimerNames[i], JsonLite::Value::Number(Round3(cs.timersUs[i] / 1000.0)));
+        const double samples = (double)cs.counters[(size_t)Counter::Samples];
+        o.Set("samplesPerSec", JsonLite::Value::Number(cs.totalMs > 0.0 ? std::round(samples * 1000.0 / cs.totalMs) : 0.0));
+    }
+    return JsonLite::ToString(root);
+}
+
+void Reset ()
+{
+    g_commands.clear();
+    g_since = std::time(nullptr);
+}
+
+} // namespace Perf
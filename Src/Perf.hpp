@@ -0,0 +1,124 @@
+#ifndef PERF_HPP
+#define PERF_HPP
+
+#include "APIEnvir.h"
+#include "ACAPinc.h"
+#include "GSRoot.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <utility>
+
+// ============================================================================
+// Perf — счётчики и таймеры команд палитры.
+// Счётчики глобальные и атомарные (расчёт в рабочих потоках тоже считается);
+// CommandScope на внешнем уровне снимает разницу до/после и копит её по
+// имени команды. Вложенные области (REPL, макрос) попадают во внешнюю.
+// ============================================================================
+namespace Perf {
+
+    enum class Counter {
+        ElementGet, ElementChange, ElementCreate, MemoFetch, MemoBytes, TinBuilds, Samples,
+        Count_
+    };
+
+    enum class Timer {
+        TinBuild, Undo, Fetch, Compute, Commit,
+        Count_
+    };
+
+    void Add (Counter c, UInt64 n = 1);
+    void AddTime (Timer t, double ms);
+
+    // Время области в таймер t
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer (Timer t) : m_timer(t), m_t0(std::chrono::steady_clock::now()) {}
+        ~ScopedTimer ();
+        ScopedTimer (const ScopedTimer&) = delete;
+        ScopedTimer& operator= (const ScopedTimer&) = delete;
+
+    private:
+        Timer                                 m_timer;
+        std::chrono::steady_clock::time_point m_t0;
+    };
+
+    // Счётчики расчёта задачи в рабочем потоке. Поток под SinkScope пишет сюда, а не в общие
+    // суммы, иначе расчёт попадёт в команду, открытую в это время на главном потоке.
+    // Drain переносит накопленное в общие суммы — внутри CommandScope задачи (главный поток)
+    struct Sink {
+        Sink ();
+        void Drain ();
+
+        std::atomic<UInt64> counters[(size_t)Counter::Count_];
+        std::atomic<UInt64> timersUs[(size_t)Timer::Count_];
+    };
+
+    // Направить счёт текущего потока в sink (nullptr — общие суммы). Пул потоков берёт
+    // Current() у запустившего потока и открывает SinkScope в каждом своём потоке
+    class SinkScope {
+    public:
+        explicit SinkScope (Sink* sink);
+        ~SinkScope ();
+        SinkScope (const SinkScope&) = delete;
+        SinkScope& operator= (const SinkScope&) = delete;
+
+        static Sink* Current ();
+
+    private:
+        Sink* m_prev;
+    };
+
+    // Одна команда (или один шаг задачи: newCall=false — время и счётчики добавляются без нового вызова)
+    class CommandScope {
+    public:
+        explicit CommandScope (const std::string& name, bool newCall = true);
+        ~CommandScope ();
+        CommandScope (const CommandScope&) = delete;
+        CommandScope& operator= (const CommandScope&) = delete;
+
+    private:
+        bool m_outer;
+    };
+
+    // Размер handle-ов memo (координаты, контуры, дуги, вершины, параметры)
+    UInt64 MemoBytes (const API_ElementMemo& memo);
+
+    // Обёртки ACAPI со счётом вызовов
+    template <typename... A>
+    inline GSErrCode ElementGet (A&&... a)
+    {
+        Add(Counter::ElementGet);
+        return ACAPI_Element_Get(std::forward<A>(a)...);
+    }
+
+    template <typename... A>
+    inline GSErrCode ElementChange (A&&... a)
+    {
+        Add(Counter::ElementChange);
+        return ACAPI_Element_Change(std::forward<A>(a)...);
+    }
+
+    template <typename... A>
+    inline GSErrCode ElementCreate (A&&... a)
+    {
+        Add(Counter::ElementCreate);
+        return ACAPI_Element_Create(std::forward<A>(a)...);
+    }
+
+    inline GSErrCode ElementGetMemo (const API_Guid& guid, API_ElementMemo* memo, UInt64 mask = APIMemoMask_All)
+    {
+        const GSErrCode err = ACAPI_Element_GetMemo(guid, memo, mask);
+        Add(Counter::MemoFetch);
+        if (err == NoError && memo != nullptr) Add(Counter::MemoBytes, MemoBytes(*memo));
+        return err;
+    }
+
+    // Сводка по командам: {"commands":[{"name","calls","totalMs","maxMs",...}],"since":..}
+    std::string ToJson ();
+    void        Reset ();
+
+}
+
+#endif // PERF_HPP
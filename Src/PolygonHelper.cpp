@@ -0,0 +1,712 @@
+// ============================================================================
+// PolygonHelper.cpp — булевы операции: разрезка рёбер sweep-line,
+// классификация по числам обхода, сборка контуров
+// ============================================================================
+
+#include "PolygonHelper.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+namespace PolygonHelper {
+
+namespace {
+
+constexpr double kPI   = 3.14159265358979323846;
+constexpr double kEps  = 1e-12;
+constexpr double kSnap = 1e-7;   // м: точки ближе — одна вершина
+constexpr double kOn   = 1e-9;   // м: точка ближе к ребру — лежит на нём
+
+// ------------------ Векторная арифметика ------------------
+inline API_Coord Sub (const API_Coord& a, const API_Coord& b) { return { a.x - b.x, a.y - b.y }; }
+inline double    Dot (const API_Coord& a, const API_Coord& b) { return a.x * b.x + a.y * b.y; }
+inline double    Cross (const API_Coord& a, const API_Coord& b) { return a.x * b.y - a.y * b.x; }
+inline double    Len (const API_Coord& a) { return std::sqrt(a.x * a.x + a.y * a.y); }
+inline API_Coord ArcPt (const API_Coord& c, double r, double ang) { return { c.x + r * std::cos(ang), c.y + r * std::sin(ang) }; }
+
+inline bool Near (const API_Coord& a, const API_Coord& b, double tol)
+{
+    return std::fabs(a.x - b.x) <= tol && std::fabs(a.y - b.y) <= tol;
+}
+
+inline API_Coord Unit (const API_Coord& v)
+{
+    const double l = Len(v);
+    return (l < kEps) ? API_Coord{ 1.0, 0.0 } : API_Coord{ v.x / l, v.y / l };
+}
+
+double SignedArea (const std::vector<API_Coord>& pts)
+{
+    double a = 0.0;
+    for (size_t i = 0; i < pts.size(); ++i)
+        a += Cross(pts[i], pts[(i + 1) % pts.size()]);
+    return a * 0.5;
+}
+
+bool PointInLoop (const std::vector<API_Coord>& pts, const API_Coord& p)
+{
+    bool in = false;
+    for (size_t i = 0, j = pts.size() - 1; i < pts.size(); j = i++) {
+        if ((pts[i].y > p.y) != (pts[j].y > p.y) &&
+            p.x < (pts[j].x - pts[i].x) * (p.y - pts[i].y) / (pts[j].y - pts[i].y) + pts[i].x)
+            in = !in;
+    }
+    return in;
+}
+
+// Дуга полилинии по хорде a → b и центральному углу (> 0 — против часовой), без начальной точки
+void AppendChordArc (Contour& out, const API_Coord& a, const API_Coord& b, double arcAngle, double tol)
+{
+    const double chord = Len(Sub(b, a));
+    if (chord < 1e-9 || std::fabs(arcAngle) < 1e-9) { out.Push(b); return; }
+    const double r = chord / (2.0 * std::sin(std::fabs(arcAngle) / 2.0));
+    const double h = chord / (2.0 * std::tan(arcAngle / 2.0));
+    const API_Coord t = Unit(Sub(b, a));
+    const API_Coord c = { (a.x + b.x) * 0.5 - t.y * h, (a.y + b.y) * 0.5 + t.x * h };
+    AppendArc(out, c, r, std::atan2(a.y - c.y, a.x - c.x), arcAngle, tol);
+    out[out.GetSize() - 1] = b;   // конец — ровно точка полилинии
+}
+
+// ------------------ Кольца и рёбра ------------------
+struct Ring {
+    std::vector<API_Coord> pts;   // замкнут неявно
+    int operand = 0;
+};
+
+struct Edge {
+    API_Coord a{}, b{};
+    int       operand = -1;    // 0/1 — ребро контура операнда, -1 — ребро разрезаемой ломаной
+};
+
+struct Split { double t; API_Coord p; };
+
+// Контуры набора с единым обходом: внешние против часовой, дыры по часовой,
+// тогда перекрытия внутри набора дают число обхода > 0, а дыры — 0
+void AddRings (const GS::Array<Polygon>& polys, int operand, std::vector<Ring>& rings)
+{
+    auto add = [&](const Contour& c, bool hole) {
+        Ring r;
+        r.operand = operand;
+        for (const API_Coord& p : c)
+            if (r.pts.empty() || !Near(r.pts.back(), p, 0.0)) r.pts.push_back(p);
+        while (r.pts.size() > 1 && Near(r.pts.back(), r.pts.front(), 0.0)) r.pts.pop_back();
+        if (r.pts.size() < 3) return;
+        const double a = SignedArea(r.pts);
+        if ((hole && a > 0.0) || (!hole && a < 0.0))
+            std::reverse(r.pts.begin(), r.pts.end());
+        rings.push_back(std::move(r));
+    };
+    for (const Polygon& poly : polys) {
+        add(poly.outer, false);
+        for (const Contour& h : poly.holes) add(h, true);
+    }
+}
+
+void EdgesOfRings (const std::vector<Ring>& rings, std::vector<Edge>& edges)
+{
+    for (const Ring& r : rings) {
+        for (size_t i = 0; i < r.pts.size(); ++i) {
+            const API_Coord& a = r.pts[i];
+            const API_Coord& b = r.pts[(i + 1) % r.pts.size()];
+            // Короткие рёбра не выбрасываем: концы склеивает VertexPool, иначе в кольце будет щель
+            if (!Near(a, b, 0.0)) edges.push_back({ a, b, r.operand });
+        }
+    }
+}
+
+// ------------------ Разрезка рёбер (sweep-line) ------------------
+// Все точки пересечения и касания рёбер; точка пишется в оба ребра одной и той же координатой.
+// Рёбра упорядочены по левому X; активный список — рёбра, чей X-диапазон ещё не закончился.
+// linesOnly — пары «контур × контур» пропускаются
+void CollectSplits (const std::vector<Edge>& edges, bool linesOnly, std::vector<std::vector<Split>>& splits)
+{
+    const size_t n = edges.size();
+    splits.assign(n, {});
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; ++i) order[i] = i;
+    auto minX = [&](size_t i) { return std::min(edges[i].a.x, edges[i].b.x); };
+    auto maxX = [&](size_t i) { return std::max(edges[i].a.x, edges[i].b.x); };
+    std::sort(order.begin(), order.end(), [&](size_t l, size_t r) { return minX(l) < minX(r); });
+
+    auto addSplit = [&](size_t e, double t, const API_Coord& p) {
+        const double el = Len(Sub(edges[e].b, edges[e].a));
+        if (el < kEps) return;
+        const double et = kSnap / el;
+        if (t > et && t < 1.0 - et) splits[e].push_back({ t, p });
+    };
+
+    std::vector<size_t> active;
+    for (size_t oi = 0; oi < n; ++oi) {
+        const size_t i = order[oi];
+        const double x0 = minX(i);
+        active.erase(std::remove_if(active.begin(), active.end(), [&](size_t k) { return maxX(k) < x0 - kSnap; }), active.end());
+
+        const Edge& E = edges[i];
+        const double ey0 = std::min(E.a.y, E.b.y), ey1 = std::max(E.a.y, E.b.y);
+        for (size_t k : active) {
+            const Edge& F = edges[k];
+            if (linesOnly && E.operand >= 0 && F.operand >= 0) continue;
+            if (std::max(F.a.y, F.b.y) < ey0 - kSnap || std::min(F.a.y, F.b.y) > ey1 + kSnap) continue;
+
+            const API_Coord r = Sub(E.b, E.a), u = Sub(F.b, F.a), qp = Sub(F.a, E.a);
+            const double lr = Len(r), lu = Len(u);
+            if (lr < kEps || lu < kEps) continue;
+            const double den = Cross(r, u);
+            if (std::fabs(den) > 1e-12 * lr * lu) {
+                const double te = Cross(qp, u) / den;
+                const double tf = Cross(qp, r) / den;
+                const double ee = kSnap / lr, ef = kSnap / lu;
+                if (te < -ee || te > 1.0 + ee || tf < -ef || tf > 1.0 + ef) continue;
+                API_Coord p;
+                if      (te <= ee)       p = E.a;
+                else if (te >= 1.0 - ee) p = E.b;
+                else if (tf <= ef)       p = F.a;
+                else if (tf >= 1.0 - ef) p = F.b;
+                else                     p = { E.a.x + r.x * te, E.a.y + r.y * te };
+                addSplit(i, te, p);
+                addSplit(k, tf, p);
+            } else if (std::fabs(Cross(qp, r)) / lr < kSnap) {
+                // Коллинеарные: концы одного режут другое
+                addSplit(i, Dot(Sub(F.a, E.a), r) / (lr * lr), F.a);
+                addSplit(i, Dot(Sub(F.b, E.a), r) / (lr * lr), F.b);
+                addSplit(k, Dot(Sub(E.a, F.a), u) / (lu * lu), E.a);
+                addSplit(k, Dot(Sub(E.b, F.a), u) / (lu * lu), E.b);
+            }
+        }
+        active.push_back(i);
+    }
+
+    for (auto& s : splits)
+        std::sort(s.begin(), s.end(), [](const Split& l, const Split& r) { return l.t < r.t; });
+}
+
+// Ребро, разрезанное в точках splits: концы кусочков (с прилипанием к соседним рёбрам)
+void ChainOf (const Edge& e, const std::vector<Split>& splits, std::vector<Split>& chain)
+{
+    chain.clear();
+    chain.push_back({ 0.0, e.a });
+    chain.insert(chain.end(), splits.begin(), splits.end());
+    chain.push_back({ 1.0, e.b });
+}
+
+// Проба кусочка — середина на исходном ребре, а не между сдвинутыми прилипанием концами:
+// так ребро, совпадающее с ребром другого контура, остаётся на нём точно
+inline API_Coord ProbeOf (const Edge& e, const Split& s0, const Split& s1)
+{
+    const double t = (s0.t + s1.t) * 0.5;
+    return { e.a.x + (e.b.x - e.a.x) * t, e.a.y + (e.b.y - e.a.y) * t };
+}
+
+// ------------------ Вершины с прилипанием ------------------
+class VertexPool {
+public:
+    int Get (const API_Coord& p)
+    {
+        const long long ix = (long long)std::floor(p.x / kCell), iy = (long long)std::floor(p.y / kCell);
+        for (long long dx = -1; dx <= 1; ++dx)
+            for (long long dy = -1; dy <= 1; ++dy) {
+                auto it = m_cells.find(Key(ix + dx, iy + dy));
+                if (it == m_cells.end()) continue;
+                for (int id : it->second)
+                    if (Near(m_pts[id], p, kSnap)) return id;
+            }
+        const int id = (int)m_pts.size();
+        m_pts.push_back(p);
+        m_cells[Key(ix, iy)].push_back(id);
+        return id;
+    }
+    const API_Coord& At (int id) const { return m_pts[id]; }
+    int              Size () const { return (int)m_pts.size(); }
+
+private:
+    static constexpr double kCell = 4.0 * kSnap;
+    static long long Key (long long ix, long long iy) { return ix * 1000003LL ^ iy; }
+
+    std::vector<API_Coord> m_pts;
+    std::unordered_map<long long, std::vector<int>> m_cells;
+};
+
+// ------------------ Числа обхода (луч по сетке рёбер) ------------------
+// Луч идёт к ближайшей стороне сетки вдоль строки или столбца ячеек, поэтому
+// запрос стоит порядка числа рёбер на его пути, а не всех рёбер
+class EdgeGrid {
+public:
+    explicit EdgeGrid (const std::vector<Edge>& edges) : m_edges(edges)
+    {
+        size_t n = 0;
+        bool first = true;
+        double x0 = 0.0, y0 = 0.0, x1 = 0.0, y1 = 0.0;
+        for (const Edge& e : edges) {
+            if (e.operand < 0) continue;
+            if (first) { x0 = x1 = e.a.x; y0 = y1 = e.a.y; first = false; }
+            x0 = std::min(x0, std::min(e.a.x, e.b.x)); x1 = std::max(x1, std::max(e.a.x, e.b.x));
+            y0 = std::min(y0, std::min(e.a.y, e.b.y)); y1 = std::max(y1, std::max(e.a.y, e.b.y));
+            ++n;
+        }
+        if (n == 0) return;
+        m_x0 = x0 - kSnap; m_y0 = y0 - kSnap;
+        m_x1 = x1 + kSnap; m_y1 = y1 + kSnap;
+        const double w = m_x1 - m_x0, h = m_y1 - m_y0;
+        m_cell = std::max(std::sqrt(w * h / (double)n) * 2.0, 1e-6);
+        m_nx = std::min(1024, (int)(w / m_cell) + 1);
+        m_ny = std::min(1024, (int)(h / m_cell) + 1);
+        m_cell = std::max(m_cell, std::max(w / m_nx, h / m_ny) * 1.000001);
+        m_cells.assign((size_t)m_nx * (size_t)m_ny, {});
+        for (int k = 0; k < (int)edges.size(); ++k) {
+            const Edge& e = edges[k];
+            if (e.operand < 0) continue;
+            const int i0 = CellX(std::min(e.a.x, e.b.x) - kSnap), i1 = CellX(std::max(e.a.x, e.b.x) + kSnap);
+            const int j0 = CellY(std::min(e.a.y, e.b.y) - kSnap), j1 = CellY(std::max(e.a.y, e.b.y) + kSnap);
+            for (int i = i0; i <= i1; ++i)
+                for (int j = j0; j <= j1; ++j)
+                    m_cells[(size_t)j * m_nx + i].push_back(k);
+        }
+    }
+
+    // Числа обхода операндов слева и справа от кусочка, идущего через p в направлении d.
+    // through — сколько раз (со знаком относительно d) граница операнда проходит по кусочку;
+    // на входе — рёбра skip, к ним добавляются найденные рёбра, на которых лежит p
+    void Wind (const API_Coord& p, const API_Coord& d, const std::vector<int>& skip,
+               int through[2], int left[2], int right[2]) const
+    {
+        int w[2] = { 0, 0 };
+        int dir = 0;
+        if (!m_cells.empty() && p.x >= m_x0 && p.x <= m_x1 && p.y >= m_y0 && p.y <= m_y1) {
+            const double dist[4] = { m_x1 - p.x, m_y1 - p.y, p.x - m_x0, p.y - m_y0 };
+            for (int k = 1; k < 4; ++k)
+                if (dist[k] < dist[dir]) dir = k;
+            const API_Coord q = Rot(p, dir);
+            const int ci = CellX(p.x), cj = CellY(p.y);
+            const bool alongX = (dir % 2 == 0);
+            const int step = (dir < 2) ? 1 : -1;
+            const int start = alongX ? ci : cj;
+            const int stop = alongX ? (step > 0 ? m_nx : -1) : (step > 0 ? m_ny : -1);
+            for (int c = start; c != stop; c += step) {
+                const std::vector<int>& cell = m_cells[alongX ? (size_t)cj * m_nx + c : (size_t)c * m_nx + ci];
+                for (int k : cell) {
+                    if (std::find(skip.begin(), skip.end(), k) != skip.end()) continue;
+                    const Edge& e = m_edges[k];
+                    if (c == start && OnEdge(e, p)) {
+                        through[e.operand] += (Dot(Sub(e.b, e.a), d) >= 0.0) ? 1 : -1;
+                        continue;
+                    }
+                    const API_Coord a = Rot(e.a, dir), b = Rot(e.b, dir);
+                    int s = 0;
+                    if (a.y <= q.y && b.y > q.y)      s = 1;
+                    else if (b.y <= q.y && a.y > q.y) s = -1;
+                    else continue;
+                    const double cr = Cross(Sub(b, a), Sub(q, a));
+                    if ((s > 0 && cr <= 0.0) || (s < 0 && cr >= 0.0)) continue;
+                    // Ребро лежит в нескольких ячейках — считаем его там, где луч его пересёк
+                    const double xc = a.x + (q.y - a.y) * (b.x - a.x) / (b.y - a.y);
+                    if (AxisCell(xc, dir) != c) continue;
+                    w[e.operand] += s;
+                }
+            }
+        }
+        // Луч из точки слева от кусочка пересекает его, если кусочек идёт «вверх» в системе луча
+        const API_Coord dq = Rot(d, dir);
+        const bool crossesLeft = dq.y > 0.0 || (dq.y == 0.0 && dq.x < 0.0);
+        for (int k = 0; k < 2; ++k) {
+            left[k] = w[k] + (crossesLeft ? through[k] : 0);
+            right[k] = left[k] - through[k];
+        }
+    }
+
+private:
+    // Поворот на dir × 90° по часовой: луч во всех случаях идёт по +X
+    static API_Coord Rot (const API_Coord& p, int dir)
+    {
+        switch (dir) {
+        case 1:  return { p.y, -p.x };
+        case 2:  return { -p.x, -p.y };
+        case 3:  return { -p.y, p.x };
+        default: return p;
+        }
+    }
+
+    int AxisCell (double xr, int dir) const
+    {
+        switch (dir) {
+        case 1:  return CellY(xr);
+        case 2:  return CellX(-xr);
+        case 3:  return CellY(-xr);
+        default: return CellX(xr);
+        }
+    }
+
+    static bool OnEdge (const Edge& e, const API_Coord& p)
+    {
+        const API_Coord ab = Sub(e.b, e.a), ap = Sub(p, e.a);
+        const double l2 = Dot(ab, ab);
+        const double c = Cross(ab, ap);
+        if (l2 <= 0.0 || c * c > kOn * kOn * l2) return false;
+        const double t = Dot(ap, ab) / l2;
+        return t >= 0.0 && t <= 1.0;
+    }
+
+    int CellX (double x) const { return std::max(0, std::min(m_nx - 1, (int)std::floor((x - m_x0) / m_cell))); }
+    int CellY (double y) const { return std::max(0, std::min(m_ny - 1, (int)std::floor((y - m_y0) / m_cell))); }
+
+    const std::vector<Edge>& m_edges;
+    double m_x0 = 0.0, m_y0 = 0.0, m_x1 = 0.0, m_y1 = 0.0, m_cell = 1.0;
+    int    m_nx = 0, m_ny = 0;
+    std::vector<std::vector<int>> m_cells;
+};
+
+bool Keep (Op op, bool a, bool b)
+{
+    switch (op) {
+    case Op::Union:        return a || b;
+    case Op::Intersection: return a && b;
+    case Op::Difference:   return a && !b;
+    case Op::Xor:          return a != b;
+    }
+    return false;
+}
+
+// Удалить вершины, лежащие на прямой между соседями
+void DropCollinear (std::vector<API_Coord>& pts, bool closed)
+{
+    bool changed = true;
+    while (changed && pts.size() > 2) {
+        changed = false;
+        std::vector<API_Coord> res;
+        const size_t n = pts.size();
+        for (size_t i = 0; i < n; ++i) {
+            const bool endpoint = !closed && (i == 0 || i + 1 == n);
+            if (!endpoint) {
+                const API_Coord& p = res.empty() ? pts[(i + n - 1) % n] : res.back();
+                const API_Coord& q = pts[(i + 1) % n];
+                const API_Coord pq = Sub(q, p);
+                const double l = Len(pq);
+                if (l < kEps || (std::fabs(Cross(pq, Sub(pts[i], p))) / l < kSnap && Dot(Sub(pts[i], p), pq) > 0.0 && Dot(Sub(q, pts[i]), pq) > 0.0)) {
+                    changed = true;
+                    continue;
+                }
+            }
+            res.push_back(pts[i]);
+        }
+        pts.swap(res);
+    }
+}
+
+// ------------------ Сборка контуров ------------------
+struct HalfEdge { int from, to; };
+
+// Полурёбра границы (область слева) → многоугольники с дырами, по убыванию площади
+void Assemble (const std::vector<HalfEdge>& hes, const VertexPool& pool, GS::Array<Polygon>& out)
+{
+    // В точке касания — самый левый поворот, чтобы касающиеся контуры не склеивались в «восьмёрку»
+    std::unordered_map<int, std::vector<int>> outgoing;
+    for (int i = 0; i < (int)hes.size(); ++i) outgoing[hes[i].from].push_back(i);
+    std::vector<bool> used(hes.size(), false);
+
+    std::vector<std::vector<API_Coord>> loops;
+    for (int start = 0; start < (int)hes.size(); ++start) {
+        if (used[start]) continue;
+        std::vector<API_Coord> loop;
+        int cur = start;
+        bool closed = false;
+        for (size_t guard = 0; guard <= hes.size(); ++guard) {
+            used[cur] = true;
+            loop.push_back(pool.At(hes[cur].from));
+            const int v = hes[cur].to;
+            const API_Coord back = Sub(pool.At(hes[cur].from), pool.At(v));
+            const double aBack = std::atan2(back.y, back.x);
+            int best = -1;
+            double bestAng = -1.0;
+            for (int cand : outgoing[v]) {
+                if (used[cand] && cand != start) continue;
+                const API_Coord dir = Sub(pool.At(hes[cand].to), pool.At(v));
+                double ang = std::atan2(dir.y, dir.x) - aBack;
+                while (ang <= 0.0)      ang += 2.0 * kPI;
+                while (ang > 2.0 * kPI) ang -= 2.0 * kPI;
+                if (ang > bestAng) { bestAng = ang; best = cand; }
+            }
+            if (best < 0) break;
+            if (best == start) { closed = true; break; }
+            cur = best;
+        }
+        if (!closed) continue;
+        DropCollinear(loop, true);
+        if (loop.size() >= 3 && std::fabs(SignedArea(loop)) > 1e-10)
+            loops.push_back(std::move(loop));
+    }
+
+    // Внешние контуры (против часовой) по убыванию площади; дыра — в наименьший содержащий
+    std::vector<size_t> outers, holes;
+    for (size_t i = 0; i < loops.size(); ++i)
+        (SignedArea(loops[i]) > 0.0 ? outers : holes).push_back(i);
+    std::sort(outers.begin(), outers.end(), [&](size_t l, size_t r) { return SignedArea(loops[l]) > SignedArea(loops[r]); });
+
+    out.Clear();
+    for (size_t o : outers) {
+        Polygon poly;
+        for (const API_Coord& p : loops[o]) poly.outer.Push(p);
+        out.Push(poly);
+    }
+    for (size_t hIdx : holes) {
+        const API_Coord& a = loops[hIdx][0];
+        int owner = -1;
+        for (int k = (int)outers.size() - 1; k >= 0; --k)
+            if (PointInLoop(loops[outers[k]], a)) { owner = k; break; }
+        if (owner < 0) continue;
+        Contour hole;
+        for (const API_Coord& p : loops[hIdx]) hole.Push(p);
+        out[owner].holes.Push(hole);
+    }
+}
+
+// Граница области op(A, B) по кольцам обоих операндов
+void Combine (const std::vector<Ring>& rings, Op op, GS::Array<Polygon>& out)
+{
+    std::vector<Edge> edges;
+    EdgesOfRings(rings, edges);
+    std::vector<std::vector<Split>> splits;
+    CollectSplits(edges, false, splits);
+    const EdgeGrid grid(edges);
+    VertexPool pool;
+
+    // Кусочки рёбер, сгруппированные по паре вершин: совпадающие рёбра — одна группа
+    struct Piece { int va, vb, edge; API_Coord probe; };
+    std::vector<Piece> pieces;
+    std::unordered_map<long long, std::vector<int>> groups;
+    std::vector<Split> chain;
+    for (size_t e = 0; e < edges.size(); ++e) {
+        ChainOf(edges[e], splits[e], chain);
+        for (size_t k = 0; k + 1 < chain.size(); ++k) {
+            const int va = pool.Get(chain[k].p), vb = pool.Get(chain[k + 1].p);
+            if (va == vb) continue;
+            const long long key = (long long)std::min(va, vb) * 0x100000000LL + std::max(va, vb);
+            groups[key].push_back((int)pieces.size());
+            pieces.push_back({ va, vb, (int)e, ProbeOf(edges[e], chain[k], chain[k + 1]) });
+        }
+    }
+
+    // Ребро — граница результата, если результат слева и справа от него разный.
+    // Внутренность — слева
+    std::vector<HalfEdge> hes;
+    std::vector<int> skip;
+    for (const auto& g : groups) {
+        const Piece& first = pieces[g.second[0]];
+        const int lo = std::min(first.va, first.vb), hi = std::max(first.va, first.vb);
+        int through[2] = { 0, 0 };
+        skip.clear();
+        for (int pi : g.second) {
+            const Piece& pc = pieces[pi];
+            through[edges[pc.edge].operand] += (pc.va == lo) ? 1 : -1;
+            skip.push_back(pc.edge);
+        }
+        int left[2], right[2];
+        grid.Wind(first.probe, Unit(Sub(pool.At(hi), pool.At(lo))), skip, through, left, right);
+        const bool inL = Keep(op, left[0] != 0, left[1] != 0);
+        const bool inR = Keep(op, right[0] != 0, right[1] != 0);
+        if (inL == inR) continue;
+        hes.push_back(inL ? HalfEdge{ lo, hi } : HalfEdge{ hi, lo });
+    }
+
+    Assemble(hes, pool, out);
+}
+
+} // namespace
+
+// ================================================================
+// Дуги
+// ================================================================
+int ArcSegments (double r, double sweep, double tol)
+{
+    r = std::fabs(r);
+    const double a = std::fabs(sweep);
+    if (a < 1e-9) return 1;
+    int n = (int)std::ceil(a / (kPI / 2.0));  // не больше четверти окружности на хорду
+    if (r > tol) {
+        const double half = std::acos(std::max(-1.0, 1.0 - tol / r));
+        if (half > 1e-9) n = std::max(n, (int)std::ceil(a / (2.0 * half)));
+    }
+    return std::min(std::max(n, 1), 4096);
+}
+
+void AppendArc (Contour& out, const API_Coord& c, double r, double a0, double sweep, double tol)
+{
+    const int n = ArcSegments(r, sweep, tol);
+    for (int i = 1; i <= n; ++i)
+        out.Push(ArcPt(c, r, a0 + sweep * (double)i / (double)n));
+}
+
+bool FromMemo (const API_Polygon& poly, const API_ElementMemo& memo, double tol, Polygon& out)
+{
+    out = Polygon();
+    if (memo.coords == nullptr || memo.pends == nullptr || poly.nSubPolys < 1) return false;
+
+    for (Int32 k = 0; k < poly.nSubPolys; ++k) {
+        // Контур k: coords[pends[k] + 1 .. pends[k + 1]], последняя точка повторяет первую
+        const Int32 beg = (*memo.pends)[k] + 1, end = (*memo.pends)[k + 1];
+        if (end - beg < 3) continue;
+        Contour c;
+        c.Push((*memo.coords)[beg]);
+        for (Int32 i = beg; i < end; ++i) {
+            double arcAngle = 0.0;
+            for (Int32 a = 0; a < poly.nArcs && memo.parcs != nullptr; ++a)
+                if ((*memo.parcs)[a].begIndex == i) { arcAngle = (*memo.parcs)[a].arcAngle; break; }
+            AppendChordArc(c, (*memo.coords)[i], (*memo.coords)[i + 1], arcAngle, tol);
+        }
+        c.Delete(c.GetSize() - 1);
+        if (k == 0) out.outer = c;
+        else        out.holes.Push(c);
+    }
+    return out.outer.GetSize() >= 3;
+}
+
+// ================================================================
+// Булевы операции
+// ================================================================
+bool Boolean (const GS::Array<Polygon>& a, const GS::Array<Polygon>& b, Op op, GS::Array<Polygon>& out)
+{
+    out.Clear();
+    std::vector<Ring> rings;
+    AddRings(a, 0, rings);
+    AddRings(b, 1, rings);
+    if (rings.empty()) return false;
+    Combine(rings, op, out);
+    return !out.IsEmpty();
+}
+
+bool Union (const GS::Array<Polygon>& polys, GS::Array<Polygon>& out)
+{
+    return Boolean(polys, GS::Array<Polygon>(), Op::Union, out);
+}
+
+// ================================================================
+// Проверка и регуляризация
+// ================================================================
+bool IsRegular (const Polygon& poly)
+{
+    std::vector<std::vector<API_Coord>> contours(1);
+    for (const API_Coord& p : poly.outer) contours[0].push_back(p);
+    for (const Contour& h : poly.holes) {
+        contours.emplace_back();
+        for (const API_Coord& p : h) contours.back().push_back(p);
+    }
+
+    VertexPool pool;
+    for (size_t k = 0; k < contours.size(); ++k) {
+        const std::vector<API_Coord>& c = contours[k];
+        if (c.size() < 3) return false;
+        const double area = SignedArea(c);
+        if (k == 0 ? area <= 1e-10 : area >= -1e-10) return false;
+        for (const API_Coord& p : c) {
+            const int before = pool.Size();
+            if (pool.Get(p) < before) return false;   // повтор вершины (подряд или «защемление»)
+        }
+        if (k > 0 && !PointInLoop(contours[0], c[0])) return false;
+        for (size_t o = 1; o < k; ++o)
+            if (PointInLoop(contours[o], c[0]) || PointInLoop(c, contours[o][0])) return false;
+    }
+
+    // Касание или пересечение рёбер — разрез внутри какого-нибудь ребра
+    std::vector<Edge> edges;
+    for (const auto& c : contours)
+        for (size_t i = 0; i < c.size(); ++i)
+            edges.push_back({ c[i], c[(i + 1) % c.size()], 0 });
+    std::vector<std::vector<Split>> splits;
+    CollectSplits(edges, false, splits);
+    for (const auto& s : splits)
+        if (!s.empty()) return false;
+    return true;
+}
+
+bool Regularize (const Polygon& poly, GS::Array<Polygon>& out)
+{
+    out.Clear();
+    if (IsRegular(poly)) {
+        out.Push(poly);
+        return true;
+    }
+
+    // Повторы подряд убираем сразу; остальное (обход, самопересечения, касания)
+    // разбирает объединение по числу обхода
+    auto dedupe = [](const Contour& c) {
+        Contour res;
+        for (const API_Coord& p : c)
+            if (res.IsEmpty() || !Near(res[res.GetSize() - 1], p, kSnap)) res.Push(p);
+        while (res.GetSize() > 1 && Near(res[res.GetSize() - 1], res[0], kSnap)) res.Delete(res.GetSize() - 1);
+        return res;
+    };
+    Polygon clean;
+    clean.outer = dedupe(poly.outer);
+    for (const Contour& h : poly.holes) clean.holes.Push(dedupe(h));
+    GS::Array<Polygon> in;
+    in.Push(clean);
+    return Union(in, out);
+}
+
+// ================================================================
+// Разрезка ломаной областью
+// ================================================================
+bool ClipPolyline (const Contour& line, bool closed, const GS::Array<Polygon>& region, bool keepInside,
+                   GS::Array<Contour>& runs)
+{
+    runs.Clear();
+    std::vector<Edge> edges;
+    for (UIndex i = 1; i < line.GetSize(); ++i)
+        if (!Near(line[i - 1], line[i], 0.0)) edges.push_back({ line[i - 1], line[i], -1 });
+    const size_t nLine = edges.size();
+    if (nLine == 0) return false;
+    std::vector<Ring> rings;
+    AddRings(region, 0, rings);
+    EdgesOfRings(rings, edges);
+
+    std::vector<std::vector<Split>> splits;
+    CollectSplits(edges, true, splits);
+    const EdgeGrid grid(edges);
+    const std::vector<int> noSkip;
+
+    // Внутри — область и слева, и справа от кусочка; кусочек на границе — снаружи
+    Contour run;
+    auto flush = [&]() {
+        if (run.GetSize() >= 2) {
+            std::vector<API_Coord> v;
+            for (const API_Coord& p : run) v.push_back(p);
+            DropCollinear(v, false);
+            Contour clean;
+            for (const API_Coord& p : v) clean.Push(p);
+            runs.Push(clean);
+        }
+        run.Clear();
+    };
+    std::vector<Split> chain;
+    for (size_t e = 0; e < nLine; ++e) {
+        const API_Coord d = Unit(Sub(edges[e].b, edges[e].a));
+        ChainOf(edges[e], splits[e], chain);
+        for (size_t k = 0; k + 1 < chain.size(); ++k) {
+            const API_Coord& a = chain[k].p;
+            const API_Coord& b = chain[k + 1].p;
+            if (Near(a, b, kSnap)) continue;
+            int through[2] = { 0, 0 }, left[2], right[2];
+            grid.Wind(ProbeOf(edges[e], chain[k], chain[k + 1]), d, noSkip, through, left, right);
+            const bool inside = left[0] != 0 && right[0] != 0;
+            if (inside != keepInside) continue;
+            // Вырезанная петля начинается и кончается в одной точке — кусок продолжается
+            if (!run.IsEmpty() && !Near(run[run.GetSize() - 1], a, kSnap))
+                flush();
+            if (run.IsEmpty())
+                run.Push(a);
+            run.Push(b);
+        }
+    }
+    flush();
+
+    if (closed && runs.GetSize() > 1) {
+        Contour& last = runs[runs.GetSize() - 1];
+        if (Near(last[last.GetSize() - 1], runs[0][0], kSnap)) {
+            for (UIndex i = 1; i < runs[0].GetSize(); ++i) last.Push(runs[0][i]);
+            runs.Delete(0);
+        }
+    }
+    return !runs.IsEmpty();
+}
+
+} // namespace PolygonHelper
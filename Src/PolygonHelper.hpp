@@ -0,0 +1,53 @@
+#ifndef POLYGONHELPER_HPP
+#define POLYGONHELPER_HPP
+
+#include "APIdefs_Elements.h"
+
+// ============================================================================
+// PolygonHelper — булевы операции над многоугольниками в плане (объединение,
+// пересечение, разность, исключающее ИЛИ). Дуги заранее дробятся на хорды по допуску.
+// Рёбра режутся в точках пересечения sweep-line по X, каждое получившееся ребро
+// классифицируется числами обхода операндов слева и справа от него (луч по сетке рёбер),
+// поэтому тысячи рёбер обрабатываются без перебора всех пар.
+// Без ACAPI-вызовов: можно звать из любого потока.
+// ============================================================================
+namespace PolygonHelper {
+
+    using Contour = GS::Array<API_Coord>;   // без замыкающей точки
+
+    // Внешний контур против часовой, дыры по часовой
+    struct Polygon {
+        Contour            outer;
+        GS::Array<Contour> holes;
+    };
+
+    enum class Op { Union, Intersection, Difference, Xor };
+
+    // Сколько хорд нужно дуге радиуса r на угол sweep, чтобы отклонение не превышало tol
+    int  ArcSegments (double r, double sweep, double tol);
+    // Точки дуги после начальной (начальная уже в контуре), sweep > 0 — против часовой
+    void AppendArc (Contour& out, const API_Coord& c, double r, double a0, double sweep, double tol);
+    // Многоугольник элемента (coords/pends/parcs memo, 1-based): первый контур — внешний, остальные — дыры
+    bool FromMemo (const API_Polygon& poly, const API_ElementMemo& memo, double tol, Polygon& out);
+
+    // a op b. Внутри набора многоугольники могут перекрываться — это их объединение;
+    // направление обхода входа не важно. Результат — по убыванию площади
+    bool Boolean (const GS::Array<Polygon>& a, const GS::Array<Polygon>& b, Op op, GS::Array<Polygon>& out);
+    bool Union (const GS::Array<Polygon>& polys, GS::Array<Polygon>& out);
+
+    // Правильный многоугольник: в каждом контуре ≥ 3 вершины без повторов, внешний против часовой,
+    // дыры по часовой и внутри внешнего, рёбра контуров не пересекаются и не касаются.
+    // Такой создаётся элементом с первого раза
+    bool IsRegular (const Polygon& poly);
+    // Привести к правильному виду до создания элемента: повторы вершин убраны, обход исправлен,
+    // самопересечения разрезаны («восьмёрка» — два многоугольника). Правильный возвращается как есть
+    bool Regularize (const Polygon& poly, GS::Array<Polygon>& out);
+
+    // Разрезать ломаную границей области: keepInside — куски строго внутри, иначе
+    // снаружи и на границе. Подряд идущие куски — одна ломаная; closed — последний
+    // кусок продолжает первый
+    bool ClipPolyline (const Contour& line, bool closed, const GS::Array<Polygon>& region, bool keepInside,
+                       GS::Array<Contour>& runs);
+}
+
+#endif // POLYGONHELPER_HPP
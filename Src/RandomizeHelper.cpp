@@ -0,0 +1,300 @@
+﻿#include "RandomizeHelper.hpp"
+#include "UndoScope.hpp"
+#include "Perf.hpp"
+#include "BrowserRepl.hpp"
+#include "SelectionHelper.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
+namespace RandomizeHelper {
+
+constexpr double PI = 3.14159265358979323846;
+
+static Settings g_settings;
+
+static inline void Log (const GS::UniString& s)
+{
+    if (BrowserRepl::HasInstance())
+        BrowserRepl::GetInstance().LogToBrowser(s);
+}
+
+// ---------------- Хэш ----------------
+// splitmix64: дешёвый и хорошо перемешивающий финализатор, одинаковый на всех платформах
+static inline UInt64 Mix64 (UInt64 x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// [0,1) из ключа, seed и номера канала (угол/масштаб/Z независимы друг от друга)
+static inline double Uniform01 (UInt64 key, UInt32 seed, UInt32 channel)
+{
+    const UInt64 h = Mix64(key ^ Mix64(((UInt64)seed << 8) | channel));
+    return (double)(h >> 11) * (1.0 / 9007199254740992.0); // 53 бита
+}
+
+UInt64 KeyFromGuid (const API_Guid& guid)
+{
+    static_assert(sizeof(API_Guid) == 16, "API_Guid layout");
+    UInt64 lo = 0, hi = 0;
+    std::memcpy(&lo, &guid, 8);
+    std::memcpy(&hi, reinterpret_cast<const char*>(&guid) + 8, 8);
+    return Mix64(lo ^ Mix64(hi));
+}
+
+UInt64 KeyFromGuidIndex (const API_Guid& guid, UInt32 index)
+{
+    return Mix64(KeyFromGuid(guid) + index);
+}
+
+// ---------------- Настройки ----------------
+void SetSettings (const Settings& s)
+{
+    g_settings = s;
+    if (g_settings.scaleMax < g_settings.scaleMin) std::swap(g_settings.scaleMin, g_settings.scaleMax);
+    if (g_settings.scaleMin <= 0.0) g_settings.scaleMin = 0.01;
+    if (g_settings.scaleMax <= 0.0) g_settings.scaleMax = 0.01;
+    g_settings.zJitterMM = std::fabs(g_settings.zJitterMM);
+
+    Log(GS::UniString::Printf("[Random] seed=%u angle=%.1fdeg scale=[%.3f..%.3f] z=+-%.1fmm",
+        (unsigned)g_settings.seed, g_settings.angleDeg, g_settings.scaleMin, g_settings.scaleMax, g_settings.zJitterMM));
+}
+
+const Settings& GetSettings ()
+{
+    return g_settings;
+}
+
+// ---------------- Выборка ----------------
+Sample SampleFor (UInt64 key, const Settings& s)
+{
+    Sample smp;
+
+    const double a = Uniform01(key, s.seed, 0);
+    if (s.angleDeg >= 360.0) {
+        smp.angleRad = a * 2.0 * PI;
+        smp.angleAbsolute = true;
+        smp.hasAngle = true;
+    } else if (s.angleDeg > 0.0) {
+        smp.angleRad = (2.0 * a - 1.0) * s.angleDeg * PI / 180.0;
+        smp.angleAbsolute = false;
+        smp.hasAngle = true;
+    }
+
+    smp.scale = s.scaleMin + (s.scaleMax - s.scaleMin) * Uniform01(key, s.seed, 1);
+    smp.dz = (2.0 * Uniform01(key, s.seed, 2) - 1.0) * s.zJitterMM / 1000.0;
+    return smp;
+}
+
+Sample SampleFor (UInt64 key)
+{
+    return SampleFor(key, g_settings);
+}
+
+// ---------------- Запись в элемент ----------------
+static inline double NewAngle (double current, const Sample& smp)
+{
+    return smp.angleAbsolute ? smp.angleRad : current + smp.angleRad;
+}
+
+bool ApplySample (API_Element& e, const API_Element& base, const Sample& smp, API_Element* mask)
+{
+    const bool hasScale = std::fabs(smp.scale - 1.0) > 1e-9;
+    const bool hasZ = std::fabs(smp.dz) > 1e-9;
+
+    switch (e.header.type.typeID) {
+    case API_ObjectID:
+        if (smp.hasAngle) {
+            e.object.angle = NewAngle(e.object.angle, smp);
+            if (mask) ACAPI_ELEMENT_MASK_SET(*mask, API_ObjectType, angle);
+        }
+        e.object.xRatio = base.object.xRatio * smp.scale;
+        e.object.yRatio = base.object.yRatio * smp.scale;
+        e.object.level = base.object.level + smp.dz;
+        if (mask && hasScale) { ACAPI_ELEMENT_MASK_SET(*mask, API_ObjectType, xRatio); ACAPI_ELEMENT_MASK_SET(*mask, API_ObjectType, yRatio); }
+        if (mask && hasZ) ACAPI_ELEMENT_MASK_SET(*mask, API_ObjectType, level);
+        return true;
+
+    case API_LampID:
+        if (smp.hasAngle) {
+            e.lamp.angle = NewAngle(e.lamp.angle, smp);
+            if (mask) ACAPI_ELEMENT_MASK_SET(*mask, API_LampType, angle);
+        }
+        e.lamp.xRatio = base.lamp.xRatio * smp.scale;
+        e.lamp.yRatio = base.lamp.yRatio * smp.scale;
+        e.lamp.level = base.lamp.level + smp.dz;
+        if (mask && hasScale) { ACAPI_ELEMENT_MASK_SET(*mask, API_LampType, xRatio); ACAPI_ELEMENT_MASK_SET(*mask, API_LampType, yRatio); }
+        if (mask && hasZ) ACAPI_ELEMENT_MASK_SET(*mask, API_LampType, level);
+        return true;
+
+    case API_ColumnID:
+        // масштаб и Z у колонн не трогаем — высота задаётся привязкой к этажам
+        if (smp.hasAngle) {
+            e.column.axisRotationAngle = NewAngle(e.column.axisRotationAngle, smp);
+            if (mask) ACAPI_ELEMENT_MASK_SET(*mask, API_ColumnType, axisRotationAngle);
+        }
+        return true;
+
+    case API_BeamID:
+        if (smp.hasAngle) {
+            // поворот балки в плоскости XY вокруг begC
+            const double dx = e.beam.endC.x - e.beam.begC.x;
+            const double dy = e.beam.endC.y - e.beam.begC.y;
+            const double len = std::hypot(dx, dy);
+            const double ang = NewAngle(std::atan2(dy, dx), smp);
+            e.beam.endC.x = e.beam.begC.x + len * std::cos(ang);
+            e.beam.endC.y = e.beam.begC.y + len * std::sin(ang);
+            if (mask) { ACAPI_ELEMENT_MASK_SET(*mask, API_BeamType, begC); ACAPI_ELEMENT_MASK_SET(*mask, API_BeamType, endC); }
+        }
+        e.beam.level = base.beam.level + smp.dz;
+        if (mask && hasZ) ACAPI_ELEMENT_MASK_SET(*mask, API_BeamType, level);
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+// ---------------- Исходные значения ----------------
+// Поля, которые меняет разброс. Для уже разбросанного элемента выборка считается от исходных
+// значений, а не от текущих, поэтому повторный запуск с тем же seed ничего не меняет.
+struct Fields {
+    double   angle = 0.0, xRatio = 1.0, yRatio = 1.0, level = 0.0;
+    API_Coord begC = {}, endC = {};
+};
+
+struct Remembered {
+    Fields original;   // до первого разброса
+    Fields applied;    // что записали последним разбросом
+};
+
+// Ключ — KeyFromGuid. Живёт до конца сессии; если элемент с тех пор правили вручную
+// (текущие значения не совпадают с applied), его текущие значения становятся новыми исходными.
+static std::unordered_map<UInt64, Remembered> g_remembered;
+
+static Fields Capture (const API_Element& e)
+{
+    Fields f;
+    switch (e.header.type.typeID) {
+    case API_ObjectID: f.angle = e.object.angle; f.xRatio = e.object.xRatio; f.yRatio = e.object.yRatio; f.level = e.object.level; break;
+    case API_LampID:   f.angle = e.lamp.angle;   f.xRatio = e.lamp.xRatio;   f.yRatio = e.lamp.yRatio;   f.level = e.lamp.level;   break;
+    case API_ColumnID: f.angle = e.column.axisRotationAngle; break;
+    case API_BeamID:   f.begC = e.beam.begC; f.endC = e.beam.endC; f.level = e.beam.level; break;
+    default: break;
+    }
+    return f;
+}
+
+static void Put (API_Element& e, const Fields& f, API_Element* mask)
+{
+    switch (e.header.type.typeID) {
+    case API_ObjectID:
+        e.object.angle = f.angle; e.object.xRatio = f.xRatio; e.object.yRatio = f.yRatio; e.object.level = f.level;
+        if (mask) {
+            ACAPI_ELEMENT_MASK_SET(*mask, API_ObjectType, angle); ACAPI_ELEMENT_MASK_SET(*mask, API_ObjectType, xRatio);
+            ACAPI_ELEMENT_MASK_SET(*mask, API_ObjectType, yRatio); ACAPI_ELEMENT_MASK_SET(*mask, API_ObjectType, level);
+        }
+        break;
+    case API_LampID:
+        e.lamp.angle = f.angle; e.lamp.xRatio = f.xRatio; e.lamp.yRatio = f.yRatio; e.lamp.level = f.level;
+        if (mask) {
+            ACAPI_ELEMENT_MASK_SET(*mask, API_LampType, angle); ACAPI_ELEMENT_MASK_SET(*mask, API_LampType, xRatio);
+            ACAPI_ELEMENT_MASK_SET(*mask, API_LampType, yRatio); ACAPI_ELEMENT_MASK_SET(*mask, API_LampType, level);
+        }
+        break;
+    case API_ColumnID:
+        e.column.axisRotationAngle = f.angle;
+        if (mask) ACAPI_ELEMENT_MASK_SET(*mask, API_ColumnType, axisRotationAngle);
+        break;
+    case API_BeamID:
+        e.beam.begC = f.begC; e.beam.endC = f.endC; e.beam.level = f.level;
+        if (mask) {
+            ACAPI_ELEMENT_MASK_SET(*mask, API_BeamType, begC); ACAPI_ELEMENT_MASK_SET(*mask, API_BeamType, endC);
+            ACAPI_ELEMENT_MASK_SET(*mask, API_BeamType, level);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static bool SameFields (const Fields& a, const Fields& b)
+{
+    const double eps = 1e-9;
+    return std::fabs(a.angle - b.angle) < eps && std::fabs(a.xRatio - b.xRatio) < eps &&
+           std::fabs(a.yRatio - b.yRatio) < eps && std::fabs(a.level - b.level) < eps &&
+           std::fabs(a.begC.x - b.begC.x) < eps && std::fabs(a.begC.y - b.begC.y) < eps &&
+           std::fabs(a.endC.x - b.endC.x) < eps && std::fabs(a.endC.y - b.endC.y) < eps;
+}
+
+// ---------------- Выделение ----------------
+bool RandomizeSelected (const Settings& s)
+{
+    return RandomizeElements(SelectionHelper::GetSelectedGuids(), s);
+}
+
+bool RandomizeElements (const GS::Array<API_Guid>& guids, const Settings& s)
+{
+    if (guids.IsEmpty()) return false;
+
+    // Сначала считаем все изменения, потом одна команда Undo с Change подряд
+    struct Pending { API_Element elem; API_Element mask; UInt64 key; Fields original; };
+    std::vector<Pending> pending;
+    pending.reserve(guids.GetSize());
+
+    UInt32 unchanged = 0;
+    for (const API_Guid& g : guids) {
+        Pending p = {};
+        p.elem.header.guid = g;
+        if (Perf::ElementGet(&p.elem) != NoError) continue;
+
+        ACAPI_ELEMENT_MASK_CLEAR(p.mask);
+        p.key = KeyFromGuid(g);
+        const Fields current = Capture(p.elem);
+        p.original = current;
+        auto it = g_remembered.find(p.key);
+        if (it != g_remembered.end() && SameFields(current, it->second.applied)) {
+            // уже разбросан нами и не тронут: считаем от исходных значений
+            p.original = it->second.original;
+            Put(p.elem, p.original, &p.mask);
+        }
+        const API_Element base = p.elem;
+        if (!ApplySample(p.elem, base, SampleFor(p.key, s), &p.mask)) continue;
+        if (SameFields(Capture(p.elem), current)) { ++unchanged; continue; }
+        pending.push_back(p);
+    }
+
+    if (pending.empty()) {
+        if (unchanged > 0)
+            Log(GS::UniString::Printf("[Random] nothing to change, %u already at seed=%u", (unsigned)unchanged, (unsigned)s.seed));
+        return unchanged > 0;
+    }
+
+    UInt32 changed = 0;
+    GSErrCode err = UndoScope::Call("Randomize Selected", [&]() -> GSErrCode {
+        for (Pending& p : pending) {
+            if (Perf::ElementChange(&p.elem, &p.mask, nullptr, 0, true) == NoError) {
+                ++changed;
+                g_remembered[p.key] = { p.original, Capture(p.elem) };
+            }
+        }
+        return NoError;
+    });
+
+    Log(GS::UniString::Printf("[Random] changed=%u of %u, unchanged=%u (seed=%u)",
+        (unsigned)changed, (unsigned)pending.size(), (unsigned)unchanged, (unsigned)s.seed));
+    return err == NoError;
+}
+
+bool RandomizeSelected ()
+{
+    return RandomizeSelected(g_settings);
+}
+
+} // namespace RandomizeHelper
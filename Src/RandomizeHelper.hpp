@@ -0,0 +1,54 @@
+﻿#ifndef RANDOMIZEHELPER_HPP
+#define RANDOMIZEHELPER_HPP
+
+#include "APIEnvir.h"
+#include "ACAPinc.h"
+#include "GSRoot.hpp"
+
+// ============================================================================
+// RandomizeHelper — детерминированный разброс угла/масштаба/Z
+// Значения зависят только от seed и ключа элемента (хэш GUID), поэтому
+// повторный запуск с тем же seed даёт тот же результат.
+// ============================================================================
+namespace RandomizeHelper {
+
+    struct Settings {
+        UInt32 seed = 1;
+        double angleDeg = 360.0;   // >=360 — случайный абсолютный угол, меньше — ±angleDeg к текущему, 0 — не трогать
+        double scaleMin = 1.0;     // масштаб A/B для объектов и светильников
+        double scaleMax = 1.0;
+        double zJitterMM = 0.0;    // ±мм к уровню (объекты, светильники, балки)
+    };
+
+    struct Sample {
+        double angleRad = 0.0;     // абсолютный угол или приращение (см. Settings::angleDeg)
+        bool   angleAbsolute = true;
+        bool   hasAngle = false;
+        double scale = 1.0;
+        double dz = 0.0;           // метры
+    };
+
+    void            SetSettings (const Settings& s);
+    const Settings& GetSettings ();
+
+    // Ключи: по GUID существующего элемента или по (GUID пути, номер станции) для новых
+    UInt64 KeyFromGuid (const API_Guid& guid);
+    UInt64 KeyFromGuidIndex (const API_Guid& guid, UInt32 index);
+
+    Sample SampleFor (UInt64 key);
+    Sample SampleFor (UInt64 key, const Settings& s);
+
+    // Записать выборку в элемент. Масштаб и Z всегда считаются от base (можно многократно
+    // применять к одной рабочей копии), угол — от текущего e. mask (если задан) дополняется изменёнными полями.
+    // Возвращает false для неподдерживаемых типов.
+    bool ApplySample (API_Element& e, const API_Element& base, const Sample& smp, API_Element* mask);
+
+    // Разброс для выделенных элементов одной командой Undo. Выборка считается от значений
+    // до первого разброса (запоминаются на сессию), повтор с тем же seed ничего не меняет.
+    bool RandomizeSelected ();
+    bool RandomizeSelected (const Settings& s);
+    bool RandomizeElements (const GS::Array<API_Guid>& guids, const Settings& s);
+
+}
+
+#endif // RANDOMIZEHELPER_HPP
@@ -0,0 +1,541 @@
+﻿#include "ReplEngine.hpp"
+#include "BrowserRepl.hpp"
+#include "UndoScope.hpp"
+#include "Perf.hpp"
+#include "CommandProtocol.hpp"
+#include "GroundHelper.hpp"
+#include "RotateHelper.hpp"
+#include "RandomizeHelper.hpp"
+#include "LayerHelper.hpp"
+#include "LandscapeHelper.hpp"
+#include "SelectionHelper.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <locale>
+#include <map>
+#include <sstream>
+#include <unordered_set>
+#include <vector>
+
+namespace ReplEngine {
+
+static inline void Log (const GS::UniString& s)
+{
+    if (BrowserRepl::HasInstance())
+        BrowserRepl::GetInstance().LogToBrowser(s);
+}
+
+static std::map<std::string, GS::Array<API_Guid>> g_named;
+
+void ClearNamedSets ()
+{
+    g_named.clear();
+}
+
+// ---------------- Типы элементов ----------------
+struct TypeWord { const char* word; API_ElemTypeID id; };
+
+static const TypeWord kTypeWords[] = {
+    { "object",   API_ObjectID },   { "lamp",     API_LampID },
+    { "column",   API_ColumnID },   { "beam",     API_BeamID },
+    { "mesh",     API_MeshID },     { "polyline", API_PolyLineID },
+    { "spline",   API_SplineID },   { "arc",      API_ArcID },
+    { "line",     API_LineID },     { "wall",     API_WallID },
+    { "slab",     API_SlabID },     { "shell",    API_ShellID },
+    { "morph",    API_MorphID },    { "zone",     API_ZoneID },
+};
+
+// "all" без типа — то, с чем работают помощники палитры
+static const API_ElemTypeID kDefaultAll[] = {
+    API_ObjectID, API_LampID, API_ColumnID, API_BeamID, API_MeshID,
+    API_PolyLineID, API_SplineID, API_ArcID, API_LineID,
+};
+
+static bool TypeFromWord (std::string w, API_ElemTypeID& out)
+{
+    if (w.size() > 1 && w.back() == 's') w.pop_back(); // objects, lamps, ...
+    for (const TypeWord& t : kTypeWords)
+        if (w == t.word) { out = t.id; return true; }
+    return false;
+}
+
+// ---------------- Разбор ----------------
+enum class OpKind {
+    Select, All, Layer, Type, Save, Load, Add, Minus, Clear, Count, Show,
+    Surface, Land, ZDelta, Rotate, RotateRandom, Align, Random,
+    ToLayer, Id, Paths, Proto, Distribute, Cmd
+};
+
+struct Op {
+    OpKind                      kind = OpKind::Count;
+    int                         line = 0;
+    double                      num = 0.0;
+    int                         count = 0;
+    std::string                 text;            // имя набора/слоя/команды, ID
+    std::vector<API_ElemTypeID> types;
+    RandomizeHelper::Settings   random;
+    std::vector<std::pair<std::string, std::string>> kv; // аргументы cmd
+};
+
+using Tokens = std::vector<std::string>;
+
+static std::string Lower (std::string s)
+{
+    for (char& c : s) if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+    return s;
+}
+
+// число: "1.5", "1,5", "-0.2"; разбор в локали "C" — strtod в русской локали ждёт запятую
+static bool ParseNumber (const std::string& s, double& out)
+{
+    std::string t = s;
+    std::replace(t.begin(), t.end(), ',', '.');
+    if (t.empty()) return false;
+    std::istringstream in(t);
+    in.imbue(std::locale::classic());
+    in >> out;
+    return !in.fail() && in.peek() == std::char_traits<char>::eof() && std::isfinite(out);
+}
+
+// строка скрипта → операторы; кавычки "..." сохраняют пробелы, ';' и '#'
+static bool SplitLine (const std::string& line, std::vector<Tokens>& stmts, std::string& err)
+{
+    Tokens cur;
+    std::string tok;
+    bool inQuote = false, hasTok = false;
+
+    auto flushTok = [&]() { if (hasTok) cur.push_back(tok); tok.clear(); hasTok = false; };
+    auto flushStmt = [&]() { flushTok(); if (!cur.empty()) stmts.push_back(cur); cur.clear(); };
+
+    for (size_t i = 0; i < line.size(); ++i) {
+        const char c = line[i];
+        if (inQuote) {
+            if (c == '"') inQuote = false;
+            else tok += c;
+            continue;
+        }
+        if (c == '"')                  { inQuote = true; hasTok = true; }
+        else if (c == '#')             break;
+        else if (c == ';')             flushStmt();
+        else if (c == ' ' || c == '\t' || c == '\r') flushTok();
+        else                           { tok += c; hasTok = true; }
+    }
+    if (inQuote) { err = "unterminated quote"; return false; }
+    flushStmt();
+    return true;
+}
+
+// key=value → пара; false, если '=' нет
+static bool SplitKv (const std::string& t, std::string& k, std::string& v)
+{
+    const size_t eq = t.find('=');
+    if (eq == std::string::npos || eq == 0) return false;
+    k = Lower(t.substr(0, eq));
+    v = t.substr(eq + 1);
+    return true;
+}
+
+static bool CompileStmt (const Tokens& t, Op& op, std::string& err)
+{
+    const std::string w = Lower(t[0]);
+    const size_t argc = t.size() - 1;
+
+    auto needArgs = [&](size_t lo, size_t hi) {
+        if (argc >= lo && argc <= hi) return true;
+        err = "'" + w + "' expects " + (lo == hi ? std::to_string(lo) : std::to_string(lo) + ".." + std::to_string(hi)) + " argument(s)";
+        return false;
+    };
+    auto numArg = [&](size_t i, double& out) {
+        if (ParseNumber(t[i], out)) return true;
+        err = "'" + w + "': bad number '" + t[i] + "'";
+        return false;
+    };
+    auto typeArgs = [&]() {
+        for (size_t i = 1; i < t.size(); ++i) {
+            API_ElemTypeID id;
+            if (!TypeFromWord(Lower(t[i]), id)) { err = "unknown type '" + t[i] + "'"; return false; }
+            op.types.push_back(id);
+        }
+        return true;
+    };
+
+    if (w == "select")  { op.kind = OpKind::Select;  return needArgs(0, 0); }
+    if (w == "clear")   { op.kind = OpKind::Clear;   return needArgs(0, 0); }
+    if (w == "count")   { op.kind = OpKind::Count;   return needArgs(0, 0); }
+    if (w == "show")    { op.kind = OpKind::Show;    return needArgs(0, 0); }
+    if (w == "surface") { op.kind = OpKind::Surface; return needArgs(0, 0); }
+    if (w == "align")   { op.kind = OpKind::Align;   return needArgs(0, 0); }
+    if (w == "paths")   { op.kind = OpKind::Paths;   return needArgs(0, 0); }
+    if (w == "proto")   { op.kind = OpKind::Proto;   return needArgs(0, 0); }
+
+    if (w == "all")  { op.kind = OpKind::All;  return typeArgs(); }
+    if (w == "type") { op.kind = OpKind::Type; return needArgs(1, 32) && typeArgs(); }
+
+    if (w == "layer" || w == "save" || w == "load" || w == "add" || w == "minus" || w == "tolayer" || w == "id") {
+        if (!needArgs(1, 1)) return false;
+        op.text = t[1];
+        op.kind = (w == "layer") ? OpKind::Layer : (w == "save") ? OpKind::Save : (w == "load") ? OpKind::Load
+                : (w == "add") ? OpKind::Add : (w == "minus") ? OpKind::Minus : (w == "tolayer") ? OpKind::ToLayer : OpKind::Id;
+        if (op.kind == OpKind::ToLayer && op.text.find_last_of('/') == op.text.size() - 1) { err = "empty layer name"; return false; }
+        return true;
+    }
+
+    if (w == "land") {
+        op.kind = OpKind::Land;
+        return needArgs(0, 1) && (argc == 0 || numArg(1, op.num));
+    }
+    if (w == "zdelta") {
+        op.kind = OpKind::ZDelta;
+        return needArgs(1, 1) && numArg(1, op.num);
+    }
+    if (w == "rotate") {
+        if (!needArgs(1, 1)) return false;
+        if (Lower(t[1]) == "random") { op.kind = OpKind::RotateRandom; return true; }
+        op.kind = OpKind::Rotate;
+        return numArg(1, op.num);
+    }
+    if (w == "random") {
+        op.kind = OpKind::Random;
+        op.random = RandomizeHelper::Settings(); // значения по умолчанию; seed — из текущих настроек при запуске
+        op.count = 0;                            // 1 — seed задан явно
+        for (size_t i = 1; i < t.size(); ++i) {
+            std::string k, v; double d = 0.0;
+            if (!SplitKv(t[i], k, v) || !ParseNumber(v, d)) { err = "'random': expected key=number, got '" + t[i] + "'"; return false; }
+            if (k == "seed")       { op.random.seed = (UInt32)std::llround(d); op.count = 1; }
+            else if (k == "angle") op.random.angleDeg = d;
+            else if (k == "smin")  op.random.scaleMin = d;
+            else if (k == "smax")  op.random.scaleMax = d;
+            else if (k == "z")     op.random.zJitterMM = d;
+            else { err = "'random': unknown key '" + k + "'"; return false; }
+        }
+        return true;
+    }
+    if (w == "distribute") {
+        op.kind = OpKind::Distribute;
+        for (size_t i = 1; i < t.size(); ++i) {
+            std::string k, v; double d = 0.0;
+            if (!SplitKv(t[i], k, v) || !ParseNumber(v, d)) { err = "'distribute': expected step= or count=, got '" + t[i] + "'"; return false; }
+            if (k == "step")       op.num = d;
+            else if (k == "count") op.count = (int)std::llround(d);
+            else { err = "'distribute': unknown key '" + k + "'"; return false; }
+        }
+        if (op.num <= 0.0 && op.count <= 0) { err = "'distribute' needs step= or count="; return false; }
+        return true;
+    }
+    if (w == "cmd") {
+        if (argc < 1) { err = "'cmd' expects a command name"; return false; }
+        op.kind = OpKind::Cmd;
+        op.text = t[1];
+        if (CommandProtocol::Find(op.text) == nullptr) { err = "unknown command '" + op.text + "'"; return false; }
+        for (size_t i = 2; i < t.size(); ++i) {
+            std::string k, v;
+            if (!SplitKv(t[i], k, v)) { err = "'cmd': expected key=value, got '" + t[i] + "'"; return false; }
+            op.kv.emplace_back(t[i].substr(0, t[i].find('=')), v); // ключи команд регистрозависимы
+        }
+        return true;
+    }
+
+    err = "unknown statement '" + t[0] + "'";
+    return false;
+}
+
+static bool Compile (const std::string& script, std::vector<Op>& ops, std::string& err)
+{
+    int lineNo = 0;
+    size_t pos = 0;
+    while (pos <= script.size()) {
+        size_t nl = script.find('\n', pos);
+        if (nl == std::string::npos) nl = script.size();
+        const std::string line = script.substr(pos, nl - pos);
+        pos = nl + 1;
+        ++lineNo;
+
+        std::vector<Tokens> stmts;
+        std::string e;
+        if (!SplitLine(line, stmts, e)) { err = "line " + std::to_string(lineNo) + ": " + e; return false; }
+        for (const Tokens& t : stmts) {
+            Op op;
+            op.line = lineNo;
+            if (!CompileStmt(t, op, e)) { err = "line " + std::to_string(lineNo) + ": " + e; return false; }
+            ops.push_back(std::move(op));
+        }
+    }
+    return true;
+}
+
+// ---------------- Выполнение ----------------
+struct Machine {
+    GS::Array<API_Guid> set;
+};
+
+struct GuidHash {
+    size_t operator() (const API_Guid& g) const { return (size_t)RandomizeHelper::KeyFromGuid(g); }
+};
+using GuidSet = std::unordered_set<API_Guid, GuidHash>;
+
+static GS::UniString LayerName (const API_AttributeIndex& idx)
+{
+    API_Attribute attr = {};
+    attr.header.typeID = API_LayerID;
+    attr.header.index = idx;
+    GS::UniString name;
+    attr.header.uniStringNamePtr = &name;
+    if (ACAPI_Attribute_Get(&attr) != NoError) return GS::UniString();
+    return name;
+}
+
+static void FilterSet (GS::Array<API_Guid>& set, const std::function<bool (const API_Elem_Head&)>& keep)
+{
+    GS::Array<API_Guid> out;
+    for (const API_Guid& g : set) {
+        API_Elem_Head h = {}; h.guid = g;
+        if (ACAPI_Element_GetHeader(&h) == NoError && keep(h)) out.Push(g);
+    }
+    set = out;
+}
+
+static void Unite (GS::Array<API_Guid>& set, const GS::Array<API_Guid>& other)
+{
+    GuidSet seen;
+    for (const API_Guid& g : set) seen.insert(g);
+    for (const API_Guid& g : other)
+        if (seen.insert(g).second) set.Push(g);
+}
+
+static void Subtract (GS::Array<API_Guid>& set, const GS::Array<API_Guid>& other)
+{
+    GuidSet drop;
+    for (const API_Guid& g : other) drop.insert(g);
+    GS::Array<API_Guid> out;
+    for (const API_Guid& g : set)
+        if (drop.find(g) == drop.end()) out.Push(g);
+    set = out;
+}
+
+static bool Exec (const Op& op, Machine& m, std::string& err)
+{
+    auto needSet = [&]() {
+        if (!m.set.IsEmpty()) return true;
+        err = "working set is empty";
+        return false;
+    };
+
+    switch (op.kind) {
+    case OpKind::Select:
+        m.set = SelectionHelper::GetSelectedGuids();
+        return true;
+
+    case OpKind::All: {
+        m.set.Clear();
+        std::vector<API_ElemTypeID> types = op.types;
+        if (types.empty()) types.assign(std::begin(kDefaultAll), std::end(kDefaultAll));
+        for (API_ElemTypeID t : types) {
+            GS::Array<API_Guid> list;
+            if (ACAPI_Element_GetElemList(API_ElemType(t), &list, APIFilt_IsEditable) == NoError)
+                m.set.Append(list);
+        }
+        return true;
+    }
+
+    case OpKind::Layer: {
+        const GS::UniString want = CommandProtocol::FromUtf8(op.text);
+        // решение по индексу слоя — одно чтение атрибута на слой
+        std::vector<std::pair<API_AttributeIndex, bool>> match;
+        FilterSet(m.set, [&](const API_Elem_Head& h) {
+            for (const auto& e : match)
+                if (e.first == h.layer) return e.second;
+            match.emplace_back(h.layer, LayerName(h.layer) == want);
+            return match.back().second;
+        });
+        return true;
+    }
+
+    case OpKind::Type:
+        FilterSet(m.set, [&](const API_Elem_Head& h) {
+            return std::find(op.types.begin(), op.types.end(), h.type.typeID) != op.types.end();
+        });
+        return true;
+
+    case OpKind::Save:  g_named[op.text] = m.set; return true;
+    case OpKind::Clear: m.set.Clear(); return true;
+
+    case OpKind::Load:
+    case OpKind::Add:
+    case OpKind::Minus: {
+        auto it = g_named.find(op.text);
+        if (it == g_named.end()) { err = "no saved set '" + op.text + "'"; return false; }
+        if (op.kind == OpKind::Load)     m.set = it->second;
+        else if (op.kind == OpKind::Add) Unite(m.set, it->second);
+        else                             Subtract(m.set, it->second);
+        return true;
+    }
+
+    case OpKind::Count:
+        Log(GS::UniString::Printf("[REPL] line %d: set=%u", op.line, (unsigned)m.set.GetSize()));
+        return true;
+
+    case OpKind::Show: {
+        ACAPI_Selection_DeselectAll();
+        GS::Array<API_Neig> neigs;
+        for (const API_Guid& g : m.set) neigs.Push(API_Neig(g));
+        if (!neigs.IsEmpty()) ACAPI_Selection_Select(neigs, true);
+        return true;
+    }
+
+    case OpKind::Surface:
+        for (const API_Guid& g : m.set) {
+            API_Elem_Head h = {}; h.guid = g;
+            if (ACAPI_Element_GetHeader(&h) != NoError || h.type.typeID != API_MeshID) continue;
+            if (GroundHelper::SetGroundSurfaceByGuid(g)) return true;
+            err = "mesh rejected";
+            return false;
+        }
+        err = "no mesh in set";
+        return false;
+
+    case OpKind::Land:
+        if (!needSet()) return false;
+        if (!GroundHelper::SetGroundObjectsByGuids(m.set)) { err = "no landable elements in set"; return false; }
+        if (!GroundHelper::ApplyGroundOffset(op.num)) { err = "land failed (surface set?)"; return false; }
+        return true;
+
+    case OpKind::ZDelta:
+        if (!needSet()) return false;
+        if (!GroundHelper::ApplyZDeltaToElements(m.set, op.num)) { err = "zdelta changed nothing"; return false; }
+        return true;
+
+    case OpKind::Rotate:
+        if (!needSet()) return false;
+        if (!RotateHelper::RotateElements(m.set, op.num)) { err = "rotate changed nothing"; return false; }
+        return true;
+
+    case OpKind::Align:
+        if (!needSet()) return false;
+        if (!RotateHelper::AlignElementsX(m.set)) { err = "align changed nothing"; return false; }
+        return true;
+
+    case OpKind::RotateRandom:
+    case OpKind::Random: {
+        if (!needSet()) return false;
+        RandomizeHelper::Settings s = op.random;
+        if (op.kind == OpKind::RotateRandom) { s = RandomizeHelper::Settings(); s.angleDeg = 360.0; }
+        if (op.count == 0) s.seed = RandomizeHelper::GetSettings().seed;
+        if (s.scaleMax < s.scaleMin) std::swap(s.scaleMin, s.scaleMax);
+        if (!RandomizeHelper::RandomizeElements(m.set, s)) { err = "random changed nothing"; return false; }
+        return true;
+    }
+
+    case OpKind::ToLayer: {
+        if (!needSet()) return false;
+        const size_t slash = op.text.find_last_of('/');
+        const GS::UniString folder = (slash == std::string::npos) ? GS::UniString() : CommandProtocol::FromUtf8(op.text.substr(0, slash));
+        const GS::UniString name = CommandProtocol::FromUtf8(slash == std::string::npos ? op.text : op.text.substr(slash + 1));
+        API_AttributeIndex idx;
+        if (!LayerHelper::CreateLayer(folder, name, idx)) { err = "cannot create layer '" + op.text + "'"; return false; }
+        if (!LayerHelper::MoveElementsToLayer(m.set, idx)) { err = "move to layer failed"; return false; }
+        return true;
+    }
+
+    case OpKind::Id:
+        if (!needSet()) return false;
+        if (!LayerHelper::ChangeElementsID(m.set, CommandProtocol::FromUtf8(op.text))) { err = "id change failed"; return false; }
+        return true;
+
+    case OpKind::Paths:
+        if (!LandscapeHelper::SetDistributionPaths(m.set)) { err = "no paths in set"; return false; }
+        return true;
+
+    case OpKind::Proto:
+        for (const API_Guid& g : m.set)
+            if (LandscapeHelper::SetDistributionProto(g)) return true;
+        err = "no object/lamp/column/beam in set";
+        return false;
+
+    case OpKind::Distribute:
+        // созданные элементы помощник не возвращает — набор не меняется
+        if (!LandscapeHelper::DistributeSelected(op.num, op.count)) { err = "distribute failed (paths/proto set?)"; return false; }
+        return true;
+
+    case OpKind::Cmd: {
+        JsonLite::Value c = JsonLite::Value::Object();
+        c.Set("cmd", JsonLite::Value::String(op.text));
+        JsonLite::Value& args = c.Set("args", JsonLite::Value::Object());
+        for (const auto& kv : op.kv) args.Set(kv.first.c_str(), JsonLite::Value::String(kv.second));
+        const JsonLite::Value r = CommandProtocol::RunOne(c);
+        if (r.Find("ok")->AsBool()) return true;
+        const JsonLite::Value* e = r.Find("error");
+        err = op.text + ": " + ((e != nullptr && e->IsString()) ? e->AsString() : std::string("failed"));
+        return false;
+    }
+    }
+    err = "internal: bad op";
+    return false;
+}
+
+// ---------------- API ----------------
+GS::UniString Check (const GS::UniString& script)
+{
+    std::vector<Op> ops;
+    std::string err;
+    Compile(CommandProtocol::ToUtf8(script), ops, err);
+    return CommandProtocol::FromUtf8(err);
+}
+
+Result Run (const GS::UniString& script)
+{
+    Perf::CommandScope perf("RunScript");
+    const auto t0 = std::chrono::steady_clock::now();
+    Result res;
+
+    std::vector<Op> ops;
+    std::string err;
+    if (!Compile(CommandProtocol::ToUtf8(script), ops, err)) {
+        res.error = CommandProtocol::FromUtf8(err);
+        Log("[REPL] " + res.error);
+        return res;
+    }
+
+    Machine m;
+    const GSErrCode undoErr = UndoScope::Call("REPL Script", [&]() -> GSErrCode {
+        for (const Op& op : ops) {
+            if (!Exec(op, m, err)) {
+                err = "line " + std::to_string(op.line) + ": " + err;
+                return NoError; // выполненные шаги остаются в одной команде Undo
+            }
+            ++res.ops;
+        }
+        return NoError;
+    });
+    // команда Undo не открылась (идёт другая команда, проект только для чтения) — ничего не выполнено
+    if (undoErr != NoError && err.empty())
+        err = "undoable command failed, err=" + std::to_string((int)undoErr);
+
+    res.ok = err.empty();
+    res.error = CommandProtocol::FromUtf8(err);
+    res.setSize = (UInt32)m.set.GetSize();
+    res.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    Log(GS::UniString::Printf("[REPL] %u/%u ops, set=%u, %.1f ms", (unsigned)res.ops, (unsigned)ops.size(),
+        (unsigned)res.setSize, res.ms) + (res.ok ? GS::UniString() : " | " + res.error));
+    return res;
+}
+
+JsonLite::Value ToJson (const Result& r)
+{
+    JsonLite::Value v = JsonLite::Value::Object();
+    v.Set("ok", JsonLite::Value::Bool(r.ok));
+    v.Set("ops", JsonLite::Value::Number(r.ops));
+    v.Set("ms", JsonLite::Value::Number(std::round(r.ms * 1000.0) / 1000.0));
+    v.Set("set", JsonLite::Value::Number(r.setSize));
+    if (!r.ok) v.Set("error", JsonLite::Value::String(CommandProtocol::ToUtf8(r.error)));
+    return v;
+}
+
+std::string RunJson (const std::string& scriptUtf8)
+{
+    return JsonLite::ToString(ToJson(Run(CommandProtocol::FromUtf8(scriptUtf8))));
+}
+
+} // namespace ReplEngine
@@ -0,0 +1,59 @@
+﻿#ifndef REPLENGINE_HPP
+#define REPLENGINE_HPP
+
+#include "APIEnvir.h"
+#include "ACAPinc.h"
+#include "GSRoot.hpp"
+#include "JsonLite.hpp"
+
+#include <string>
+
+// ============================================================================
+// ReplEngine — маленький язык команд палитры. Скрипт целиком разбирается до
+// запуска (ошибка — с номером строки, ничего не выполняется), затем все шаги
+// идут подряд в одной команде Undo. Рабочий набор элементов и именованные
+// наборы живут в C++ и не передаются в JS.
+//
+//   select                      набор = текущее выделение
+//   all [тип...]                набор = все элементы (объекты, лампы, колонны, балки, mesh, линии)
+//   layer "Имя" / type тип...   фильтры набора
+//   save NAME / load NAME / add NAME / minus NAME / clear
+//   count / show                лог размера / выделить набор в Archicad
+//   surface                     первый mesh набора — поверхность
+//   land [offset]               посадить набор на поверхность (offset, м)
+//   zdelta m                    сдвиг по Z, м
+//   rotate deg | rotate random | align
+//   random seed= angle= smin= smax= z=
+//   tolayer "Папка/Слой" / id "BASE"
+//   paths / proto / distribute step=мм | count=N
+//   cmd Имя key=value ...       любая команда CommandProtocol
+// Разделители — перевод строки и ';', комментарий — '#'.
+// ============================================================================
+namespace ReplEngine {
+
+    struct Result {
+        bool          ok = false;
+        UInt32        ops = 0;     // выполнено шагов
+        double        ms = 0.0;
+        UInt32        setSize = 0; // размер рабочего набора после скрипта
+        GS::UniString error;       // "line N: ..." при ошибке
+    };
+
+    // Разобрать и выполнить скрипт одной командой Undo
+    Result Run (const GS::UniString& script);
+
+    // Только разбор (проверка синтаксиса); пустая строка — без ошибок
+    GS::UniString Check (const GS::UniString& script);
+
+    // Результат как JSON {"ok","ops","ms","set","error"}
+    JsonLite::Value ToJson (const Result& r);
+
+    // Run с ответом JSON (текст UTF-8)
+    std::string RunJson (const std::string& scriptUtf8);
+
+    // Именованные наборы (save/load) — общие для всех запусков
+    void ClearNamedSets ();
+
+}
+
+#endif // REPLENGINE_HPP
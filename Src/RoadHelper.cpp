@@ -1,4 +1,6 @@
 #include "RoadHelper.hpp"
+#include "UndoScope.hpp"
+#include "Perf.hpp"
 
 #include "BrowserRepl.hpp"
 #include "GroundHelper.hpp"
@@ -177,7 +179,7 @@ namespace RoadHelper {
         if (totalLen) *totalLen = 0.0;
 
         API_Element e = {}; e.header.guid = pathGuid;
-        if (ACAPI_Element_Get(&e) != NoError) return false;
+        if (Perf::ElementGet(&e) != NoError) return false;
 
         switch (e.header.type.typeID) {
         case API_LineID:
@@ -204,7 +206,7 @@ namespace RoadHelper {
 
         case API_PolyLineID: {
             API_ElementMemo memo = {};
-            if (ACAPI_Element_GetMemo(pathGuid, &memo) == NoError && memo.coords != nullptr) {
+            if (Perf::ElementGetMemo(pathGuid, &memo) == NoError && memo.coords != nullptr) {
                 const Int32 nAll = (Int32)(BMGetHandleSize((GSHandle)memo.coords) / sizeof(API_Coord));
                 const Int32 nPts = std::max<Int32>(0, nAll - 1);
                 if (nPts >= 2) {
@@ -222,7 +224,7 @@ namespace RoadHelper {
         case API_SplineID: {
             // Кубические Безье по bezierDirs
             API_ElementMemo memo = {};
-            if (ACAPI_Element_GetMemo(pathGuid, &memo, APIMemoMask_Polygon) == NoError &&
+            if (Perf::ElementGetMemo(pathGuid, &memo, APIMemoMask_Polygon) == NoError &&
                 memo.coords != nullptr && memo.bezierDirs != nullptr)
             {
                 const Int32 n = (Int32)(BMGetHandleSize((GSHandle)memo.coords) / sizeof(API_Coord));
@@ -302,7 +304,7 @@ namespace RoadHelper {
 
         API_Element el = {};
         el.header.guid = guid;
-        if (ACAPI_Element_Get(&el) != NoError) {
+        if (Perf::ElementGet(&el) != NoError) {
             Log("[RoadHelper] CollectAxisPoints2D: не смогли прочитать элемент оси");
             return false;
         }
@@ -365,7 +367,7 @@ namespace RoadHelper {
         case API_PolyLineID:
         case API_SplineID: {
             API_ElementMemo memo = {};
-            if (ACAPI_Element_GetMemo(guid, &memo, APIMemoMask_Polygon) == NoError &&
+            if (Perf::ElementGetMemo(guid, &memo, APIMemoMask_Polygon) == NoError &&
                 memo.coords != nullptr)
             {
                 const Int32 nAll = (Int32)(BMGetHandleSize((GSHandle)memo.coords) / sizeof(API_Coord));
@@ -493,8 +495,8 @@ namespace RoadHelper {
         lineEl.line.begC = a;
         lineEl.line.endC = b;
 
-        const GSErrCode e = ACAPI_CallUndoableCommand("Create Road Line", [&]() -> GSErrCode {
-            return ACAPI_Element_Create(&lineEl, nullptr);
+        const GSErrCode e = UndoScope::Call("Create Road Line", [&]() -> GSErrCode {
+            return Perf::ElementCreate(&lineEl, nullptr);
             });
 
         if (e == NoError) {
@@ -556,7 +558,7 @@ namespace RoadHelper {
         // Получаем информацию об элементе для определения правильного neigID
         API_Element sourceEl = {};
         sourceEl.header.guid = sourceGuid;
-        if (ACAPI_Element_Get(&sourceEl) != NoError) {
+        if (Perf::ElementGet(&sourceEl) != NoError) {
             Log("[RoadHelper] ERROR: не удалось прочитать исходный элемент");
             return APINULLGuid;
         }
@@ -636,7 +638,7 @@ namespace RoadHelper {
         // Для дуг и кругов используем специальный алгоритм с построением перпендикуляров
         API_Element el = {};
         el.header.guid = sourceGuid;
-        if (ACAPI_Element_Get(&el) == NoError && 
+        if (Perf::ElementGet(&el) == NoError && 
             (el.header.type.typeID == API_ArcID || el.header.type.typeID == API_CircleID)) {
             
             // Используем алгоритм с перпендикулярами для дуг
@@ -695,7 +697,7 @@ namespace RoadHelper {
         const double rightOffsetX = -nx * halfWidthM;
         const double rightOffsetY = -ny * halfWidthM;
 
-        GSErrCode err = ACAPI_CallUndoableCommand("Copy Road Lines", [&]() -> GSErrCode {
+        GSErrCode err = UndoScope::Call("Copy Road Lines", [&]() -> GSErrCode {
             leftGuid = CopyElementWithOffset(sourceGuid, leftOffsetX, leftOffsetY);
             rightGuid = CopyElementWithOffset(sourceGuid, rightOffsetX, rightOffsetY);
             
@@ -772,7 +774,7 @@ namespace RoadHelper {
         // Определяем тип линии
         API_Element el = {};
         el.header.guid = g_centerLineGuid;
-        if (ACAPI_Element_Get(&el) != NoError) {
+        if (Perf::ElementGet(&el) != NoError) {
             Log("[RoadHelper] ERROR: не удалось прочитать элемент");
             return false;
         }
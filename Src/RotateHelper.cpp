@@ -1,5 +1,7 @@
 ﻿#include "RotateHelper.hpp"
-#include <random>
+#include "RandomizeHelper.hpp"
+#include "BatchModifyHelper.hpp"
+#include "SelectionHelper.hpp"
 #include <cmath>
 
 constexpr double PI = 3.14159265358979323846;
@@ -7,217 +9,106 @@ constexpr double DegToRad(double deg) { return deg * PI / 180.0; }
 
 namespace RotateHelper {
 
-// ---------------- Поворот ----------------
-bool RotateSelected (double angleDeg)
-{
-    if (fabs(angleDeg) < 1e-6) return false;
-
-    API_SelectionInfo selInfo = {};
-    GS::Array<API_Neig> selNeigs;
-    ACAPI_Selection_Get(&selInfo, &selNeigs, false, false);
-    BMKillHandle((GSHandle*)&selInfo.marquee.coords);
+// ---------------- Угол в плане ----------------
+// Чистые функции над копией элемента — вызываются из параллельного расчёта BatchModifyHelper
 
-    if (selNeigs.IsEmpty()) return false;
+static bool GetPlanAngle (const API_Element& e, double& outAngle)
+{
+    switch (e.header.type.typeID) {
+    case API_ColumnID: outAngle = e.column.axisRotationAngle; return true;
+    case API_ObjectID: outAngle = e.object.angle;             return true;
+    case API_LampID:   outAngle = e.lamp.angle;               return true;
+    case API_BeamID:   outAngle = std::atan2(e.beam.endC.y - e.beam.begC.y, e.beam.endC.x - e.beam.begC.x); return true;
+    default:           return false;
+    }
+}
 
-    const double addRad = DegToRad(angleDeg);
+static bool GetPlanPos (const API_Element& e, API_Coord& outPos)
+{
+    switch (e.header.type.typeID) {
+    case API_ObjectID: outPos = e.object.pos; return true;
+    case API_LampID:   outPos = e.lamp.pos;   return true;
+    case API_ColumnID: outPos.x = e.column.origoPos.x; outPos.y = e.column.origoPos.y; return true;
+    case API_BeamID:   outPos = e.beam.begC;  return true;  // Используем начальную точку балки
+    default:           return false;
+    }
+}
 
-    GSErrCode err = ACAPI_CallUndoableCommand("Rotate Selected", [&]() -> GSErrCode {
-        for (const API_Neig& n : selNeigs) {
-            API_Element element = {};
-            element.header.guid = n.guid;
-            if (ACAPI_Element_Get(&element) != NoError) continue;
+static bool SetPlanAngle (API_Element& e, BatchModifyHelper::FieldMask& mask, double newAngle)
+{
+    switch (e.header.type.typeID) {
+    case API_ColumnID:
+        e.column.axisRotationAngle = newAngle;
+        BATCH_MASK_SET(mask, API_ColumnType, axisRotationAngle);
+        return true;
+    case API_ObjectID:
+        e.object.angle = newAngle;
+        BATCH_MASK_SET(mask, API_ObjectType, angle);
+        return true;
+    case API_LampID:
+        e.lamp.angle = newAngle;
+        BATCH_MASK_SET(mask, API_LampType, angle);
+        return true;
+    case API_BeamID: {
+        // Поворот балки в плоскости XY - меняем направление begC -> endC (memo для этого не нужен)
+        const double dx = e.beam.endC.x - e.beam.begC.x;
+        const double dy = e.beam.endC.y - e.beam.begC.y;
+        const double beamLength = std::hypot(dx, dy);
+        e.beam.endC.x = e.beam.begC.x + beamLength * std::cos(newAngle);
+        e.beam.endC.y = e.beam.begC.y + beamLength * std::sin(newAngle);
+        BATCH_MASK_SET(mask, API_BeamType, begC);
+        BATCH_MASK_SET(mask, API_BeamType, endC);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
 
-            API_Element mask; ACAPI_ELEMENT_MASK_CLEAR(mask);
+// ---------------- Поворот ----------------
+bool RotateSelected (double angleDeg)
+{
+    return RotateElements(SelectionHelper::GetSelectedGuids(), angleDeg);
+}
 
-            API_ElementMemo memo{};
-            bool needsMemo = false;
-            bool hasMemo = false;
-            
-            switch (element.header.type.typeID) {
-            case API_ColumnID:
-                element.column.axisRotationAngle += addRad;
-                ACAPI_ELEMENT_MASK_SET(mask, API_ColumnType, axisRotationAngle);
-                break;
-            case API_ObjectID:
-                element.object.angle += addRad;
-                ACAPI_ELEMENT_MASK_SET(mask, API_ObjectType, angle);
-                break;
-            case API_LampID:
-                element.lamp.angle += addRad;
-                ACAPI_ELEMENT_MASK_SET(mask, API_LampType, angle);
-                break;
-            case API_BeamID: {
-                // Поворот балки в плоскости XY - меняем направление begC -> endC
-                const double dx = element.beam.endC.x - element.beam.begC.x;
-                const double dy = element.beam.endC.y - element.beam.begC.y;
-                const double beamLength = std::hypot(dx, dy);
-                const double currentAngle = std::atan2(dy, dx);
-                const double newAngle = currentAngle + addRad;
-                
-                element.beam.endC.x = element.beam.begC.x + beamLength * std::cos(newAngle);
-                element.beam.endC.y = element.beam.begC.y + beamLength * std::sin(newAngle);
-                
-                ACAPI_ELEMENT_MASK_SET(mask, API_BeamType, begC);
-                ACAPI_ELEMENT_MASK_SET(mask, API_BeamType, endC);
-                needsMemo = true;
-                hasMemo = (ACAPI_Element_GetMemo(n.guid, &memo, APIMemoMask_All) == NoError);
-                break;
-            }
-            default:
-                continue;
-            }
-            
-            if (needsMemo && hasMemo) {
-                (void)ACAPI_Element_Change(&element, &mask, &memo, 0, true);
-                ACAPI_DisposeElemMemoHdls(&memo);
-            } else {
-                (void)ACAPI_Element_Change(&element, &mask, nullptr, 0, true);
-            }
-        }
-        return NoError;
-    });
+bool RotateElements (const GS::Array<API_Guid>& guids, double angleDeg)
+{
+    if (fabs(angleDeg) < 1e-6) return false;
+    if (guids.IsEmpty()) return false;
 
-    return err == NoError;
+    const double addRad = DegToRad(angleDeg);
+    return BatchModifyHelper::Run("Rotate Selected", "[Rotate]", guids,
+        [addRad](BatchModifyHelper::Item& it) -> bool {
+            double cur = 0.0;
+            if (!GetPlanAngle(it.elem, cur)) return false;
+            return SetPlanAngle(it.elem, it.mask, cur + addRad);
+        });
 }
 
 // ---------------- Выравнивание по X ----------------
 bool AlignSelectedX ()
 {
-    API_SelectionInfo selInfo = {};
-    GS::Array<API_Neig> selNeigs;
-    ACAPI_Selection_Get(&selInfo, &selNeigs, false, false);
-    BMKillHandle((GSHandle*)&selInfo.marquee.coords);
-
-    if (selNeigs.IsEmpty()) return false;
-
-    GSErrCode err = ACAPI_CallUndoableCommand("Align to X", [&]() -> GSErrCode {
-        for (const API_Neig& n : selNeigs) {
-            API_Element element = {};
-            element.header.guid = n.guid;
-            if (ACAPI_Element_Get(&element) != NoError) continue;
-
-            API_Element mask; ACAPI_ELEMENT_MASK_CLEAR(mask);
+    return AlignElementsX(SelectionHelper::GetSelectedGuids());
+}
 
-            API_ElementMemo memo{};
-            bool needsMemo = false;
-            bool hasMemo = false;
-            
-            switch (element.header.type.typeID) {
-            case API_ColumnID: 
-                element.column.axisRotationAngle = 0.0; 
-                ACAPI_ELEMENT_MASK_SET(mask, API_ColumnType, axisRotationAngle); 
-                break;
-            case API_ObjectID: 
-                element.object.angle = 0.0; 
-                ACAPI_ELEMENT_MASK_SET(mask, API_ObjectType, angle); 
-                break;
-            case API_LampID:   
-                element.lamp.angle = 0.0;   
-                ACAPI_ELEMENT_MASK_SET(mask, API_LampType, angle); 
-                break;
-            case API_BeamID: {
-                // Выравнивание балки по X - поворачиваем в плоскости XY
-                const double dx = element.beam.endC.x - element.beam.begC.x;
-                const double dy = element.beam.endC.y - element.beam.begC.y;
-                const double beamLength = std::hypot(dx, dy);
-                
-                element.beam.endC.x = element.beam.begC.x + beamLength; // Вдоль оси X
-                element.beam.endC.y = element.beam.begC.y;              // Y не меняется
-                
-                ACAPI_ELEMENT_MASK_SET(mask, API_BeamType, begC);
-                ACAPI_ELEMENT_MASK_SET(mask, API_BeamType, endC);
-                needsMemo = true;
-                hasMemo = (ACAPI_Element_GetMemo(n.guid, &memo, APIMemoMask_All) == NoError);
-                break;
-            }
-            default: 
-                continue;
-            }
-            
-            if (needsMemo && hasMemo) {
-                (void)ACAPI_Element_Change(&element, &mask, &memo, 0, true);
-                ACAPI_DisposeElemMemoHdls(&memo);
-            } else {
-                (void)ACAPI_Element_Change(&element, &mask, nullptr, 0, true);
-            }
-        }
-        return NoError;
-    });
+bool AlignElementsX (const GS::Array<API_Guid>& guids)
+{
+    if (guids.IsEmpty()) return false;
 
-    return err == NoError;
+    return BatchModifyHelper::Run("Align to X", "[AlignX]", guids,
+        [](BatchModifyHelper::Item& it) -> bool {
+            return SetPlanAngle(it.elem, it.mask, 0.0);
+        });
 }
 
 // ---------------- Случайные углы ----------------
+// Угол 0..360 по хэшу GUID и текущему seed (RandomizeHelper) — повторный вызов даёт тот же результат
 bool RandomizeSelectedAngles ()
 {
-    API_SelectionInfo selInfo = {};
-    GS::Array<API_Neig> selNeigs;
-    ACAPI_Selection_Get(&selInfo, &selNeigs, false, false);
-    BMKillHandle((GSHandle*)&selInfo.marquee.coords);
-
-    if (selNeigs.IsEmpty()) return false;
-
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<double> dist(0.0, 2.0 * PI);
-
-    GSErrCode err = ACAPI_CallUndoableCommand("Randomize angles", [&]() -> GSErrCode {
-        for (const API_Neig& n : selNeigs) {
-            API_Element element = {};
-            element.header.guid = n.guid;
-            if (ACAPI_Element_Get(&element) != NoError) continue;
-
-            const double rnd = dist(gen);
-
-            API_Element mask; ACAPI_ELEMENT_MASK_CLEAR(mask);
-
-            API_ElementMemo memo{};
-            bool needsMemo = false;
-            bool hasMemo = false;
-            
-            switch (element.header.type.typeID) {
-            case API_ObjectID: 
-                element.object.angle = rnd; 
-                ACAPI_ELEMENT_MASK_SET(mask, API_ObjectType, angle); 
-                break;
-            case API_LampID:   
-                element.lamp.angle = rnd;   
-                ACAPI_ELEMENT_MASK_SET(mask, API_LampType, angle); 
-                break;
-            case API_ColumnID: 
-                element.column.axisRotationAngle = rnd; 
-                ACAPI_ELEMENT_MASK_SET(mask, API_ColumnType, axisRotationAngle); 
-                break;
-            case API_BeamID: {
-                // Случайный поворот балки в плоскости XY
-                const double dx = element.beam.endC.x - element.beam.begC.x;
-                const double dy = element.beam.endC.y - element.beam.begC.y;
-                const double beamLength = std::hypot(dx, dy);
-                
-                element.beam.endC.x = element.beam.begC.x + beamLength * std::cos(rnd);
-                element.beam.endC.y = element.beam.begC.y + beamLength * std::sin(rnd);
-                
-                ACAPI_ELEMENT_MASK_SET(mask, API_BeamType, begC);
-                ACAPI_ELEMENT_MASK_SET(mask, API_BeamType, endC);
-                needsMemo = true;
-                hasMemo = (ACAPI_Element_GetMemo(n.guid, &memo, APIMemoMask_All) == NoError);
-                break;
-            }
-            default: 
-                continue;
-            }
-            
-            if (needsMemo && hasMemo) {
-                (void)ACAPI_Element_Change(&element, &mask, &memo, 0, true);
-                ACAPI_DisposeElemMemoHdls(&memo);
-            } else {
-                (void)ACAPI_Element_Change(&element, &mask, nullptr, 0, true);
-            }
-        }
-        return NoError;
-    });
-
-    return err == NoError;
+    RandomizeHelper::Settings s;
+    s.seed = RandomizeHelper::GetSettings().seed;
+    s.angleDeg = 360.0;
+    return RandomizeHelper::RandomizeSelected(s);
 }
 
 // ---------------- Ориентация на точку ----------------
@@ -228,80 +119,16 @@ bool OrientObjectsToPoint ()
     if (ACAPI_UserInput_GetPoint(&pt) != NoError) return false;
     const API_Coord target = { pt.pos.x, pt.pos.y };
 
-    API_SelectionInfo selInfo = {};
-    GS::Array<API_Neig> selNeigs;
-    ACAPI_Selection_Get(&selInfo, &selNeigs, false, false);
-    BMKillHandle((GSHandle*)&selInfo.marquee.coords);
-
-    if (selNeigs.IsEmpty()) return false;
-
-    GSErrCode err = ACAPI_CallUndoableCommand("Orient Objects to Point", [&]() -> GSErrCode {
-        for (const API_Neig& n : selNeigs) {
-            API_Element element = {};
-            element.header.guid = n.guid;
-            if (ACAPI_Element_Get(&element) != NoError) continue;
+    const GS::Array<API_Guid> guids = SelectionHelper::GetSelectedGuids();
+    if (guids.IsEmpty()) return false;
 
+    return BatchModifyHelper::Run("Orient Objects to Point", "[OrientToPoint]", guids,
+        [target](BatchModifyHelper::Item& it) -> bool {
             API_Coord objPos = {};
-            switch (element.header.type.typeID) {
-            case API_ObjectID: objPos = element.object.pos; break;
-            case API_LampID:   objPos = element.lamp.pos;   break;
-            case API_ColumnID: objPos.x = element.column.origoPos.x; objPos.y = element.column.origoPos.y; break;
-            case API_BeamID:   objPos = element.beam.begC; break;  // Используем начальную точку балки
-            default: continue;
-            }
-
-            const double dx = target.x - objPos.x;
-            const double dy = target.y - objPos.y;
-            const double newAngle = std::atan2(dy, dx);
-
-            API_Element mask; ACAPI_ELEMENT_MASK_CLEAR(mask);
-            API_ElementMemo memo{};
-            bool needsMemo = false;
-            bool hasMemo = false;
-            
-            switch (element.header.type.typeID) {
-            case API_ObjectID: 
-                element.object.angle = newAngle; 
-                ACAPI_ELEMENT_MASK_SET(mask, API_ObjectType, angle); 
-                break;
-            case API_LampID:   
-                element.lamp.angle = newAngle;   
-                ACAPI_ELEMENT_MASK_SET(mask, API_LampType, angle);   
-                break;
-            case API_ColumnID: 
-                element.column.axisRotationAngle = newAngle; 
-                ACAPI_ELEMENT_MASK_SET(mask, API_ColumnType, axisRotationAngle); 
-                break;
-            case API_BeamID: {
-                // Ориентация балки в плоскости XY - направляем begC -> endC к целевой точке
-                const double beamDx = element.beam.endC.x - element.beam.begC.x;
-                const double beamDy = element.beam.endC.y - element.beam.begC.y;
-                const double beamLength = std::hypot(beamDx, beamDy);
-                
-                element.beam.endC.x = element.beam.begC.x + beamLength * std::cos(newAngle);
-                element.beam.endC.y = element.beam.begC.y + beamLength * std::sin(newAngle);
-                
-                ACAPI_ELEMENT_MASK_SET(mask, API_BeamType, begC);
-                ACAPI_ELEMENT_MASK_SET(mask, API_BeamType, endC);
-                needsMemo = true;
-                hasMemo = (ACAPI_Element_GetMemo(n.guid, &memo, APIMemoMask_All) == NoError);
-                break;
-            }
-            default: 
-                continue;
-            }
-            
-            if (needsMemo && hasMemo) {
-                (void)ACAPI_Element_Change(&element, &mask, &memo, 0, true);
-                ACAPI_DisposeElemMemoHdls(&memo);
-            } else {
-                (void)ACAPI_Element_Change(&element, &mask, nullptr, 0, true);
-            }
-        }
-        return NoError;
-    });
-
-    return err == NoError;
+            if (!GetPlanPos(it.elem, objPos)) return false;
+            const double newAngle = std::atan2(target.y - objPos.y, target.x - objPos.x);
+            return SetPlanAngle(it.elem, it.mask, newAngle);
+        });
 }
 
 } // namespace RotateHelper
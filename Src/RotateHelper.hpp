@@ -13,6 +13,10 @@ namespace RotateHelper {
     // Выравнивание по оси X (угол = 0)
     bool AlignSelectedX ();
 
+    // То же для готового списка GUID
+    bool RotateElements (const GS::Array<API_Guid>& guids, double angleDeg);
+    bool AlignElementsX (const GS::Array<API_Guid>& guids);
+
     // Случайные углы для выделенных
     bool RandomizeSelectedAngles ();
 
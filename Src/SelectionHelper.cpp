@@ -1,46 +1,133 @@
 ﻿#include "SelectionHelper.hpp"
+#include "UndoScope.hpp"
+
+#include <vector>
 
 namespace SelectionHelper {
 
+// ---------------- Кэши имён слоёв и типов ----------------
+// Слоёв и типов в выделении немного, а спрашиваются они для каждого элемента.
+// Сброс: смена проекта (BrowserRepl), операции со слоями (LayerHelper), ResyncSelection
+// и изменение количества слоёв (проверяется один раз на запрос).
+struct LayerNameEntry { API_AttributeIndex index; GS::UniString name; };
+struct TypeNameEntry  { API_ElemType type; GS::UniString name; };
+
+static std::vector<LayerNameEntry> g_layerNames;
+static std::vector<TypeNameEntry>  g_typeNames;
+static GS::UInt32                  g_layerCount = 0;
+
+void InvalidateCaches ()
+{
+    g_layerNames.clear();
+    g_typeNames.clear();
+    g_layerCount = 0;
+}
+
+static void ValidateLayerCache ()
+{
+    GS::UInt32 layerCount = 0;
+    if (ACAPI_Attribute_GetNum(API_LayerID, layerCount) != NoError || layerCount != g_layerCount) {
+        g_layerNames.clear();
+        g_layerCount = layerCount;
+    }
+}
+
+static const GS::UniString& GetLayerNameCached (const API_AttributeIndex& layer)
+{
+    for (const LayerNameEntry& e : g_layerNames)
+        if (e.index == layer) return e.name;
+
+    LayerNameEntry entry { layer, GS::UniString() };
+    API_Attribute layerAttr = {};
+    layerAttr.header.typeID = API_LayerID;
+    layerAttr.header.index = layer;
+    if (ACAPI_Attribute_Get(&layerAttr) == NoError)
+        entry.name = layerAttr.header.name;
+    g_layerNames.push_back(entry);
+    return g_layerNames.back().name;
+}
+
+static const GS::UniString& GetTypeNameCached (const API_ElemType& type)
+{
+    for (const TypeNameEntry& e : g_typeNames)
+        if (e.type == type) return e.name;
+
+    TypeNameEntry entry { type, GS::UniString() };
+    GS::UniString typeName;
+    if (ACAPI_Element_GetElemTypeName(type, typeName) == NoError)
+        entry.name = typeName;
+    g_typeNames.push_back(entry);
+    return g_typeNames.back().name;
+}
+
+// ---------------- Информация об одном элементе ----------------
+static bool FillElementInfo (const API_Guid& guid, ElementInfo& elemInfo)
+{
+    API_Elem_Head elemHead = {};
+    elemHead.guid = guid;
+    if (ACAPI_Element_GetHeader(&elemHead) != NoError)
+        return false;
+
+    elemInfo.guidStr = APIGuidToString(elemHead.guid);
+
+    elemInfo.typeName = GetTypeNameCached(elemHead.type);
+
+    // ID — единственное, что читается для каждого элемента помимо заголовка
+    GS::UniString elemID;
+    if (ACAPI_Element_GetElementInfoString(&elemHead.guid, &elemID) == NoError)
+        elemInfo.elemID = elemID;
+
+    elemInfo.layerName = GetLayerNameCached(elemHead.layer);
+    return true;
+}
+
 // ---------------- Получить список выделенных элементов ----------------
 GS::Array<ElementInfo> GetSelectedElements ()
+{
+    ValidateLayerCache();
+    GS::Array<ElementInfo> selectedElements;
+    for (const API_Guid& guid : GetSelectedGuids()) {
+        ElementInfo elemInfo;
+        if (FillElementInfo(guid, elemInfo))
+            selectedElements.Push(elemInfo);
+    }
+    return selectedElements;
+}
+
+// ---------------- GUID-ы выделения ----------------
+GS::Array<API_Guid> GetSelectedGuids ()
 {
     API_SelectionInfo selectionInfo = {};
     GS::Array<API_Neig> selNeigs;
     ACAPI_Selection_Get(&selectionInfo, &selNeigs, false, false);
     BMKillHandle((GSHandle*)&selectionInfo.marquee.coords);
 
-    GS::Array<ElementInfo> selectedElements;
+    GS::Array<API_Guid> guids;
+    guids.SetCapacity(selNeigs.GetSize());
+    for (const API_Neig& neig : selNeigs)
+        guids.Push(neig.guid);
+    return guids;
+}
 
-    for (const API_Neig& neig : selNeigs) {
-        API_Elem_Head elemHead = {};
-        elemHead.guid = neig.guid;
-        if (ACAPI_Element_GetHeader(&elemHead) != NoError)
-            continue;
+// ---------------- Информация по списку GUID ----------------
+GS::Array<ElementInfo> GetElementsInfo (const GS::UniString& guidList)
+{
+    ValidateLayerCache();
+    GS::Array<ElementInfo> result;
+    GS::Array<GS::UniString> parts;
+    guidList.Split(GS::UniString(","), [&parts](const GS::UniString& part) {
+        parts.Push(part);
+    });
+    for (const GS::UniString& part : parts) {
+        const API_Guid guid = APIGuidFromString(part.ToCStr().Get());
+        if (guid == APINULLGuid) continue;
 
         ElementInfo elemInfo;
-        elemInfo.guidStr = APIGuidToString(elemHead.guid);
-
-        GS::UniString typeName;
-        if (ACAPI_Element_GetElemTypeName(elemHead.type, typeName) == NoError)
-            elemInfo.typeName = typeName;
-
-        GS::UniString elemID;
-        if (ACAPI_Element_GetElementInfoString(&elemHead.guid, &elemID) == NoError)
-            elemInfo.elemID = elemID;
-
-        // Получить информацию о слое
-        API_Attribute layerAttr = {};
-        layerAttr.header.typeID = API_LayerID;
-        layerAttr.header.index = elemHead.layer;
-        if (ACAPI_Attribute_Get(&layerAttr) == NoError) {
-            elemInfo.layerName = layerAttr.header.name;
-        }
-
-        selectedElements.Push(elemInfo);
+        if (!FillElementInfo(guid, elemInfo))
+            elemInfo.guidStr = part; // элемент уже удалён — отдаём пустую запись, чтобы страница не ждала
+        result.Push(elemInfo);
     }
-
-    return selectedElements;
+    return result;
 }
 
 // ---------------- Изменить выделение ----------------
@@ -71,7 +158,7 @@ bool ChangeSelectedElementsID (const GS::UniString& baseID)
     if (selNeigs.IsEmpty()) return false;
 
     // Используем Undo-группу для возможности отмены
-    GSErrCode err = ACAPI_CallUndoableCommand("Change Elements ID", [&]() -> GSErrCode {
+    GSErrCode err = UndoScope::Call("Change Elements ID", [&]() -> GSErrCode {
         for (UIndex i = 0; i < selNeigs.GetSize(); ++i) {
             // Создаем новый ID: baseID-01, baseID-02, etc.
             GS::UniString newID = baseID;
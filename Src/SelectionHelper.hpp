@@ -19,6 +19,15 @@ namespace SelectionHelper {
     // Получить список выделенных элементов
     GS::Array<ElementInfo> GetSelectedElements ();
 
+    // GUID-ы текущего выделения
+    GS::Array<API_Guid> GetSelectedGuids ();
+
+    // Информация по списку GUID (постраничная подгрузка в палитре); GUID-ы через запятую
+    GS::Array<ElementInfo> GetElementsInfo (const GS::UniString& guidList);
+
+    // Сбросить кэши имён слоёв/типов (смена проекта, изменение слоёв)
+    void InvalidateCaches ();
+
     // Добавить или удалить элемент по GUID
     void ModifySelection (const GS::UniString& elemGuidStr, SelectionModification modification);
 
@@ -5,12 +5,17 @@
 #include "APIdefs_Elements.h"
 #include "APIdefs_Goodies.h"
 #include "ShellHelper.hpp"
+#include "UndoScope.hpp"
+#include "Perf.hpp"
 #include "LandscapeHelper.hpp"
 #include "GroundHelper.hpp"
+#include "OffsetHelper.hpp"
+#include "PolygonHelper.hpp"
 #include "BrowserRepl.hpp"
 #include <cstdarg>
 #include <cmath>
 #include <algorithm>
+#include <functional>
 #include <limits>
 #include <unordered_map>
 
@@ -70,11 +75,76 @@ bool SetBaseLineForShell()
 }
 
 // =============== ТЕСТОВАЯ ФУНКЦИЯ СОЗДАНИЯ MESH ===============
+// =============== Memo контура Mesh ===============
+// Внешний контур и дыры замыкаются повтором первой точки (coords/pends/meshPolyZ 1-based),
+// Z — в каждой вершине. Контур должен быть уже правильным (PolygonHelper::Regularize),
+// тогда Mesh создаётся с первого раза. memo освобождает вызывающий и при ошибке
+static GSErrCode FillMeshMemo(const PolygonHelper::Polygon& poly, const std::function<double (const API_Coord&)>& zAt,
+                              API_Element& mesh, API_ElementMemo& memo)
+{
+    GS::Array<const GS::Array<API_Coord>*> rings;
+    rings.Push(&poly.outer);
+    for (const auto& h : poly.holes)
+        rings.Push(&h);
+
+    const Int32 nSubPolys = (Int32)rings.GetSize();
+    Int32 nCoords = 0;
+    for (const auto* r : rings)
+        nCoords += (Int32)r->GetSize() + 1;
+
+    BNZeroMemory(&memo, sizeof(API_ElementMemo));
+    memo.coords = reinterpret_cast<API_Coord**>(BMAllocateHandle((nCoords + 1) * (GSSize)sizeof(API_Coord), ALLOCATE_CLEAR, 0));
+    memo.pends = reinterpret_cast<Int32**>(BMAllocateHandle((nSubPolys + 1) * (GSSize)sizeof(Int32), ALLOCATE_CLEAR, 0));
+    memo.meshPolyZ = reinterpret_cast<double**>(BMAllocateHandle((nCoords + 1) * (GSSize)sizeof(double), ALLOCATE_CLEAR, 0));
+    if (memo.coords == nullptr || memo.pends == nullptr || memo.meshPolyZ == nullptr)
+        return APIERR_MEMFULL;
+
+    Int32 idx = 0;
+    for (Int32 k = 0; k < nSubPolys; ++k) {
+        const Int32 first = idx + 1;
+        for (const API_Coord& c : *rings[k]) {
+            ++idx;
+            (*memo.coords)[idx] = c;
+            (*memo.meshPolyZ)[idx] = zAt(c);
+        }
+        ++idx;
+        (*memo.coords)[idx] = (*memo.coords)[first];        // замкнуть
+        (*memo.meshPolyZ)[idx] = (*memo.meshPolyZ)[first];
+        (*memo.pends)[k + 1] = idx;
+    }
+
+    mesh.mesh.poly.nCoords = nCoords;
+    mesh.mesh.poly.nSubPolys = nSubPolys;
+    mesh.mesh.poly.nArcs = 0;
+    return NoError;
+}
+
+// Z точки на замкнутом контуре с высотами в вершинах: линейно по ближайшему ребру
+static double ZOnContour(const GS::Array<API_Coord>& pts, const GS::Array<double>& z, const API_Coord& p)
+{
+    double bestD = std::numeric_limits<double>::max(), bestZ = z.IsEmpty() ? 0.0 : z[0];
+    const UIndex n = pts.GetSize();
+    for (UIndex i = 0; i < n; ++i) {
+        const API_Coord& a = pts[i];
+        const API_Coord& b = pts[(i + 1) % n];
+        const double dx = b.x - a.x, dy = b.y - a.y;
+        const double l2 = dx * dx + dy * dy;
+        double t = (l2 > kEPS * kEPS) ? ((p.x - a.x) * dx + (p.y - a.y) * dy) / l2 : 0.0;
+        t = std::max(0.0, std::min(1.0, t));
+        const double ex = a.x + dx * t - p.x, ey = a.y + dy * t - p.y;
+        const double d = ex * ex + ey * ey;
+        if (d < bestD) {
+            bestD = d;
+            bestZ = z[i] + (z[(i + 1) % n] - z[i]) * t;
+        }
+    }
+    return bestZ;
+}
+
 bool CreateTestMesh()
 {
-    Log("[ShellHelper] ТЕСТ: Создаем MESH ТОЧНО КАК В ПРИМЕРЕ Element_Test!");
+    Log("[ShellHelper] ТЕСТ: Создаем MESH по контуру из примера Element_Test");
     
-    // Создаем MESH элемент ТОЧНО КАК В ПРИМЕРЕ
     API_Element element = {};
     element.header.type = API_MeshID;
     GSErrCode err = ACAPI_Element_GetDefaults(&element, nullptr);
@@ -83,106 +153,42 @@ bool CreateTestMesh()
         return false;
     }
     
-    // Настройки ТОЧНО КАК В ПРИМЕРЕ
-    element.mesh.poly.nCoords = 5;
-    element.mesh.poly.nSubPolys = 1;
-    element.mesh.poly.nArcs = 0;
-    
-    Log("[ShellHelper] ТЕСТ: MESH настройки: nCoords=5, nSubPolys=1, nArcs=0");
+    // Контур из примера самопересекается («восьмёрка»), Z в вершинах 1..4
+    PolygonHelper::Polygon test;
+    test.outer.Push({ 0.0, 0.0 });
+    test.outer.Push({ 5.0, 3.0 });
+    test.outer.Push({ 5.0, 0.0 });
+    test.outer.Push({ 0.0, 2.0 });
+    GS::Array<double> testZ;
+    testZ.Push(1.0);
+    testZ.Push(2.0);
+    testZ.Push(3.0);
+    testZ.Push(4.0);
+    
+    // Регуляризуем до создания: «восьмёрка» распадается на два правильных контура,
+    // точка самопересечения получает Z по ребру исходного контура
+    GS::Array<PolygonHelper::Polygon> pieces;
+    if (!PolygonHelper::Regularize(test, pieces)) {
+        Log("[ShellHelper] ТЕСТ ERROR: контур не удалось регуляризовать");
+        return false;
+    }
+    Log("[ShellHelper] ТЕСТ: контур регуляризован, %d полигонов", (int)pieces.GetSize());
     
-    // Создаем memo ТОЧНО КАК В ПРИМЕРЕ
-    API_ElementMemo memo = {};
-    memo.coords = reinterpret_cast<API_Coord**>(BMAllocateHandle((element.mesh.poly.nCoords + 1) * sizeof(API_Coord), ALLOCATE_CLEAR, 0));
-    memo.pends = reinterpret_cast<Int32**>(BMAllocateHandle((element.mesh.poly.nSubPolys + 1) * sizeof(Int32), ALLOCATE_CLEAR, 0));
-    memo.parcs = reinterpret_cast<API_PolyArc**>(BMAllocateHandle(element.mesh.poly.nArcs * sizeof(API_PolyArc), ALLOCATE_CLEAR, 0));
-    memo.meshPolyZ = reinterpret_cast<double**>(BMAllocateHandle((element.mesh.poly.nCoords + 1) * sizeof(double), ALLOCATE_CLEAR, 0));
-    
-    // Координаты ТОЧНО КАК В ПРИМЕРЕ (прямоугольник)
-    (*memo.coords)[1].x = 0.0;
-    (*memo.coords)[1].y = 0.0;
-    (*memo.coords)[2].x = 5.0;
-    (*memo.coords)[2].y = 3.0;
-    (*memo.coords)[3].x = 5.0;
-    (*memo.coords)[3].y = 0.0;
-    (*memo.coords)[4].x = 0.0;
-    (*memo.coords)[4].y = 2.0;
-    (*memo.coords)[element.mesh.poly.nCoords] = (*memo.coords)[1]; // Замыкаем полигон
-    
-    (*memo.pends)[1] = element.mesh.poly.nCoords;
-    
-    // Z-координаты ТОЧНО КАК В ПРИМЕРЕ
-    (*memo.meshPolyZ)[1] = 1.0;
-    (*memo.meshPolyZ)[2] = 2.0;
-    (*memo.meshPolyZ)[3] = 3.0;
-    (*memo.meshPolyZ)[4] = 4.0;
-    (*memo.meshPolyZ)[5] = (*memo.meshPolyZ)[1]; // Замыкаем Z-координаты
-    
-    Log("[ShellHelper] ТЕСТ: Заполнены координаты и Z-координаты ТОЧНО КАК В ПРИМЕРЕ");
-    
-    // Создаем MESH ТОЧНО КАК В ПРИМЕРЕ
-    err = ACAPI_Element_Create(&element, &memo);
-    if (err == APIERR_IRREGULARPOLY) {
-        Log("[ShellHelper] ТЕСТ: Полигон нерегулярный, регуляризуем ТОЧНО КАК В ПРИМЕРЕ...");
-        
-        API_RegularizedPoly poly = {};
-        poly.coords = memo.coords;
-        poly.pends = memo.pends;
-        poly.parcs = memo.parcs;
-        poly.vertexIDs = memo.vertexIDs;
-        poly.needVertexAncestry = 1;
-        
-        Int32 nResult = 0;
-        API_RegularizedPoly** polys = nullptr;
-        GSErrCode regErr = ACAPI_Polygon_RegularizePolygon(&poly, &nResult, &polys);
-        
-        if (regErr != NoError) {
-            Log("[ShellHelper] ТЕСТ ERROR: ACAPI_Polygon_RegularizePolygon failed, err=%d", (int)regErr);
-            ACAPI_DisposeElemMemoHdls(&memo);
-            return false;
-        }
-        
-        if (regErr == NoError) {
-            Log("[ShellHelper] ТЕСТ: Регуляризация успешна, создаем %d полигонов", (int)nResult);
-            
-            for (Int32 i = 0; i < nResult && err == NoError; i++) {
-                element.mesh.poly.nCoords = BMhGetSize(reinterpret_cast<GSHandle>((*polys)[i].coords)) / sizeof(API_Coord) - 1;
-                element.mesh.poly.nSubPolys = BMhGetSize(reinterpret_cast<GSHandle>((*polys)[i].pends)) / sizeof(Int32) - 1;
-                element.mesh.poly.nArcs = BMhGetSize(reinterpret_cast<GSHandle>((*polys)[i].parcs)) / sizeof(API_PolyArc);
-                
-                API_ElementMemo tmpMemo = {};
-                tmpMemo.coords = (*polys)[i].coords;
-                tmpMemo.pends = (*polys)[i].pends;
-                tmpMemo.parcs = (*polys)[i].parcs;
-                tmpMemo.vertexIDs = (*polys)[i].vertexIDs;
-                
-                tmpMemo.meshPolyZ = reinterpret_cast<double**>(BMAllocateHandle((element.mesh.poly.nCoords + 1) * sizeof(double), ALLOCATE_CLEAR, 0));
-                if (tmpMemo.meshPolyZ != nullptr) {
-                    for (Int32 j = 1; j <= element.mesh.poly.nCoords; j++) {
-                        Int32 oldVertexIndex = 1; // Упрощенная логика
-                        if (oldVertexIndex <= 5) {
-                            (*tmpMemo.meshPolyZ)[j] = (*memo.meshPolyZ)[oldVertexIndex];
-                        } else {
-                            (*tmpMemo.meshPolyZ)[j] = 0.0;
-                        }
-                    }
-                    
-                    err = ACAPI_Element_Create(&element, &tmpMemo);
-                    if (err != NoError) {
-                        Log("[ShellHelper] ТЕСТ ERROR: ACAPI_Element_Create piece %d failed, err=%d", (int)i, (int)err);
-                    }
-                    BMKillHandle(reinterpret_cast<GSHandle*>(&tmpMemo.meshPolyZ));
-                }
-            }
-        }
+    for (UIndex i = 0; i < pieces.GetSize() && err == NoError; ++i) {
+        API_ElementMemo memo = {};
+        err = FillMeshMemo(pieces[i], [&](const API_Coord& c) { return ZOnContour(test.outer, testZ, c); }, element, memo);
+        if (err == NoError)
+            err = Perf::ElementCreate(&element, &memo);
+        ACAPI_DisposeElemMemoHdls(&memo);
+        if (err != NoError)
+            Log("[ShellHelper] ТЕСТ ERROR: ACAPI_Element_Create piece %d failed, err=%d", (int)i, (int)err);
     }
     
     if (err == NoError) {
-        Log("[ShellHelper] ТЕСТ SUCCESS: MESH создан ТОЧНО КАК В ПРИМЕРЕ!");
-        ACAPI_DisposeElemMemoHdls(&memo);
+        Log("[ShellHelper] ТЕСТ SUCCESS: MESH создан, %d полигонов", (int)pieces.GetSize());
         return true;
     } else {
         Log("[ShellHelper] ТЕСТ ERROR: Не удалось создать MESH, err=%d", (int)err);
-        ACAPI_DisposeElemMemoHdls(&memo);
         return false;
     }
 }
@@ -243,7 +249,7 @@ bool CreateShellFromLine(double widthMM, double stepMM)
     // Получаем данные элемента
     API_Element element = {};
     element.header = elemHead;
-    err = ACAPI_Element_Get(&element);
+    err = Perf::ElementGet(&element);
     
     if (err != NoError) {
         Log("[ShellHelper] ERROR: Не удалось получить данные элемента базовой линии");
@@ -395,7 +401,7 @@ bool CreatePerpendicularLines(const API_Element& baseLine, double widthMM)
         dx, dy, perpX, perpY, halfWidth);
     
     // Создаем две перпендикулярные линии
-    ACAPI_CallUndoableCommand("Create Shell Lines", [&] () -> GSErrCode {
+    UndoScope::Call("Create Shell Lines", [&] () -> GSErrCode {
         
         // Левая линия
         API_Element leftLine = {};
@@ -416,7 +422,7 @@ bool CreatePerpendicularLines(const API_Element& baseLine, double widthMM)
             leftLine.line.begC.x, leftLine.line.begC.y, 
             leftLine.line.endC.x, leftLine.line.endC.y);
         
-        err = ACAPI_Element_Create(&leftLine, nullptr);
+        err = Perf::ElementCreate(&leftLine, nullptr);
         if (err != NoError) {
             Log("[ShellHelper] ERROR: Не удалось создать левую линию, err=%d", (int)err);
             return err;
@@ -441,7 +447,7 @@ bool CreatePerpendicularLines(const API_Element& baseLine, double widthMM)
             rightLine.line.begC.x, rightLine.line.begC.y, 
             rightLine.line.endC.x, rightLine.line.endC.y);
         
-        err = ACAPI_Element_Create(&rightLine, nullptr);
+        err = Perf::ElementCreate(&rightLine, nullptr);
         if (err != NoError) {
             Log("[ShellHelper] ERROR: Не удалось создать правую линию, err=%d", (int)err);
             return err;
@@ -622,7 +628,7 @@ bool ParseElementToSegments(const API_Element& element, PathData& path)
     else if (element.header.type == API_PolyLineID) {
             API_ElementMemo memo;
             BNZeroMemory(&memo, sizeof(memo));
-            GSErrCode err = ACAPI_Element_GetMemo(element.header.guid, &memo);
+            GSErrCode err = Perf::ElementGetMemo(element.header.guid, &memo);
             if (err != NoError || memo.coords == nullptr) {
                 ACAPI_DisposeElemMemoHdls(&memo);
                 Log("[ShellHelper] ERROR: Не удалось получить memo для полилинии");
@@ -718,7 +724,7 @@ bool ParseElementToSegments(const API_Element& element, PathData& path)
         // Базовая поддержка сплайнов - пока создаем простую линию
         API_ElementMemo memo;
         BNZeroMemory(&memo, sizeof(memo));
-        GSErrCode err = ACAPI_Element_GetMemo(element.header.guid, &memo);
+        GSErrCode err = Perf::ElementGetMemo(element.header.guid, &memo);
         if (err != NoError || memo.coords == nullptr) {
             ACAPI_DisposeElemMemoHdls(&memo);
             Log("[ShellHelper] ERROR: Не удалось получить memo для сплайна");
@@ -767,6 +773,41 @@ bool ParseElementToSegments(const API_Element& element, PathData& path)
     }
 }
 
+// =============== Путь для OffsetHelper ===============
+// Дуги передаются дугами (смещаются точно), прочие сегменты — отрезком A→B, как и при разборе
+static void ToOffsetPath(const PathData& path, OffsetHelper::Path& out)
+{
+    out.Clear();
+    for (UIndex i = 0; i < path.segs.GetSize(); ++i) {
+        const Seg& seg = path.segs[i];
+        if (seg.type == SegType::Arc) {
+            double sweep = seg.a1 - seg.a0;
+            if (seg.ccw && sweep < 0.0)  sweep += 2.0 * kPI;
+            if (!seg.ccw && sweep > 0.0) sweep -= 2.0 * kPI;
+            OffsetHelper::AddArc(out, seg.C, seg.r, seg.a0, sweep);
+        } else {
+            OffsetHelper::AddLine(out, seg.A, seg.B);
+        }
+    }
+}
+
+// Замкнутый контур с дополнительными точками не реже шага (для Z по Mesh)
+static void DensifyClosed(const GS::Array<API_Coord>& contour, double step, GS::Array<API_Coord>& out)
+{
+    out.Clear();
+    const UIndex n = contour.GetSize();
+    for (UIndex i = 0; i < n; ++i) {
+        const API_Coord& a = contour[i];
+        const API_Coord& b = contour[(i + 1) % n];
+        const double len = SegLenLine(a, b);
+        const int parts = (step > kEPS) ? std::max(1, (int)std::ceil(len / step)) : 1;
+        for (int k = 0; k < parts; ++k) {
+            const double t = (double)k / (double)parts;
+            out.Push({ a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t });
+        }
+    }
+}
+
 // =============== Создание 3D оболочки через Ruled Shell ===============
 bool Create3DShellFromPath(const PathData& path, double widthMM, double stepMM)
 {
@@ -778,373 +819,172 @@ bool Create3DShellFromPath(const PathData& path, double widthMM, double stepMM)
         return false;
     }
     
-    // Используем логику из LandscapeHelper для получения точек по шагу
-    double step = stepMM / 1000.0; // шаг в метрах
-    
-    // Генерируем позиции точек по шагу (как в DistributeOnSinglePath)
-    GS::Array<double> sVals;
-    for (double s = 0.0; s <= path.total + 1e-9; s += step) {
-        sVals.Push(s);
-    }
-    
-    // Убеждаемся, что последняя точка точно на конце линии
-    if (sVals.IsEmpty() || sVals[sVals.GetSize() - 1] < path.total - 1e-9) {
-        sVals.Push(path.total);
-    }
-    
-    Log("[ShellHelper] Сгенерировано %d точек по шагу %.3fм", (int)sVals.GetSize(), step);
-    
-    GS::Array<API_Coord3D> leftPoints;
-    GS::Array<API_Coord3D> rightPoints;
-    
-    // Обрабатываем каждую точку
-    for (UIndex i = 0; i < sVals.GetSize(); ++i) {
-        double s = sVals[i];
-        // Получаем точку и угол используя логику из LandscapeHelper
-        API_Coord pointOnPath;
-        double tangentAngle = 0.0;
-        
-        // Используем EvalOnPath логику для получения точки и угла
-        double acc = 0.0;
-        bool found = false;
-        for (UIndex j = 0; j < path.segs.GetSize() && !found; ++j) {
-            const Seg& seg = path.segs[j];
-            
-            if (s > acc + seg.len) { 
-                acc += seg.len; 
-                continue; 
-            }
-            const double f = (seg.len < 1e-9) ? 0.0 : (s - acc) / seg.len;
-
-            if (seg.type == SegType::Line) {
-                pointOnPath.x = seg.A.x + f * (seg.B.x - seg.A.x);
-                pointOnPath.y = seg.A.y + f * (seg.B.y - seg.A.y);
-                tangentAngle = std::atan2(seg.B.y - seg.A.y, seg.B.x - seg.A.x);
-            } else if (seg.type == SegType::Arc) {
-                const double sweep = seg.a1 - seg.a0;
-                const double ang = seg.a0 + f * sweep;
-                pointOnPath.x = seg.C.x + seg.r * std::cos(ang);
-                pointOnPath.y = seg.C.y + seg.r * std::sin(ang);
-                tangentAngle = ang + ((sweep >= 0.0) ? kPI / 2.0 : -kPI / 2.0);
-            } else {
-                // Для сплайнов используем линейную интерполяцию
-                pointOnPath.x = seg.A.x + f * (seg.B.x - seg.A.x);
-                pointOnPath.y = seg.A.y + f * (seg.B.y - seg.A.y);
-                tangentAngle = std::atan2(seg.B.y - seg.A.y, seg.B.x - seg.A.x);
-            }
-            found = true;
-        }
-        
-        if (!found) {
-            // Если не нашли сегмент, используем последнюю точку
-            const Seg& seg = path.segs[path.segs.GetSize() - 1];
-            if (seg.type == SegType::Line) {
-                pointOnPath = seg.B;
-                tangentAngle = std::atan2(seg.B.y - seg.A.y, seg.B.x - seg.A.x);
-            } else {
-                const double sweep = seg.a1 - seg.a0;
-                pointOnPath.x = seg.C.x + seg.r * std::cos(seg.a1);
-                pointOnPath.y = seg.C.y + seg.r * std::sin(seg.a1);
-                tangentAngle = seg.a1 + ((sweep >= 0.0) ? kPI / 2.0 : -kPI / 2.0);
-            }
-        }
-        
-        // Шаг 2: Строим перпендикуляры от каждой точки
-        double perpAngle = tangentAngle + kPI / 2.0;
-        double perpX = std::cos(perpAngle);
-        double perpY = std::sin(perpAngle);
-        
-        double halfWidth = widthMM / 2000.0; // Переводим мм в метры и делим пополам
-        
-        // Создаем левую и правую точки на перпендикуляре
-        API_Coord3D leftPoint = {pointOnPath.x + perpX * halfWidth, pointOnPath.y + perpY * halfWidth, 0.0};
-        API_Coord3D rightPoint = {pointOnPath.x - perpX * halfWidth, pointOnPath.y - perpY * halfWidth, 0.0};
-        
-        // Шаг 3: Получаем Z-координаты от Mesh для каждой точки
-        double leftZ = 0.0, rightZ = 0.0;
-        API_Vector3D leftNormal = {}, rightNormal = {};
-        
-        if (GroundHelper::GetGroundZAndNormal(leftPoint, leftZ, leftNormal)) {
-            leftPoint.z = leftZ;
-        } else {
-            Log("[ShellHelper] WARNING: Не удалось получить Z для левой точки");
-            leftPoint.z = 0.0;
-        }
-        
-        if (GroundHelper::GetGroundZAndNormal(rightPoint, rightZ, rightNormal)) {
-            rightPoint.z = rightZ;
-        } else {
-            Log("[ShellHelper] WARNING: Не удалось получить Z для правой точки");
-            rightPoint.z = 0.0;
-        }
-        
-        leftPoints.Push(leftPoint);
-        rightPoints.Push(rightPoint);
-        
-        // Логируем первые и последние точки для отладки
-        if (i < 5 || i >= sVals.GetSize() - 5) {
-            Log("[ShellHelper] Точка %d: left(%.3f, %.3f, %.3f), right(%.3f, %.3f, %.3f)", 
-                (int)i + 1, leftPoint.x, leftPoint.y, leftPoint.z, rightPoint.x, rightPoint.y, rightPoint.z);
-        }
-    }
-    
-    Log("[ShellHelper] Создано %d пар точек для 3D оболочки", (int)leftPoints.GetSize());
-    
-    // Шаг 4: Создаем 2 НЕ замкнутые Spline по найденным точкам
-    Log("[ShellHelper] Создаем два НЕ замкнутых Spline из %d точек", (int)leftPoints.GetSize() * 2);
-    
-    // Создаем левый Spline из левых точек
-    GS::Array<API_Coord> leftSplinePoints;
-    for (UIndex i = 0; i < leftPoints.GetSize(); ++i) {
-        leftSplinePoints.Push({leftPoints[i].x, leftPoints[i].y});
-    }
-    
-    Log("[ShellHelper] Левый Spline: %d точек", (int)leftSplinePoints.GetSize());
-    if (leftSplinePoints.GetSize() > 0) {
-        Log("[ShellHelper] Левый Spline: первая точка (%.3f, %.3f), последняя (%.3f, %.3f)", 
-            leftSplinePoints[0].x, leftSplinePoints[0].y,
-            leftSplinePoints[leftSplinePoints.GetSize()-1].x, leftSplinePoints[leftSplinePoints.GetSize()-1].y);
-    }
-    
-    API_Guid leftSplineGuid = CreateSplineFromPoints(leftSplinePoints);
-    if (leftSplineGuid == APINULLGuid) {
-        Log("[ShellHelper] ERROR: Не удалось создать левый Spline");
+    const double step = stepMM / 1000.0;        // шаг в метрах
+    const double halfWidth = widthMM / 2000.0;  // переводим мм в метры и делим пополам
+
+    // Шаг 1-2: кромки и контур строим эквидистантами пути (OffsetHelper): дуги смещаются
+    // точно, стыки срезаются, петли на тугих изгибах вырезаются — контур сразу без самопересечений
+    OffsetHelper::Path offPath;
+    ToOffsetPath(path, offPath);
+
+    GS::Array<OffsetHelper::Polygon> band;
+    if (!OffsetHelper::BandPolygons(offPath, 2.0 * halfWidth, band)) {
+        Log("[ShellHelper] ERROR: Не удалось построить контур ленты");
         return false;
     }
-    
-    // Создаем правый Spline из правых точек
-    GS::Array<API_Coord> rightSplinePoints;
-    for (UIndex i = 0; i < rightPoints.GetSize(); ++i) {
-        rightSplinePoints.Push({rightPoints[i].x, rightPoints[i].y});
-    }
-    
-    Log("[ShellHelper] Правый Spline: %d точек", (int)rightSplinePoints.GetSize());
-    if (rightSplinePoints.GetSize() > 0) {
-        Log("[ShellHelper] Правый Spline: первая точка (%.3f, %.3f), последняя (%.3f, %.3f)", 
-            rightSplinePoints[0].x, rightSplinePoints[0].y,
-            rightSplinePoints[rightSplinePoints.GetSize()-1].x, rightSplinePoints[rightSplinePoints.GetSize()-1].y);
+    GS::Array<GS::Array<API_Coord>> leftRuns, rightRuns;
+    OffsetHelper::OffsetSide(offPath, halfWidth, leftRuns);
+    OffsetHelper::OffsetSide(offPath, -halfWidth, rightRuns);
+
+    Log("[ShellHelper] Офсет: контур %d точек, левая кромка %d кусков, правая %d",
+        (int)band[0].outer.GetSize(), (int)leftRuns.GetSize(), (int)rightRuns.GetSize());
+
+    // Шаг 4: Создаем НЕ замкнутые Spline по кромкам (кромка, пересекающая ленту, — несколько кусков)
+    for (const GS::Array<API_Coord>& run : leftRuns) {
+        Log("[ShellHelper] Левый Spline: %d точек, первая (%.3f, %.3f), последняя (%.3f, %.3f)",
+            (int)run.GetSize(), run[0].x, run[0].y, run[run.GetSize() - 1].x, run[run.GetSize() - 1].y);
+        if (CreateSplineFromPoints(run) == APINULLGuid) {
+            Log("[ShellHelper] ERROR: Не удалось создать левый Spline");
+            return false;
+        }
     }
-    
-    API_Guid rightSplineGuid = CreateSplineFromPoints(rightSplinePoints);
-    if (rightSplineGuid == APINULLGuid) {
-        Log("[ShellHelper] ERROR: Не удалось создать правый Spline");
-        return false;
+    for (const GS::Array<API_Coord>& run : rightRuns) {
+        Log("[ShellHelper] Правый Spline: %d точек, первая (%.3f, %.3f), последняя (%.3f, %.3f)",
+            (int)run.GetSize(), run[0].x, run[0].y, run[run.GetSize() - 1].x, run[run.GetSize() - 1].y);
+        if (CreateSplineFromPoints(run) == APINULLGuid) {
+            Log("[ShellHelper] ERROR: Не удалось создать правый Spline");
+            return false;
+        }
     }
-    
-    Log("[ShellHelper] SUCCESS: Созданы два НЕ замкнутых Spline (левый и правый)");
-    
-    // Шаг 5: Замыкаем крайние точки обоих Spline простыми линиями
-    Log("[ShellHelper] Замыкаем крайние точки обоих Spline простыми линиями");
-    
-    // Создаем линию между первыми точками (начало)
-    API_Element startLine = {};
-    startLine.header.type = API_LineID;
-    GSErrCode err = ACAPI_Element_GetDefaults(&startLine, nullptr);
-    if (err == NoError) {
-        startLine.line.begC = leftSplinePoints[0];
-        startLine.line.endC = rightSplinePoints[0];
-        
-        Log("[ShellHelper] Start Line: begC=(%.3f,%.3f), endC=(%.3f,%.3f)", 
-            startLine.line.begC.x, startLine.line.begC.y,
-            startLine.line.endC.x, startLine.line.endC.y);
-        
-        err = ACAPI_CallUndoableCommand("Create Start Line", [&]() -> GSErrCode {
-            return ACAPI_Element_Create(&startLine, nullptr);
-        });
-        
+
+    Log("[ShellHelper] SUCCESS: Созданы НЕ замкнутые Spline (левые и правые кромки)");
+
+    // Шаг 5: Замыкаем крайние точки кромок простыми линиями
+    GSErrCode err = NoError;
+    if (!leftRuns.IsEmpty() && !rightRuns.IsEmpty()) {
+        Log("[ShellHelper] Замыкаем крайние точки обоих Spline простыми линиями");
+
+        const GS::Array<API_Coord>& leftFirst = leftRuns[0];
+        const GS::Array<API_Coord>& rightFirst = rightRuns[0];
+        const GS::Array<API_Coord>& leftLast = leftRuns[leftRuns.GetSize() - 1];
+        const GS::Array<API_Coord>& rightLast = rightRuns[rightRuns.GetSize() - 1];
+
+        // Создаем линию между первыми точками (начало)
+        API_Element startLine = {};
+        startLine.header.type = API_LineID;
+        err = ACAPI_Element_GetDefaults(&startLine, nullptr);
         if (err == NoError) {
-            Log("[ShellHelper] SUCCESS: Создана линия между первыми точками");
-        } else {
-            Log("[ShellHelper] ERROR: Не удалось создать линию между первыми точками, err=%d", (int)err);
+            startLine.line.begC = leftFirst[0];
+            startLine.line.endC = rightFirst[0];
+
+            Log("[ShellHelper] Start Line: begC=(%.3f,%.3f), endC=(%.3f,%.3f)",
+                startLine.line.begC.x, startLine.line.begC.y,
+                startLine.line.endC.x, startLine.line.endC.y);
+
+            err = UndoScope::Call("Create Start Line", [&]() -> GSErrCode {
+                return Perf::ElementCreate(&startLine, nullptr);
+            });
+
+            if (err == NoError) {
+                Log("[ShellHelper] SUCCESS: Создана линия между первыми точками");
+            } else {
+                Log("[ShellHelper] ERROR: Не удалось создать линию между первыми точками, err=%d", (int)err);
+            }
         }
-    }
-    
-    // Создаем линию между последними точками (конец)
-    API_Element endLine = {};
-    endLine.header.type = API_LineID;
-    err = ACAPI_Element_GetDefaults(&endLine, nullptr);
-    if (err == NoError) {
-        endLine.line.begC = leftSplinePoints[leftSplinePoints.GetSize() - 1];
-        endLine.line.endC = rightSplinePoints[rightSplinePoints.GetSize() - 1];
-        
-        Log("[ShellHelper] End Line: begC=(%.3f,%.3f), endC=(%.3f,%.3f)", 
-            endLine.line.begC.x, endLine.line.begC.y,
-            endLine.line.endC.x, endLine.line.endC.y);
-        
-        err = ACAPI_CallUndoableCommand("Create End Line", [&]() -> GSErrCode {
-            return ACAPI_Element_Create(&endLine, nullptr);
-        });
-        
+
+        // Создаем линию между последними точками (конец)
+        API_Element endLine = {};
+        endLine.header.type = API_LineID;
+        err = ACAPI_Element_GetDefaults(&endLine, nullptr);
         if (err == NoError) {
-            Log("[ShellHelper] SUCCESS: Создана линия между последними точками");
-        } else {
-            Log("[ShellHelper] ERROR: Не удалось создать линию между последними точками, err=%d", (int)err);
+            endLine.line.begC = leftLast[leftLast.GetSize() - 1];
+            endLine.line.endC = rightLast[rightLast.GetSize() - 1];
+
+            Log("[ShellHelper] End Line: begC=(%.3f,%.3f), endC=(%.3f,%.3f)",
+                endLine.line.begC.x, endLine.line.begC.y,
+                endLine.line.endC.x, endLine.line.endC.y);
+
+            err = UndoScope::Call("Create End Line", [&]() -> GSErrCode {
+                return Perf::ElementCreate(&endLine, nullptr);
+            });
+
+            if (err == NoError) {
+                Log("[ShellHelper] SUCCESS: Создана линия между последними точками");
+            } else {
+                Log("[ShellHelper] ERROR: Не удалось создать линию между последними точками, err=%d", (int)err);
+            }
         }
+
+        Log("[ShellHelper] SUCCESS: Замыкающие линии созданы");
     }
-    
-    Log("[ShellHelper] SUCCESS: Замыкающие линии созданы");
-    
+
     // Шаг 6: Создаем SHELL вместо MESH!
     Log("[ShellHelper] Создаем SHELL вместо MESH!");
-    
-    // Создаем замкнутый контур для MESH: левые точки + правые точки в обратном порядке
-    GS::Array<API_Coord> meshContourPoints;
-    
-    // Добавляем левые точки от начала до конца
-    for (UIndex i = 0; i < leftPoints.GetSize(); ++i) {
-        meshContourPoints.Push({leftPoints[i].x, leftPoints[i].y});
+
+    // Контур MESH — контур ленты (с дырами, если путь замкнут в петлю) с точками не реже шага.
+    // Проверяем и при необходимости правим его до создания, чтобы Mesh создавался с первого раза
+    PolygonHelper::Polygon meshPoly;
+    DensifyClosed(band[0].outer, step, meshPoly.outer);
+    for (const auto& hole : band[0].holes) {
+        GS::Array<API_Coord> dense;
+        DensifyClosed(hole, step, dense);
+        meshPoly.holes.Push(dense);
     }
-    
-    // Добавляем правые точки от конца до начала (в обратном порядке)
-    for (Int32 i = rightPoints.GetSize() - 1; i >= 0; --i) {
-        meshContourPoints.Push({rightPoints[i].x, rightPoints[i].y});
+
+    GS::Array<PolygonHelper::Polygon> meshPieces;
+    if (!PolygonHelper::Regularize(meshPoly, meshPieces)) {
+        Log("[ShellHelper] ERROR: Контур MESH вырожден");
+        return false;
     }
-    
-    Log("[ShellHelper] MESH контур: %d точек", (int)meshContourPoints.GetSize());
-    
-    // СОЗДАЕМ MESH С УРОВНЯМИ! 🎯
+    Log("[ShellHelper] MESH контур: %d точек, %d дыр, полигонов после проверки: %d",
+        (int)meshPoly.outer.GetSize(), (int)meshPoly.holes.GetSize(), (int)meshPieces.GetSize());
+
+    // Z-координаты от Mesh в каждой вершине
+    int zMisses = 0;
+    auto groundZ = [&](const API_Coord& c) -> double {
+        const API_Coord3D p3 = { c.x, c.y, 0.0 };
+        double z = 0.0;
+        API_Vector3D normal = {};
+        if (!GroundHelper::GetGroundZAndNormal(p3, z, normal)) {
+            ++zMisses;
+            z = 0.0;
+        }
+        return z;
+    };
+
     API_Element mesh = {};
     mesh.header.type = API_MeshID;
     err = ACAPI_Element_GetDefaults(&mesh, nullptr);
-    if (err == NoError) {
-        // ПРОСТОЙ MESH КАК ПОЛИГОН! 🎯
-        const Int32 nCoords = (Int32)meshContourPoints.GetSize();
-        
-        mesh.mesh.poly.nCoords = nCoords;
-        mesh.mesh.poly.nSubPolys = 1;
-        mesh.mesh.poly.nArcs = 0;
-        
-        Log("[ShellHelper] ПРОСТОЙ MESH: %d координат, 1 полигон", (int)nCoords);
-        
-        // Создаем memo для MESH
-        API_ElementMemo meshMemo = {};
-        BNZeroMemory(&meshMemo, sizeof(API_ElementMemo));
-        
-        // ВЫДЕЛЯЕМ ПАМЯТЬ ДЛЯ КООРДИНАТ! 🎯
-        meshMemo.coords = reinterpret_cast<API_Coord**>(BMAllocateHandle((nCoords + 1) * (GSSize)sizeof(API_Coord), ALLOCATE_CLEAR, 0));
-        if (meshMemo.coords != nullptr) {
-            // Инициализируем элемент с индексом 0
-            (*meshMemo.coords)[0] = meshContourPoints[0]; // Заглушка для элемента 0
-            
-            // Заполняем координаты (1-based indexing)
-            for (UIndex i = 0; i < meshContourPoints.GetSize(); ++i) {
-                (*meshMemo.coords)[i + 1] = meshContourPoints[i];
-            }
-            
-            // ВЫДЕЛЯЕМ ПАМЯТЬ ДЛЯ Z-КООРДИНАТ! 🎯
-            meshMemo.meshPolyZ = reinterpret_cast<double**>(BMAllocateHandle((nCoords + 1) * (GSSize)sizeof(double), ALLOCATE_CLEAR, 0));
-            if (meshMemo.meshPolyZ != nullptr) {
-                // Инициализируем элемент с индексом 0
-                (*meshMemo.meshPolyZ)[0] = 0.0; // Заглушка для элемента 0
-                
-                // Заполняем Z-координаты из левых и правых точек
-                UIndex zIndex = 1; // 1-based indexing
-                
-                // Добавляем Z-координаты левых точек (от начала до конца)
-                for (UIndex i = 0; i < leftPoints.GetSize(); ++i) {
-                    (*meshMemo.meshPolyZ)[zIndex++] = leftPoints[i].z;
-                }
-                
-                // Добавляем Z-координаты правых точек (от конца до начала)
-                for (Int32 i = rightPoints.GetSize() - 1; i >= 0; --i) {
-                    (*meshMemo.meshPolyZ)[zIndex++] = rightPoints[i].z;
-                }
-                
-                Log("[ShellHelper] MESH Z-координаты: %d точек", (int)nCoords);
-                
-                // ПРОСТОЙ MESH БЕЗ УРОВНЕЙ! 🎯
-                // Попробуем создать MESH как простой полигон с Z-координатами
-                Log("[ShellHelper] MESH: создаем простой MESH без уровней");
-            } else {
-                Log("[ShellHelper] ERROR: Не удалось выделить память для Z-координат MESH");
-                ACAPI_DisposeElemMemoHdls(&meshMemo);
-                return false;
-            }
-            
-            // Создаем MESH внутри Undo-команды
-            err = ACAPI_CallUndoableCommand("Create Mesh", [&]() -> GSErrCode {
-                GSErrCode createErr = ACAPI_Element_Create(&mesh, &meshMemo);
-                
-                // Если полигон нерегулярный, нужно его регуляризовать!
-                if (createErr == APIERR_IRREGULARPOLY) {
-                    Log("[ShellHelper] MESH: Полигон нерегулярный, регуляризуем...");
-                    
-                    API_RegularizedPoly poly = {};
-                    poly.coords = meshMemo.coords;
-                    poly.pends = meshMemo.pends;
-                    poly.parcs = meshMemo.parcs;
-                    poly.vertexIDs = meshMemo.vertexIDs;
-                    poly.needVertexAncestry = 1;
-                    
-                    Int32 nResult = 0;
-                    API_RegularizedPoly** polys = nullptr;
-                    GSErrCode regErr = ACAPI_Polygon_RegularizePolygon(&poly, &nResult, &polys);
-                    
-                    if (regErr == NoError && nResult > 0) {
-                        Log("[ShellHelper] MESH: Регуляризация успешна, создаем %d полигонов", (int)nResult);
-                        
-                        // Создаем регуляризованные полигоны
-                        for (Int32 i = 0; i < nResult; i++) {
-                            mesh.mesh.poly.nCoords = BMhGetSize(reinterpret_cast<GSHandle>((*polys)[i].coords)) / sizeof(API_Coord) - 1;
-                            mesh.mesh.poly.nSubPolys = BMhGetSize(reinterpret_cast<GSHandle>((*polys)[i].pends)) / sizeof(Int32) - 1;
-                            mesh.mesh.poly.nArcs = BMhGetSize(reinterpret_cast<GSHandle>((*polys)[i].parcs)) / sizeof(API_PolyArc);
-                            
-                            // Создаем временный memo для регуляризованного полигона
-                            API_ElementMemo tmpMemo = {};
-                            tmpMemo.coords = (*polys)[i].coords;
-                            tmpMemo.pends = (*polys)[i].pends;
-                            tmpMemo.parcs = (*polys)[i].parcs;
-                            tmpMemo.vertexIDs = (*polys)[i].vertexIDs;
-                            
-                            // Выделяем память для Z-координат
-                            tmpMemo.meshPolyZ = reinterpret_cast<double**>(BMAllocateHandle((mesh.mesh.poly.nCoords + 1) * sizeof(double), ALLOCATE_CLEAR, 0));
-                            if (tmpMemo.meshPolyZ != nullptr) {
-                                // Копируем Z-координаты из оригинального meshPolyZ
-                                for (Int32 j = 1; j <= mesh.mesh.poly.nCoords; j++) {
-                                    // Находим соответствующий индекс в оригинальном массиве
-                                    Int32 oldVertexIndex = 1; // Упрощенная логика - можно улучшить
-                                    if (oldVertexIndex <= (Int32)meshContourPoints.GetSize()) {
-                                        (*tmpMemo.meshPolyZ)[j] = (*meshMemo.meshPolyZ)[oldVertexIndex];
-                                    } else {
-                                        (*tmpMemo.meshPolyZ)[j] = 0.0;
-                                    }
-                                }
-                                
-                                GSErrCode pieceErr = ACAPI_Element_Create(&mesh, &tmpMemo);
-                                if (pieceErr != NoError) {
-                                    Log("[ShellHelper] MESH ERROR: Не удалось создать регуляризованный полигон %d, err=%d", (int)i, (int)pieceErr);
-                                }
-                                
-                                BMKillHandle(reinterpret_cast<GSHandle*>(&tmpMemo.meshPolyZ));
-                            }
-                        }
-                        
-                        createErr = NoError; // Успешно создали регуляризованные полигоны
-                    } else {
-                        Log("[ShellHelper] MESH ERROR: Не удалось регуляризовать полигон, err=%d", (int)regErr);
-                    }
-                }
-                
-                return createErr;
-            });
-            
-            if (err == NoError) {
-                Log("[ShellHelper] SUCCESS: ПРОСТОЙ MESH создан! %d координат", (int)nCoords);
-                ACAPI_DisposeElemMemoHdls(&meshMemo);
-                return true;
-            } else {
-                Log("[ShellHelper] ERROR: Не удалось создать простой MESH, err=%d", (int)err);
-                ACAPI_DisposeElemMemoHdls(&meshMemo);
-                return false;
+    if (err != NoError) {
+        Log("[ShellHelper] ERROR: Не удалось получить настройки по умолчанию для MESH, err=%d", (int)err);
+        return false;
+    }
+
+    // Создаем MESH внутри Undo-команды — один раз, без пробного создания
+    err = UndoScope::Call("Create Mesh", [&]() -> GSErrCode {
+        for (UIndex i = 0; i < meshPieces.GetSize(); ++i) {
+            API_ElementMemo meshMemo = {};
+            GSErrCode pieceErr = FillMeshMemo(meshPieces[i], groundZ, mesh, meshMemo);
+            if (pieceErr == NoError)
+                pieceErr = Perf::ElementCreate(&mesh, &meshMemo);
+            ACAPI_DisposeElemMemoHdls(&meshMemo);
+            if (pieceErr != NoError) {
+                Log("[ShellHelper] MESH ERROR: Не удалось создать полигон %d, err=%d", (int)i, (int)pieceErr);
+                return pieceErr;
             }
-        } else {
-            Log("[ShellHelper] ERROR: Не удалось выделить память для координат MESH");
-            return false;
         }
-    } else {
-        Log("[ShellHelper] ERROR: Не удалось получить настройки по умолчанию для MESH, err=%d", (int)err);
+        return NoError;
+    });
+
+    if (zMisses > 0)
+        Log("[ShellHelper] WARNING: Не удалось получить Z для %d точек контура", zMisses);
+
+    if (err != NoError) {
+        Log("[ShellHelper] ERROR: Не удалось создать MESH, err=%d", (int)err);
         return false;
     }
+    Log("[ShellHelper] SUCCESS: MESH создан, полигонов: %d", (int)meshPieces.GetSize());
+    return true;
 }
 
 // =============== Создание Spline из 2D точек ===============
@@ -1269,8 +1109,8 @@ API_Guid CreateSplineFromPoints(const GS::Array<API_Coord>& points)
     
     
     // Создаем элемент внутри Undo-команды
-    err = ACAPI_CallUndoableCommand("Create Spline", [&]() -> GSErrCode {
-        return ACAPI_Element_Create(&spline, &memo);
+    err = UndoScope::Call("Create Spline", [&]() -> GSErrCode {
+        return Perf::ElementCreate(&spline, &memo);
     });
     ACAPI_DisposeElemMemoHdls(&memo);
     
@@ -1346,8 +1186,8 @@ API_Guid Create3DShell(const GS::Array<API_Coord3D>& points)
     // Для Shell настройки делаются через memo, не нужно менять shell.shell.poly
     
     // Создаем элемент внутри Undo-команды
-    err = ACAPI_CallUndoableCommand("Create 3D Shell", [&]() -> GSErrCode {
-        return ACAPI_Element_Create(&shell, &memo);
+    err = UndoScope::Call("Create 3D Shell", [&]() -> GSErrCode {
+        return Perf::ElementCreate(&shell, &memo);
     });
     ACAPI_DisposeElemMemoHdls(&memo);
     
@@ -1428,7 +1268,7 @@ bool CreateRuledShell(const API_Guid& leftSplineGuid, const API_Guid& rightSplin
     // Для Shell настройки делаются через memo, не нужно менять shellClass
     
     // Создаем элемент
-    err = ACAPI_Element_Create(&shell, &memo);
+    err = Perf::ElementCreate(&shell, &memo);
     ACAPI_DisposeElemMemoHdls(&memo);
     
     if (err != NoError) {
@@ -1453,7 +1293,7 @@ bool CreatePerpendicularLinesFromSegments(const PathData& path, double widthMM)
     
     double halfWidth = widthMM / 2000.0; // Переводим мм в метры и делим пополам
     
-    ACAPI_CallUndoableCommand("Create Shell Lines", [&] () -> GSErrCode {
+    UndoScope::Call("Create Shell Lines", [&] () -> GSErrCode {
         
         // Создаем перпендикулярные линии с шагом
         // ОПТИМИЗАЦИЯ: увеличиваем шаг для уменьшения количества вызовов GetGroundZAndNormal
@@ -1562,7 +1402,7 @@ bool CreatePerpendicularLinesFromSegments(const PathData& path, double widthMM)
             line.line.endC.x = pointOnPath.x - perpX * halfWidth;
             line.line.endC.y = pointOnPath.y - perpY * halfWidth;
             
-            err = ACAPI_Element_Create(&line, nullptr);
+            err = Perf::ElementCreate(&line, nullptr);
             if (err != NoError) {
                 Log("[ShellHelper] ERROR: Не удалось создать перпендикулярную линию, err=%d", (int)err);
             } else {
@@ -1624,7 +1464,7 @@ GS::Array<API_Coord3D> Get3DPointsAlongBaseLine(double stepMM)
     // Получаем элемент базовой линии
     API_Element element = {};
     element.header.guid = g_baseLineGuid;
-    GSErrCode err = ACAPI_Element_Get(&element);
+    GSErrCode err = Perf::ElementGet(&element);
     if (err != NoError) {
         Log("[ShellHelper] ERROR: Не удалось получить элемент базовой линии");
         return points;
@@ -1796,8 +1636,8 @@ bool CreateSimpleShell()
         }
         
         // Создаем SHELL внутри Undo-команды
-        err = ACAPI_CallUndoableCommand("Create Simple Shell", [&]() -> GSErrCode {
-            return ACAPI_Element_Create(&shell, &shellMemo);
+        err = UndoScope::Call("Create Simple Shell", [&]() -> GSErrCode {
+            return Perf::ElementCreate(&shell, &shellMemo);
         });
         
         if (err == NoError) {
@@ -0,0 +1,11 @@
+#include "UndoScope.hpp"
+
+namespace UndoScope {
+
+int& Depth ()
+{
+    static int depth = 0;
+    return depth;
+}
+
+}
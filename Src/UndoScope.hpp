@@ -0,0 +1,36 @@
+﻿#ifndef UNDOSCOPE_HPP
+#define UNDOSCOPE_HPP
+
+#include "APIEnvir.h"
+#include "ACAPinc.h"
+#include "GSRoot.hpp"
+#include "Perf.hpp"
+
+// ============================================================================
+// UndoScope — обёртка над ACAPI_CallUndoableCommand с вложенностью:
+// внутри уже открытой команды (скрипт REPL, воспроизведение макроса) вызовы
+// помощников выполняются напрямую, и весь пакет остаётся одним шагом Undo.
+// ============================================================================
+namespace UndoScope {
+
+    // Глубина вложенности (0 — вне команды); только главный поток
+    int& Depth ();
+
+    inline bool IsOpen () { return Depth() > 0; }
+
+    template <typename F>
+    GSErrCode Call (const GS::UniString& undoName, F&& fn)
+    {
+        if (Depth() > 0) return (GSErrCode)fn();
+        Perf::ScopedTimer timer(Perf::Timer::Undo);
+        return ACAPI_CallUndoableCommand(undoName, [&]() -> GSErrCode {
+            ++Depth();
+            const GSErrCode err = (GSErrCode)fn();
+            --Depth();
+            return err;
+        });
+    }
+
+}
+
+#endif // UNDOSCOPE_HPP